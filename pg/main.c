@@ -125,18 +125,18 @@ main(int argc, char **argv)
     vc_device_builder_end(b);
     (void)comp_queue;
 
+    u64 code_size = 0;
+    u8 *code      = fio_read_whole_file("pg_shaders/test.comp.spv", &code_size);
+
+    // The layout is reflected from the shader, its set layout is needed to allocate the image sets
+    vc_pipeline_layout_info reflected = vc_pipeline_layout_reflect(&ctx, 1, &code, &code_size);
+    if(reflected.set_layout_count == 0)
     {
-        vc_descriptor_set_layout_builder builder =
-        {
-            0
-        };
-        vc_descriptor_set_layout_builder_add_binding(&builder, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
-        pipe_layout = vc_descriptor_set_layout_builder_build(&ctx, &builder, 0);
+        printf("Failed to reflect the layout of pg_shaders/test.comp.spv.\n");
+        return 1;
     }
+    pipe_layout = reflected.set_layouts[0];
 
-
-    u64 code_size                 = 0;
-    u8 *code                      = fio_read_whole_file("pg_shaders/test.comp.spv", &code_size);
     vc_compute_pipeline comp_pipe = vc_compute_pipeline_create(
         &ctx,
         code,
@@ -144,15 +144,7 @@ main(int argc, char **argv)
         "main",
         (vc_pipeline_layout_info)
         {
-            .set_layout_count     = 1,
-            .set_layouts          = &pipe_layout,
-            .push_constants_count = 1,
-            .push_constants       = &(VkPushConstantRange)
-            {
-                .size       = sizeof(size),
-                .offset     = 0,
-                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
-            }
+            0
         }
         );
     (void)comp_pipe;
@@ -289,6 +281,7 @@ main(int argc, char **argv)
         vc_semaphore sem;
         vc_semaphore sem_2;
         vc_device_wait_idle(&ctx);
+        vc_frame_begin(&ctx);
         vc_swpchn_img_id id   = vc_swapchain_acquire_image(&ctx, swapchain, &sem);
         vc_swpchn_img_id id_2 = vc_swapchain_acquire_image(&ctx, swapchain_2, &sem_2);
 
@@ -484,6 +477,7 @@ main(int argc, char **argv)
 
         vc_command_buffer_end(rec);
         vc_command_buffer_submit(&ctx, comp_buf, comp_queue, 2, (vc_semaphore[2]) { sem, sem_2 }, (VkPipelineStageFlags[2]){ VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT }, 1, &sig_sem);
+        vc_frame_end(&ctx, comp_queue);
 
         vc_swapchain_present_images(&ctx, 2, (vc_swapchain[2]){ swapchain, swapchain_2 }, (vc_swpchn_img_id[2]){ id, id_2 }, pres_queue, 1, &sig_sem );
 
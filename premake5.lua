@@ -11,7 +11,7 @@ targetdir("bin")
 buildoptions({"-Wall", "-Werror", "-g"})
 libdirs({"third_party/vma/", "third_party/cimgui"})
 includedirs({"third_party/vma/", "third_party/cimgui"})
-links({"m", "vulkan", "vma", "cimgui"})
+links({"m", "pthread", "vulkan", "vma", "cimgui"})
 files({"src/**.c"})
 
 -- Playground
@@ -24,6 +24,6 @@ buildoptions({"-Wall", "-Werror", "-g"})
 dependson({"libvulcain"})
 libdirs({"bin/","third_party/cimgui"})
 libdirs({"third_party/vma/", "third_party/cimgui"})
-links({"m", "vulcain", "glfw", "vulkan", "vma", "stdc++", "cimgui"})
+links({"m", "pthread", "vulcain", "glfw", "vulkan", "vma", "stdc++", "cimgui"})
 includedirs({"third_party/vma/", "src/", "third_party/cimgui"})
 files({"pg/**.c","pg/**.h"})
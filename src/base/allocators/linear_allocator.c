@@ -0,0 +1,39 @@
+#include "linear_allocator.h"
+
+void    mem_linear_create(mem_linear *linear, void *memory, u64 size)
+{
+    linear->memory = memory;
+    linear->size   = size;
+    linear->head   = 0;
+}
+
+void   *mem_linear_alloc(mem_linear *linear, u64 size, u64 alignment)
+{
+    u64 head = __atomic_load_n(&linear->head, __ATOMIC_RELAXED);
+    u64 offset;
+    do
+    {
+        offset = (head + alignment - 1) & ~(alignment - 1);
+        if (offset + size > linear->size)
+        {
+            return NULL;
+        }
+    }
+    while (!__atomic_compare_exchange_n(&linear->head, &head, offset + size, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return (u8 *)linear->memory + offset;
+}
+
+void    mem_linear_reset(mem_linear   *linear)
+{
+    __atomic_store_n(&linear->head, 0, __ATOMIC_RELAXED);
+}
+
+void   *mem_linear_destroy(mem_linear   *linear)
+{
+    void *memory = linear->memory;
+    linear->memory = NULL;
+    linear->size   = 0;
+    linear->head   = 0;
+    return memory;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Linear (bump) allocator: allocations are only freed all at once, allocating is thread safe
+
+#include "../base.h"
+#include "../types.h"
+
+/**
+ * @brief A linear allocator object
+ *
+ */
+typedef struct
+{
+    void   *memory;
+    u64     size;
+    u64     head; // Atomic
+} mem_linear;
+
+/**
+ * @brief Creates a linear allocator over a memory block
+ *
+ * @param linear A linear allocator object
+ * @param memory The memory block
+ * @param size The size of the memory block
+ */
+void    mem_linear_create(mem_linear *linear, void *memory, u64 size);
+
+/**
+ * @brief Allocates from the allocator, thread safe
+ *
+ * @param linear The linear allocator object
+ * @param size The size of the allocation
+ * @param alignment The alignment of the allocation, a power of two
+ * @return void* A pointer to the allocation, is NULL if the block is full
+ */
+void   *mem_linear_alloc(mem_linear *linear, u64 size, u64 alignment);
+
+/**
+ * @brief Frees every allocation at once
+ *
+ * @param linear The linear allocator object
+ * @attention No allocation may happen during the reset.
+ */
+void    mem_linear_reset(mem_linear   *linear);
+
+/**
+ * @brief Destroys the allocator
+ *
+ * @param linear The linear allocator to destroy
+ * @return void* A pointer to the block of memory
+ */
+void   *mem_linear_destroy(mem_linear   *linear);
@@ -3,6 +3,7 @@
 #include "compiler.h"
 #include "fio.h"
 #include "flags.h"
+#include "hash.h"
 #include "logging.h"
 #include "math.h"
 #include "memory.h"
@@ -108,6 +108,14 @@ b8      _darray_qsort(void *array, darray_usr_compare_func cmp);
 #define darray_length(array) \
         _darray_get_field(array, DARRAY_LENGTH)
 
+/**
+ * @brief Removes every element of the array, keeping its capacity
+ *
+ * @param array The array
+ */
+#define darray_clear(array) \
+        _darray_set_field(array, DARRAY_LENGTH, 0)
+
 /**
  * @brief Gets the current capacity of the array ()
  *
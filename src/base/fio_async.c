@@ -0,0 +1,481 @@
+#include "fio_async.h"
+#include "memory.h"
+#include "data_structures/darray.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+struct fio_async_request
+{
+    fio_async_reader     *reader;
+    i32                   fd;
+
+    u8                   *dest;
+    u64                   offset;
+    u64                   size;
+    u64                   done; // Bytes already read, reads may be short
+    i64                   result;
+
+    struct iovec          iov;
+
+    fio_async_callback    callback;
+    void                 *usr_data;
+};
+
+// ## Common
+
+b8      fio_get_file_size(const char *filepath, u64 *file_size)
+{
+    struct stat st;
+    if (stat(filepath, &st) != 0)
+    {
+        return FALSE;
+    }
+
+    *file_size = st.st_size;
+    return TRUE;
+}
+
+void    _fio_async_request_free(fio_async_request   *req)
+{
+    close(req->fd);
+    mem_free(req);
+}
+
+void    _fio_async_complete(fio_async_reader *reader, fio_async_request *req)
+{
+    reader->pending_count--;
+
+    fio_async_callback callback = req->callback;
+    void *usr_data              = req->usr_data;
+    i64 result                  = req->result < 0 ? req->result : (i64)req->done;
+
+    // Freed first, callbacks may start new reads
+    _fio_async_request_free(req);
+
+    if (callback)
+    {
+        callback(usr_data, result);
+    }
+}
+
+// ## io_uring backend
+
+b8      _fio_uring_setup(fio_async_reader *reader, u32 queue_depth)
+{
+    struct io_uring_params params;
+    mem_memset(&params, 0, sizeof(params));
+
+    i32 fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    reader->ring_fd      = fd;
+    reader->queue_depth  = params.sq_entries;
+    reader->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    reader->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    b8 single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        u64 size             = reader->sq_ring_size > reader->cq_ring_size ? reader->sq_ring_size : reader->cq_ring_size;
+        reader->sq_ring_size = size;
+        reader->cq_ring_size = size;
+    }
+
+    reader->sq_ring = mmap(NULL, reader->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    reader->cq_ring = single_mmap ?
+                      reader->sq_ring :
+                      mmap(NULL, reader->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    reader->sqes    = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (reader->sq_ring == MAP_FAILED || reader->cq_ring == MAP_FAILED || reader->sqes == MAP_FAILED)
+    {
+        if (reader->sq_ring != MAP_FAILED)
+            munmap(reader->sq_ring, reader->sq_ring_size);
+        if (!single_mmap && reader->cq_ring != MAP_FAILED)
+            munmap(reader->cq_ring, reader->cq_ring_size);
+        if (reader->sqes != MAP_FAILED)
+            munmap(reader->sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+        close(fd);
+        return FALSE;
+    }
+
+    u8 *sq = reader->sq_ring;
+    u8 *cq = reader->cq_ring;
+
+    reader->sq_head  = (u32 *)(sq + params.sq_off.head);
+    reader->sq_tail  = (u32 *)(sq + params.sq_off.tail);
+    reader->sq_mask  = (u32 *)(sq + params.sq_off.ring_mask);
+    reader->sq_array = (u32 *)(sq + params.sq_off.array);
+    reader->cq_head  = (u32 *)(cq + params.cq_off.head);
+    reader->cq_tail  = (u32 *)(cq + params.cq_off.tail);
+    reader->cq_mask  = (u32 *)(cq + params.cq_off.ring_mask);
+    reader->cqes     = cq + params.cq_off.cqes;
+
+    reader->in_flight = 0;
+    reader->backlog   = darray_create(fio_async_request *);
+    reader->failed    = darray_create(fio_async_request *);
+
+    return TRUE;
+}
+
+void    _fio_uring_teardown(fio_async_reader   *reader)
+{
+    munmap(reader->sqes, reader->queue_depth * sizeof(struct io_uring_sqe));
+    if (reader->cq_ring != reader->sq_ring)
+    {
+        munmap(reader->cq_ring, reader->cq_ring_size);
+    }
+    munmap(reader->sq_ring, reader->sq_ring_size);
+    close(reader->ring_fd);
+
+    darray_destroy(reader->backlog);
+    darray_destroy(reader->failed);
+}
+
+// Moves as many requests as possible from the backlog to the ring, and submits them at once
+void    _fio_uring_submit_backlog(fio_async_reader   *reader)
+{
+    u32 count = 0;
+    u32 tail  = *reader->sq_tail;
+    u32 mask  = *reader->sq_mask;
+
+    while (reader->in_flight < reader->queue_depth && darray_length(reader->backlog) > 0)
+    {
+        fio_async_request *req;
+        darray_pop_at(reader->backlog, 0, &req);
+
+        req->iov.iov_base = req->dest + req->done;
+        req->iov.iov_len  = req->size - req->done;
+
+        u32 index                = tail & mask;
+        struct io_uring_sqe *sqe = &( (struct io_uring_sqe *)reader->sqes )[index];
+        mem_memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_READV;
+        sqe->fd        = req->fd;
+        sqe->addr      = (u64)&req->iov;
+        sqe->len       = 1;
+        sqe->off       = req->offset + req->done;
+        sqe->user_data = (u64)req;
+
+        reader->sq_array[index] = index;
+        tail++;
+        count++;
+        reader->in_flight++;
+    }
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Publish the entries before the kernel reads the tail
+    __atomic_store_n(reader->sq_tail, tail, __ATOMIC_RELEASE);
+
+    i32 submitted = 0;
+    do
+    {
+        submitted = syscall(__NR_io_uring_enter, reader->ring_fd, count, 0, 0, NULL, 0);
+    }
+    while (submitted < 0 && errno == EINTR);
+
+    // The kernel consumed the entries up to its head, the others are taken back out of the ring
+    u32 head = __atomic_load_n(reader->sq_head, __ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+        return;
+    }
+
+    i32 error = submitted < 0 ? errno : 0;
+    if (error != 0 && error != EAGAIN && error != EBUSY)
+    {
+        WARN("Could not submit %u reads to io_uring (%s).", tail - head, strerror(error) );
+    }
+
+    u32 returned = 0;
+    for (u32 i = head; i != tail; i++)
+    {
+        struct io_uring_sqe *sqe = &( (struct io_uring_sqe *)reader->sqes )[reader->sq_array[i & mask]];
+        fio_async_request *req   = (fio_async_request *)sqe->user_data;
+        reader->in_flight--;
+
+        if (error == 0 || error == EAGAIN || error == EBUSY)
+        {
+            // Transient, kept in order at the front of the backlog for the next submission
+            darray_insert_at(reader->backlog, req, returned);
+            returned++;
+        }
+        else
+        {
+            req->result = -error;
+            darray_push(reader->failed, req);
+        }
+    }
+    __atomic_store_n(reader->sq_tail, head, __ATOMIC_RELEASE);
+}
+
+// Reaps completions. Finished requests are completed (if complete is TRUE) or dropped, short reads are resubmitted.
+u32     _fio_uring_reap(fio_async_reader *reader, b8 complete)
+{
+    u32 completed = 0;
+    u32 head      = *reader->cq_head;
+    u32 mask      = *reader->cq_mask;
+
+    while (head != __atomic_load_n(reader->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe *cqe = &( (struct io_uring_cqe *)reader->cqes )[head & mask];
+        fio_async_request *req   = (fio_async_request *)cqe->user_data;
+        i32 res                  = cqe->res;
+
+        head++;
+        reader->in_flight--;
+
+        if (res == -EAGAIN || res == -EINTR)
+        {
+            darray_push(reader->backlog, req);
+            continue;
+        }
+
+        if (res < 0)
+        {
+            req->result = res;
+        }
+        else
+        {
+            req->done += res;
+            if (res > 0 && req->done < req->size)
+            {
+                darray_push(reader->backlog, req);
+                continue;
+            }
+        }
+
+        if (complete)
+        {
+            _fio_async_complete(reader, req);
+        }
+        else
+        {
+            reader->pending_count--;
+            _fio_async_request_free(req);
+        }
+        completed++;
+    }
+
+    __atomic_store_n(reader->cq_head, head, __ATOMIC_RELEASE);
+    return completed;
+}
+
+void    _fio_uring_wait(fio_async_reader   *reader)
+{
+    if (reader->in_flight == 0)
+    {
+        return;
+    }
+
+    i32 res = 0;
+    do
+    {
+        res = syscall(__NR_io_uring_enter, reader->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    }
+    while (res < 0 && errno == EINTR);
+
+    if (res < 0)
+    {
+        WARN("Could not wait for io_uring completions (%s).", strerror(errno) );
+    }
+}
+
+// ## Thread pool backend
+
+void    _fio_pool_read_job(void   *usr_data)
+{
+    fio_async_request *req = usr_data;
+
+    while (req->done < req->size)
+    {
+        ssize_t res = pread(req->fd, req->dest + req->done, req->size - req->done, req->offset + req->done);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            req->result = -errno;
+            break;
+        }
+
+        if (res == 0)
+        {
+            break; // End of file
+        }
+        req->done += res;
+    }
+
+    fio_async_reader *reader = req->reader;
+    pthread_mutex_lock(&reader->completed_lock);
+    darray_push(reader->completed, req);
+    pthread_mutex_unlock(&reader->completed_lock);
+}
+
+fio_async_request **_fio_pool_take_completed(fio_async_reader   *reader)
+{
+    pthread_mutex_lock(&reader->completed_lock);
+    fio_async_request **completed = reader->completed;
+    reader->completed = darray_create(fio_async_request *);
+    pthread_mutex_unlock(&reader->completed_lock);
+
+    return completed;
+}
+
+// ## Interface
+
+b8      fio_async_create(fio_async_reader *reader, u32 queue_depth, u32 fallback_threads)
+{
+    mem_memset(reader, 0, sizeof(fio_async_reader));
+
+    reader->uring_enabled = _fio_uring_setup(reader, queue_depth);
+    if (reader->uring_enabled)
+    {
+        return TRUE;
+    }
+
+    // io_uring may be missing or forbidden (old kernels, seccomp filters...)
+    pthread_mutex_init(&reader->completed_lock, NULL);
+    reader->completed = darray_create(fio_async_request *);
+
+    return thread_pool_create(&reader->pool, fallback_threads);
+}
+
+void    fio_async_destroy(fio_async_reader   *reader)
+{
+    if (reader->uring_enabled)
+    {
+        // Requests that never reached the kernel are simply dropped
+        for (u32 i = 0; i < darray_length(reader->backlog); i++)
+        {
+            _fio_async_request_free(reader->backlog[i]);
+        }
+        darray_clear(reader->backlog);
+        for (u32 i = 0; i < darray_length(reader->failed); i++)
+        {
+            _fio_async_request_free(reader->failed[i]);
+        }
+        darray_clear(reader->failed);
+
+        while (reader->in_flight > 0)
+        {
+            _fio_uring_wait(reader);
+            _fio_uring_reap(reader, FALSE);
+
+            for (u32 i = 0; i < darray_length(reader->backlog); i++)
+            {
+                _fio_async_request_free(reader->backlog[i]);
+            }
+            darray_clear(reader->backlog);
+        }
+
+        _fio_uring_teardown(reader);
+        return;
+    }
+
+    thread_pool_destroy(&reader->pool);
+
+    for (u32 i = 0; i < darray_length(reader->completed); i++)
+    {
+        _fio_async_request_free(reader->completed[i]);
+    }
+    darray_destroy(reader->completed);
+    pthread_mutex_destroy(&reader->completed_lock);
+}
+
+b8      fio_async_read(fio_async_reader *reader, const char *filepath, u64 offset, u64 size, void *dest, fio_async_callback callback, void *usr_data)
+{
+    i32 fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    fio_async_request *req = mem_allocate(sizeof(fio_async_request), MEMORY_TAG_FIO_DATA);
+    mem_memset(req, 0, sizeof(fio_async_request));
+    req->reader   = reader;
+    req->fd       = fd;
+    req->dest     = dest;
+    req->offset   = offset;
+    req->size     = size;
+    req->callback = callback;
+    req->usr_data = usr_data;
+
+    reader->pending_count++;
+
+    if (reader->uring_enabled)
+    {
+        darray_push(reader->backlog, req);
+        _fio_uring_submit_backlog(reader);
+    }
+    else
+    {
+        thread_pool_submit(&reader->pool, _fio_pool_read_job, req);
+    }
+
+    return TRUE;
+}
+
+u32     fio_async_poll(fio_async_reader   *reader)
+{
+    if (reader->uring_enabled)
+    {
+        u32 completed = _fio_uring_reap(reader, TRUE);
+        _fio_uring_submit_backlog(reader);
+
+        // Requests the ring refused complete with the submission error
+        fio_async_request **failed = reader->failed;
+        reader->failed = darray_create(fio_async_request *);
+        for (u32 i = 0; i < darray_length(failed); i++)
+        {
+            _fio_async_complete(reader, failed[i]);
+        }
+        completed += darray_length(failed);
+        darray_destroy(failed);
+
+        return completed;
+    }
+
+    fio_async_request **completed = _fio_pool_take_completed(reader);
+    u32 count                     = darray_length(completed);
+    for (u32 i = 0; i < count; i++)
+    {
+        _fio_async_complete(reader, completed[i]);
+    }
+    darray_destroy(completed);
+
+    return count;
+}
+
+void    fio_async_wait_all(fio_async_reader   *reader)
+{
+    while (reader->pending_count > 0)
+    {
+        if (reader->uring_enabled)
+        {
+            _fio_uring_submit_backlog(reader);
+            _fio_uring_wait(reader);
+        }
+        else
+        {
+            thread_pool_wait_idle(&reader->pool);
+        }
+
+        fio_async_poll(reader);
+    }
+}
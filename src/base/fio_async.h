@@ -0,0 +1,106 @@
+#pragma once
+
+// Asynchronous file reads. Uses io_uring when the kernel allows it, and falls back to a thread pool otherwise.
+// Completion callbacks are always called from fio_async_poll/fio_async_wait_all, on the calling thread.
+
+#include "types.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Called when an asynchronous read completes
+ *
+ * @param usr_data The user data given with the read
+ * @param result The number of bytes read, or a negative errno value on failure
+ */
+typedef void (*fio_async_callback)(void *usr_data, i64 result);
+
+typedef struct fio_async_request fio_async_request;
+
+typedef struct
+{
+    b8                    uring_enabled;
+
+    // io_uring backend
+    i32                   ring_fd;
+    u32                   queue_depth;
+    void                 *sq_ring;
+    u64                   sq_ring_size;
+    void                 *cq_ring;
+    u64                   cq_ring_size;
+    void                 *sqes;
+
+    u32                  *sq_head;
+    u32                  *sq_tail;
+    u32                  *sq_mask;
+    u32                  *sq_array;
+    u32                  *cq_head;
+    u32                  *cq_tail;
+    u32                  *cq_mask;
+    void                 *cqes;
+
+    u32                   in_flight; // Requests submitted to the ring
+    fio_async_request   **backlog; // darray, requests waiting for room in the ring
+    fio_async_request   **failed; // darray, requests the ring refused, completed at the next poll
+
+    // Thread pool backend
+    thread_pool           pool;
+    pthread_mutex_t       completed_lock;
+    fio_async_request   **completed; // darray, guarded by completed_lock
+
+    u32                   pending_count; // Requests whose callback has not been called yet
+} fio_async_reader;
+
+/**
+ * @brief Creates an asynchronous reader
+ *
+ * @param reader The reader
+ * @param queue_depth The maximum number of reads in flight in the kernel at once
+ * @param fallback_threads The number of threads of the fallback backend (0 for one per processor)
+ * @return Wether the reader could be created
+ */
+b8      fio_async_create(fio_async_reader *reader, u32 queue_depth, u32 fallback_threads);
+
+/**
+ * @brief Waits for all the reads in flight (their callbacks are not called), and destroys the reader
+ *
+ * @param reader The reader
+ */
+void    fio_async_destroy(fio_async_reader   *reader);
+
+/**
+ * @brief Returns the size of a file
+ *
+ * @param filepath The path of the file
+ * @param file_size Out: the size of the file
+ * @return FALSE if the file could not be accessed
+ */
+b8      fio_get_file_size(const char *filepath, u64 *file_size);
+
+/**
+ * @brief Starts reading a part of a file, directly into the destination memory
+ *
+ * @param reader The reader
+ * @param filepath The path of the file
+ * @param offset The offset in the file to start reading at
+ * @param size The number of bytes to read
+ * @param dest The destination, which must stay valid until the callback is called
+ * @param callback Called on completion (may be NULL)
+ * @param usr_data The data passed to the callback
+ * @return FALSE if the file could not be opened
+ */
+b8      fio_async_read(fio_async_reader *reader, const char *filepath, u64 offset, u64 size, void *dest, fio_async_callback callback, void *usr_data);
+
+/**
+ * @brief Processes completed reads, and calls their callbacks
+ *
+ * @param reader The reader
+ * @return The number of completed reads
+ */
+u32     fio_async_poll(fio_async_reader   *reader);
+
+/**
+ * @brief Blocks until every read is complete, calling their callbacks
+ *
+ * @param reader The reader
+ */
+void    fio_async_wait_all(fio_async_reader   *reader);
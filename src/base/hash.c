@@ -0,0 +1,104 @@
+#include "hash.h"
+
+// wyhash by Wang Yi, released in the public domain (The Unlicense)
+
+static const u64 _hash_wyp[4] =
+{
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+static inline void  _hash_wymum(u64 *a, u64 *b)
+{
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+}
+
+static inline u64   _hash_wymix(u64 a, u64 b)
+{
+    _hash_wymum(&a, &b);
+    return a ^ b;
+}
+
+// Unaligned little endian reads
+static inline u64   _hash_read8(const u8 *p)
+{
+    u64 v;
+    __builtin_memcpy(&v, p, 8);
+    return v;
+}
+
+static inline u64   _hash_read4(const u8 *p)
+{
+    u32 v;
+    __builtin_memcpy(&v, p, 4);
+    return v;
+}
+
+static inline u64   _hash_read3(const u8 *p, u64 k)
+{
+    return ( ( (u64)p[0] ) << 16 ) | ( ( (u64)p[k >> 1] ) << 8 ) | p[k - 1];
+}
+
+u64     hash_bytes(const void *data, u64 size, u64 seed)
+{
+    const u8 *p = data;
+    u64 a, b;
+
+    seed ^= _hash_wymix(seed ^ _hash_wyp[0], _hash_wyp[1]);
+
+    if (size <= 16)
+    {
+        if (size >= 4)
+        {
+            a = (_hash_read4(p) << 32) | _hash_read4(p + ( (size >> 3) << 2 ) );
+            b = (_hash_read4(p + size - 4) << 32) | _hash_read4(p + size - 4 - ( (size >> 3) << 2 ) );
+        }
+        else if (size > 0)
+        {
+            a = _hash_read3(p, size);
+            b = 0;
+        }
+        else
+        {
+            a = 0;
+            b = 0;
+        }
+    }
+    else
+    {
+        u64 i = size;
+        if (i > 48)
+        {
+            u64 see1 = seed;
+            u64 see2 = seed;
+            do
+            {
+                seed = _hash_wymix(_hash_read8(p) ^ _hash_wyp[1], _hash_read8(p + 8) ^ seed);
+                see1 = _hash_wymix(_hash_read8(p + 16) ^ _hash_wyp[2], _hash_read8(p + 24) ^ see1);
+                see2 = _hash_wymix(_hash_read8(p + 32) ^ _hash_wyp[3], _hash_read8(p + 40) ^ see2);
+                p   += 48;
+                i   -= 48;
+            }
+            while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16)
+        {
+            seed = _hash_wymix(_hash_read8(p) ^ _hash_wyp[1], _hash_read8(p + 8) ^ seed);
+            i   -= 16;
+            p   += 16;
+        }
+
+        a = _hash_read8(p + i - 16);
+        b = _hash_read8(p + i - 8);
+    }
+
+    a ^= _hash_wyp[1];
+    b ^= seed;
+    _hash_wymum(&a, &b);
+
+    return _hash_wymix(a ^ _hash_wyp[0] ^ size, b ^ _hash_wyp[1]);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Non cryptographic hashing
+
+#include "types.h"
+
+/**
+ * @brief Hashes a memory region (wyhash, final version 4)
+ *
+ * @param data The data to hash
+ * @param size The size of the data in bytes
+ * @param seed The seed, different seeds give independent hashes
+ * @return The hash of the data
+ */
+u64     hash_bytes(const void *data, u64 size, u64 seed);
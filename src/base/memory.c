@@ -36,6 +36,19 @@ void    memory_shutdown()
     };
 }
 
+// Allocations may happen on any thread (thread pool jobs), the counters are updated atomically
+void    _mem_usage_add(enum memory_alloc_tag tag, u64 size)
+{
+    __atomic_add_fetch(&current_memory_usage.total_memory_usage, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&current_memory_usage.tags_memory_usage[tag], size, __ATOMIC_RELAXED);
+}
+
+void    _mem_usage_sub(enum memory_alloc_tag tag, u64 size)
+{
+    __atomic_sub_fetch(&current_memory_usage.total_memory_usage, size, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&current_memory_usage.tags_memory_usage[tag], size, __ATOMIC_RELAXED);
+}
+
 void   *mem_allocate(u64 size, enum memory_alloc_tag tag)
 {
     if (tag == MEMORY_TAG_UNKNOWN)
@@ -49,8 +62,7 @@ void   *mem_allocate(u64 size, enum memory_alloc_tag tag)
     void *mem           = platform_alloc(full_alloc_size);
     ASSERT_MSG(mem, "Memory allocation failed.");
 
-    current_memory_usage.total_memory_usage     += full_alloc_size;
-    current_memory_usage.tags_memory_usage[tag] += full_alloc_size;
+    _mem_usage_add(tag, full_alloc_size);
 
     // Write data in the header
     struct mem_chunk_header *header = mem;
@@ -64,13 +76,13 @@ void   *mem_allocate(u64 size, enum memory_alloc_tag tag)
 void   *mem_reallocate(void *ptr, u64 size)
 {
     struct mem_chunk_header *full_block = ptr - sizeof(struct mem_chunk_header);
-    current_memory_usage.total_memory_usage                            -= full_block->allocated_size;
-    current_memory_usage.tags_memory_usage[full_block->allocated_type] -= full_block->allocated_size;
-
-    current_memory_usage.total_memory_usage                            += size;
-    current_memory_usage.tags_memory_usage[full_block->allocated_type] += size;
+    u64 full_alloc_size                 = sizeof(struct mem_chunk_header) + size;
+    _mem_usage_sub(full_block->allocated_type, full_block->allocated_size);
+    _mem_usage_add(full_block->allocated_type, full_alloc_size);
 
-    full_block = platform_realloc( full_block, size + sizeof(struct mem_chunk_header) );
+    full_block = platform_realloc(full_block, full_alloc_size);
+    ASSERT_MSG(full_block, "Memory allocation failed.");
+    full_block->allocated_size = full_alloc_size;
 
     void *result = (void *)( (u64)full_block + sizeof(struct mem_chunk_header) );
     return result;
@@ -85,8 +97,7 @@ void    mem_free(void   *ptr)
     (void)full_chunk;
 
     struct mem_chunk_header *header = full_chunk;
-    current_memory_usage.total_memory_usage                        -= header->allocated_size;
-    current_memory_usage.tags_memory_usage[header->allocated_type] -= header->allocated_size;
+    _mem_usage_sub(header->allocated_type, header->allocated_size);
 
     platform_free(full_chunk);
 }
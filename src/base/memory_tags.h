@@ -7,6 +7,7 @@ enum memory_alloc_tag
     MEMORY_TAG_DARRAY,
     MEMORY_TAG_STRING,
     MEMORY_TAG_FIO_DATA, // Allocated data used to store File inputs temporarly in memory (read_file)
+    MEMORY_TAG_THREADING, // Thread pools
 
     // Free tags, those can be anything
     MEMORY_TAG_RENDERER,    // Allocated data used by the renderer for it to work
@@ -23,6 +24,7 @@ __attribute__( (unused) ) static char *memory_alloc_tag_names[MEMORY_TAG_COUNT]
     "MEMORY_DARRAY     ",
     "MEMORY_STRING     ",
     "MEMORY_FIO_DATA   ",
+    "MEMORY_THREADING  ",
 
     // Free tags, those can be anything
     "MEMORY_RENDERER   ",
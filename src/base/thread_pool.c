@@ -0,0 +1,124 @@
+#include "thread_pool.h"
+#include "memory.h"
+#include "data_structures/darray.h"
+#include <unistd.h>
+
+void   *_thread_pool_worker(void   *usr_data)
+{
+    thread_pool *pool = usr_data;
+
+    pthread_mutex_lock(&pool->lock);
+    while (TRUE)
+    {
+        while (darray_length(pool->jobs) == 0 && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->job_available, &pool->lock);
+        }
+
+        if (darray_length(pool->jobs) == 0 && pool->stopping)
+        {
+            break;
+        }
+
+        thread_pool_job job;
+        darray_pop_at(pool->jobs, 0, &job);
+        pool->running_jobs++;
+
+        pthread_mutex_unlock(&pool->lock);
+        job.func(job.usr_data);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->running_jobs--;
+        if (pool->running_jobs == 0 && darray_length(pool->jobs) == 0)
+        {
+            pthread_cond_broadcast(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+b8      thread_pool_create(thread_pool *pool, u32 thread_count)
+{
+    if (thread_count == 0)
+    {
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpu_count > 0 ? cpu_count : 1;
+    }
+
+    pool->thread_count = 0;
+    pool->threads      = mem_allocate(sizeof(pthread_t) * thread_count, MEMORY_TAG_THREADING);
+    pool->jobs         = darray_create(thread_pool_job);
+    pool->running_jobs = 0;
+    pool->stopping     = FALSE;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, _thread_pool_worker, pool) != 0)
+        {
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0)
+    {
+        thread_pool_destroy(pool);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void    thread_pool_destroy(thread_pool   *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = TRUE;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Workers drain the remaining jobs before exiting
+    for (u32 i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_mutex_destroy(&pool->lock);
+
+    mem_free(pool->threads);
+    darray_destroy(pool->jobs);
+    pool->threads      = NULL;
+    pool->jobs         = NULL;
+    pool->thread_count = 0;
+}
+
+void    thread_pool_submit(thread_pool *pool, thread_pool_job_func func, void *usr_data)
+{
+    thread_pool_job job =
+    {
+        .func     = func,
+        .usr_data = usr_data,
+    };
+
+    pthread_mutex_lock(&pool->lock);
+    darray_push(pool->jobs, job);
+    pthread_cond_signal(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void    thread_pool_wait_idle(thread_pool   *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running_jobs > 0 || darray_length(pool->jobs) > 0)
+    {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
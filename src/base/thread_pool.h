@@ -0,0 +1,61 @@
+#pragma once
+
+// Simple fixed size thread pool, running jobs in submission order
+
+#include "types.h"
+
+#include <pthread.h>
+
+typedef void (*thread_pool_job_func)(void *usr_data);
+
+typedef struct
+{
+    thread_pool_job_func    func;
+    void                   *usr_data;
+} thread_pool_job;
+
+typedef struct
+{
+    pthread_t           *threads;
+    u32                  thread_count;
+
+    pthread_mutex_t      lock;
+    pthread_cond_t       job_available;
+    pthread_cond_t       idle;
+
+    thread_pool_job     *jobs; // darray, guarded by lock
+    u32                  running_jobs;
+    b8                   stopping;
+} thread_pool;
+
+/**
+ * @brief Creates a thread pool
+ *
+ * @param pool The pool
+ * @param thread_count The number of worker threads, 0 to use the number of online processors
+ * @return Wether the pool could be created
+ */
+b8      thread_pool_create(thread_pool *pool, u32 thread_count);
+
+/**
+ * @brief Waits for all submitted jobs to finish, and destroys the pool
+ *
+ * @param pool The pool
+ */
+void    thread_pool_destroy(thread_pool   *pool);
+
+/**
+ * @brief Submits a job to the pool
+ *
+ * @param pool The pool
+ * @param func The job function, called from a worker thread
+ * @param usr_data The data passed to the job function
+ */
+void    thread_pool_submit(thread_pool *pool, thread_pool_job_func func, void *usr_data);
+
+/**
+ * @brief Blocks until every submitted job has finished
+ *
+ * @param pool The pool
+ */
+void    thread_pool_wait_idle(thread_pool   *pool);
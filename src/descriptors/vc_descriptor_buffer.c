@@ -0,0 +1,370 @@
+#include "vc_descriptor_buffer.h"
+#include "../base/data_structures/darray.h"
+#include "../base/memory.h"
+#include "../vulcain.h"
+#include "../vc_enum_util.h"
+
+// Loads a device function into a descriptor buffer field, fails the creation if it is missing
+#define _VC_DB_LOAD(field, name)                                                   \
+        do                                                                         \
+        {                                                                          \
+            db->field = (typeof(db->field))vkGetDeviceProcAddr(dev, name);         \
+            if(db->field == NULL)                                                  \
+            {                                                                      \
+                vc_error("Descriptor buffer: could not load '%s'.", name);         \
+                return FALSE;                                                      \
+            }                                                                      \
+        } while(0)
+
+u64
+_vc_descriptor_buffer_align(u64 value, u64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+b8
+vc_descriptor_buffer_create(vc_descriptor_buffer *db, VkPhysicalDevice phy, VkDevice dev, VmaAllocator allocator, PFN_vkGetBufferDeviceAddressKHR get_buffer_device_address)
+{
+    db->created = FALSE;
+
+    _VC_DB_LOAD(get_layout_size, "vkGetDescriptorSetLayoutSizeEXT");
+    _VC_DB_LOAD(get_binding_offset, "vkGetDescriptorSetLayoutBindingOffsetEXT");
+    _VC_DB_LOAD(get_descriptor, "vkGetDescriptorEXT");
+    _VC_DB_LOAD(cmd_bind_buffers, "vkCmdBindDescriptorBuffersEXT");
+    _VC_DB_LOAD(cmd_set_offsets, "vkCmdSetDescriptorBufferOffsetsEXT");
+    db->get_buffer_device_address = get_buffer_device_address;
+
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT props =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceProperties2 props2 =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &props,
+    };
+    vkGetPhysicalDeviceProperties2(phy, &props2);
+
+    db->alignment = props.descriptorBufferOffsetAlignment;
+    mem_memset(db->descriptor_sizes, 0, sizeof(db->descriptor_sizes));
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_SAMPLER]                = props.samplerDescriptorSize;
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER] = props.combinedImageSamplerDescriptorSize;
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE]          = props.sampledImageDescriptorSize;
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_STORAGE_IMAGE]          = props.storageImageDescriptorSize;
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER]         = props.uniformBufferDescriptorSize;
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_STORAGE_BUFFER]         = props.storageBufferDescriptorSize;
+    db->descriptor_sizes[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT]       = props.inputAttachmentDescriptorSize;
+
+    // Samplers and resources live in the same buffer, so both ranges apply
+    u64 frames_size = _vc_descriptor_buffer_align(VC_DESCRIPTOR_BUFFER_FRAME_SIZE, db->alignment) * VC_FRAMES_IN_FLIGHT;
+    u64 max_size    = MIN(props.maxSamplerDescriptorBufferRange, props.maxResourceDescriptorBufferRange);
+    if(max_size <= frames_size)
+    {
+        vc_error("Descriptor buffer: the device only supports %lu bytes of descriptors.", max_size);
+        return FALSE;
+    }
+
+    u64 persistent_size = MIN(VC_DESCRIPTOR_BUFFER_PERSISTENT_SIZE, max_size - frames_size);
+    u64 base            = 0;
+    for(u32 i = 0; i <= VC_FRAMES_IN_FLIGHT; i++)
+    {
+        db->regions[i].base = base;
+        db->regions[i].size = i == VC_DESCRIPTOR_BUFFER_PERSISTENT ? persistent_size : VC_DESCRIPTOR_BUFFER_FRAME_SIZE;
+        db->regions[i].head = 0;
+        base               += _vc_descriptor_buffer_align(db->regions[i].size, db->alignment);
+    }
+
+    db->usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+                VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    VkBufferCreateInfo buf_ci =
+    {
+        .sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size        = base,
+        .usage       = db->usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    // Descriptors are written often and in small pieces, coherent memory avoids flushing each of them
+    VmaAllocationCreateInfo alloc_ci =
+    {
+        .usage         = VMA_MEMORY_USAGE_AUTO,
+        .flags         = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    };
+
+    VmaAllocationInfo alloc_i;
+    VK_CHECKR(vmaCreateBuffer(allocator, &buf_ci, &alloc_ci, &db->buffer, &db->alloc, &alloc_i), "Could not allocate the descriptor buffer.");
+    db->mapped = alloc_i.pMappedData;
+
+    VkBufferDeviceAddressInfo addr_i =
+    {
+        .sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = db->buffer,
+    };
+    db->address = get_buffer_device_address(dev, &addr_i);
+
+    db->layouts = darray_create(vc_descriptor_buffer_layout *);
+    pthread_mutex_init(&db->layouts_lock, NULL);
+
+    db->free_ranges = darray_create(_vc_descriptor_buffer_range);
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        db->retired_ranges[i] = darray_create(_vc_descriptor_buffer_range);
+    }
+    pthread_mutex_init(&db->free_lock, NULL);
+
+    db->created = TRUE;
+    vc_info("Created descriptor buffer (%lu bytes of persistent sets, %u bytes of transient sets per frame).", persistent_size, VC_DESCRIPTOR_BUFFER_FRAME_SIZE);
+    return TRUE;
+}
+
+void
+vc_descriptor_buffer_destroy(vc_descriptor_buffer *db, VmaAllocator allocator)
+{
+    if(!db->created)
+    {
+        return;
+    }
+
+    vmaDestroyBuffer(allocator, db->buffer, db->alloc);
+
+    for(u32 i = 0; i < darray_length(db->layouts); i++)
+    {
+        mem_free(db->layouts[i]);
+    }
+    darray_destroy(db->layouts);
+    pthread_mutex_destroy(&db->layouts_lock);
+
+    darray_destroy(db->free_ranges);
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        darray_destroy(db->retired_ranges[i]);
+    }
+    pthread_mutex_destroy(&db->free_lock);
+
+    db->created = FALSE;
+}
+
+const vc_descriptor_buffer_layout *
+vc_descriptor_buffer_get_layout(vc_descriptor_buffer *db, VkDevice dev, VkDescriptorSetLayout layout, const VkDescriptorSetLayoutCreateInfo *info)
+{
+    pthread_mutex_lock(&db->layouts_lock);
+
+    // Layouts are few, and only looked up when layout handles are created
+    vc_descriptor_buffer_layout *db_layout = NULL;
+    for(u32 i = 0; i < darray_length(db->layouts); i++)
+    {
+        if(db->layouts[i]->layout == layout)
+        {
+            db_layout = db->layouts[i];
+            break;
+        }
+    }
+
+    if(db_layout == NULL)
+    {
+        u32 binding_count = 0;
+        for(u32 i = 0; i < info->bindingCount; i++)
+        {
+            binding_count = MAX(binding_count, info->pBindings[i].binding + 1);
+        }
+
+        db_layout = mem_allocate(sizeof(vc_descriptor_buffer_layout) + sizeof(u64) * binding_count, MEMORY_TAG_RENDERER);
+        mem_memset(db_layout->offsets, 0, sizeof(u64) * binding_count);
+        db_layout->layout        = layout;
+        db_layout->binding_count = binding_count;
+
+        db->get_layout_size(dev, layout, &db_layout->size);
+        for(u32 i = 0; i < info->bindingCount; i++)
+        {
+            u32 binding = info->pBindings[i].binding;
+            db->get_binding_offset(dev, layout, binding, &db_layout->offsets[binding]);
+        }
+
+        darray_push(db->layouts, db_layout);
+    }
+
+    pthread_mutex_unlock(&db->layouts_lock);
+    return db_layout;
+}
+
+// Takes a range from the free list of the persistent region (first fit, the rest stays free)
+b8
+_vc_descriptor_buffer_reuse(vc_descriptor_buffer *db, u64 size, u64 *offset)
+{
+    b8 found = FALSE;
+
+    pthread_mutex_lock(&db->free_lock);
+    for(u32 i = 0; i < darray_length(db->free_ranges); i++)
+    {
+        _vc_descriptor_buffer_range *range = &db->free_ranges[i];
+        if(range->size < size)
+        {
+            continue;
+        }
+
+        *offset        = range->offset;
+        range->offset += size;
+        range->size   -= size;
+        if(range->size == 0)
+        {
+            darray_pop_at(db->free_ranges, i, NULL);
+        }
+        found = TRUE;
+        break;
+    }
+    pthread_mutex_unlock(&db->free_lock);
+
+    return found;
+}
+
+b8
+vc_descriptor_buffer_allocate(vc_descriptor_buffer *db, const vc_descriptor_buffer_layout *layout, u32 region, u64 *offset)
+{
+    _vc_descriptor_buffer_region *r = &db->regions[region];
+    u64 size                        = _vc_descriptor_buffer_align(layout->size, db->alignment);
+
+    if(region == VC_DESCRIPTOR_BUFFER_PERSISTENT && _vc_descriptor_buffer_reuse(db, size, offset) )
+    {
+        return TRUE;
+    }
+
+    // Every allocation keeps the head aligned, the head only moves when the set fits
+    u64 start = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    do
+    {
+        if(start + size > r->size)
+        {
+            vc_error("Descriptor buffer: the %s region is full (%lu of %lu bytes used, a set needs %lu bytes).",
+                     region == VC_DESCRIPTOR_BUFFER_PERSISTENT ? "persistent" : "transient", start, r->size, size);
+            return FALSE;
+        }
+    }
+    while(!__atomic_compare_exchange_n(&r->head, &start, start + size, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+
+    *offset = r->base + start;
+    return TRUE;
+}
+
+void
+vc_descriptor_buffer_free(vc_descriptor_buffer *db, const vc_descriptor_buffer_layout *layout, u64 offset, u32 slot)
+{
+    _vc_descriptor_buffer_region *r = &db->regions[VC_DESCRIPTOR_BUFFER_PERSISTENT];
+    if(offset < r->base || offset >= r->base + r->size)
+    {
+        return; // Transient sets are reclaimed with their frame
+    }
+
+    _vc_descriptor_buffer_range range =
+    {
+        .offset = offset,
+        .size   = _vc_descriptor_buffer_align(layout->size, db->alignment),
+    };
+
+    // The GPU may still read the set during the frames in flight
+    pthread_mutex_lock(&db->free_lock);
+    darray_push(db->retired_ranges[slot], range);
+    pthread_mutex_unlock(&db->free_lock);
+}
+
+void
+vc_descriptor_buffer_write(vc_descriptor_buffer *db, VkDevice dev, const vc_descriptor_buffer_layout *layout, u64 offset, u32 write_count, const VkWriteDescriptorSet *writes)
+{
+    for(u32 i = 0; i < write_count; i++)
+    {
+        const VkWriteDescriptorSet *w = &writes[i];
+        u64 size                      = w->descriptorType <= VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT ? db->descriptor_sizes[w->descriptorType] : 0;
+
+        if(size == 0 || w->dstBinding >= layout->binding_count)
+        {
+            vc_error("Descriptor buffer: unsupported write (binding %u, type %u).", w->dstBinding, w->descriptorType);
+            continue;
+        }
+
+        u8 *dst = db->mapped + offset + layout->offsets[w->dstBinding] + size * w->dstArrayElement;
+        for(u32 d = 0; d < w->descriptorCount; d++)
+        {
+            VkDescriptorGetInfoEXT get_i =
+            {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+                .type  = w->descriptorType,
+            };
+
+            VkDescriptorAddressInfoEXT addr_i =
+            {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+            };
+
+            const VkDescriptorImageInfo *img = w->pImageInfo ? &w->pImageInfo[d] : NULL;
+            if(w->pBufferInfo != NULL)
+            {
+                VkBufferDeviceAddressInfo buf_addr_i =
+                {
+                    .sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                    .buffer = w->pBufferInfo[d].buffer,
+                };
+                addr_i.address = db->get_buffer_device_address(dev, &buf_addr_i) + w->pBufferInfo[d].offset;
+                addr_i.range   = w->pBufferInfo[d].range;
+            }
+
+            // Images without a view are written as null descriptors
+            const VkDescriptorImageInfo *view = img && img->imageView != VK_NULL_HANDLE ? img : NULL;
+            switch (w->descriptorType)
+            {
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+                get_i.data.pSampler = &img->sampler;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                get_i.data.pCombinedImageSampler = img;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                get_i.data.pSampledImage = view;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                get_i.data.pStorageImage = view;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                get_i.data.pInputAttachmentImage = view;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                get_i.data.pUniformBuffer = &addr_i;
+                break;
+
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                get_i.data.pStorageBuffer = &addr_i;
+                break;
+
+            default:
+                break;
+            }
+
+            db->get_descriptor(dev, &get_i, size, dst + size * d);
+        }
+    }
+}
+
+void
+vc_descriptor_buffer_frame_reset(vc_descriptor_buffer *db, u32 slot)
+{
+    if(!db->created)
+    {
+        return;
+    }
+
+    __atomic_store_n(&db->regions[slot].head, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&db->free_lock);
+    for(u32 i = 0; i < darray_length(db->retired_ranges[slot]); i++)
+    {
+        darray_push(db->free_ranges, db->retired_ranges[slot][i]);
+    }
+    darray_clear(db->retired_ranges[slot]);
+    pthread_mutex_unlock(&db->free_lock);
+}
@@ -0,0 +1,140 @@
+#ifndef __VC_DESCRIPTOR_BUFFER__
+#define __VC_DESCRIPTOR_BUFFER__
+
+/*
+ * Descriptor buffer backend (VK_EXT_descriptor_buffer).
+ * Sets are not allocated from pools: a set is a range of a single host visible buffer, into which descriptors are
+ * written directly with vkGetDescriptorEXT, at the offsets queried from the set layout. The buffer is split in regions:
+ * one for persistent sets, and one per frame in flight for transient sets, reset when the frame retires. Every region
+ * is a linear allocator. Freed persistent sets go back to a free list once the frame that freed them retires, and are
+ * reused before the persistent region grows.
+ */
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <pthread.h>
+#include "../base/types.h"
+#include "../vc_frames.h"
+
+#define VC_DESCRIPTOR_BUFFER_PERSISTENT_SIZE (8 * 1024 * 1024)
+#define VC_DESCRIPTOR_BUFFER_FRAME_SIZE      (1 * 1024 * 1024)
+
+// Region index of the persistent sets, regions below are the transient regions of each frame slot
+#define VC_DESCRIPTOR_BUFFER_PERSISTENT      VC_FRAMES_IN_FLIGHT
+
+/**
+ * @brief The size and binding offsets of a set layout in the descriptor buffer
+ */
+typedef struct
+{
+    VkDescriptorSetLayout    layout;
+    u64                      size;
+    u32                      binding_count; // Highest binding number + 1
+    u64                      offsets[]; // Indexed by binding number
+} vc_descriptor_buffer_layout;
+
+typedef struct
+{
+    u64    base;
+    u64    size;
+    u64    head; // Atomic, relative to base
+} _vc_descriptor_buffer_region;
+
+typedef struct
+{
+    u64    offset;
+    u64    size;
+} _vc_descriptor_buffer_range;
+
+typedef struct
+{
+    b8                                              created;
+
+    VkBuffer                                        buffer;
+    VmaAllocation                                   alloc;
+    u8                                             *mapped;
+    VkDeviceAddress                                 address;
+    VkBufferUsageFlags                              usage;
+
+    u64                                             alignment; // Of set offsets
+    u64                                             descriptor_sizes[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1]; // 0 for unsupported types
+
+    _vc_descriptor_buffer_region                    regions[VC_FRAMES_IN_FLIGHT + 1];
+
+    pthread_mutex_t                                 free_lock;
+    _vc_descriptor_buffer_range                    *free_ranges; // darray, reusable ranges of the persistent region
+    _vc_descriptor_buffer_range                    *retired_ranges[VC_FRAMES_IN_FLIGHT]; // darrays, freed during each frame slot
+
+    pthread_mutex_t                                 layouts_lock;
+    vc_descriptor_buffer_layout                   **layouts; // darray
+
+    PFN_vkGetDescriptorSetLayoutSizeEXT             get_layout_size;
+    PFN_vkGetDescriptorSetLayoutBindingOffsetEXT    get_binding_offset;
+    PFN_vkGetDescriptorEXT                          get_descriptor;
+    PFN_vkGetBufferDeviceAddressKHR                 get_buffer_device_address;
+
+    PFN_vkCmdBindDescriptorBuffersEXT               cmd_bind_buffers;
+    PFN_vkCmdSetDescriptorBufferOffsetsEXT          cmd_set_offsets;
+} vc_descriptor_buffer;
+
+/**
+ * @brief Creates the descriptor buffer
+ *
+ * @param db The descriptor buffer
+ * @param phy The physical device, supporting VK_EXT_descriptor_buffer
+ * @param dev The device
+ * @param allocator The allocator to allocate the buffer with (with buffer device addresses enabled)
+ * @param get_buffer_device_address The function returning buffer device addresses
+ * @return Wether the buffer could be created
+ */
+b8                                 vc_descriptor_buffer_create(vc_descriptor_buffer *db, VkPhysicalDevice phy, VkDevice dev, VmaAllocator allocator, PFN_vkGetBufferDeviceAddressKHR get_buffer_device_address);
+void                               vc_descriptor_buffer_destroy(vc_descriptor_buffer *db, VmaAllocator allocator);
+
+/**
+ * @brief Returns the size and binding offsets of a layout, querying them the first time
+ *
+ * @param db The descriptor buffer
+ * @param dev The device
+ * @param layout A layout created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+ * @param info The create info of the layout
+ * @return The layout information, owned by the descriptor buffer
+ */
+const vc_descriptor_buffer_layout *vc_descriptor_buffer_get_layout(vc_descriptor_buffer *db, VkDevice dev, VkDescriptorSetLayout layout, const VkDescriptorSetLayoutCreateInfo *info);
+
+/**
+ * @brief Allocates the range of a set, thread safe
+ *
+ * @param db The descriptor buffer
+ * @param layout The layout of the set
+ * @param region A frame slot, or VC_DESCRIPTOR_BUFFER_PERSISTENT
+ * @param offset The offset of the set in the buffer
+ * @return FALSE if the region is full
+ */
+b8                                 vc_descriptor_buffer_allocate(vc_descriptor_buffer *db, const vc_descriptor_buffer_layout *layout, u32 region, u64 *offset);
+
+/**
+ * @brief Frees the range of a persistent set, thread safe. It is reused once the frame slot retires.
+ *
+ * @param db The descriptor buffer
+ * @param layout The layout of the set
+ * @param offset The offset of the set, offsets outside of the persistent region are ignored
+ * @param slot The current frame slot
+ */
+void                               vc_descriptor_buffer_free(vc_descriptor_buffer *db, const vc_descriptor_buffer_layout *layout, u64 offset, u32 slot);
+
+/**
+ * @brief Writes descriptors into a set, the dstSet of the writes is ignored
+ *
+ * @param db The descriptor buffer
+ * @param dev The device
+ * @param layout The layout of the set
+ * @param offset The offset of the set
+ * @param write_count The number of writes
+ * @param writes The writes, with image or buffer infos only (the buffer ranges must not be VK_WHOLE_SIZE)
+ */
+void                               vc_descriptor_buffer_write(vc_descriptor_buffer *db, VkDevice dev, const vc_descriptor_buffer_layout *layout, u64 offset, u32 write_count, const VkWriteDescriptorSet *writes);
+
+// The transient sets of the frame slot, and the persistent sets freed during it, are no longer used by the GPU
+void                               vc_descriptor_buffer_frame_reset(vc_descriptor_buffer *db, u32 slot);
+
+#endif // __VC_DESCRIPTOR_BUFFER__
@@ -1,109 +1,876 @@
 #include "../vulcain.h"
 #include "../handles/vc_internal_types.h"
 #include "vc_ds_alloc.h"
+#include "../vc_enum_util.h"
 #include "../base/data_structures/darray.h"
+#include <alloca.h>
 
+// Pool sets go back with their pool, only the persistent ranges of the descriptor buffer are freed one by one
+void
+_vc_descriptor_set_destroy(vc_ctx *ctx, _vc_descriptor_set_intern *set_i)
+{
+    if(set_i->buffer_layout != NULL)
+    {
+        vc_descriptor_buffer_free(&ctx->descriptor_buffer, set_i->buffer_layout, set_i->offset, ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT);
+    }
+}
+
+// Creates the handle of an allocated set
 vc_descriptor_set
-vc_descriptor_set_allocate(vc_ctx *ctx, vc_descriptor_set_layout layout)
+_vc_descriptor_set_handle_create(vc_ctx *ctx, _vc_descriptor_set_intern *set_i)
 {
-    _vc_descriptor_set_layout_intern *sl_i = vc_handles_manager_deref(&ctx->handles_manager, layout);
+    vc_descriptor_set hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET, set_i);
+    vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET, (vc_handle_destroy_func)_vc_descriptor_set_destroy);
 
-    VkDescriptorSet set = vc_ds_alloc_allocate(&ctx->ds_allocator, ctx->current_device, sl_i->layout);
+    return hndl;
+}
 
-    _vc_descriptor_set_intern set_i =
+// Allocates a set from a pool allocator, or from a region of the descriptor buffer with the descriptor buffer backend
+b8
+_vc_descriptor_set_storage_allocate(vc_ctx *ctx, _vc_descriptor_set_layout_intern *sl_i, vc_descriptor_set_allocator *allocator, u32 region, _vc_descriptor_set_intern *set_i)
+{
+    if(sl_i->flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR)
     {
-        .set    = set,
-        .layout = sl_i->layout,
+        vc_error("Cannot allocate a set of a push descriptor set layout.");
+        return FALSE;
+    }
+
+    *set_i = (_vc_descriptor_set_intern) {
+        .set           = VK_NULL_HANDLE,
+        .layout        = sl_i->layout,
+        .offset        = 0,
+        .buffer_layout = sl_i->buffer_layout,
     };
-    vc_descriptor_set hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET, &set_i);
+
+    if(sl_i->buffer_layout != NULL)
+    {
+        return vc_descriptor_buffer_allocate(&ctx->descriptor_buffer, sl_i->buffer_layout, region, &set_i->offset);
+    }
+
+    set_i->set = vc_ds_alloc_allocate(allocator, ctx->current_device, sl_i->layout, &sl_i->demand);
+    return set_i->set != VK_NULL_HANDLE;
+}
+
+vc_descriptor_set
+vc_descriptor_set_allocate(vc_ctx *ctx, vc_descriptor_set_layout layout)
+{
+    _vc_descriptor_set_layout_intern sl_i;
+    vc_handles_manager_read(&ctx->handles_manager, layout, &sl_i, sizeof(sl_i) );
+    vc_ds_thread_allocator *alloc = vc_ds_registry_get(&ctx->ds_registry);
+
+    _vc_descriptor_set_intern set_i;
+    if(!_vc_descriptor_set_storage_allocate(ctx, &sl_i, &alloc->persistent, VC_DESCRIPTOR_BUFFER_PERSISTENT, &set_i))
+    {
+        return VC_NULL_HANDLE;
+    }
+
+    return _vc_descriptor_set_handle_create(ctx, &set_i);
+}
+
+vc_descriptor_set
+vc_descriptor_set_allocate_transient(vc_ctx *ctx, vc_descriptor_set_layout layout)
+{
+    _vc_descriptor_set_layout_intern sl_i;
+    vc_handles_manager_read(&ctx->handles_manager, layout, &sl_i, sizeof(sl_i) );
+    vc_ds_thread_allocator *alloc = vc_ds_registry_get(&ctx->ds_registry);
+    u64 slot                      = ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT;
+
+    _vc_descriptor_set_intern set_i;
+    if(!_vc_descriptor_set_storage_allocate(ctx, &sl_i, &alloc->frames[slot], slot, &set_i))
+    {
+        return VC_NULL_HANDLE;
+    }
+    vc_descriptor_set hndl = _vc_descriptor_set_handle_create(ctx, &set_i);
+
+    // Only this thread touches its handle list, until the frame retires
+    darray_push(alloc->frame_handles[slot], hndl);
 
     return hndl;
 }
 
+// Gives back the storage of sets that did not get a handle. Pool sets cannot be freed, they are reused by the set cache.
+void
+_vc_descriptor_sets_release_storage(vc_ctx *ctx, u32 count, const _vc_descriptor_set_intern *sets_i)
+{
+    pthread_mutex_lock(&ctx->set_cache.lock);
+    for(u32 i = 0; i < count; i++)
+    {
+        if(sets_i[i].buffer_layout != NULL)
+        {
+            vc_descriptor_buffer_free(&ctx->descriptor_buffer, sets_i[i].buffer_layout, sets_i[i].offset, ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT);
+        }
+        else
+        {
+            vc_set_cache_add_reusable(&ctx->set_cache, sets_i[i].layout, sets_i[i].set, 0);
+        }
+    }
+    pthread_mutex_unlock(&ctx->set_cache.lock);
+}
+
+b8
+vc_descriptor_sets_allocate(vc_ctx *ctx, u32 count, const vc_descriptor_set_layout *layouts, vc_descriptor_set *out_sets)
+{
+    if(count == 0)
+    {
+        return TRUE;
+    }
+
+    _vc_descriptor_set_intern *sets_i       = mem_allocate(sizeof(_vc_descriptor_set_intern) * count, MEMORY_TAG_RENDERER);
+    _vc_descriptor_set_layout_intern *sls_i = mem_allocate(sizeof(_vc_descriptor_set_layout_intern) * count, MEMORY_TAG_RENDERER);
+    VkDescriptorSetLayout *vk_layouts       = mem_allocate(sizeof(VkDescriptorSetLayout) * count, MEMORY_TAG_RENDERER);
+    VkDescriptorSet *vk_sets                = mem_allocate(sizeof(VkDescriptorSet) * count, MEMORY_TAG_RENDERER);
+    const vc_ds_demand **demands            = mem_allocate(sizeof(vc_ds_demand *) * count, MEMORY_TAG_RENDERER);
+
+    // Every layout uses the same backend
+    const vc_descriptor_buffer_layout *buffer_layout = NULL;
+
+    b8 success    = TRUE;
+    u32 allocated = 0; // Sets with storage, given back on failure
+    for(u32 i = 0; i < count && success; i++)
+    {
+        _vc_descriptor_set_layout_intern *sl_i = &sls_i[i];
+        vc_handles_manager_read(&ctx->handles_manager, layouts[i], sl_i, sizeof(*sl_i) );
+        if(sl_i->flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR)
+        {
+            vc_error("Cannot allocate a set of a push descriptor set layout.");
+            success = FALSE;
+        }
+
+        sets_i[i] = (_vc_descriptor_set_intern) {
+            .set           = VK_NULL_HANDLE,
+            .layout        = sl_i->layout,
+            .offset        = 0,
+            .buffer_layout = sl_i->buffer_layout,
+        };
+        vk_layouts[i] = sl_i->layout;
+        demands[i]    = &sl_i->demand;
+        buffer_layout = sl_i->buffer_layout;
+    }
+
+    if(success && buffer_layout != NULL)
+    {
+        // Descriptor buffer backend, allocations reuse freed ranges or move the head of the region
+        for(u32 i = 0; i < count && success; i++)
+        {
+            success    = vc_descriptor_buffer_allocate(&ctx->descriptor_buffer, sets_i[i].buffer_layout, VC_DESCRIPTOR_BUFFER_PERSISTENT, &sets_i[i].offset);
+            allocated += success;
+        }
+    }
+    else if(success)
+    {
+        vc_ds_thread_allocator *alloc = vc_ds_registry_get(&ctx->ds_registry);
+
+        allocated = vc_ds_alloc_allocate_n(&alloc->persistent, ctx->current_device, count, vk_layouts, demands, vk_sets);
+        success   = allocated == count;
+        for(u32 i = 0; i < allocated; i++)
+        {
+            sets_i[i].set = vk_sets[i];
+        }
+    }
+
+    if(success)
+    {
+        success = vc_handles_manager_walloc_n(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET, count, sets_i, out_sets);
+        vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET, (vc_handle_destroy_func)_vc_descriptor_set_destroy);
+    }
+
+    if(!success)
+    {
+        _vc_descriptor_sets_release_storage(ctx, allocated, sets_i);
+        mem_memset(out_sets, 0, sizeof(vc_descriptor_set) * count); // VC_NULL_HANDLE
+    }
+
+    mem_free(sets_i);
+    mem_free(sls_i);
+    mem_free(vk_layouts);
+    mem_free(vk_sets);
+    mem_free(demands);
+
+    return success;
+}
+
+void
+vc_descriptor_pool_stats_get(vc_ctx *ctx, vc_ds_stats *stats)
+{
+    vc_ds_registry_stats(&ctx->ds_registry, stats);
+}
 
 void
-_vc_descriptor_set_writer_init(vc_descriptor_set_writer   *writer)
+vc_descriptor_pool_stats_print(vc_ctx   *ctx)
 {
-    writer->writes = darray_create(VkWriteDescriptorSet);
+    static const char *type_names[VC_DS_TYPE_COUNT] =
+    {
+        [VK_DESCRIPTOR_TYPE_SAMPLER]                = "sampler",
+        [VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER] = "combined image sampler",
+        [VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE]          = "sampled image",
+        [VK_DESCRIPTOR_TYPE_STORAGE_IMAGE]          = "storage image",
+        [VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER]   = "uniform texel buffer",
+        [VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER]   = "storage texel buffer",
+        [VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER]         = "uniform buffer",
+        [VK_DESCRIPTOR_TYPE_STORAGE_BUFFER]         = "storage buffer",
+        [VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC] = "dynamic uniform buffer",
+        [VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC] = "dynamic storage buffer",
+        [VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT]       = "input attachment",
+    };
 
-    writer->img_infos = darray_create(VkDescriptorImageInfo);
-    writer->buf_infos = darray_create(VkDescriptorBufferInfo);
+    vc_ds_stats stats;
+    vc_ds_registry_stats(&ctx->ds_registry, &stats);
+
+    vc_info("Descriptor pools: %lu sets allocated from %lu pools, %lu out of pool memory retries, %lu fragmented pool retries, %lu sets wasted in full pools.",
+            stats.sets, stats.pools, stats.out_of_pool_retries, stats.fragmented_retries, stats.wasted_sets);
+    for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+    {
+        f32 ratio = 0.0f;
+        __atomic_load(&ctx->ds_registry.ratios[t], &ratio, __ATOMIC_RELAXED);
+        if(stats.demand[t] == 0 && ratio == 0.0f)
+        {
+            continue;
+        }
+
+        f32 waste = stats.capacity[t] ? 100.0f * stats.wasted[t] / stats.capacity[t] : 0.0f;
+        vc_info("  %s: %lu allocated, %.1f%% wasted in full pools, ratio %.2f per set.", type_names[t], stats.demand[t], waste, ratio);
+    }
 }
 
+b8
+vc_descriptor_pool_ratios_save(vc_ctx *ctx, const char *path)
+{
+    return vc_ds_registry_save_ratios(&ctx->ds_registry, path);
+}
+
+b8
+vc_descriptor_pool_ratios_load(vc_ctx *ctx, const char *path)
+{
+    return vc_ds_registry_load_ratios(&ctx->ds_registry, path);
+}
+
+// Which info of a VkWriteDescriptorSet a descriptor type reads
+typedef enum
+{
+    _VC_DESCRIPTOR_KIND_IMAGE,
+    _VC_DESCRIPTOR_KIND_BUFFER,
+    _VC_DESCRIPTOR_KIND_TEXEL_BUFFER,
+    _VC_DESCRIPTOR_KIND_UNSUPPORTED,
+} _vc_descriptor_kind;
+
+_vc_descriptor_kind
+_vc_descriptor_type_kind(VkDescriptorType type)
+{
+    switch (type)
+    {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        return _VC_DESCRIPTOR_KIND_IMAGE;
+
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        return _VC_DESCRIPTOR_KIND_BUFFER;
+
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        return _VC_DESCRIPTOR_KIND_TEXEL_BUFFER;
+
+    default:
+        // Inline uniform blocks and acceleration structures are written through pNext
+        return _VC_DESCRIPTOR_KIND_UNSUPPORTED;
+    }
+}
+
+// Writes into a set, with vkUpdateDescriptorSets or into the descriptor buffer
 void
-vc_descriptor_set_writer_write_image(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 binding, u32 array_elt, vc_image_view view, vc_handle sampler, VkImageLayout layout, VkDescriptorType image_type)
+_vc_descriptor_set_write(vc_ctx *ctx, _vc_descriptor_set_intern *set_i, u32 write_count, VkWriteDescriptorSet *writes)
+{
+    if(set_i->buffer_layout != NULL)
+    {
+        vc_descriptor_buffer_write(&ctx->descriptor_buffer, ctx->current_device, set_i->buffer_layout, set_i->offset, write_count, writes);
+        return;
+    }
+
+    for(u32 i = 0; i < write_count; i++)
+    {
+        writes[i].dstSet = set_i->set;
+    }
+    vkUpdateDescriptorSets(ctx->current_device, write_count, writes, 0, NULL);
+}
+
+// Frees the transient sets and the evicted cached sets of a retired frame slot, called by vc_frame_begin
+void
+_vc_descriptor_sets_frame_reset(vc_ctx *ctx, u32 slot)
+{
+    vc_ds_registry_frame_reset(&ctx->ds_registry, &ctx->handles_manager, ctx->current_device, slot);
+    vc_descriptor_buffer_frame_reset(&ctx->descriptor_buffer, slot);
+    mem_linear_reset(&ctx->writer_arenas[slot]);
+
+    pthread_mutex_lock(&ctx->set_cache.lock);
+    vc_set_cache_frame_reset(&ctx->set_cache, &ctx->handles_manager, slot);
+    pthread_mutex_unlock(&ctx->set_cache.lock);
+}
+
+// Called when the object behind a handle is destroyed or replaced, cached sets referencing it are evicted
+void
+_vc_descriptor_sets_handle_changed(vc_ctx *ctx, vc_handle hndl)
+{
+    pthread_mutex_lock(&ctx->set_cache.lock);
+    vc_set_cache_invalidate(&ctx->set_cache, ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT, hndl);
+    pthread_mutex_unlock(&ctx->set_cache.lock);
+}
+
+#define _VC_WRITER_START_CAPACITY 8
+
+// Points the writer to its storage, and the writes to their infos
+void
+_vc_descriptor_set_writer_set_storage(vc_descriptor_set_writer *writer, void *memory, u32 capacity)
 {
-    _vc_image_view_intern *img_vw_i = vc_handles_manager_deref(&ctx->handles_manager, view);
-    if(writer->writes == NULL)
+    writer->writes    = memory;
+    writer->infos     = (vc_descriptor_data *)(writer->writes + capacity);
+    writer->resources = (vc_handle *)(writer->infos + capacity);
+    writer->capacity  = capacity;
+
+    for(u32 i = 0; i < writer->count; i++)
+    {
+        if(writer->writes[i].pImageInfo != NULL)
+        {
+            writer->writes[i].pImageInfo = &writer->infos[i].image;
+        }
+        else
+        {
+            writer->writes[i].pBufferInfo = &writer->infos[i].buffer;
+        }
+    }
+}
+
+void
+vc_descriptor_set_writer_init(vc_descriptor_set_writer *writer, void *memory, u64 size)
+{
+    writer->count = 0;
+    writer->fixed = TRUE;
+    _vc_descriptor_set_writer_set_storage(writer, memory, size / VC_DESCRIPTOR_SET_WRITER_WRITE_SIZE);
+}
+
+b8
+vc_descriptor_set_writer_init_transient(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 capacity)
+{
+    u64 size     = VC_DESCRIPTOR_SET_WRITER_WRITE_SIZE * capacity;
+    void *memory = mem_linear_alloc(&ctx->writer_arenas[ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT], size, sizeof(u64) );
+    if(memory == NULL)
+    {
+        vc_error("Not enough transient memory left this frame for a writer of %u writes.", capacity);
+        *writer = (vc_descriptor_set_writer) {
+            0
+        };
+        return FALSE;
+    }
+
+    vc_descriptor_set_writer_init(writer, memory, size);
+    return TRUE;
+}
+
+// Drops the writes, only writers that own their storage free it
+void
+_vc_descriptor_set_writer_reset(vc_descriptor_set_writer   *writer)
+{
+    writer->count = 0;
+    if(writer->fixed || writer->writes == NULL)
+    {
+        return;
+    }
+
+    mem_free(writer->writes);
+    *writer = (vc_descriptor_set_writer) {
+        0
+    };
+}
+
+void
+vc_descriptor_set_writer_reset(vc_descriptor_set_writer   *writer)
+{
+    _vc_descriptor_set_writer_reset(writer);
+}
+
+// Returns the index of a new write, writers that own their storage grow it when full
+b8
+_vc_descriptor_set_writer_push(vc_descriptor_set_writer *writer, u32 *index)
+{
+    if(writer->count == writer->capacity)
     {
-        _vc_descriptor_set_writer_init(writer);
+        if(writer->fixed)
+        {
+            vc_error("The descriptor set writer is full (%u writes), the write is ignored.", writer->capacity);
+            return FALSE;
+        }
+
+        u32 capacity = MAX(writer->capacity * 2, _VC_WRITER_START_CAPACITY);
+        void *memory = mem_allocate(VC_DESCRIPTOR_SET_WRITER_WRITE_SIZE * capacity, MEMORY_TAG_RENDERER);
+        if(writer->writes != NULL)
+        {
+            mem_memcpy(memory, writer->writes, sizeof(VkWriteDescriptorSet) * writer->count);
+            mem_memcpy( (VkWriteDescriptorSet *)memory + capacity, writer->infos, sizeof(vc_descriptor_data) * writer->count);
+            mem_memcpy( (u8 *)memory + (sizeof(VkWriteDescriptorSet) + sizeof(vc_descriptor_data) ) * capacity, writer->resources, sizeof(vc_handle) * 2 * writer->count);
+            mem_free(writer->writes);
+        }
+        _vc_descriptor_set_writer_set_storage(writer, memory, capacity);
     }
 
-    VkDescriptorImageInfo info =
+    *index = writer->count++;
+    return TRUE;
+}
+
+void
+vc_descriptor_set_writer_write_image(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 binding, u32 array_elt, vc_image_view view, vc_handle sampler, VkImageLayout layout, VkDescriptorType image_type)
+{
+    u32 index = 0;
+    if(!_vc_descriptor_set_writer_push(writer, &index) )
     {
-        .sampler     = VK_NULL_HANDLE, // TODO:
-        .imageView   = img_vw_i->view,
+        return;
+    }
+
+    VkDescriptorImageInfo *info = &writer->infos[index].image;
+    *info = (VkDescriptorImageInfo) {
+        .sampler     = VK_NULL_HANDLE,
+        .imageView   = VK_NULL_HANDLE,
         .imageLayout = layout,
     };
-    darray_push(writer->img_infos, info);
 
-    VkWriteDescriptorSet write =
+    if(view != VC_NULL_HANDLE)
     {
+        _vc_image_view_intern img_vw_i;
+        vc_handles_manager_read(&ctx->handles_manager, view, &img_vw_i, sizeof(img_vw_i) );
+        info->imageView = img_vw_i.view;
+    }
+
+    if(sampler != VC_NULL_HANDLE)
+    {
+        _vc_sampler_intern sampler_i;
+        vc_handles_manager_read(&ctx->handles_manager, sampler, &sampler_i, sizeof(sampler_i) );
+        info->sampler = sampler_i.sampler;
+    }
+
+    writer->writes[index] = (VkWriteDescriptorSet) {
         .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pImageInfo      = &writer->img_infos[darray_length(writer->img_infos) - 1],
+        .pImageInfo      = info,
         .descriptorType  = image_type,
         .dstBinding      = binding,
         .dstArrayElement = array_elt,
         .descriptorCount = 1,
     };
 
-    darray_push(writer->writes, write);
+    writer->resources[index * 2]     = view;
+    writer->resources[index * 2 + 1] = sampler;
 }
 
 void
 vc_descriptor_set_writer_write_buffer(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 binding, u32 array_elt, vc_buffer buffer, u64 offset, u64 range, VkDescriptorType buffer_type)
 {
-    _vc_buffer_intern *buf_i = vc_handles_manager_deref(&ctx->handles_manager, buffer);
-    if(writer->writes == NULL)
+    _vc_buffer_intern buf_i;
+    vc_handles_manager_read(&ctx->handles_manager, buffer, &buf_i, sizeof(buf_i) );
+
+    u32 index = 0;
+    if(!_vc_descriptor_set_writer_push(writer, &index) )
     {
-        _vc_descriptor_set_writer_init(writer);
+        return;
     }
 
-    VkDescriptorBufferInfo info =
-    {
-        .range  = range,
+    // Resolved here, descriptor buffers need the actual range
+    VkDescriptorBufferInfo *info = &writer->infos[index].buffer;
+    *info = (VkDescriptorBufferInfo) {
+        .range  = range == VK_WHOLE_SIZE ? buf_i.size - offset : range,
         .offset = offset,
-        .buffer = buf_i->buffer,
+        .buffer = buf_i.buffer,
     };
 
-    darray_push(writer->buf_infos, info);
-
-    VkWriteDescriptorSet write =
-    {
+    writer->writes[index] = (VkWriteDescriptorSet) {
         .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pBufferInfo     = &writer->buf_infos[darray_length(writer->buf_infos) - 1],
+        .pBufferInfo     = info,
         .descriptorType  = buffer_type,
         .dstBinding      = binding,
         .dstArrayElement = array_elt,
         .descriptorCount = 1,
     };
 
-    darray_push(writer->writes, write);
+    writer->resources[index * 2]     = buffer;
+    writer->resources[index * 2 + 1] = VC_NULL_HANDLE;
+}
+
+// Writes the written information into a set
+void
+_vc_descriptor_set_writer_update(vc_ctx *ctx, vc_descriptor_set_writer *writer, _vc_descriptor_set_intern *set_i)
+{
+    if(writer->count == 0)
+    {
+        return;
+    }
+
+    _vc_descriptor_set_write(ctx, set_i, writer->count, writer->writes);
 }
 
 void
 vc_descriptor_set_writer_write(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_descriptor_set set)
 {
-    _vc_descriptor_set_intern *set_i = vc_handles_manager_deref(&ctx->handles_manager, set);
-    u32 len                          = darray_length(writer->writes);
-    for(u32 i = 0; i < len; i++)
+    _vc_descriptor_set_intern set_i;
+    vc_handles_manager_read(&ctx->handles_manager, set, &set_i, sizeof(set_i) );
+
+    _vc_descriptor_set_writer_update(ctx, writer, &set_i);
+    _vc_descriptor_set_writer_reset(writer);
+}
+
+void
+vc_descriptor_set_writer_write_many(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 set_count, const vc_descriptor_set *sets)
+{
+    if(writer->count == 0 || set_count == 0)
+    {
+        _vc_descriptor_set_writer_reset(writer);
+        return;
+    }
+
+    // Descriptor buffer sets are written one by one, they are not VkDescriptorSets
+    if(ctx->supported_features.descriptor_buffer)
+    {
+        for(u32 i = 0; i < set_count; i++)
+        {
+            _vc_descriptor_set_intern set_i;
+            vc_handles_manager_read(&ctx->handles_manager, sets[i], &set_i, sizeof(set_i) );
+            _vc_descriptor_set_writer_update(ctx, writer, &set_i);
+        }
+        _vc_descriptor_set_writer_reset(writer);
+        return;
+    }
+
+    // The copies of the writes come from the frame memory when possible, the heap otherwise
+    u64 size                  = sizeof(VkWriteDescriptorSet) * writer->count * set_count;
+    VkWriteDescriptorSet *all = mem_linear_alloc(&ctx->writer_arenas[ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT], size, sizeof(u64) );
+    b8 heap                   = all == NULL;
+    if(heap)
+    {
+        all = mem_allocate(size, MEMORY_TAG_RENDERER);
+    }
+
+    for(u32 s = 0; s < set_count; s++)
+    {
+        _vc_descriptor_set_intern set_i;
+        vc_handles_manager_read(&ctx->handles_manager, sets[s], &set_i, sizeof(set_i) );
+        for(u32 w = 0; w < writer->count; w++)
+        {
+            all[s * writer->count + w]        = writer->writes[w];
+            all[s * writer->count + w].dstSet = set_i.set;
+        }
+    }
+
+    vkUpdateDescriptorSets(ctx->current_device, writer->count * set_count, all, 0, NULL);
+
+    if(heap)
+    {
+        mem_free(all);
+    }
+    _vc_descriptor_set_writer_reset(writer);
+}
+
+// Builds the cache key of the writer (see vc_set_cache.h)
+void
+_vc_descriptor_set_writer_key(vc_descriptor_set_writer *writer, vc_descriptor_set_layout layout, u64 *key)
+{
+    key[0] = layout;
+
+    for(u32 i = 0; i < writer->count; i++)
+    {
+        VkWriteDescriptorSet *w = &writer->writes[i];
+        u64 *words              = &key[1 + i * VC_SET_CACHE_WRITE_WORDS];
+
+        words[0]                     = w->dstBinding | ( (u64)w->dstArrayElement << 32 );
+        words[1]                     = w->descriptorType;
+        words[VC_SET_CACHE_RESOURCE] = writer->resources[i * 2];
+        words[VC_SET_CACHE_SAMPLER]  = writer->resources[i * 2 + 1];
+        words[4]                     = w->pImageInfo ? w->pImageInfo->imageLayout : w->pBufferInfo->offset;
+        words[5]                     = w->pImageInfo ? 0 : w->pBufferInfo->range;
+    }
+}
+
+vc_descriptor_set
+vc_descriptor_set_writer_get_cached(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_descriptor_set_layout layout)
+{
+    _vc_descriptor_set_layout_intern layout_i;
+    vc_handles_manager_read(&ctx->handles_manager, layout, &layout_i, sizeof(layout_i) );
+    _vc_descriptor_set_layout_intern *sl_i = &layout_i;
+
+    u32 key_length = 1 + writer->count * VC_SET_CACHE_WRITE_WORDS;
+    u64 *key       = alloca(sizeof(u64) * key_length);
+    _vc_descriptor_set_writer_key(writer, layout, key);
+    u64 hash = vc_set_cache_hash(key, key_length);
+
+    pthread_mutex_lock(&ctx->set_cache.lock);
+
+    vc_descriptor_set hndl = vc_set_cache_lookup(&ctx->set_cache, hash, key, key_length);
+    if(hndl == VC_NULL_HANDLE)
+    {
+        // Rewrite an evicted set when possible, allocate otherwise
+        _vc_descriptor_set_intern set_i =
+        {
+            .layout        = sl_i->layout,
+            .buffer_layout = sl_i->buffer_layout,
+        };
+
+        b8 available = vc_set_cache_take_reusable(&ctx->set_cache, sl_i->layout, &set_i.set, &set_i.offset);
+        if(!available)
+        {
+            vc_ds_thread_allocator *alloc = vc_ds_registry_get(&ctx->ds_registry);
+            available = _vc_descriptor_set_storage_allocate(ctx, sl_i, &alloc->persistent, VC_DESCRIPTOR_BUFFER_PERSISTENT, &set_i);
+        }
+
+        if(available)
+        {
+            _vc_descriptor_set_writer_update(ctx, writer, &set_i);
+
+            hndl = _vc_descriptor_set_handle_create(ctx, &set_i);
+            vc_set_cache_insert(&ctx->set_cache, ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT, hash, key, key_length, hndl, set_i.set, set_i.offset, sl_i->layout);
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->set_cache.lock);
+
+    _vc_descriptor_set_writer_reset(writer);
+    return hndl;
+}
+
+void
+_vc_descriptor_update_template_destroy(vc_ctx *ctx, _vc_descriptor_update_template_intern *i)
+{
+    vkDestroyDescriptorUpdateTemplate(ctx->current_device, i->update_template, NULL);
+    if(i->entries != NULL)
+    {
+        mem_free(i->entries);
+    }
+}
+
+// Creates a template from the writes of a writer, the type specific fields of the create info must be filled in
+vc_descriptor_update_template
+_vc_descriptor_set_writer_compile(vc_ctx *ctx, vc_descriptor_set_writer *writer, VkDescriptorUpdateTemplateCreateInfo *template_ci, _vc_descriptor_update_template_intern *template_i)
+{
+    u32 write_count                          = writer->count;
+    VkDescriptorUpdateTemplateEntry *entries = alloca(sizeof(VkDescriptorUpdateTemplateEntry) * (write_count + 1) );
+    u32 entry_count                          = 0;
+
+    // Writes to consecutive elements of the same binding are merged into a single entry
+    for(u32 i = 0; i < write_count; i++)
+    {
+        VkWriteDescriptorSet *w = &writer->writes[i];
+
+        if(entry_count > 0)
+        {
+            VkDescriptorUpdateTemplateEntry *last = &entries[entry_count - 1];
+            if(last->dstBinding == w->dstBinding && last->descriptorType == w->descriptorType &&
+               last->dstArrayElement + last->descriptorCount == w->dstArrayElement)
+            {
+                last->descriptorCount++;
+                continue;
+            }
+        }
+
+        entries[entry_count++] = (VkDescriptorUpdateTemplateEntry) {
+            .dstBinding      = w->dstBinding,
+            .dstArrayElement = w->dstArrayElement,
+            .descriptorCount = 1,
+            .descriptorType  = w->descriptorType,
+            .offset          = sizeof(vc_descriptor_data) * i,
+            .stride          = sizeof(vc_descriptor_data),
+        };
+    }
+
+    template_ci->sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    template_ci->descriptorUpdateEntryCount = entry_count;
+    template_ci->pDescriptorUpdateEntries   = entries;
+    template_i->data_count                  = write_count;
+
+    template_i->entries                     = NULL;
+    template_i->entry_count                 = entry_count;
+
+    _vc_descriptor_set_writer_reset(writer);
+
+    if(template_ci->templateType == VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET && ctx->supported_features.descriptor_buffer)
+    {
+        // Descriptor buffer sets are not VkDescriptorSets, the entries are replayed as writes instead
+        template_i->update_template = VK_NULL_HANDLE;
+        template_i->entries         = mem_allocate(sizeof(VkDescriptorUpdateTemplateEntry) * (entry_count + 1), MEMORY_TAG_RENDERER);
+        mem_memcpy(template_i->entries, entries, sizeof(VkDescriptorUpdateTemplateEntry) * entry_count);
+    }
+    else
+    {
+        VK_CHECKH(vkCreateDescriptorUpdateTemplate(ctx->current_device, template_ci, NULL, &template_i->update_template), "Could not create a descriptor update template.");
+    }
+
+    vc_descriptor_update_template hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_UPDATE_TEMPLATE, template_i);
+    vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_UPDATE_TEMPLATE, (vc_handle_destroy_func)_vc_descriptor_update_template_destroy);
+
+    return hndl;
+}
+
+vc_descriptor_update_template
+vc_descriptor_set_writer_compile(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_descriptor_set_layout layout)
+{
+    _vc_descriptor_set_layout_intern sl_i;
+    vc_handles_manager_read(&ctx->handles_manager, layout, &sl_i, sizeof(sl_i) );
+
+    VkDescriptorUpdateTemplateCreateInfo template_ci =
+    {
+        .templateType        = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+        .descriptorSetLayout = sl_i.layout,
+    };
+
+    _vc_descriptor_update_template_intern template_i =
+    {
+        .layout = sl_i.layout,
+        .push   = FALSE,
+    };
+
+    return _vc_descriptor_set_writer_compile(ctx, writer, &template_ci, &template_i);
+}
+
+vc_descriptor_update_template
+vc_descriptor_set_writer_compile_push(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_handle pipeline, u32 set_index)
+{
+    if(!ctx->supported_features.push_descriptor)
+    {
+        vc_error("Cannot compile a push descriptor template, the push_descriptor feature is not supported.");
+        return VC_NULL_HANDLE;
+    }
+
+    vc_pipeline_type *pipe         = vc_handles_manager_deref(&ctx->handles_manager, pipeline);
+    VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    VkPipelineLayout layout        = VK_NULL_HANDLE;
+
+    if(*pipe == VC_PIPELINE_COMPUTE)
+    {
+        bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+        layout     = ( (_vc_compute_pipeline_intern *)pipe )->layout;
+    }
+    else if(*pipe == VC_PIPELINE_SHADER)
+    {
+        _vc_shader_intern *shader_i = (_vc_shader_intern *)pipe;
+        bind_point = shader_i->stage == VK_SHADER_STAGE_COMPUTE_BIT ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+        layout     = shader_i->layout;
+    }
+    else
+    {
+        layout = ( (_vc_gfx_pipeline_intern *)pipe )->layout;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo template_ci =
+    {
+        .templateType      = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR,
+        .pipelineBindPoint = bind_point,
+        .pipelineLayout    = layout,
+        .set               = set_index,
+    };
+
+    _vc_descriptor_update_template_intern template_i =
+    {
+        .layout    = VK_NULL_HANDLE,
+        .push      = TRUE,
+        .set_index = set_index,
+    };
+
+    return _vc_descriptor_set_writer_compile(ctx, writer, &template_ci, &template_i);
+}
+
+void
+vc_descriptor_set_update_with_template(vc_ctx *ctx, vc_descriptor_set set, vc_descriptor_update_template update_template, const vc_descriptor_data *data)
+{
+    _vc_descriptor_set_intern set_i;
+    vc_handles_manager_read(&ctx->handles_manager, set, &set_i, sizeof(set_i) );
+    _vc_descriptor_update_template_intern *template_i = vc_handles_manager_deref(&ctx->handles_manager, update_template);
+
+    if(template_i->push || template_i->layout != set_i.layout)
+    {
+        vc_error("Descriptor update template used on a set of another layout.");
+        return;
+    }
+
+    if(template_i->entries == NULL)
+    {
+        vkUpdateDescriptorSetWithTemplate(ctx->current_device, set_i.set, template_i->update_template, data);
+        return;
+    }
+
+    // One write per descriptor, pointing into the data
+    VkWriteDescriptorSet *writes = alloca(sizeof(VkWriteDescriptorSet) * (template_i->data_count + 1) );
+    u32 write_count              = 0;
+    for(u32 e = 0; e < template_i->entry_count; e++)
+    {
+        VkDescriptorUpdateTemplateEntry *entry = &template_i->entries[e];
+        for(u32 d = 0; d < entry->descriptorCount; d++)
+        {
+            const vc_descriptor_data *desc = (const vc_descriptor_data *)( (const u8 *)data + entry->offset + entry->stride * d );
+            _vc_descriptor_kind kind       = _vc_descriptor_type_kind(entry->descriptorType);
+            if(kind == _VC_DESCRIPTOR_KIND_UNSUPPORTED)
+            {
+                vc_error("Descriptor update template: unsupported descriptor type %u.", entry->descriptorType);
+                break;
+            }
+
+            writes[write_count++] = (VkWriteDescriptorSet) {
+                .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstBinding       = entry->dstBinding,
+                .dstArrayElement  = entry->dstArrayElement + d,
+                .descriptorCount  = 1,
+                .descriptorType   = entry->descriptorType,
+                .pImageInfo       = kind == _VC_DESCRIPTOR_KIND_IMAGE ? &desc->image : NULL,
+                .pBufferInfo      = kind == _VC_DESCRIPTOR_KIND_BUFFER ? &desc->buffer : NULL,
+                .pTexelBufferView = kind == _VC_DESCRIPTOR_KIND_TEXEL_BUFFER ? &desc->texel_buffer : NULL,
+            };
+        }
+    }
+
+    _vc_descriptor_set_write(ctx, &set_i, write_count, writes);
+}
+
+vc_descriptor_data
+vc_descriptor_data_image(vc_ctx *ctx, vc_image_view view, vc_sampler sampler, VkImageLayout layout)
+{
+    vc_descriptor_data data =
+    {
+        .image =
+        {
+            .sampler     = VK_NULL_HANDLE,
+            .imageView   = VK_NULL_HANDLE,
+            .imageLayout = layout,
+        },
+    };
+
+    if(view != VC_NULL_HANDLE)
     {
-        writer->writes[i].dstSet = set_i->set;
+        _vc_image_view_intern img_vw_i;
+        vc_handles_manager_read(&ctx->handles_manager, view, &img_vw_i, sizeof(img_vw_i) );
+        data.image.imageView = img_vw_i.view;
     }
-    vkUpdateDescriptorSets(ctx->current_device, darray_length(writer->writes), writer->writes, 0, 0);
 
-    darray_destroy(writer->writes);
-    darray_destroy(writer->buf_infos);
-    darray_destroy(writer->img_infos);
+    if(sampler != VC_NULL_HANDLE)
+    {
+        _vc_sampler_intern sampler_i;
+        vc_handles_manager_read(&ctx->handles_manager, sampler, &sampler_i, sizeof(sampler_i) );
+        data.image.sampler = sampler_i.sampler;
+    }
+
+    return data;
 }
 
+vc_descriptor_data
+vc_descriptor_data_buffer(vc_ctx *ctx, vc_buffer buffer, u64 offset, u64 range)
+{
+    _vc_buffer_intern buf_i;
+    vc_handles_manager_read(&ctx->handles_manager, buffer, &buf_i, sizeof(buf_i) );
+
+    vc_descriptor_data data =
+    {
+        .buffer =
+        {
+            .buffer = buf_i.buffer,
+            .offset = offset,
+            .range  = range == VK_WHOLE_SIZE ? buf_i.size - offset : range,
+        },
+    };
+
+    return data;
+}
@@ -1,9 +1,12 @@
 #include "vc_ds_alloc.h"
 #include "../base/data_structures/darray.h"
+#include "../base/memory.h"
+#include "../base/math.h"
 #include "../vc_enum_util.h"
 
 #define _VC_POOL_RESIZE_FACTOR   1.5f
 #define _VC_POOL_MAX_SETS        4096
+#define _VC_POOL_HEADROOM        1.25f // Of the sets allocated in a reset cycle, when consolidating pools
 
 #define _VC_DEFAULT_RATIOS_COUNT 11
 vc_ds_ratio _vc_ds_default_ratios[_VC_DEFAULT_RATIOS_COUNT] =
@@ -43,27 +46,41 @@ vc_ds_ratio _vc_ds_default_ratios[_VC_DEFAULT_RATIOS_COUNT] =
 
 #include <alloca.h>
 
-VkDescriptorPool
-_vc_ds_get_pool(VkDevice dev, vc_descriptor_set_allocator *allocator)
+// The allocating thread is the only writer of its statistics, relaxed stores are enough for the readers
+#define _VC_DS_STAT_ADD(field, n) __atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+
+// Creates a pool of allocator->current_set_count sets, large enough for a set of the given demand
+b8
+_vc_ds_create_pool(VkDevice dev, vc_descriptor_set_allocator *allocator, const vc_ds_demand *demand, _vc_ds_pool *pool)
 {
-    // Check if pool is available in ready pools
-    if(darray_length(allocator->ready_pools) > 0)
+    *pool = (_vc_ds_pool) {
+        .pool     = VK_NULL_HANDLE,
+        .max_sets = allocator->current_set_count,
+        .sets     = 0,
+    };
+
+    VkDescriptorPoolSize sizes[VC_DS_TYPE_COUNT];
+    u32 size_count = 0;
+    for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
     {
-        VkDescriptorPool pool = VK_NULL_HANDLE;
-        darray_pop(allocator->ready_pools, &pool);
-        return pool;
-    }
+        f32 ratio = 0.0f;
+        __atomic_load(&allocator->ratios[t], &ratio, __ATOMIC_RELAXED);
 
-    // Create a new pool
-    VkDescriptorPoolSize *sizes = alloca( darray_length(allocator->ratios) * sizeof(*sizes) );
+        u32 count = ratio * pool->max_sets;
+        if(count < demand->counts[t])
+        {
+            count = demand->counts[t];
+        }
 
-    for(u32 i = 0; i < darray_length(allocator->ratios); i++)
-    {
-        sizes[i] = (VkDescriptorPoolSize)
+        pool->capacity[t] = count;
+        pool->used[t]     = 0;
+        if(count > 0)
         {
-            .type            = allocator->ratios[i].type,
-            .descriptorCount = allocator->ratios[i].ratio * allocator->current_set_count,
-        };
+            sizes[size_count++] = (VkDescriptorPoolSize) {
+                .type            = t,
+                .descriptorCount = count,
+            };
+        }
     }
 
     allocator->current_set_count *= _VC_POOL_RESIZE_FACTOR;
@@ -75,86 +92,278 @@ _vc_ds_get_pool(VkDevice dev, vc_descriptor_set_allocator *allocator)
     VkDescriptorPoolCreateInfo pool_ci =
     {
         .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets       = allocator->current_set_count,
-        .poolSizeCount = darray_length(allocator->ratios),
+        .maxSets       = pool->max_sets,
+        .poolSizeCount = size_count,
         .pPoolSizes    = sizes,
     };
+    VK_CHECKR(vkCreateDescriptorPool(dev, &pool_ci, NULL, &pool->pool), "Could not create a new descriptor pool.");
 
-    VkDescriptorPool new_pool = VK_NULL_HANDLE;
-    VK_CHECK(vkCreateDescriptorPool(dev, &pool_ci, NULL, &new_pool), "Could not create a new descriptor pool.");
-
-    return new_pool;
+    _VC_DS_STAT_ADD(allocator->stats.pools, 1);
+    return TRUE;
 }
 
+// A pool could not fit a set, it is kept aside until the next reset, and its leftovers are accounted as waste
 void
-vc_ds_alloc_create(vc_descriptor_set_allocator *allocator, vc_ds_ratio *pool_ratios, u32 ratio_count, u32 start_set_count)
+_vc_ds_retire_pool(vc_descriptor_set_allocator *allocator, _vc_ds_pool *pool)
 {
-    allocator->full_pools        = darray_create(VkDescriptorPool);
-    allocator->ready_pools       = darray_create(VkDescriptorPool);
-    allocator->ratios            = darray_create(vc_ds_ratio);
-    allocator->current_set_count = start_set_count;
+    _VC_DS_STAT_ADD(allocator->stats.wasted_sets, pool->max_sets - pool->sets);
+    for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+    {
+        _VC_DS_STAT_ADD(allocator->stats.capacity[t], pool->capacity[t]);
+        _VC_DS_STAT_ADD(allocator->stats.wasted[t], pool->capacity[t] - pool->used[t]);
+    }
+
+    darray_push(allocator->full_pools, *pool);
+}
 
+void
+vc_ds_ratios_fill(f32 ratios[VC_DS_TYPE_COUNT], vc_ds_ratio *pool_ratios, u32 ratio_count)
+{
     if(ratio_count == 0 || !pool_ratios)
     {
         pool_ratios = _vc_ds_default_ratios;
         ratio_count = _VC_DEFAULT_RATIOS_COUNT;
     }
 
+    for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+    {
+        ratios[t] = 0.0f;
+    }
+
     for(u32 i = 0; i < ratio_count; i++)
     {
-        darray_push(allocator->ratios, pool_ratios[i]);
+        if( (u32)pool_ratios[i].type < VC_DS_TYPE_COUNT )
+        {
+            ratios[pool_ratios[i].type] = pool_ratios[i].ratio;
+        }
     }
 }
 
-VkDescriptorSet
-vc_ds_alloc_allocate(vc_descriptor_set_allocator *allocator, VkDevice dev, VkDescriptorSetLayout layout)
+void
+vc_ds_alloc_create(vc_descriptor_set_allocator *allocator, f32 *ratios, u32 start_set_count)
+{
+    allocator->full_pools        = darray_create(_vc_ds_pool);
+    allocator->ready_pools       = darray_create(_vc_ds_pool);
+    allocator->ratios            = ratios;
+    allocator->current_set_count = start_set_count;
+    allocator->allocated_sets    = 0;
+    allocator->stats             = (vc_ds_stats) {
+        0
+    };
+}
+
+// Returns how many of the sets fit in what is left of the pool
+u32
+_vc_ds_pool_fit(_vc_ds_pool *pool, u32 count, const vc_ds_demand **demands)
 {
-    VkDescriptorPool pool = _vc_ds_get_pool(dev, allocator);
+    u32 used[VC_DS_TYPE_COUNT];
+    mem_memcpy(used, pool->used, sizeof(used) );
 
-    VkDescriptorSetAllocateInfo alloc_info =
+    u32 fit = 0;
+    while(fit < count && pool->sets + fit < pool->max_sets)
     {
-        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool     = pool,
-        .descriptorSetCount = 1,
-        .pSetLayouts        = &layout,
-    };
+        for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+        {
+            used[t] += demands[fit]->counts[t];
+            if(used[t] > pool->capacity[t])
+            {
+                return fit;
+            }
+        }
+        fit++;
+    }
 
-    VkDescriptorSet ds = VK_NULL_HANDLE;
-    VkResult res       = vkAllocateDescriptorSets(dev, &alloc_info, &ds);
+    return fit;
+}
 
-    // Allocation failed, mark pool as full
-    if(res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL)
+u32
+vc_ds_alloc_allocate_n(vc_descriptor_set_allocator *allocator, VkDevice dev, u32 count, const VkDescriptorSetLayout *layouts, const vc_ds_demand **demands, VkDescriptorSet *sets)
+{
+    u32 done = 0;
+    while(done < count)
     {
-        darray_push(allocator->full_pools, pool);
+        // Ready pools are tried first, a new pool always fits the next set
+        _vc_ds_pool pool;
+        b8 fresh = darray_length(allocator->ready_pools) == 0;
+        if(!fresh)
+        {
+            darray_pop(allocator->ready_pools, &pool);
+        }
+        else
+        {
+            // Sized for as much of the batch as a pool may take
+            u32 remaining                = count - done;
+            allocator->current_set_count = MAX(allocator->current_set_count, MIN(remaining, _VC_POOL_MAX_SETS) );
+
+            vc_ds_demand batch_demand =
+            {
+                {
+                    0
+                }
+            };
+            for(u32 i = 0; i < MIN(remaining, allocator->current_set_count); i++)
+            {
+                for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+                {
+                    batch_demand.counts[t] += demands[done + i]->counts[t];
+                }
+            }
+
+            if(!_vc_ds_create_pool(dev, allocator, &batch_demand, &pool) )
+            {
+                return done;
+            }
+        }
+
+        u32 fit = _vc_ds_pool_fit(&pool, count - done, &demands[done]);
+        if(fit == 0)
+        {
+            if(fresh)
+            {
+                vc_error("Descriptor set allocation error: a new pool cannot fit the set.");
+                darray_push(allocator->ready_pools, pool);
+                return done;
+            }
 
-        // Retry
-        pool                      = _vc_ds_get_pool(dev, allocator);
-        alloc_info.descriptorPool = pool;
-        VK_CHECK(vkAllocateDescriptorSets(dev, &alloc_info, &ds), "Descriptor set allocation error: Free pool should not have been full.");
+            // Out of pool memory, without asking the driver
+            _VC_DS_STAT_ADD(allocator->stats.out_of_pool_retries, 1);
+            _vc_ds_retire_pool(allocator, &pool);
+            continue;
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info =
+        {
+            .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool     = pool.pool,
+            .descriptorSetCount = fit,
+            .pSetLayouts        = &layouts[done],
+        };
+        VkResult res = vkAllocateDescriptorSets(dev, &alloc_info, &sets[done]);
+        if(res != VK_SUCCESS)
+        {
+            if( fresh || (res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL) )
+            {
+                vc_error("Descriptor set allocation error: %s.", vc_priv_VkResult_to_str(res) );
+                darray_push(allocator->ready_pools, pool);
+                return done;
+            }
+
+            // The pool is full, retry with the next one
+            if(res == VK_ERROR_FRAGMENTED_POOL)
+            {
+                _VC_DS_STAT_ADD(allocator->stats.fragmented_retries, 1);
+            }
+            else
+            {
+                _VC_DS_STAT_ADD(allocator->stats.out_of_pool_retries, 1);
+            }
+            _vc_ds_retire_pool(allocator, &pool);
+            continue;
+        }
+
+        pool.sets += fit;
+        for(u32 i = done; i < done + fit; i++)
+        {
+            for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+            {
+                if(demands[i]->counts[t] > 0)
+                {
+                    pool.used[t] += demands[i]->counts[t];
+                    _VC_DS_STAT_ADD(allocator->stats.demand[t], demands[i]->counts[t]);
+                }
+            }
+        }
+        _VC_DS_STAT_ADD(allocator->stats.sets, fit);
+
+        // Put gotten pool back into list
+        darray_push(allocator->ready_pools, pool);
+        allocator->allocated_sets += fit;
+        done                      += fit;
     }
 
-    // Put gotten pull back into list
-    darray_push(allocator->ready_pools, pool);
+    return done;
+}
+
+VkDescriptorSet
+vc_ds_alloc_allocate(vc_descriptor_set_allocator *allocator, VkDevice dev, VkDescriptorSetLayout layout, const vc_ds_demand *demand)
+{
+    VkDescriptorSet ds = VK_NULL_HANDLE;
+    vc_ds_alloc_allocate_n(allocator, dev, 1, &layout, &demand, &ds);
     return ds;
 }
 
 void
-vc_ds_alloc_destroy(vc_descriptor_set_allocator *allocator, VkDevice dev)
+_vc_ds_destroy_pools(_vc_ds_pool *pools, VkDevice dev)
+{
+    for(u32 i = 0; i < darray_length(pools); i++)
+    {
+        vkDestroyDescriptorPool(dev, pools[i].pool, NULL);
+    }
+    darray_clear(pools);
+}
+
+void
+vc_ds_alloc_reset(vc_descriptor_set_allocator *allocator, VkDevice dev)
 {
+    if(allocator->allocated_sets == 0)
+    {
+        return;
+    }
+
+    // Pools filled up since the last reset: replace them all by a single pool sized for what was allocated, so
+    // transient allocators converge to one pool per frame
+    u32 needed_sets = allocator->allocated_sets * _VC_POOL_HEADROOM;
+    if(darray_length(allocator->full_pools) > 0 && needed_sets <= _VC_POOL_MAX_SETS)
+    {
+        _vc_ds_destroy_pools(allocator->ready_pools, dev);
+        _vc_ds_destroy_pools(allocator->full_pools, dev);
+
+        allocator->current_set_count = MAX(allocator->current_set_count, needed_sets);
+        allocator->allocated_sets    = 0;
+        return;
+    }
+
     u32 ready_pool_length = darray_length(allocator->ready_pools);
     for(u32 i = 0; i < ready_pool_length; i++)
     {
-        vkDestroyDescriptorPool(dev, allocator->ready_pools[i], NULL);
+        VK_CHECK(vkResetDescriptorPool(dev, allocator->ready_pools[i].pool, 0), "Could not reset a descriptor pool.");
+        allocator->ready_pools[i].sets = 0;
+        mem_memset(allocator->ready_pools[i].used, 0, sizeof(allocator->ready_pools[i].used) );
     }
 
+    // Full pools are empty again
     u32 full_pool_length = darray_length(allocator->full_pools);
     for(u32 i = 0; i < full_pool_length; i++)
     {
-        vkDestroyDescriptorPool(dev, allocator->full_pools[i], NULL);
+        _vc_ds_pool pool = allocator->full_pools[i];
+        VK_CHECK(vkResetDescriptorPool(dev, pool.pool, 0), "Could not reset a descriptor pool.");
+        pool.sets = 0;
+        mem_memset(pool.used, 0, sizeof(pool.used) );
+        darray_push(allocator->ready_pools, pool);
     }
+    darray_clear(allocator->full_pools);
+
+    allocator->allocated_sets = 0;
+}
+
+void
+vc_ds_alloc_destroy(vc_descriptor_set_allocator *allocator, VkDevice dev)
+{
+    _vc_ds_destroy_pools(allocator->ready_pools, dev);
+    _vc_ds_destroy_pools(allocator->full_pools, dev);
 
     darray_destroy(allocator->full_pools);
     darray_destroy(allocator->ready_pools);
-    darray_destroy(allocator->ratios);
 }
 
+void
+vc_ds_stats_accumulate(vc_ds_stats *stats, const vc_ds_stats *alloc_stats)
+{
+    // Every field is a u64 counter
+    const u64 *src = (const u64 *)alloc_stats;
+    u64 *dst       = (u64 *)stats;
+    for(u32 i = 0; i < sizeof(vc_ds_stats) / sizeof(u64); i++)
+    {
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
@@ -5,6 +5,11 @@
 #include "../base/types.h"
 
 // Based on vkguide's implementation
+// New pools are sized from ratios of descriptors per set, tuned from the observed demand (see vc_ds_registry), and
+// always large enough for the set being allocated.
+
+// Descriptor types handled by the pools (the core types, indexed by VkDescriptorType)
+#define VC_DS_TYPE_COUNT (VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1)
 
 typedef struct
 {
@@ -12,19 +17,66 @@ typedef struct
     f32                 ratio;
 } vc_ds_ratio;
 
+// Descriptor counts of a set layout, by type
+typedef struct
+{
+    u32    counts[VC_DS_TYPE_COUNT];
+} vc_ds_demand;
+
+/**
+ * @brief Descriptor pool usage statistics
+ */
+typedef struct
+{
+    u64    sets; // Sets allocated
+    u64    pools; // Pools created
+    u64    out_of_pool_retries; // Allocations moved to another pool, the current one being out of memory
+    u64    fragmented_retries; // Allocations retried after VK_ERROR_FRAGMENTED_POOL
+    u64    wasted_sets; // Sets left unallocated in the pools that filled up
+    u64    demand[VC_DS_TYPE_COUNT]; // Descriptors allocated, by type
+    u64    capacity[VC_DS_TYPE_COUNT]; // Descriptors of the pools that filled up, by type
+    u64    wasted[VC_DS_TYPE_COUNT]; // Descriptors left unallocated in the pools that filled up, by type
+} vc_ds_stats;
+
+typedef struct
+{
+    VkDescriptorPool    pool;
+    u32                 max_sets;
+    u32                 sets;
+    u32                 capacity[VC_DS_TYPE_COUNT];
+    u32                 used[VC_DS_TYPE_COUNT];
+} _vc_ds_pool;
+
 typedef struct
 {
-    VkDescriptorPool   *ready_pools; // darray
-    VkDescriptorPool   *full_pools; // darray
+    _vc_ds_pool   *ready_pools; // darray
+    _vc_ds_pool   *full_pools; // darray
 
-    vc_ds_ratio        *ratios; // darray
-    u32                 current_set_count;
+    f32           *ratios; // VC_DS_TYPE_COUNT descriptors per set, owned by the caller, read atomically
+    u32            current_set_count;
+    u32            allocated_sets; // Since the last reset
+
+    vc_ds_stats    stats; // Only written by the allocating thread, read atomically by others
 } vc_descriptor_set_allocator;
 
-void            vc_ds_alloc_create(vc_descriptor_set_allocator *allocator, vc_ds_ratio *pool_ratios, u32 ratio_count, u32 start_set_count);
+// Fills a ratio table indexed by descriptor type, the default ratios are used if pool_ratios is NULL
+void            vc_ds_ratios_fill(f32 ratios[VC_DS_TYPE_COUNT], vc_ds_ratio *pool_ratios, u32 ratio_count);
+
+// Creates an allocator using a ratio table owned by the caller, which must outlive the allocator
+void            vc_ds_alloc_create(vc_descriptor_set_allocator *allocator, f32 *ratios, u32 start_set_count);
+
+VkDescriptorSet vc_ds_alloc_allocate(vc_descriptor_set_allocator *allocator, VkDevice dev, VkDescriptorSetLayout layout, const vc_ds_demand *demand);
+
+// Allocates count sets, with as few vkAllocateDescriptorSets calls as the pools allow, returns the number of sets allocated
+u32             vc_ds_alloc_allocate_n(vc_descriptor_set_allocator *allocator, VkDevice dev, u32 count, const VkDescriptorSetLayout *layouts, const vc_ds_demand **demands, VkDescriptorSet *sets);
+
+// Frees every set allocated from the allocator at once, keeping the pools for reuse
+void            vc_ds_alloc_reset(vc_descriptor_set_allocator *allocator, VkDevice dev);
+
+void            vc_ds_alloc_destroy(vc_descriptor_set_allocator *allocator, VkDevice dev);
 
-VkDescriptorSet vc_ds_alloc_allocate(vc_descriptor_set_allocator *allocator, VkDevice dev, VkDescriptorSetLayout layout);
+// Adds the statistics of an allocator to stats, may be called while the allocator is in use
+void            vc_ds_stats_accumulate(vc_ds_stats *stats, const vc_ds_stats *alloc_stats);
 
-void vc_ds_alloc_destroy(vc_descriptor_set_allocator *allocator, VkDevice dev);
 #endif // __VC_DS_ALLOC__
 
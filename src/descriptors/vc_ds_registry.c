@@ -0,0 +1,230 @@
+#include "vc_ds_registry.h"
+#include "../base/data_structures/darray.h"
+#include "../base/memory.h"
+#include "../vulcain.h"
+#include <stdio.h>
+
+#define _VC_DS_START_SET_COUNT 16
+
+// Sets allocated before the ratios are retuned, and margin over the observed descriptors per set
+#define _VC_DS_TUNE_MIN_SETS   256
+#define _VC_DS_TUNE_HEADROOM   1.25f
+#define _VC_DS_TUNE_MIN_RATIO  0.01f
+
+static u64 _vc_ds_registry_next_id = 1;
+
+// Last allocators used by the thread, avoids taking the lock on every allocation
+static _Thread_local struct
+{
+    u64                       registry_id;
+    vc_ds_thread_allocator   *alloc;
+} _vc_ds_thread_cache;
+
+void
+vc_ds_registry_create(vc_ds_registry *reg, vc_ds_ratio *pool_ratios, u32 ratio_count)
+{
+    reg->id      = __atomic_fetch_add(&_vc_ds_registry_next_id, 1, __ATOMIC_RELAXED);
+    reg->threads = darray_create(vc_ds_thread_allocator *);
+    reg->tuned   = (vc_ds_stats) {
+        0
+    };
+    vc_ds_ratios_fill(reg->ratios, pool_ratios, ratio_count);
+
+    pthread_mutex_init(&reg->lock, NULL);
+}
+
+void
+vc_ds_registry_destroy(vc_ds_registry *reg, VkDevice dev)
+{
+    for(u32 i = 0; i < darray_length(reg->threads); i++)
+    {
+        vc_ds_thread_allocator *alloc = reg->threads[i];
+
+        vc_ds_alloc_destroy(&alloc->persistent, dev);
+        for(u32 f = 0; f < VC_FRAMES_IN_FLIGHT; f++)
+        {
+            vc_ds_alloc_destroy(&alloc->frames[f], dev);
+            darray_destroy(alloc->frame_handles[f]);
+        }
+        mem_free(alloc);
+    }
+    darray_destroy(reg->threads);
+
+    pthread_mutex_destroy(&reg->lock);
+
+    reg->threads = NULL;
+}
+
+vc_ds_thread_allocator *
+vc_ds_registry_get(vc_ds_registry   *reg)
+{
+    if(_vc_ds_thread_cache.registry_id == reg->id)
+    {
+        return _vc_ds_thread_cache.alloc;
+    }
+
+    pthread_t self                = pthread_self();
+    vc_ds_thread_allocator *alloc = NULL;
+
+    pthread_mutex_lock(&reg->lock);
+
+    // The thread may have used another registry since
+    for(u32 i = 0; i < darray_length(reg->threads); i++)
+    {
+        if(pthread_equal(reg->threads[i]->owner, self))
+        {
+            alloc = reg->threads[i];
+            break;
+        }
+    }
+
+    if(alloc == NULL)
+    {
+        alloc        = mem_allocate(sizeof(vc_ds_thread_allocator), MEMORY_TAG_RENDERER);
+        alloc->owner = self;
+
+        vc_ds_alloc_create(&alloc->persistent, reg->ratios, _VC_DS_START_SET_COUNT);
+        for(u32 f = 0; f < VC_FRAMES_IN_FLIGHT; f++)
+        {
+            vc_ds_alloc_create(&alloc->frames[f], reg->ratios, _VC_DS_START_SET_COUNT);
+            alloc->frame_handles[f] = darray_create(vc_descriptor_set);
+        }
+
+        darray_push(reg->threads, alloc);
+    }
+
+    pthread_mutex_unlock(&reg->lock);
+
+    _vc_ds_thread_cache.registry_id = reg->id;
+    _vc_ds_thread_cache.alloc       = alloc;
+    return alloc;
+}
+
+// Must be called with the lock held
+void
+_vc_ds_registry_sum_stats(vc_ds_registry *reg, vc_ds_stats *stats)
+{
+    *stats = (vc_ds_stats) {
+        0
+    };
+
+    for(u32 i = 0; i < darray_length(reg->threads); i++)
+    {
+        vc_ds_stats_accumulate(stats, &reg->threads[i]->persistent.stats);
+        for(u32 f = 0; f < VC_FRAMES_IN_FLIGHT; f++)
+        {
+            vc_ds_stats_accumulate(stats, &reg->threads[i]->frames[f].stats);
+        }
+    }
+}
+
+// Moves the ratios towards the descriptors per set allocated since the last tuning, must be called with the lock held
+void
+_vc_ds_registry_tune(vc_ds_registry   *reg)
+{
+    vc_ds_stats stats;
+    _vc_ds_registry_sum_stats(reg, &stats);
+
+    u64 sets = stats.sets - reg->tuned.sets;
+    if(sets < _VC_DS_TUNE_MIN_SETS)
+    {
+        return;
+    }
+
+    for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+    {
+        f32 observed = (f32)(stats.demand[t] - reg->tuned.demand[t]) / sets * _VC_DS_TUNE_HEADROOM;
+
+        // Smoothed, a single unusual frame does not resize every new pool
+        f32 ratio = 0.0f;
+        __atomic_load(&reg->ratios[t], &ratio, __ATOMIC_RELAXED);
+        ratio = (ratio + observed) * 0.5f;
+        if(ratio < _VC_DS_TUNE_MIN_RATIO)
+        {
+            ratio = 0.0f; // Pools still fit the sets of a type no longer in the ratios
+        }
+        __atomic_store(&reg->ratios[t], &ratio, __ATOMIC_RELAXED);
+    }
+
+    reg->tuned = stats;
+}
+
+void
+vc_ds_registry_frame_reset(vc_ds_registry *reg, vc_handles_manager *mgr, VkDevice dev, u32 slot)
+{
+    pthread_mutex_lock(&reg->lock);
+
+    for(u32 i = 0; i < darray_length(reg->threads); i++)
+    {
+        vc_ds_thread_allocator *alloc = reg->threads[i];
+        vc_descriptor_set *hndls      = alloc->frame_handles[slot];
+
+        // Freed in reverse order, so the handles are found at the end of the destroy queue
+        for(u32 h = darray_length(hndls); h-- > 0; )
+        {
+            vc_handles_manager_dealloc(mgr, hndls[h]);
+        }
+        darray_clear(alloc->frame_handles[slot]);
+
+        vc_ds_alloc_reset(&alloc->frames[slot], dev);
+    }
+
+    _vc_ds_registry_tune(reg);
+
+    pthread_mutex_unlock(&reg->lock);
+}
+
+void
+vc_ds_registry_stats(vc_ds_registry *reg, vc_ds_stats *stats)
+{
+    pthread_mutex_lock(&reg->lock);
+    _vc_ds_registry_sum_stats(reg, stats);
+    pthread_mutex_unlock(&reg->lock);
+}
+
+b8
+vc_ds_registry_save_ratios(vc_ds_registry *reg, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if(!f)
+    {
+        vc_error("Could not open '%s' to save the descriptor pool ratios.", path);
+        return FALSE;
+    }
+
+    for(u32 t = 0; t < VC_DS_TYPE_COUNT; t++)
+    {
+        f32 ratio = 0.0f;
+        __atomic_load(&reg->ratios[t], &ratio, __ATOMIC_RELAXED);
+        fprintf(f, "%u %f\n", t, ratio);
+    }
+
+    fclose(f);
+    return TRUE;
+}
+
+b8
+vc_ds_registry_load_ratios(vc_ds_registry *reg, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if(!f)
+    {
+        vc_warn("Could not open '%s' to load the descriptor pool ratios.", path);
+        return FALSE;
+    }
+
+    u32 type  = 0;
+    f32 ratio = 0.0f;
+    while(fscanf(f, "%u %f", &type, &ratio) == 2)
+    {
+        if(type >= VC_DS_TYPE_COUNT || ratio < 0.0f)
+        {
+            vc_warn("Ignoring invalid descriptor pool ratio '%u %f' in '%s'.", type, ratio, path);
+            continue;
+        }
+        __atomic_store(&reg->ratios[type], &ratio, __ATOMIC_RELAXED);
+    }
+
+    fclose(f);
+    return TRUE;
+}
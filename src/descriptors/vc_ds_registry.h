@@ -0,0 +1,100 @@
+#ifndef __VC_DS_REGISTRY__
+#define __VC_DS_REGISTRY__
+
+/*
+ * Per thread descriptor set allocators.
+ * Each thread allocating descriptor sets gets its own allocators, registered on its first allocation, so threads never
+ * contend on pools. Every allocator shares the pool ratios of the registry, which are retuned on frame resets from the
+ * descriptors actually allocated since the last tuning.
+ */
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include "../base/types.h"
+#include "../handles/vc_handles.h"
+#include "../vc_frames.h"
+#include "vc_ds_alloc.h"
+
+typedef struct
+{
+    pthread_t                      owner;
+
+    vc_descriptor_set_allocator    persistent;
+    vc_descriptor_set_allocator    frames[VC_FRAMES_IN_FLIGHT]; // Transient sets, reset when their frame retires
+    vc_descriptor_set             *frame_handles[VC_FRAMES_IN_FLIGHT]; // darrays, the transient set handles
+} vc_ds_thread_allocator;
+
+typedef struct
+{
+    u64                        id; // Unique, tells apart registries living at the same address
+
+    pthread_mutex_t            lock; // Guards threads, only taken on registration and frame reset
+    vc_ds_thread_allocator   **threads; // darray
+
+    f32                        ratios[VC_DS_TYPE_COUNT]; // Shared by every allocator, read and written atomically
+    vc_ds_stats                tuned; // Statistics at the last tuning
+} vc_ds_registry;
+
+/**
+ * @brief Creates a registry
+ *
+ * @param reg The registry
+ * @param pool_ratios The ratios of descriptor types in the pools (NULL for the defaults)
+ * @param ratio_count The number of ratios
+ */
+void                    vc_ds_registry_create(vc_ds_registry *reg, vc_ds_ratio *pool_ratios, u32 ratio_count);
+
+/**
+ * @brief Destroys the registry, and every pool of every thread
+ *
+ * @param reg The registry
+ * @param dev The device
+ */
+void                    vc_ds_registry_destroy(vc_ds_registry *reg, VkDevice dev);
+
+/**
+ * @brief Returns the allocators of the calling thread, registering them on first use
+ *
+ * @param reg The registry
+ * @return The allocators of the calling thread
+ */
+vc_ds_thread_allocator *vc_ds_registry_get(vc_ds_registry   *reg);
+
+/**
+ * @brief Frees the transient sets of every thread for a frame slot
+ *
+ * @param reg The registry
+ * @param mgr The handles manager of the transient set handles
+ * @param dev The device
+ * @param slot The retired frame slot
+ * @attention No thread may allocate transient sets for the slot during the reset.
+ */
+void                    vc_ds_registry_frame_reset(vc_ds_registry *reg, vc_handles_manager *mgr, VkDevice dev, u32 slot);
+
+/**
+ * @brief Sums the statistics of every allocator of every thread
+ *
+ * @param reg The registry
+ * @param stats The statistics
+ */
+void                    vc_ds_registry_stats(vc_ds_registry *reg, vc_ds_stats *stats);
+
+/**
+ * @brief Writes the current pool ratios to a file, one "<VkDescriptorType> <ratio>" line per type
+ *
+ * @param reg The registry
+ * @param path The path of the file
+ * @return Wether the file could be written
+ */
+b8                      vc_ds_registry_save_ratios(vc_ds_registry *reg, const char *path);
+
+/**
+ * @brief Replaces the pool ratios by those of a file written by vc_ds_registry_save_ratios
+ *
+ * @param reg The registry
+ * @param path The path of the file
+ * @return Wether the file could be read
+ */
+b8                      vc_ds_registry_load_ratios(vc_ds_registry *reg, const char *path);
+
+#endif // __VC_DS_REGISTRY__
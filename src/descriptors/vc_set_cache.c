@@ -0,0 +1,285 @@
+#include "vc_set_cache.h"
+#include "../base/data_structures/darray.h"
+#include "../base/memory.h"
+#include "../base/hash.h"
+
+void
+vc_set_cache_create(vc_set_cache *cache, u32 capacity)
+{
+    // Keep the table at most half full, so probe sequences stay short
+    u32 table_size = 16;
+    while(table_size < capacity * 2)
+    {
+        table_size *= 2;
+    }
+
+    cache->capacity     = capacity;
+    cache->entries      = mem_allocate(sizeof(_vc_set_cache_entry) * capacity, MEMORY_TAG_RENDERER);
+    cache->free_entries = darray_create(u32);
+    cache->lru_head     = VC_SET_CACHE_NONE;
+    cache->lru_tail     = VC_SET_CACHE_NONE;
+
+    for(u32 i = capacity; i > 0; i--)
+    {
+        u32 index = i - 1;
+        darray_push(cache->free_entries, index);
+    }
+
+    cache->table      = mem_allocate(sizeof(u32) * table_size, MEMORY_TAG_RENDERER);
+    cache->table_mask = table_size - 1;
+    mem_memset(cache->table, 0xFF, sizeof(u32) * table_size); // VC_SET_CACHE_NONE
+
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        cache->retiring[i] = darray_create(_vc_set_cache_retired);
+    }
+    cache->reusable = darray_create(_vc_set_cache_retired);
+
+    pthread_mutex_init(&cache->lock, NULL);
+}
+
+void
+vc_set_cache_destroy(vc_set_cache   *cache)
+{
+    // Sets belong to the descriptor pools, and handles to the handles manager, only the keys are freed here
+    for(u32 i = cache->lru_head; i != VC_SET_CACHE_NONE; i = cache->entries[i].next)
+    {
+        mem_free(cache->entries[i].key);
+    }
+
+    mem_free(cache->entries);
+    mem_free(cache->table);
+    darray_destroy(cache->free_entries);
+
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        darray_destroy(cache->retiring[i]);
+    }
+    darray_destroy(cache->reusable);
+
+    pthread_mutex_destroy(&cache->lock);
+}
+
+u64
+vc_set_cache_hash(u64 *key, u32 key_length)
+{
+    return hash_bytes(key, sizeof(u64) * key_length, 0);
+}
+
+void
+_vc_set_cache_lru_unlink(vc_set_cache *cache, u32 index)
+{
+    _vc_set_cache_entry *e = &cache->entries[index];
+
+    if(e->prev != VC_SET_CACHE_NONE)
+    {
+        cache->entries[e->prev].next = e->next;
+    }
+    else
+    {
+        cache->lru_head = e->next;
+    }
+
+    if(e->next != VC_SET_CACHE_NONE)
+    {
+        cache->entries[e->next].prev = e->prev;
+    }
+    else
+    {
+        cache->lru_tail = e->prev;
+    }
+}
+
+void
+_vc_set_cache_lru_push_front(vc_set_cache *cache, u32 index)
+{
+    _vc_set_cache_entry *e = &cache->entries[index];
+    e->prev = VC_SET_CACHE_NONE;
+    e->next = cache->lru_head;
+
+    if(cache->lru_head != VC_SET_CACHE_NONE)
+    {
+        cache->entries[cache->lru_head].prev = index;
+    }
+    cache->lru_head = index;
+
+    if(cache->lru_tail == VC_SET_CACHE_NONE)
+    {
+        cache->lru_tail = index;
+    }
+}
+
+// Removes an entry from the table, shifting back the entries of its probe sequence (no tombstones)
+void
+_vc_set_cache_table_remove(vc_set_cache *cache, u32 index)
+{
+    u32 mask = cache->table_mask;
+    u32 i    = cache->entries[index].hash & mask;
+    while(cache->table[i] != index)
+    {
+        i = (i + 1) & mask;
+    }
+
+    u32 j = i;
+    while(TRUE)
+    {
+        j = (j + 1) & mask;
+        if(cache->table[j] == VC_SET_CACHE_NONE)
+        {
+            break;
+        }
+
+        // The entry at j may move to i only if its home slot is not cyclically in (i, j]
+        u32 home = cache->entries[cache->table[j]].hash & mask;
+        b8 stays = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+        if(!stays)
+        {
+            cache->table[i] = cache->table[j];
+            i               = j;
+        }
+    }
+
+    cache->table[i] = VC_SET_CACHE_NONE;
+}
+
+// Removes an entry, its set is kept until the frame slot retires
+void
+_vc_set_cache_remove(vc_set_cache *cache, u32 slot, u32 index)
+{
+    _vc_set_cache_entry *e = &cache->entries[index];
+
+    _vc_set_cache_lru_unlink(cache, index);
+    _vc_set_cache_table_remove(cache, index);
+
+    _vc_set_cache_retired retired =
+    {
+        .set_hndl = e->set_hndl,
+        .set      = e->set,
+        .offset   = e->offset,
+        .layout   = e->layout,
+    };
+    darray_push(cache->retiring[slot], retired);
+
+    mem_free(e->key);
+    e->key = NULL;
+    darray_push(cache->free_entries, index);
+}
+
+vc_descriptor_set
+vc_set_cache_lookup(vc_set_cache *cache, u64 hash, u64 *key, u32 key_length)
+{
+    u32 mask = cache->table_mask;
+    for(u32 i = hash & mask; cache->table[i] != VC_SET_CACHE_NONE; i = (i + 1) & mask)
+    {
+        u32 index              = cache->table[i];
+        _vc_set_cache_entry *e = &cache->entries[index];
+
+        if(e->hash == hash && e->key_length == key_length && mem_memcmp(e->key, key, sizeof(u64) * key_length) == 0)
+        {
+            _vc_set_cache_lru_unlink(cache, index);
+            _vc_set_cache_lru_push_front(cache, index);
+            return e->set_hndl;
+        }
+    }
+
+    return VC_NULL_HANDLE;
+}
+
+void
+vc_set_cache_insert(vc_set_cache *cache, u32 slot, u64 hash, u64 *key, u32 key_length, vc_descriptor_set set_hndl, VkDescriptorSet set, u64 offset, VkDescriptorSetLayout layout)
+{
+    if(darray_length(cache->free_entries) == 0)
+    {
+        _vc_set_cache_remove(cache, slot, cache->lru_tail);
+    }
+
+    u32 index = 0;
+    darray_pop(cache->free_entries, &index);
+
+    _vc_set_cache_entry *e = &cache->entries[index];
+    e->hash       = hash;
+    e->key_length = key_length;
+    e->key        = mem_allocate(sizeof(u64) * key_length, MEMORY_TAG_RENDERER);
+    e->set_hndl   = set_hndl;
+    e->set        = set;
+    e->offset     = offset;
+    e->layout     = layout;
+    mem_memcpy(e->key, key, sizeof(u64) * key_length);
+
+    _vc_set_cache_lru_push_front(cache, index);
+
+    u32 mask = cache->table_mask;
+    u32 i    = hash & mask;
+    while(cache->table[i] != VC_SET_CACHE_NONE)
+    {
+        i = (i + 1) & mask;
+    }
+    cache->table[i] = index;
+}
+
+void
+vc_set_cache_invalidate(vc_set_cache *cache, u32 slot, vc_handle hndl)
+{
+    u32 index = cache->lru_head;
+    while(index != VC_SET_CACHE_NONE)
+    {
+        _vc_set_cache_entry *e = &cache->entries[index];
+        u32 next               = e->next;
+
+        for(u32 w = 1; w < e->key_length; w += VC_SET_CACHE_WRITE_WORDS)
+        {
+            if(e->key[w + VC_SET_CACHE_RESOURCE] == hndl || e->key[w + VC_SET_CACHE_SAMPLER] == hndl)
+            {
+                _vc_set_cache_remove(cache, slot, index);
+                break;
+            }
+        }
+
+        index = next;
+    }
+}
+
+b8
+vc_set_cache_take_reusable(vc_set_cache *cache, VkDescriptorSetLayout layout, VkDescriptorSet *set, u64 *offset)
+{
+    for(u32 i = 0; i < darray_length(cache->reusable); i++)
+    {
+        if(cache->reusable[i].layout == layout)
+        {
+            _vc_set_cache_retired reused;
+            darray_pop_at(cache->reusable, i, &reused);
+            *set    = reused.set;
+            *offset = reused.offset;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void
+vc_set_cache_add_reusable(vc_set_cache *cache, VkDescriptorSetLayout layout, VkDescriptorSet set, u64 offset)
+{
+    _vc_set_cache_retired reusable =
+    {
+        .set_hndl = VC_NULL_HANDLE,
+        .set      = set,
+        .offset   = offset,
+        .layout   = layout,
+    };
+    darray_push(cache->reusable, reusable);
+}
+
+void
+vc_set_cache_frame_reset(vc_set_cache *cache, vc_handles_manager *mgr, u32 slot)
+{
+    _vc_set_cache_retired *retired = cache->retiring[slot];
+
+    // Freed in reverse order, so the handles are found at the end of the destroy queue
+    for(u32 i = darray_length(retired); i-- > 0; )
+    {
+        vc_handles_manager_dealloc(mgr, retired[i].set_hndl);
+        darray_push(cache->reusable, retired[i]);
+    }
+    darray_clear(cache->retiring[slot]);
+}
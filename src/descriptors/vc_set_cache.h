@@ -0,0 +1,92 @@
+#ifndef __VC_SET_CACHE__
+#define __VC_SET_CACHE__
+
+/*
+ * Content addressed descriptor set cache.
+ * Sets are keyed by their layout and everything written into them. Identical writes get the same set back, without
+ * allocating or updating anything. Entries are evicted in least recently used order, or invalidated when a handle they
+ * reference is destroyed or moved. Evicted sets are kept, and rewritten for later sets of the same layout, once the
+ * frames in flight which may use them have retired.
+ */
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include "../base/types.h"
+#include "../handles/vc_handles.h"
+#include "../vc_frames.h"
+
+#define VC_SET_CACHE_NONE        UINT32_MAX
+
+// Keys are the layout handle, followed by VC_SET_CACHE_WRITE_WORDS words per write:
+// binding | array element << 32, descriptor type, resource handle, sampler handle, image layout or offset, range
+#define VC_SET_CACHE_WRITE_WORDS 6
+#define VC_SET_CACHE_RESOURCE    2
+#define VC_SET_CACHE_SAMPLER     3
+
+typedef struct
+{
+    u64                      hash;
+    u64                     *key; // The layout, then every write
+    u32                      key_length;
+
+    vc_descriptor_set        set_hndl;
+    VkDescriptorSet          set;
+    u64                      offset; // Offset in the descriptor buffer, with the descriptor buffer backend
+    VkDescriptorSetLayout    layout;
+
+    // LRU list, most recently used first
+    u32                      prev;
+    u32                      next;
+} _vc_set_cache_entry;
+
+typedef struct
+{
+    vc_descriptor_set        set_hndl;
+    VkDescriptorSet          set;
+    u64                      offset;
+    VkDescriptorSetLayout    layout;
+} _vc_set_cache_retired;
+
+typedef struct
+{
+    pthread_mutex_t           lock; // Guards everything below
+
+    u32                       capacity;
+    _vc_set_cache_entry      *entries; // capacity entries
+    u32                      *free_entries; // darray
+    u32                       lru_head;
+    u32                       lru_tail;
+
+    u32                      *table; // Open addressing (linear probing) of entry indices, VC_SET_CACHE_NONE if empty
+    u32                       table_mask;
+
+    _vc_set_cache_retired    *retiring[VC_FRAMES_IN_FLIGHT]; // darrays, removed entries still used by frames in flight
+    _vc_set_cache_retired    *reusable; // darray, sets no frame uses anymore (their handles are freed)
+} vc_set_cache;
+
+void                vc_set_cache_create(vc_set_cache *cache, u32 capacity);
+void                vc_set_cache_destroy(vc_set_cache   *cache);
+
+// The functions below must be called with the cache locked
+
+u64                 vc_set_cache_hash(u64 *key, u32 key_length);
+
+// Returns the set of the key, or VC_NULL_HANDLE
+vc_descriptor_set   vc_set_cache_lookup(vc_set_cache *cache, u64 hash, u64 *key, u32 key_length);
+
+// Inserts a set (the key is copied). If the cache is full, the least recently used entry is evicted into the given frame slot.
+void                vc_set_cache_insert(vc_set_cache *cache, u32 slot, u64 hash, u64 *key, u32 key_length, vc_descriptor_set set_hndl, VkDescriptorSet set, u64 offset, VkDescriptorSetLayout layout);
+
+// Removes every entry referencing the handle, into the given frame slot
+void                vc_set_cache_invalidate(vc_set_cache *cache, u32 slot, vc_handle hndl);
+
+// Takes a set of the layout which can be rewritten (its set, or its descriptor buffer offset), returns FALSE if there is none
+b8                  vc_set_cache_take_reusable(vc_set_cache *cache, VkDescriptorSetLayout layout, VkDescriptorSet *set, u64 *offset);
+
+// Adds a set no frame uses, and without a handle, to the reusable sets
+void                vc_set_cache_add_reusable(vc_set_cache *cache, VkDescriptorSetLayout layout, VkDescriptorSet set, u64 offset);
+
+// The sets removed during the retired slot's frame can be reused, their handles are freed
+void                vc_set_cache_frame_reset(vc_set_cache *cache, vc_handles_manager *mgr, u32 slot);
+
+#endif // __VC_SET_CACHE__
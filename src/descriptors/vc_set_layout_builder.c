@@ -53,6 +53,27 @@ vc_descriptor_set_layout_builder_add_bindings(vc_descriptor_set_layout_builder *
 vc_descriptor_set_layout
 vc_descriptor_set_layout_builder_build(vc_ctx *ctx, vc_descriptor_set_layout_builder *builder, VkDescriptorSetLayoutCreateFlags flags)
 {
+    if( (flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) && !ctx->supported_features.push_descriptor )
+    {
+        vc_error("Cannot create a push descriptor set layout, the push_descriptor feature is not supported.");
+        return VC_NULL_HANDLE;
+    }
+
+    // Descriptor buffers have no dynamic descriptors, offsets are given when binding instead
+    if(ctx->supported_features.descriptor_buffer)
+    {
+        for(u32 i = 0; i < darray_length(builder->bindings); i++)
+        {
+            VkDescriptorType type = builder->bindings[i].descriptorType;
+            if(type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+            {
+                vc_error("Cannot create a set layout with dynamic buffer descriptors (binding %u), the descriptor buffer backend does not support them.",
+                         builder->bindings[i].binding);
+                return VC_NULL_HANDLE;
+            }
+        }
+    }
+
     VkDescriptorSetLayoutCreateInfo info =
     {
         0
@@ -65,13 +86,34 @@ vc_descriptor_set_layout_builder_build(vc_ctx *ctx, vc_descriptor_set_layout_bui
     info.flags        = flags;
     info.pNext        = NULL;
 
+    if(ctx->supported_features.descriptor_buffer)
+    {
+        info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+    }
+
     VkDescriptorSetLayout sl = vc_slc_get(&ctx->set_layout_cache, ctx->current_device, info);
 
     _vc_descriptor_set_layout_intern sl_i =
     {
-        .layout = sl,
+        .layout        = sl,
+        .flags         = info.flags,
+        .buffer_layout = NULL,
+        .demand        = { { 0 } },
     };
 
+    for(u32 i = 0; i < info.bindingCount; i++)
+    {
+        if( (u32)info.pBindings[i].descriptorType < VC_DS_TYPE_COUNT )
+        {
+            sl_i.demand.counts[info.pBindings[i].descriptorType] += info.pBindings[i].descriptorCount;
+        }
+    }
+
+    if(ctx->supported_features.descriptor_buffer)
+    {
+        sl_i.buffer_layout = vc_descriptor_buffer_get_layout(&ctx->descriptor_buffer, ctx->current_device, sl, &info);
+    }
+
     vc_descriptor_set_layout hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET_LAYOUT, &sl_i);
 
     darray_destroy(builder->bindings);
@@ -1,132 +1,172 @@
 #include "vc_set_layout_cache.h"
 
-#include "../base/data_structures/darray.h"
+#include "../base/memory.h"
 #include "../vc_enum_util.h"
+#include <alloca.h>
 
-i32
-_vc_slc_binding_comp(VkDescriptorSetLayoutBinding *a, VkDescriptorSetLayoutBinding *b)
+// Key: flags, binding count, then for each binding (sorted) the words below, then the immutable samplers of each binding
+#define _VC_SLC_HEADER_WORDS    2
+#define _VC_SLC_BINDING_WORDS   5
+
+void
+vc_slc_create(vc_set_layout_cache   *cache)
+{
+    vc_ocache_create(&cache->layouts);
+}
+
+// Returns the binding flags of the create info, if any
+const VkDescriptorBindingFlags *
+_vc_slc_binding_flags(VkDescriptorSetLayoutCreateInfo   *info)
 {
-    return a->binding - b->binding;
+    for(const VkBaseInStructure *s = info->pNext; s != NULL; s = s->pNext)
+    {
+        if(s->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO)
+        {
+            const VkDescriptorSetLayoutBindingFlagsCreateInfo *flags_ci = (const VkDescriptorSetLayoutBindingFlagsCreateInfo *)s;
+            return flags_ci->bindingCount > 0 ? flags_ci->pBindingFlags : NULL;
+        }
+    }
+    return NULL;
 }
 
-// Compares two SORTED set layout infos
-b8
-_vc_slc_info_comp(VkDescriptorSetLayoutCreateInfo a, VkDescriptorSetLayoutCreateInfo b)
+// Sorts the binding indices by binding number (insertion sort, layouts have few bindings)
+void
+_vc_slc_sort(VkDescriptorSetLayoutCreateInfo *info, u32 *order)
 {
-    if(
-        a.flags != b.flags ||
-        a.bindingCount != b.bindingCount
-        )
+    for(u32 i = 0; i < info->bindingCount; i++)
     {
-        return FALSE;
+        order[i] = i;
     }
 
-    // Compare each bindings
-    for(u32 i = 0; i < a.bindingCount; i++)
+    for(u32 i = 1; i < info->bindingCount; i++)
     {
-        VkDescriptorSetLayoutBinding a_b = a.pBindings[i];
-        VkDescriptorSetLayoutBinding b_b = b.pBindings[i];
-
-        // Since both lists are supposed to be sorted, we can compare both lists by going through them
-        if(
-            a_b.binding != b_b.binding ||
-            a_b.descriptorType != b_b.descriptorType ||
-            a_b.stageFlags != b_b.stageFlags ||
-            a_b.descriptorCount != b_b.descriptorCount
-            )
+        u32 current = order[i];
+        u32 j       = i;
+        while(j > 0 && info->pBindings[order[j - 1]].binding > info->pBindings[current].binding)
         {
-            return FALSE;
+            order[j] = order[j - 1];
+            j--;
         }
+        order[j] = current;
     }
-
-    return TRUE;
 }
 
-void
-vc_slc_create(vc_set_layout_cache   *cache)
+u32
+_vc_slc_key_length(VkDescriptorSetLayoutCreateInfo   *info)
 {
-    for(u32 i = 0; i < VC_SLC_BUCKET_COUNT; i++)
+    u32 length = _VC_SLC_HEADER_WORDS + _VC_SLC_BINDING_WORDS * info->bindingCount;
+    for(u32 i = 0; i < info->bindingCount; i++)
     {
-        cache->buckets[i] = darray_create(_vc_slc_cell);
+        if(info->pBindings[i].pImmutableSamplers != NULL)
+        {
+            length += info->pBindings[i].descriptorCount;
+        }
     }
+    return length;
 }
 
-u64
-_vc_slc_hash(VkDescriptorSetLayoutCreateInfo   *d)
+// Writes the canonical key of a create info
+void
+_vc_slc_key(VkDescriptorSetLayoutCreateInfo *info, const VkDescriptorBindingFlags *binding_flags, u32 *order, u64 *key)
 {
-    u64 result = d->bindingCount * d->flags;
+    key[0] = info->flags;
+    key[1] = info->bindingCount;
 
-    for (int i = 0; i < d->bindingCount; i++)
+    u64 *words    = &key[_VC_SLC_HEADER_WORDS];
+    u64 *samplers = &key[_VC_SLC_HEADER_WORDS + _VC_SLC_BINDING_WORDS * info->bindingCount];
+    for(u32 i = 0; i < info->bindingCount; i++)
     {
-        VkDescriptorSetLayoutBinding b = d->pBindings[i];
-        u64 binding_hash               = b.binding | b.descriptorType << 8 | b.descriptorCount << 16 | b.stageFlags << 24;
+        const VkDescriptorSetLayoutBinding *b = &info->pBindings[order[i]];
+        u64 flags                             = binding_flags ? binding_flags[order[i]] : 0;
 
-        result ^= binding_hash;
-    }
+        words[0] = b->binding;
+        words[1] = b->descriptorType;
+        words[2] = b->descriptorCount;
+        words[3] = b->stageFlags;
+        words[4] = flags | ( (u64)(b->pImmutableSamplers != NULL) << 32 );
+        words   += _VC_SLC_BINDING_WORDS;
 
-    return result;
+        if(b->pImmutableSamplers != NULL)
+        {
+            for(u32 s = 0; s < b->descriptorCount; s++)
+            {
+                *samplers++ = (u64)b->pImmutableSamplers[s];
+            }
+        }
+    }
 }
 
-VkDescriptorSetLayout
-_vc_slc_lookup(vc_set_layout_cache *cache, VkDescriptorSetLayoutCreateInfo info)
+typedef struct
+{
+    VkDevice                           dev;
+    VkDescriptorSetLayoutCreateInfo   *info;
+    const VkDescriptorBindingFlags    *binding_flags;
+    u32                               *order;
+} _vc_slc_request;
+
+// Creates the layout from the sorted bindings, called by the object cache with its insert lock held
+u64
+_vc_slc_layout_create(_vc_slc_request *request, const void *key, u64 key_size)
 {
-    u64 hash         = _vc_slc_hash(&info);
-    u64 index        = hash % VC_SLC_BUCKET_COUNT;
-    u32 bucket_count = darray_length(cache->buckets[index]);
+    VkDescriptorSetLayoutCreateInfo *info         = request->info;
+    const VkDescriptorBindingFlags *binding_flags = request->binding_flags;
 
-    for(u32 i = 0; i < bucket_count; i++)
+    VkDescriptorSetLayoutBinding *sorted = alloca(sizeof(VkDescriptorSetLayoutBinding) * (info->bindingCount + 1) );
+    VkDescriptorBindingFlags *flags      = alloca(sizeof(VkDescriptorBindingFlags) * (info->bindingCount + 1) );
+    for(u32 i = 0; i < info->bindingCount; i++)
     {
-        if(cache->buckets[index][i].hash == hash)
-        {
-            return cache->buckets[index][i].layout;
-        }
+        sorted[i] = info->pBindings[request->order[i]];
+        flags[i]  = binding_flags ? binding_flags[request->order[i]] : 0;
     }
 
-    return VK_NULL_HANDLE;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_ci =
+    {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount  = info->bindingCount,
+        .pBindingFlags = flags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo sorted_info = *info;
+    sorted_info.pNext     = binding_flags ? &flags_ci : NULL;
+    sorted_info.pBindings = sorted;
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorSetLayout(request->dev, &sorted_info, NULL, &layout), "Could not create a descriptor set layout.");
+
+    return (u64)layout;
+}
+
+void
+_vc_slc_layout_destroy(VkDevice dev, u64 layout)
+{
+    vkDestroyDescriptorSetLayout(dev, (VkDescriptorSetLayout)layout, NULL);
 }
 
 VkDescriptorSetLayout
 vc_slc_get(vc_set_layout_cache *cache, VkDevice dev, VkDescriptorSetLayoutCreateInfo info)
 {
-    VkDescriptorSetLayoutBinding *bindings = darray_create(VkDescriptorSetLayoutBinding);
-    for(u32 i = 0; i < info.bindingCount; i++)
-    {
-        darray_push(bindings, (VkDescriptorSetLayoutBinding)info.pBindings[i]);
-    }
-    darray_qsort(bindings, _vc_slc_binding_comp);
-    info.pBindings = bindings;
-
-    // Search if set layout already extists in structure
-    VkDescriptorSetLayout layout = _vc_slc_lookup(cache, info);
+    const VkDescriptorBindingFlags *binding_flags = _vc_slc_binding_flags(&info);
 
-    if(layout == VK_NULL_HANDLE)
-    {
-        // Layout does not exist in the structure yet. Create it
-        VK_CHECK(vkCreateDescriptorSetLayout(dev, &info, NULL, &layout), "Could not create a descriptor set layout.");
+    // Everything is built on the stack, lookups do not allocate
+    u32 *order = alloca(sizeof(u32) * (info.bindingCount + 1) );
+    _vc_slc_sort(&info, order);
 
-        // Add layout to structure.
-        u64 hash              = _vc_slc_hash(&info);
-        _vc_slc_cell new_cell =
-        {
-            .layout = layout,
-            .hash   = hash,
-        };
-        darray_push(cache->buckets[hash % VC_SLC_BUCKET_COUNT], new_cell);
-    }
+    u32 key_length = _vc_slc_key_length(&info);
+    u64 *key       = alloca(sizeof(u64) * key_length);
+    _vc_slc_key(&info, binding_flags, order, key);
 
-    return layout;
+    _vc_slc_request request =
+    {
+        .dev           = dev,
+        .info          = &info,
+        .binding_flags = binding_flags,
+        .order         = order,
+    };
+    return (VkDescriptorSetLayout)vc_ocache_get(&cache->layouts, key, sizeof(u64) * key_length, (vc_ocache_create_func)_vc_slc_layout_create, &request);
 }
 
 void
 vc_slc_destroy(vc_set_layout_cache *cache, VkDevice dev)
 {
-    for(u32 i = 0; i < VC_SLC_BUCKET_COUNT; i++)
-    {
-        for(u32 j = 0; j < darray_length(cache->buckets[i]); j++)
-        {
-            vkDestroyDescriptorSetLayout(dev, cache->buckets[i][j].layout, NULL);
-        }
-        darray_destroy(cache->buckets[i]);
-    }
+    vc_ocache_destroy(&cache->layouts, (vc_ocache_destroy_func)_vc_slc_layout_destroy, dev);
 }
-
@@ -1,27 +1,35 @@
 #ifndef __VC_SET_LAYOUT_CACHE__
 #define __VC_SET_LAYOUT_CACHE__
 
+/*
+ * Hash consed descriptor set layouts: equal create infos always give the same VkDescriptorSetLayout.
+ * Create infos are reduced to a canonical key (bindings sorted, with their flags and immutable samplers) and stored in
+ * an object cache, so lookups do not take any lock: only insertions are serialized.
+ */
+
 #include <vulkan/vulkan.h>
 #include "../base/types.h"
-
-#define VC_SLC_BUCKET_COUNT 17
+#include "../vc_object_cache.h"
 
 typedef struct
 {
-    VkDescriptorSetLayout    layout;
-    u64                      hash;
-} _vc_slc_cell;
-
-typedef struct
-{
-    _vc_slc_cell   *buckets[VC_SLC_BUCKET_COUNT]; // darray
+    vc_object_cache    layouts; // Keyed by the canonical create info (see _vc_slc_key)
 } vc_set_layout_cache;
 
 void
 vc_slc_create(vc_set_layout_cache   *cache);
+
+/**
+ * @brief Returns the set layout of a create info, creating it the first time
+ *
+ * @param cache The cache
+ * @param dev The device
+ * @param info The create info, whose bindings do not need to be sorted
+ * @return The layout, owned by the cache
+ * @note Only VkDescriptorSetLayoutBindingFlagsCreateInfo is kept from the pNext chain.
+ */
 VkDescriptorSetLayout vc_slc_get(vc_set_layout_cache *cache, VkDevice dev, VkDescriptorSetLayoutCreateInfo info);
 void                  vc_slc_destroy(vc_set_layout_cache *cache, VkDevice dev);
 
 
 #endif // __VC_SET_LAYOUT_CACHE__
-
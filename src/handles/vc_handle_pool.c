@@ -1,50 +1,86 @@
 #include "../vulcain.h"
 #include "vc_handle_pool.h"
 
-#define _VC_HANDLE_POOL_NULL_NEXT ( ~(0L) )
+#define _VC_HANDLE_POOL_NULL_NEXT  ( ~(0L) )
+#define _VC_HANDLE_POOL_MAX_CHUNKS (1 << 16) // Indices are 16 bits
 
-void
-vc_handle_pool_create(vc_handle_pool *pool, u64 initial_chunk_count, u64 managed_size)
+// Returns the header of a chunk
+vc_handle_pool_chunk_header *
+_vc_handle_pool_chunk(vc_handle_pool *pool, u64 id)
 {
-    if(initial_chunk_count == 0 || managed_size == 0)
+    u8 *block = pool->blocks[id / pool->block_chunk_count];
+    return (vc_handle_pool_chunk_header *)( block + pool->chunk_size * (id % pool->block_chunk_count) );
+}
+
+// Adds a block of free chunks in front of the free list
+b8
+_vc_handle_pool_add_block(vc_handle_pool   *pool)
+{
+    u64 count = MIN(pool->block_chunk_count, _VC_HANDLE_POOL_MAX_CHUNKS - pool->chunk_count);
+    if(count == 0)
     {
-        vc_error("Pool creation called with invalid parameters");
-        pool->memory = NULL;
-        return;
+        return FALSE;
     }
 
-    pool->chunk_size = managed_size + ( sizeof(vc_handle_pool_chunk_header) - sizeof(u64) );
-    u64 initial_size = pool->chunk_size * initial_chunk_count;
-    pool->memory = mem_allocate(initial_size, MEMORY_TAG_RENDER_DATA);
+    u64 first_id                    = pool->chunk_count;
+    pool->blocks[pool->block_count] = mem_allocate(pool->chunk_size * pool->block_chunk_count, MEMORY_TAG_RENDER_DATA);
+    pool->block_count++;
 
-    // Set up headers
-    for(u32 i = 0; i < initial_chunk_count; i++)
+    for(u64 i = 0; i < count; i++)
     {
         vc_handle_pool_chunk_header hdr =
         {
             .used          = FALSE,
             .chunk_counter = 0, // 0 chunks are considered as NULL/ special value, as they are incremented at first alloc
-            .next_id       = i + 1,
+            .next_id       = (i + 1 < count) ? first_id + i + 1 : pool->head_id,
         };
 
-        *( (vc_handle_pool_chunk_header *)( (u8 *)pool->memory + pool->chunk_size * i ) ) = hdr;
+        *_vc_handle_pool_chunk(pool, first_id + i) = hdr;
+    }
+
+    // Published last, readers check their index against it without the lock of the handles manager
+    pool->head_id          = first_id;
+    pool->available_count += count;
+    __atomic_store_n(&pool->chunk_count, pool->chunk_count + count, __ATOMIC_RELEASE);
 
-        if(i == initial_chunk_count - 1)
-        {
-            hdr.next_id = _VC_HANDLE_POOL_NULL_NEXT;
-        }
+    return TRUE;
+}
+
+void
+vc_handle_pool_create(vc_handle_pool *pool, u64 initial_chunk_count, u64 managed_size)
+{
+    if(initial_chunk_count == 0 || managed_size == 0)
+    {
+        vc_error("Pool creation called with invalid parameters");
+        pool->blocks = NULL;
+        return;
     }
 
-    pool->chunk_count     = initial_chunk_count;
-    pool->available_count = initial_chunk_count;
-    pool->head_id         = 0;
+    pool->chunk_size        = managed_size + ( sizeof(vc_handle_pool_chunk_header) - sizeof(u64) );
+    pool->block_chunk_count = MIN(initial_chunk_count, _VC_HANDLE_POOL_MAX_CHUNKS);
+
+    // The block table is never reallocated, so a deref never races with the growth of the pool
+    u64 max_block_count = (_VC_HANDLE_POOL_MAX_CHUNKS + pool->block_chunk_count - 1) / pool->block_chunk_count;
+    pool->blocks = mem_allocate(sizeof(void *) * max_block_count, MEMORY_TAG_RENDER_DATA);
+    mem_memset(pool->blocks, 0, sizeof(void *) * max_block_count);
+
+    pool->block_count     = 0;
+    pool->chunk_count     = 0;
+    pool->available_count = 0;
+    pool->head_id         = _VC_HANDLE_POOL_NULL_NEXT;
+    _vc_handle_pool_add_block(pool);
 }
 
 void
 vc_handle_pool_destroy(vc_handle_pool   *pool)
 {
-    mem_free(pool->memory);
-    pool->memory          = NULL;
+    for(u64 i = 0; i < pool->block_count; i++)
+    {
+        mem_free(pool->blocks[i]);
+    }
+    mem_free(pool->blocks);
+    pool->blocks          = NULL;
+    pool->block_count     = 0;
     pool->chunk_count     = 0;
     pool->available_count = 0;
 }
@@ -52,15 +88,14 @@ vc_handle_pool_destroy(vc_handle_pool   *pool)
 u32
 vc_handle_pool_alloc(vc_handle_pool   *pool)
 {
-    if(pool->chunk_count == 0 || pool->memory == NULL)
+    if(pool->chunk_count == 0 || pool->blocks == NULL)
     {
         vc_error("ALLOC: Pool allocation called on invalid pool. Aborting.");
         return 0;
     }
-    if(pool->available_count == 0)
+    if(!vc_handle_pool_reserve(pool, 1))
     {
-        vc_warn("ALLOC: Full pool, allocation was requested, can't fullfill.");
-        return 0; // Maybe handle resize here
+        return 0;
     }
 
     // Grab new zone from head
@@ -73,7 +108,7 @@ vc_handle_pool_alloc(vc_handle_pool   *pool)
     }
 
     // Dereference pool
-    vc_handle_pool_chunk_header *new_hdr = (vc_handle_pool_chunk_header *)( ( (u8 *)pool->memory ) + (new_id * pool->chunk_size) );
+    vc_handle_pool_chunk_header *new_hdr = _vc_handle_pool_chunk(pool, new_id);
     if(new_hdr->used)
     {
         vc_fatal("ALLOC: Pool in free list is used.");
@@ -96,6 +131,45 @@ vc_handle_pool_alloc(vc_handle_pool   *pool)
     return new_hndl.hndl_id;
 }
 
+b8
+vc_handle_pool_reserve(vc_handle_pool *pool, u64 count)
+{
+    if(pool->available_count >= count)
+    {
+        return TRUE;
+    }
+
+    u64 needed = pool->chunk_count + (count - pool->available_count);
+    if(needed > _VC_HANDLE_POOL_MAX_CHUNKS)
+    {
+        vc_error("ALLOC: Full pool, %lu more chunks were requested, can't fullfill.", count);
+        return FALSE;
+    }
+
+    while(pool->available_count < count)
+    {
+        _vc_handle_pool_add_block(pool);
+    }
+
+    return TRUE;
+}
+
+b8
+vc_handle_pool_alloc_n(vc_handle_pool *pool, u32 count, u32 *ids)
+{
+    if(!vc_handle_pool_reserve(pool, count))
+    {
+        return FALSE;
+    }
+
+    for(u32 i = 0; i < count; i++)
+    {
+        ids[i] = vc_handle_pool_alloc(pool);
+    }
+
+    return TRUE;
+}
+
 void *
 vc_handle_pool_deref(vc_handle_pool *pool, u32 id)
 {
@@ -110,7 +184,13 @@ vc_handle_pool_deref(vc_handle_pool *pool, u32 id)
     };
     mask.hndl_id = id;
 
-    vc_handle_pool_chunk_header *hdr = (vc_handle_pool_chunk_header *)( ( (u8 *)pool->memory ) + (pool->chunk_size * mask.index) );
+    if(mask.index >= __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE) )
+    {
+        vc_error("DEREF: Handle (id=0x%x) outside of the pool.", id);
+        return NULL;
+    }
+
+    vc_handle_pool_chunk_header *hdr = _vc_handle_pool_chunk(pool, mask.index);
 
     if(!hdr->used)
     {
@@ -141,7 +221,13 @@ vc_handle_pool_dealloc(vc_handle_pool *pool, u32 id)
     };
     mask.hndl_id = id;
 
-    vc_handle_pool_chunk_header *hdr = (vc_handle_pool_chunk_header *)( ( (u8 *)pool->memory ) + (pool->chunk_size * mask.index) );
+    if(mask.index >= pool->chunk_count)
+    {
+        vc_error("DEALLOC: Handle (id=0x%x) outside of the pool.", id);
+        return;
+    }
+
+    vc_handle_pool_chunk_header *hdr = _vc_handle_pool_chunk(pool, mask.index);
 
     if(hdr->chunk_counter != mask.counter)
     {
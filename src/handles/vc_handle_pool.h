@@ -23,9 +23,12 @@ typedef struct
     u64    next_id;
 } vc_handle_pool_chunk_header;
 
+// Chunks are stored in fixed size blocks, the pool grows by adding blocks, so managed objects never move
 typedef struct
 {
-    void   *memory;
+    void  **blocks; // Sized for the maximum chunk count at creation, never reallocated
+    u64     block_count;
+    u64     block_chunk_count; // Chunks per block
     u64     head_id;
     u64     chunk_count;
     u64     available_count;
@@ -47,6 +50,12 @@ void    vc_handle_pool_create(vc_handle_pool *pool, u64 initial_chunk_count, u64
 void    vc_handle_pool_destroy(vc_handle_pool   *pool);
 
 u32     vc_handle_pool_alloc(vc_handle_pool   *pool);
+
+// Grows the pool so that count chunks are available, managed objects stay in place
+b8      vc_handle_pool_reserve(vc_handle_pool *pool, u64 count);
+
+// Allocates count chunks, growing the pool at most once
+b8      vc_handle_pool_alloc_n(vc_handle_pool *pool, u32 count, u32 *ids);
 void   *vc_handle_pool_deref(vc_handle_pool *pool, u32 id);
 void    vc_handle_pool_dealloc(vc_handle_pool *pool, u32 id);
 
@@ -11,34 +11,40 @@
 
 static const u64 _vc_struct_sizes[VC_HANDLE_TYPES_COUNT] =
 {
-    [VC_HANDLE_SWAPCHAIN]             = sizeof(_vc_swapchain_intern),
-    [VC_HANDLE_QUEUE]                 = sizeof(_vc_queue_intern),
-    [VC_HANDLE_COMMAND_POOL]          = sizeof(_vc_command_pool_intern),
-    [VC_HANDLE_COMMAND_BUFFER]        = sizeof(_vc_command_buffer_intern),
-    [VC_HANDLE_SEMAPHORE]             = sizeof(_vc_semaphore_intern),
-    [VC_HANDLE_IMAGE]                 = sizeof(_vc_image_intern),
-    [VC_HANDLE_IMAGE_VIEW]            = sizeof(_vc_image_view_intern),
-    [VC_HANDLE_COMPUTE_PIPELINE]      = sizeof(_vc_compute_pipeline_intern),
-    [VC_HANDLE_GFX_PIPELINE]          = sizeof(_vc_gfx_pipeline_intern),
-    [VC_HANDLE_DESCRIPTOR_SET]        = sizeof(_vc_descriptor_set_intern),
-    [VC_HANDLE_DESCRIPTOR_SET_LAYOUT] = sizeof(_vc_descriptor_set_layout_intern),
-    [VC_HANDLE_BUFFER]                = sizeof(_vc_buffer_intern),
+    [VC_HANDLE_SWAPCHAIN]                  = sizeof(_vc_swapchain_intern),
+    [VC_HANDLE_QUEUE]                      = sizeof(_vc_queue_intern),
+    [VC_HANDLE_COMMAND_POOL]               = sizeof(_vc_command_pool_intern),
+    [VC_HANDLE_COMMAND_BUFFER]             = sizeof(_vc_command_buffer_intern),
+    [VC_HANDLE_SEMAPHORE]                  = sizeof(_vc_semaphore_intern),
+    [VC_HANDLE_IMAGE]                      = sizeof(_vc_image_intern),
+    [VC_HANDLE_IMAGE_VIEW]                 = sizeof(_vc_image_view_intern),
+    [VC_HANDLE_COMPUTE_PIPELINE]           = sizeof(_vc_compute_pipeline_intern),
+    [VC_HANDLE_GFX_PIPELINE]               = sizeof(_vc_gfx_pipeline_intern),
+    [VC_HANDLE_DESCRIPTOR_SET]             = sizeof(_vc_descriptor_set_intern),
+    [VC_HANDLE_DESCRIPTOR_SET_LAYOUT]      = sizeof(_vc_descriptor_set_layout_intern),
+    [VC_HANDLE_BUFFER]                     = sizeof(_vc_buffer_intern),
+    [VC_HANDLE_SAMPLER]                    = sizeof(_vc_sampler_intern),
+    [VC_HANDLE_DESCRIPTOR_UPDATE_TEMPLATE] = sizeof(_vc_descriptor_update_template_intern),
+    [VC_HANDLE_SHADER]                     = sizeof(_vc_shader_intern),
 };
 
 static const u64 _vc_initial_chunk_counts[VC_HANDLE_TYPES_COUNT] =
 {
-    [VC_HANDLE_SWAPCHAIN]             = 8,
-    [VC_HANDLE_QUEUE]                 = 8,
-    [VC_HANDLE_COMMAND_POOL]          = 8,
-    [VC_HANDLE_COMMAND_BUFFER]        = 8,
-    [VC_HANDLE_SEMAPHORE]             = 16,
-    [VC_HANDLE_IMAGE]                 = 64,
-    [VC_HANDLE_IMAGE_VIEW]            = 32,
-    [VC_HANDLE_COMPUTE_PIPELINE]      = 16,
-    [VC_HANDLE_GFX_PIPELINE]      = 16,
-    [VC_HANDLE_DESCRIPTOR_SET]        = 32,
-    [VC_HANDLE_DESCRIPTOR_SET_LAYOUT] = 32,
-    [VC_HANDLE_BUFFER]                = 32,
+    [VC_HANDLE_SWAPCHAIN]                  = 8,
+    [VC_HANDLE_QUEUE]                      = 8,
+    [VC_HANDLE_COMMAND_POOL]               = 8,
+    [VC_HANDLE_COMMAND_BUFFER]             = 8,
+    [VC_HANDLE_SEMAPHORE]                  = 16,
+    [VC_HANDLE_IMAGE]                      = 64,
+    [VC_HANDLE_IMAGE_VIEW]                 = 32,
+    [VC_HANDLE_COMPUTE_PIPELINE]           = 16,
+    [VC_HANDLE_GFX_PIPELINE]               = 16,
+    [VC_HANDLE_DESCRIPTOR_SET]             = 32,
+    [VC_HANDLE_DESCRIPTOR_SET_LAYOUT]      = 32,
+    [VC_HANDLE_BUFFER]                     = 32,
+    [VC_HANDLE_SAMPLER]                    = 16,
+    [VC_HANDLE_DESCRIPTOR_UPDATE_TEMPLATE] = 16,
+    [VC_HANDLE_SHADER]                     = 16,
 };
 
 typedef union
@@ -60,12 +66,19 @@ vc_handles_manager_create(vc_handles_manager   *mgr)
     }
 
     mgr->destroy_queue = darray_create(vc_handle);
+
+    // Destroy functions may destroy other handles
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mgr->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
 }
 
 void
 vc_handles_manager_set_destroy_function(vc_handles_manager *mgr, vc_handle_type hndl_type, vc_handle_destroy_func func)
 {
-    mgr->destroy_functions[hndl_type] = func;
+    __atomic_store_n(&mgr->destroy_functions[hndl_type], func, __ATOMIC_RELAXED);
 }
 
 void
@@ -101,6 +114,7 @@ vc_handles_manager_destroy(vc_handles_manager   *mgr)
 
     darray_destroy(mgr->destroy_queue);
     mgr->destroy_queue = NULL;
+    pthread_mutex_destroy(&mgr->lock);
 }
 
 void *
@@ -123,6 +137,27 @@ vc_handles_manager_deref(vc_handles_manager *mgr, vc_handle hndl)
     return ptr;
 }
 
+void
+vc_handles_manager_read(vc_handles_manager *mgr, vc_handle hndl, void *dest, u64 size)
+{
+    pthread_mutex_lock(&mgr->lock);
+    void *obj = vc_handles_manager_deref(mgr, hndl);
+    if(obj != NULL)
+    {
+        mem_memcpy(dest, obj, size);
+    }
+    pthread_mutex_unlock(&mgr->lock);
+}
+
+vc_handle_type
+vc_handles_manager_get_type(vc_handles_manager *mgr, vc_handle hndl)
+{
+    vc_handle_pack pck;
+    pck.vc_hndl = hndl;
+
+    return pck.type;
+}
+
 vc_handle
 vc_handles_manager_alloc(vc_handles_manager *mgr, vc_handle_type type)
 {
@@ -131,6 +166,7 @@ vc_handles_manager_alloc(vc_handles_manager *mgr, vc_handle_type type)
         vc_error("Attempted to alloc vc_handle from invalid type.");
         return VC_NULL_HANDLE;
     }
+    pthread_mutex_lock(&mgr->lock);
     u32 id_hndl = vc_handle_pool_alloc(&mgr->pools[type]);
 
 
@@ -141,6 +177,7 @@ vc_handles_manager_alloc(vc_handles_manager *mgr, vc_handle_type type)
 
     // Maintain destroy queue
     darray_push(mgr->destroy_queue, pck.vc_hndl);
+    pthread_mutex_unlock(&mgr->lock);
 
     return pck.vc_hndl;
 }
@@ -148,13 +185,52 @@ vc_handles_manager_alloc(vc_handles_manager *mgr, vc_handle_type type)
 vc_handle
 vc_handles_manager_walloc(vc_handles_manager *mgr, vc_handle_type type, void *obj)
 {
+    pthread_mutex_lock(&mgr->lock);
     vc_handle new = vc_handles_manager_alloc(mgr, type);
     void *dest    = vc_handles_manager_deref(mgr, new);
 
     mem_memcpy(dest, obj, _vc_struct_sizes[type]);
+    pthread_mutex_unlock(&mgr->lock);
     return new;
 }
 
+b8
+vc_handles_manager_walloc_n(vc_handles_manager *mgr, vc_handle_type type, u32 count, const void *objs, vc_handle *hndls)
+{
+    if(type >= VC_HANDLE_TYPES_COUNT)
+    {
+        vc_error("Attempted to alloc vc_handle from invalid type.");
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&mgr->lock);
+
+    // Ids are written in place, then replaced by the packed handles
+    u32 *ids = (u32 *)hndls;
+    if(!vc_handle_pool_alloc_n(&mgr->pools[type], count, ids) )
+    {
+        pthread_mutex_unlock(&mgr->lock);
+        return FALSE;
+    }
+
+    for(u32 i = count; i-- > 0; )
+    {
+        vc_handle_pack pck;
+        pck.type    = type;
+        pck.id_hndl = ids[i];
+        hndls[i]    = pck.vc_hndl;
+    }
+
+    for(u32 i = 0; i < count; i++)
+    {
+        darray_push(mgr->destroy_queue, hndls[i]);
+        mem_memcpy(vc_handles_manager_deref(mgr, hndls[i]), (u8 *)objs + _vc_struct_sizes[type] * i, _vc_struct_sizes[type]);
+    }
+
+    pthread_mutex_unlock(&mgr->lock);
+    return TRUE;
+}
+
 void
 vc_handles_manager_dealloc(vc_handles_manager *mgr, vc_handle hndl)
 {
@@ -167,13 +243,15 @@ vc_handles_manager_dealloc(vc_handles_manager *mgr, vc_handle hndl)
         return;
     }
 
+    pthread_mutex_lock(&mgr->lock);
     vc_handle_pool_dealloc(&mgr->pools[pck.type], pck.id_hndl);
 
     // Search for handle in pool, and remove it
+    // Searched from the end, as recently allocated handles are the most likely to be freed (transient objects)
     {
         u32 length = darray_length(mgr->destroy_queue);
         b8 found   = FALSE;
-        for(u32 i = 0; i < length; i++)
+        for(u32 i = length; i-- > 0; )
         {
             if(mgr->destroy_queue[i] == hndl)
             {
@@ -189,18 +267,21 @@ vc_handles_manager_dealloc(vc_handles_manager *mgr, vc_handle hndl)
             vc_warn("A dealloced handle (%x) was not found in the destroy queue.", hndl);
         }
     }
-    return;
+    pthread_mutex_unlock(&mgr->lock);
 }
 
 // Frees the handle and destroys the underlying object, according to the linked function
 void
 vc_handles_manager_destroy_handle(vc_handles_manager *mgr, vc_handle hndl)
 {
+    // No other thread reads the object, or gets its chunk, while it is destroyed
+    pthread_mutex_lock(&mgr->lock);
     void *obj = vc_handles_manager_deref(mgr, hndl);
 
     if(obj == NULL)
     {
         vc_error("Attempted to destroy an invalid vc_handle (null reference).");
+        pthread_mutex_unlock(&mgr->lock);
         return;
     }
 
@@ -210,6 +291,7 @@ vc_handles_manager_destroy_handle(vc_handles_manager *mgr, vc_handle hndl)
     if(pck.type >= VC_HANDLE_TYPES_COUNT)
     {
         vc_error("Attempted to destroy an invalid vc_handle (invalid type).");
+        pthread_mutex_unlock(&mgr->lock);
         return;
     }
 
@@ -219,5 +301,6 @@ vc_handles_manager_destroy_handle(vc_handles_manager *mgr, vc_handle hndl)
     }
 
     vc_handles_manager_dealloc(mgr, hndl);
+    pthread_mutex_unlock(&mgr->lock);
 }
 
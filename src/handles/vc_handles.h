@@ -3,6 +3,7 @@
 
 #include "../base/base.h"
 #include "vc_handle_pool.h" // TODO: Figure out a neat way to not include this
+#include <pthread.h>
 
 typedef enum
 {
@@ -18,6 +19,9 @@ typedef enum
     VC_HANDLE_DESCRIPTOR_SET,
     VC_HANDLE_DESCRIPTOR_SET_LAYOUT,
     VC_HANDLE_BUFFER,
+    VC_HANDLE_SAMPLER,
+    VC_HANDLE_DESCRIPTOR_UPDATE_TEMPLATE,
+    VC_HANDLE_SHADER,
     VC_HANDLE_TYPES_COUNT,
 } vc_handle_type;
 
@@ -40,6 +44,9 @@ VC_DEF_HANDLE(vc_gfx_pipeline);
 VC_DEF_HANDLE(vc_descriptor_set);
 VC_DEF_HANDLE(vc_descriptor_set_layout);
 VC_DEF_HANDLE(vc_buffer);
+VC_DEF_HANDLE(vc_sampler);
+VC_DEF_HANDLE(vc_descriptor_update_template);
+VC_DEF_HANDLE(vc_shader);
 
 /*
  * @brief Function pointer for cleanly destroying objects stored in the handle manager
@@ -58,6 +65,8 @@ typedef struct
 
     void                     *dest_func_usr_data;
 
+    // Recursive, guards the pools and the destroy queue: handles can be allocated, read and destroyed from any thread
+    pthread_mutex_t           lock;
 } vc_handles_manager;
 
 // Functions
@@ -81,9 +90,30 @@ void      vc_handles_manager_destroy(vc_handles_manager   *mgr);
  *
  * @param mgr The handle manager
  * @param hndl The handle to dereference
+ * @note Managed objects never move, but the object may be written by other threads: use vc_handles_manager_read
+ *       to read it from a worker thread.
  */
 void     *vc_handles_manager_deref(vc_handles_manager *mgr, vc_handle hndl);
 
+/**
+ * @brief Copies the object of a handle, under the lock of the manager
+ *
+ * @param mgr The handle manager
+ * @param hndl The handle to read
+ * @param dest Where the object is copied
+ * @param size The size of the object
+ */
+void      vc_handles_manager_read(vc_handles_manager *mgr, vc_handle hndl, void *dest, u64 size);
+
+/**
+ * @brief Returns the type of a handle
+ *
+ * @param mgr The handle manager
+ * @param hndl The handle
+ * @return The type of the handle
+ */
+vc_handle_type vc_handles_manager_get_type(vc_handles_manager *mgr, vc_handle hndl);
+
 /**
  * @brief Allocates a handle in the handle manager
  *
@@ -103,6 +133,18 @@ vc_handle vc_handles_manager_alloc(vc_handles_manager *mgr, vc_handle_type type)
  */
 vc_handle vc_handles_manager_walloc(vc_handles_manager *mgr, vc_handle_type type, void *obj);
 
+/**
+ * @brief Allocates several handles of a type at once, and writes the data of each into its managed object
+ *
+ * @param mgr The handle manager
+ * @param type The type of handle to manage
+ * @param count The number of handles
+ * @param objs The data of each object, contiguous
+ * @param hndls The new handles
+ * @return Wether the handles could be allocated, no handle is allocated otherwise
+ */
+b8        vc_handles_manager_walloc_n(vc_handles_manager *mgr, vc_handle_type type, u32 count, const void *objs, vc_handle *hndls);
+
 /**
  * @brief Deallocates object from manager, without doing anything else
  *
@@ -51,10 +51,29 @@ typedef struct
     u32              family_index;
 } _vc_command_pool_intern;
 
+// Number of set indices whose bindings are tracked, per bind point (the guaranteed maxBoundDescriptorSets)
+#define VC_CMD_TRACKED_SETS 4
+
+typedef struct
+{
+    VkPipelineLayout    layout; // VK_NULL_HANDLE if nothing is known to be bound
+    VkDescriptorSet     set; // VK_NULL_HANDLE with the descriptor buffer backend
+    u64                 offset; // Descriptor buffer backend only
+} _vc_bound_set;
+
 typedef struct
 {
-    VkCommandBuffer    buffer;
-    vc_ctx            *record_ctx;
+    VkCommandBuffer           buffer;
+    vc_ctx                   *record_ctx;
+    b8                        descriptor_buffer_bound; // Wether the descriptor buffer was bound during the current recording
+    _vc_bound_set             bound_sets[2][VC_CMD_TRACKED_SETS]; // By bind point (graphics, compute) and set index, to skip redundant binds
+    b8                        skip_draws; // The last graphics pipeline bound had nothing to bind yet
+
+    // Dynamic state
+    vc_dynamic_state_flags    stale_dynamic_states; // Not set, or overwritten by a pipeline baking them, reset to their defaults when a pipeline binds them dynamic (scissors have their own bit)
+    VkRect2D                  render_area; // Of the current rendering, the default viewport and scissor
+    u32                       color_attachment_count; // Of the current rendering
+    const vc_vertex_binding  *vertex_input; // Of the bound vertex shader, the default vertex input
 } _vc_command_buffer_intern;
 
 typedef struct
@@ -65,52 +84,125 @@ typedef struct
 
 typedef struct
 {
-    b8               externally_managed; // If the image is managed by an external system like swapchains
+    b8                   externally_managed; // If the image is managed by an external system like swapchains
+
+    VkImage              image;
+    VmaAllocation        alloc;
+
+    VkFormat             image_format;
 
-    VkImage          image;
-    VmaAllocation    alloc;
+    // Used to recreate the image when it is moved
+    VkImageCreateInfo    create_info; // Queue family indices are not kept
+    VkImageLayout        resting_layout; // VK_IMAGE_LAYOUT_UNDEFINED if the image cannot be moved
 
-    VkFormat         image_format;
+    u32                  bindless_refs; // Views of the image registered in the bindless heap, the image cannot be moved while > 0
 } _vc_image_intern;
 
 typedef struct
 {
-    VkImageView    view;
+    VkImageView              view;
+
+    vc_image                 image;
+    VkImageViewCreateInfo    create_info;
 } _vc_image_view_intern;
 
+// A specialization of a pipeline, keyed by its constants (id and value pairs, sorted by id)
+typedef struct
+{
+    u64          hash;
+    u32          constant_count;
+    u64         *constants;
+    vc_handle    pipeline;
+} _vc_pipeline_variant;
+
+// Compute and graphics pipelines
 typedef struct
 {
     // HEADER
-    vc_pipeline_type    type;
+    vc_pipeline_type         type;
+
+    VkPipeline               pipeline; // VK_NULL_HANDLE until compiled
+    VkPipeline               linked; // Fast-linked from pipeline libraries, bound until the optimized pipeline is compiled, VK_NULL_HANDLE if there is none
+    VkPipelineLayout         layout;
+    vc_dynamic_state_flags   dynamic_states; // Graphics pipelines only, the groups not baked
 
-    VkPipeline          pipeline;
-    VkPipelineLayout    layout;
-} _vc_compute_pipeline_intern;
+    // Asynchronous compilation
+    vc_handle                fallback; // Bound until the pipeline is compiled, may be VC_NULL_HANDLE
+    vc_pipeline_job         *pending; // Atomic, NULL once the pipeline is compiled
+
+    // Deduplication, guarded by the pipelines lock of the context
+    u32                      refs;
+    u64                      desc_hash;
+    u8                      *desc_key; // Canonical description, NULL if the pipeline cannot be found by its description
+    u64                      desc_key_size;
+
+    // Specialization, the state is kept while the pipeline lives to create its variants (NULL for variants)
+    vc_pipeline_job         *state;
+    _vc_pipeline_variant    *variants; // darray, guarded by the pipelines lock of the context, holding a reference on each
+} _vc_pipeline_intern;
+
+typedef _vc_pipeline_intern _vc_compute_pipeline_intern;
+typedef _vc_pipeline_intern _vc_gfx_pipeline_intern;
 
 typedef struct
 {
     // HEADER
-    vc_pipeline_type    type;
+    vc_pipeline_type            type; // VC_PIPELINE_SHADER
 
-    VkPipeline          pipeline;
-    VkPipelineLayout    layout;
-} _vc_gfx_pipeline_intern;
+    VkShaderEXT                 shader;
+    VkShaderStageFlagBits       stage;
+    VkPipelineLayout            layout; // Equal to the layout of the pipelines with the same layout info
+    const vc_vertex_binding    *vertex_input; // Reflected, vertex shaders only, owned by the reflection cache, NULL if there is none
+} _vc_shader_intern;
 
 typedef struct
 {
-    VkDescriptorSet          set;
-    VkDescriptorSetLayout    layout;
+    VkDescriptorSet                       set; // VK_NULL_HANDLE with the descriptor buffer backend
+    VkDescriptorSetLayout                 layout;
+
+    // Descriptor buffer backend only
+    u64                                   offset; // Offset of the set in the descriptor buffer
+    const vc_descriptor_buffer_layout    *buffer_layout;
 } _vc_descriptor_set_intern;
 
 typedef struct
 {
-    VkDescriptorSetLayout    layout;
+    VkDescriptorSetLayout                 layout;
+    VkDescriptorSetLayoutCreateFlags      flags;
+    const vc_descriptor_buffer_layout    *buffer_layout; // NULL unless the descriptor buffer backend is used
+    vc_ds_demand                          demand; // Descriptors of each type in a set, used to size pools
 } _vc_descriptor_set_layout_intern;
 
 typedef struct
 {
-    VkBuffer         buffer;
-    VmaAllocation    alloc;
-    u64              size;
+    VkBuffer               buffer;
+    VmaAllocation          alloc;
+    u64                    size;
+    VkDeviceAddress        address; // 0 if the buffer was not created with a device address
+
+    // Used to recreate the buffer when it is moved
+    VkBufferCreateFlags    flags;
+    VkBufferUsageFlags     usage;
+
+    u32                    bindless_refs; // Registrations in the bindless heap, the buffer cannot be moved while > 0
 } _vc_buffer_intern;
 
+typedef struct
+{
+    VkSampler    sampler;
+} _vc_sampler_intern;
+
+typedef struct
+{
+    VkDescriptorUpdateTemplate         update_template; // VK_NULL_HANDLE with the descriptor buffer backend
+    VkDescriptorSetLayout              layout; // VK_NULL_HANDLE for push descriptor templates
+    u32                                data_count; // Number of vc_descriptor_data read by an update
+
+    // Push descriptor templates only
+    b8                                 push;
+    u32                                set_index;
+
+    // Used instead of the template by the descriptor buffer backend
+    VkDescriptorUpdateTemplateEntry   *entries;
+    u32                                entry_count;
+} _vc_descriptor_update_template_intern;
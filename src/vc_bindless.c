@@ -0,0 +1,483 @@
+/**
+ * @file
+ * @brief Bindless descriptor heap: a single update after bind set, with free list index management.
+ */
+
+#include "vulcain.h"
+#include "handles/vc_internal_types.h"
+#include "vc_enum_util.h"
+#include "base/data_structures/darray.h"
+
+static const VkDescriptorType _vc_bindless_types[VC_BINDLESS_BINDING_COUNT] =
+{
+    [VC_BINDLESS_SAMPLED_IMAGES]  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    [VC_BINDLESS_STORAGE_IMAGES]  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    [VC_BINDLESS_SAMPLERS]        = VK_DESCRIPTOR_TYPE_SAMPLER,
+    [VC_BINDLESS_STORAGE_BUFFERS] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+// Clamps the requested capacities to the update after bind limits of the device
+b8
+_vc_bindless_clamp_capacities(vc_ctx *ctx, u32 capacities[VC_BINDLESS_BINDING_COUNT])
+{
+    VkPhysicalDeviceDescriptorIndexingProperties props =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+    };
+    VkPhysicalDeviceProperties2 props2 =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &props,
+    };
+    vkGetPhysicalDeviceProperties2(ctx->current_physical_device, &props2);
+
+    // Every binding is visible to all stages, so the per stage limits apply as well
+    u32 limits[VC_BINDLESS_BINDING_COUNT] =
+    {
+        [VC_BINDLESS_SAMPLED_IMAGES]  = MIN(props.maxDescriptorSetUpdateAfterBindSampledImages, props.maxPerStageDescriptorUpdateAfterBindSampledImages),
+        [VC_BINDLESS_STORAGE_IMAGES]  = MIN(props.maxDescriptorSetUpdateAfterBindStorageImages, props.maxPerStageDescriptorUpdateAfterBindStorageImages),
+        [VC_BINDLESS_SAMPLERS]        = MIN(props.maxDescriptorSetUpdateAfterBindSamplers, props.maxPerStageDescriptorUpdateAfterBindSamplers),
+        [VC_BINDLESS_STORAGE_BUFFERS] = MIN(props.maxDescriptorSetUpdateAfterBindStorageBuffers, props.maxPerStageDescriptorUpdateAfterBindStorageBuffers),
+    };
+
+    u64 total = 0;
+    for(u32 i = 0; i < VC_BINDLESS_BINDING_COUNT; i++)
+    {
+        if(capacities[i] > limits[i])
+        {
+            vc_warn("Bindless binding %u capacity clamped from %u to %u descriptors.", i, capacities[i], limits[i]);
+            capacities[i] = limits[i];
+        }
+        total += capacities[i];
+    }
+
+    if(total > props.maxPerStageUpdateAfterBindResources)
+    {
+        vc_error("The bindless heap needs %lu descriptors, the device supports %u per stage.", total, props.maxPerStageUpdateAfterBindResources);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// Allocates the bindless set from its own update after bind pool
+b8
+_vc_bindless_allocate_pool_set(vc_ctx *ctx, VkDescriptorPoolSize *pool_sizes, u32 pool_size_count)
+{
+    vc_bindless_heap *heap = &ctx->bindless;
+
+    VkDescriptorPoolCreateInfo pool_ci =
+    {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets       = 1,
+        .poolSizeCount = pool_size_count,
+        .pPoolSizes    = pool_sizes,
+    };
+    if(vkCreateDescriptorPool(ctx->current_device, &pool_ci, NULL, &heap->pool) != VK_SUCCESS)
+    {
+        vc_error("Could not create the bindless descriptor pool.");
+        vkDestroyDescriptorSetLayout(ctx->current_device, heap->layout, NULL);
+        return FALSE;
+    }
+
+    VkDescriptorSetAllocateInfo set_ai =
+    {
+        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool     = heap->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &heap->layout,
+    };
+    if(vkAllocateDescriptorSets(ctx->current_device, &set_ai, &heap->set) != VK_SUCCESS)
+    {
+        vc_error("Could not allocate the bindless set.");
+        vkDestroyDescriptorPool(ctx->current_device, heap->pool, NULL);
+        vkDestroyDescriptorSetLayout(ctx->current_device, heap->layout, NULL);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+b8
+vc_bindless_create(vc_ctx *ctx, u32 sampled_image_count, u32 storage_image_count, u32 sampler_count, u32 storage_buffer_count)
+{
+    vc_bindless_heap *heap = &ctx->bindless;
+
+    if(!ctx->supported_features.descriptor_indexing)
+    {
+        vc_error("Cannot create a bindless heap, the descriptor_indexing feature is not supported.");
+        return FALSE;
+    }
+
+    if(heap->created)
+    {
+        vc_error("The bindless heap was already created.");
+        return FALSE;
+    }
+
+    u32 capacities[VC_BINDLESS_BINDING_COUNT] =
+    {
+        [VC_BINDLESS_SAMPLED_IMAGES]  = sampled_image_count,
+        [VC_BINDLESS_STORAGE_IMAGES]  = storage_image_count,
+        [VC_BINDLESS_SAMPLERS]        = sampler_count,
+        [VC_BINDLESS_STORAGE_BUFFERS] = storage_buffer_count,
+    };
+
+    if(!_vc_bindless_clamp_capacities(ctx, capacities))
+    {
+        return FALSE;
+    }
+
+    // Layout
+    VkDescriptorSetLayoutBinding bindings[VC_BINDLESS_BINDING_COUNT];
+    VkDescriptorBindingFlags binding_flags[VC_BINDLESS_BINDING_COUNT];
+    VkDescriptorPoolSize pool_sizes[VC_BINDLESS_BINDING_COUNT];
+    u32 pool_size_count = 0;
+
+    for(u32 i = 0; i < VC_BINDLESS_BINDING_COUNT; i++)
+    {
+        bindings[i] = (VkDescriptorSetLayoutBinding)
+        {
+            .binding         = i,
+            .descriptorType  = _vc_bindless_types[i],
+            .descriptorCount = capacities[i],
+            .stageFlags      = VK_SHADER_STAGE_ALL,
+        };
+
+        // Unused indices may hold anything, and indices can be written while the set is bound
+        // (descriptor buffers are plain memory, and need no update after bind flag for that)
+        binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        if(!ctx->supported_features.descriptor_buffer)
+        {
+            binding_flags[i] |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        }
+
+        if(capacities[i] > 0)
+        {
+            pool_sizes[pool_size_count++] = (VkDescriptorPoolSize)
+            {
+                .type            = _vc_bindless_types[i],
+                .descriptorCount = capacities[i],
+            };
+        }
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_ci =
+    {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount  = VC_BINDLESS_BINDING_COUNT,
+        .pBindingFlags = binding_flags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo layout_ci =
+    {
+        .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext        = &flags_ci,
+        .flags        = ctx->supported_features.descriptor_buffer ?
+                        VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT :
+                        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = VC_BINDLESS_BINDING_COUNT,
+        .pBindings    = bindings,
+    };
+    VK_CHECKR(vkCreateDescriptorSetLayout(ctx->current_device, &layout_ci, NULL, &heap->layout), "Could not create the bindless set layout.");
+
+    _vc_descriptor_set_layout_intern layout_i =
+    {
+        .layout        = heap->layout,
+        .flags         = layout_ci.flags,
+        .buffer_layout = NULL,
+    };
+
+    _vc_descriptor_set_intern set_i =
+    {
+        .set    = VK_NULL_HANDLE,
+        .layout = heap->layout,
+    };
+
+    // Descriptor buffer backend: the set is a range of the persistent region
+    heap->pool = VK_NULL_HANDLE;
+    heap->set  = VK_NULL_HANDLE;
+    if(ctx->supported_features.descriptor_buffer)
+    {
+        layout_i.buffer_layout = vc_descriptor_buffer_get_layout(&ctx->descriptor_buffer, ctx->current_device, heap->layout, &layout_ci);
+        set_i.buffer_layout    = layout_i.buffer_layout;
+
+        if(!vc_descriptor_buffer_allocate(&ctx->descriptor_buffer, set_i.buffer_layout, VC_DESCRIPTOR_BUFFER_PERSISTENT, &set_i.offset))
+        {
+            vc_error("Could not allocate the bindless set, the descriptor buffer is too small (%lu bytes needed).", set_i.buffer_layout->size);
+            vkDestroyDescriptorSetLayout(ctx->current_device, heap->layout, NULL);
+            return FALSE;
+        }
+    }
+    else if(!_vc_bindless_allocate_pool_set(ctx, pool_sizes, pool_size_count))
+    {
+        return FALSE;
+    }
+    set_i.set = heap->set;
+
+    // Handles, so the set can be used with the rest of the API
+    heap->layout_hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET_LAYOUT, &layout_i);
+    heap->set_hndl    = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_DESCRIPTOR_SET, &set_i);
+
+    for(u32 i = 0; i < VC_BINDLESS_BINDING_COUNT; i++)
+    {
+        _vc_bindless_array *array = &heap->arrays[i];
+        array->capacity     = capacities[i];
+        array->used         = 0;
+        array->free_indices = darray_create(u32);
+        array->registered   = mem_allocate(sizeof(vc_handle) * MAX(capacities[i], 1), MEMORY_TAG_RENDERER);
+        mem_memset(array->registered, 0, sizeof(vc_handle) * MAX(capacities[i], 1));
+    }
+
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        heap->releases[i] = (_vc_bindless_releases) {
+            .frame    = 0,
+            .deferred = FALSE,
+            .indices  = darray_create(u64),
+        };
+    }
+    heap->created = TRUE;
+
+    vc_info("Created bindless heap (%u sampled images, %u storage images, %u samplers, %u storage buffers).",
+            capacities[VC_BINDLESS_SAMPLED_IMAGES], capacities[VC_BINDLESS_STORAGE_IMAGES],
+            capacities[VC_BINDLESS_SAMPLERS], capacities[VC_BINDLESS_STORAGE_BUFFERS]);
+    return TRUE;
+}
+
+void
+vc_bindless_destroy(vc_bindless_heap *heap, VkDevice dev)
+{
+    if(!heap->created)
+    {
+        return;
+    }
+
+    vkDestroyDescriptorPool(dev, heap->pool, NULL);
+    vkDestroyDescriptorSetLayout(dev, heap->layout, NULL);
+
+    for(u32 i = 0; i < VC_BINDLESS_BINDING_COUNT; i++)
+    {
+        darray_destroy(heap->arrays[i].free_indices);
+        mem_free(heap->arrays[i].registered);
+    }
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        darray_destroy(heap->releases[i].indices);
+    }
+
+    heap->created = FALSE;
+}
+
+vc_descriptor_set_layout
+vc_bindless_get_layout(vc_ctx   *ctx)
+{
+    return ctx->bindless.created ? ctx->bindless.layout_hndl : VC_NULL_HANDLE;
+}
+
+vc_descriptor_set
+vc_bindless_get_set(vc_ctx   *ctx)
+{
+    return ctx->bindless.created ? ctx->bindless.set_hndl : VC_NULL_HANDLE;
+}
+
+// Takes an index from the free list, or a never used one
+u32
+_vc_bindless_acquire(vc_ctx *ctx, vc_bindless_binding binding, vc_handle resource)
+{
+    if(!ctx->bindless.created)
+    {
+        vc_error("The bindless heap was not created.");
+        return UINT32_MAX;
+    }
+
+    _vc_bindless_array *array = &ctx->bindless.arrays[binding];
+    u32 index                 = UINT32_MAX;
+
+    if(darray_length(array->free_indices) > 0)
+    {
+        darray_pop(array->free_indices, &index);
+    }
+    else if(array->used < array->capacity)
+    {
+        index = array->used++;
+    }
+    else
+    {
+        vc_error("Bindless binding %u is full (%u descriptors).", binding, array->capacity);
+        return UINT32_MAX;
+    }
+
+    array->registered[index] = resource;
+    return index;
+}
+
+void _vc_descriptor_set_write(vc_ctx *ctx, _vc_descriptor_set_intern *set_i, u32 write_count, VkWriteDescriptorSet *writes);
+
+void
+_vc_bindless_write(vc_ctx *ctx, vc_bindless_binding binding, u32 index, VkDescriptorImageInfo *image_info, VkDescriptorBufferInfo *buffer_info)
+{
+    _vc_descriptor_set_intern set_i;
+    vc_handles_manager_read(&ctx->handles_manager, ctx->bindless.set_hndl, &set_i, sizeof(set_i) );
+
+    VkWriteDescriptorSet write =
+    {
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstBinding      = binding,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType  = _vc_bindless_types[binding],
+        .pImageInfo      = image_info,
+        .pBufferInfo     = buffer_info,
+    };
+
+    _vc_descriptor_set_write(ctx, &set_i, 1, &write);
+}
+
+u32
+_vc_bindless_register_view(vc_ctx *ctx, vc_bindless_binding binding, vc_image_view view, VkImageLayout layout)
+{
+    u32 index = _vc_bindless_acquire(ctx, binding, view);
+    if(index == UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+
+    _vc_image_view_intern *view_i = vc_handles_manager_deref(&ctx->handles_manager, view);
+    _vc_image_intern *img_i       = vc_handles_manager_deref(&ctx->handles_manager, view_i->image);
+    img_i->bindless_refs++;
+
+    VkDescriptorImageInfo info =
+    {
+        .imageView   = view_i->view,
+        .imageLayout = layout,
+    };
+    _vc_bindless_write(ctx, binding, index, &info, NULL);
+
+    return index;
+}
+
+u32
+vc_bindless_register_sampled_image(vc_ctx *ctx, vc_image_view view, VkImageLayout layout)
+{
+    return _vc_bindless_register_view(ctx, VC_BINDLESS_SAMPLED_IMAGES, view, layout);
+}
+
+u32
+vc_bindless_register_storage_image(vc_ctx *ctx, vc_image_view view)
+{
+    return _vc_bindless_register_view(ctx, VC_BINDLESS_STORAGE_IMAGES, view, VK_IMAGE_LAYOUT_GENERAL);
+}
+
+u32
+vc_bindless_register_sampler(vc_ctx *ctx, vc_sampler sampler)
+{
+    u32 index = _vc_bindless_acquire(ctx, VC_BINDLESS_SAMPLERS, sampler);
+    if(index == UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+
+    _vc_sampler_intern *sampler_i = vc_handles_manager_deref(&ctx->handles_manager, sampler);
+
+    VkDescriptorImageInfo info =
+    {
+        .sampler = sampler_i->sampler,
+    };
+    _vc_bindless_write(ctx, VC_BINDLESS_SAMPLERS, index, &info, NULL);
+
+    return index;
+}
+
+u32
+vc_bindless_register_storage_buffer(vc_ctx *ctx, vc_buffer buffer, u64 offset, u64 range)
+{
+    u32 index = _vc_bindless_acquire(ctx, VC_BINDLESS_STORAGE_BUFFERS, buffer);
+    if(index == UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+
+    _vc_buffer_intern *buf_i = vc_handles_manager_deref(&ctx->handles_manager, buffer);
+    buf_i->bindless_refs++;
+
+    VkDescriptorBufferInfo info =
+    {
+        .buffer = buf_i->buffer,
+        .offset = offset,
+        .range  = range == VK_WHOLE_SIZE ? buf_i->size - offset : range,
+    };
+    _vc_bindless_write(ctx, VC_BINDLESS_STORAGE_BUFFERS, index, NULL, &info);
+
+    return index;
+}
+
+// Retire task, the indices released during the frame can be reused
+void
+_vc_bindless_retire(vc_ctx *ctx, _vc_bindless_releases *releases)
+{
+    // The heap, and its release lists, may have been destroyed along with the frames
+    if(!ctx->bindless.created)
+    {
+        return;
+    }
+
+    for(u32 i = 0; i < darray_length(releases->indices); i++)
+    {
+        u32 binding = releases->indices[i] >> 32;
+        u32 index   = releases->indices[i] & 0xFFFFFFFF;
+        darray_push(ctx->bindless.arrays[binding].free_indices, index);
+    }
+    darray_clear(releases->indices);
+    releases->deferred = FALSE;
+}
+
+void
+vc_bindless_release(vc_ctx *ctx, vc_bindless_binding binding, u32 index)
+{
+    vc_bindless_heap *heap = &ctx->bindless;
+
+    if(!heap->created || binding >= VC_BINDLESS_BINDING_COUNT || index >= heap->arrays[binding].used)
+    {
+        vc_error("Attempted to release an invalid bindless index.");
+        return;
+    }
+
+    _vc_bindless_array *array = &heap->arrays[binding];
+    vc_handle resource        = array->registered[index];
+    if(resource == VC_NULL_HANDLE)
+    {
+        vc_error("Bindless index %u of binding %u was released twice.", index, binding);
+        return;
+    }
+    array->registered[index] = VC_NULL_HANDLE;
+
+    // The resource can be moved again
+    if(binding == VC_BINDLESS_SAMPLED_IMAGES || binding == VC_BINDLESS_STORAGE_IMAGES)
+    {
+        _vc_image_view_intern *view_i = vc_handles_manager_deref(&ctx->handles_manager, resource);
+        _vc_image_intern *img_i       = vc_handles_manager_deref(&ctx->handles_manager, view_i->image);
+        img_i->bindless_refs--;
+    }
+    else if(binding == VC_BINDLESS_STORAGE_BUFFERS)
+    {
+        _vc_buffer_intern *buf_i = vc_handles_manager_deref(&ctx->handles_manager, resource);
+        buf_i->bindless_refs--;
+    }
+
+    // Frames in flight may still read the descriptor, the index is reused once the current frame retires.
+    // The slot of the frame is retired before it is used again, so its list is empty when a new frame defers it
+    u64 frame                       = ctx->frames.current_frame;
+    _vc_bindless_releases *releases = &heap->releases[frame % VC_FRAMES_IN_FLIGHT];
+    if(!releases->deferred || releases->frame != frame)
+    {
+        releases->frame    = frame;
+        releases->deferred = TRUE;
+        vc_frames_defer(&ctx->frames, (vc_frame_retire_func)_vc_bindless_retire, releases);
+    }
+
+    u64 release = ( (u64)binding << 32 ) | index;
+    darray_push(releases->indices, release);
+}
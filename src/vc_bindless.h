@@ -0,0 +1,71 @@
+#ifndef __VC_BINDLESS__
+#define __VC_BINDLESS__
+
+/*
+ * Bindless descriptor heap.
+ * A single update after bind descriptor set holds large arrays of sampled images, storage images, samplers and storage
+ * buffers. Resources are registered once and referenced from shaders by their index in the array of their binding.
+ * Released indices only go back to the free list once the frame in which they were released has retired.
+ * With the descriptor_buffer feature, the set lives in the persistent region of the descriptor buffer instead, whose
+ * size then bounds the capacities as well.
+ */
+
+#include <vulkan/vulkan.h>
+#include "base/types.h"
+#include "handles/vc_handles.h"
+#include "vc_frames.h"
+
+/**
+ * @brief The bindings of the bindless set, each binding is an array of descriptors
+ */
+typedef enum
+{
+    VC_BINDLESS_SAMPLED_IMAGES = 0,
+    VC_BINDLESS_STORAGE_IMAGES,
+    VC_BINDLESS_SAMPLERS,
+    VC_BINDLESS_STORAGE_BUFFERS,
+    VC_BINDLESS_BINDING_COUNT,
+} vc_bindless_binding;
+
+typedef struct
+{
+    u32          capacity;
+    u32          used; // Indices below are either registered or in the free list
+    u32         *free_indices; // darray
+    vc_handle   *registered; // The resource of each index, VC_NULL_HANDLE if free
+} _vc_bindless_array;
+
+// The indices released during a frame, owned by the heap so the retire task never sees a reallocated list
+typedef struct
+{
+    u64     frame;
+    b8      deferred; // Wether the retire task of frame is pending
+    u64    *indices; // darray, binding << 32 | index
+} _vc_bindless_releases;
+
+typedef struct
+{
+    b8                          created;
+
+    VkDescriptorPool            pool;
+    VkDescriptorSetLayout       layout;
+    VkDescriptorSet             set;
+
+    vc_descriptor_set_layout    layout_hndl;
+    vc_descriptor_set           set_hndl;
+
+    _vc_bindless_array          arrays[VC_BINDLESS_BINDING_COUNT];
+
+    _vc_bindless_releases       releases[VC_FRAMES_IN_FLIGHT]; // By frame slot
+} vc_bindless_heap;
+
+/**
+ * @brief Destroys the bindless heap, if it was created
+ *
+ * @param heap The bindless heap
+ * @param dev The device
+ * @attention Frames must have been retired before.
+ */
+void vc_bindless_destroy(vc_bindless_heap *heap, VkDevice dev);
+
+#endif // __VC_BINDLESS__
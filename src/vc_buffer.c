@@ -2,15 +2,60 @@
 #include "handles/vc_internal_types.h"
 #include "vc_enum_util.h"
 
+b8 _vc_defrag_release_buffer(vc_ctx *ctx, VmaAllocation alloc, VkBuffer buffer);
+
 void
 _vc_buffer_destory(vc_ctx *ctx, _vc_buffer_intern *b)
 {
+    if(_vc_defrag_release_buffer(ctx, b->alloc, b->buffer))
+    {
+        // The allocation is part of a defragmentation pass, the defragmenter frees it with the buffer
+        return;
+    }
+
     vmaDestroyBuffer(ctx->main_allocator, b->buffer, b->alloc);
 }
 
+// Creates a persistently mapped buffer, for internal transfers (staging, readback...)
+b8
+_vc_host_buffer_create(vc_ctx *ctx, u64 size, VkBufferUsageFlags usage, VmaAllocationCreateFlags host_access, VkBuffer *buffer, VmaAllocation *alloc, void **mapped)
+{
+    VkBufferCreateInfo buf_ci =
+    {
+        .sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size        = size,
+        .usage       = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    VmaAllocationCreateInfo alloc_ci =
+    {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+        .flags = host_access | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    };
+
+    VmaAllocationInfo alloc_i;
+    VK_CHECKR(vmaCreateBuffer(ctx->main_allocator, &buf_ci, &alloc_ci, buffer, alloc, &alloc_i), "Could not allocate a host buffer");
+
+    *mapped = alloc_i.pMappedData;
+    return TRUE;
+}
+
 vc_buffer
 vc_buffer_allocate(vc_ctx *ctx, u64 size, VkBufferCreateFlags flags, VkBufferUsageFlags usage, vc_memory_create_info mem)
 {
+    if( (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) && !ctx->supported_features.buffer_device_address )
+    {
+        vc_error("Buffer device address was requested for a buffer, but the device does not support it.");
+        return VC_NULL_HANDLE;
+    }
+
+    // Descriptor buffers reference buffers by their address
+    if( ctx->supported_features.descriptor_buffer && (usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) ) )
+    {
+        usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    }
+
     VkBufferCreateInfo buf_ci =
     {
         .sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -34,11 +79,30 @@ vc_buffer_allocate(vc_ctx *ctx, u64 size, VkBufferCreateFlags flags, VkBufferUsa
     };
 
     VK_CHECKH(vmaCreateBuffer(ctx->main_allocator, &buf_ci, &alloc_ci, &buf_i.buffer, &buf_i.alloc, NULL), "Could not allocate a buffer");
-    buf_i.size = size;
+    buf_i.size  = size;
+    buf_i.flags = flags;
+    buf_i.usage = usage;
+
+    if(usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+    {
+        VkBufferDeviceAddressInfo addr_i =
+        {
+            .sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            .buffer = buf_i.buffer,
+        };
+        buf_i.address = ctx->device_functions.get_buffer_device_address(ctx->current_device, &addr_i);
+    }
 
     vc_buffer hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_BUFFER, &buf_i);
+    vmaSetAllocationUserData(ctx->main_allocator, buf_i.alloc, (void *)hndl); // Lets the defragmenter find the handle back
     vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_BUFFER, (vc_handle_destroy_func)_vc_buffer_destory);
 
     return hndl;
 }
 
+VkDeviceAddress
+vc_buffer_get_device_address(vc_ctx *ctx, vc_buffer buffer)
+{
+    _vc_buffer_intern *buf_i = vc_handles_manager_deref(&ctx->handles_manager, buffer);
+    return buf_i->address;
+}
@@ -2,11 +2,51 @@
 #include "handles/vc_internal_types.h"
 #include <alloca.h>
 
+vc_dynamic_state_flags _vc_dynamic_states_supported(vc_ctx   *ctx);
+
+// Internal stale bit of the scissors, which are set apart from the viewports of VC_DYNAMIC_VIEWPORT
+#define _VC_DYNAMIC_SCISSOR (VC_DYNAMIC_ALL + 1)
+
+// The groups set while recording: the ones pipelines can make dynamic, every group with shader objects
+vc_dynamic_state_flags
+_vc_cmd_dynamic_states_recorded(vc_ctx   *ctx)
+{
+    return ctx->supported_features.shader_object ? VC_DYNAMIC_ALL : _vc_dynamic_states_supported(ctx);
+}
+
+// The stale bits of groups, with the scissors of VC_DYNAMIC_VIEWPORT
+vc_dynamic_state_flags
+_vc_cmd_stale_bits(vc_dynamic_state_flags    groups)
+{
+    return groups | ( (groups & VC_DYNAMIC_VIEWPORT) ? _VC_DYNAMIC_SCISSOR : 0);
+}
+
+// Wether the states of a group can be set, they cannot be recorded when the device does not make them dynamic
+b8
+_vc_cmd_dynamic_state_settable(_vc_command_buffer_intern *buf, vc_dynamic_state_flags group, const char *name)
+{
+    if( !(_vc_cmd_dynamic_states_recorded(buf->record_ctx) & group) )
+    {
+        vc_error("Cannot set the %s, the device does not support it as a dynamic state.", name);
+        return FALSE;
+    }
+    return TRUE;
+}
+
 vc_cmd_record
 vc_command_buffer_begin(vc_ctx *ctx, vc_command_buffer cmd_buffer, VkCommandBufferUsageFlags usage)
 {
     _vc_command_buffer_intern *buf = vc_handles_manager_deref(&ctx->handles_manager, cmd_buffer);
-    buf->record_ctx = ctx;
+    buf->record_ctx              = ctx;
+    buf->descriptor_buffer_bound = FALSE;
+    buf->stale_dynamic_states    = _vc_cmd_stale_bits(_vc_cmd_dynamic_states_recorded(ctx) );
+    buf->render_area             = (VkRect2D) {
+        0
+    };
+    buf->color_attachment_count = 0;
+    buf->vertex_input           = NULL;
+    buf->skip_draws             = FALSE;
+    mem_memset(buf->bound_sets, 0, sizeof(buf->bound_sets) );
 
     VkCommandBufferBeginInfo begin_i =
     {
@@ -134,6 +174,8 @@ vc_cmd_image_clear(vc_cmd_record record, vc_image image,
 }
 
 // Pipeline utils
+VkPipeline _vc_pipeline_bindable(vc_ctx *ctx, _vc_pipeline_intern *pipe);
+
 VkPipeline
 _vc_cmd_generic_pipeline_deref(vc_cmd_record record, vc_handle pipeline, VkPipelineBindPoint *bind_point, vc_pipeline_type *type, VkPipelineLayout *layout)
 {
@@ -161,6 +203,14 @@ _vc_cmd_generic_pipeline_deref(vc_cmd_record record, vc_handle pipeline, VkPipel
         out_type       = pipe_i->type;
         out_pipeline   = pipe_i->pipeline;
     }
+    else if(*pipe == VC_PIPELINE_SHADER)
+    {
+        _vc_shader_intern *shader_i = (_vc_shader_intern *)pipe;
+        out_bind_point = shader_i->stage == VK_SHADER_STAGE_COMPUTE_BIT ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+        out_layout     = shader_i->layout;
+        out_type       = shader_i->type;
+        out_pipeline   = VK_NULL_HANDLE;
+    }
     else
     {
         return VK_NULL_HANDLE;
@@ -190,21 +240,106 @@ vc_cmd_dispatch_compute(vc_cmd_record record, vc_compute_pipeline pipeline, u32
     _vc_command_buffer_intern *buf    = (_vc_command_buffer_intern *)record;
     _vc_compute_pipeline_intern *pipe = vc_handles_manager_deref(&buf->record_ctx->handles_manager, pipeline);
 
-    vkCmdBindPipeline(buf->buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipe->pipeline);
+    VkPipeline vk_pipeline = _vc_pipeline_bindable(buf->record_ctx, pipe);
+    if(vk_pipeline == VK_NULL_HANDLE)
+    {
+        vc_error("Compute pipeline has nothing to bind (its compilation failed), the dispatch is skipped.");
+        return;
+    }
+
+    vkCmdBindPipeline(buf->buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pipeline);
     vkCmdDispatch(buf->buffer, groups_x, groups_y, groups_z);
 }
 
+// Forgets the set bound at an index, and the sets bound with another layout, as they may have been disturbed
+void
+_vc_cmd_forget_sets(_vc_command_buffer_intern *buf, VkPipelineBindPoint bind_point, VkPipelineLayout layout, u32 set_index)
+{
+    if(bind_point > VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        return;
+    }
+
+    _vc_bound_set *bound = buf->bound_sets[bind_point];
+    for(u32 i = 0; i < VC_CMD_TRACKED_SETS; i++)
+    {
+        if(i == set_index || bound[i].layout != layout)
+        {
+            bound[i] = (_vc_bound_set) {
+                0
+            };
+        }
+    }
+}
+
+/**
+ * @brief Tracks the binding of a set. Pipelines with equal layouts share their VkPipelineLayout, so a set bound for
+ *        one of them stays bound when switching to another.
+ *
+ * @return Wether the set was already bound at this index, with the same layout
+ */
+b8
+_vc_cmd_track_set(_vc_command_buffer_intern *buf, VkPipelineBindPoint bind_point, VkPipelineLayout layout, u32 set_index, VkDescriptorSet set, u64 offset)
+{
+    if(bind_point > VK_PIPELINE_BIND_POINT_COMPUTE || set_index >= VC_CMD_TRACKED_SETS)
+    {
+        _vc_cmd_forget_sets(buf, bind_point, layout, set_index);
+        return FALSE;
+    }
+
+    _vc_bound_set *bound = &buf->bound_sets[bind_point][set_index];
+    if(bound->layout == layout && bound->set == set && bound->offset == offset)
+    {
+        return TRUE;
+    }
+
+    _vc_cmd_forget_sets(buf, bind_point, layout, set_index);
+    *bound = (_vc_bound_set) {
+        .layout = layout,
+        .set    = set,
+        .offset = offset,
+    };
+    return FALSE;
+}
+
 void
 vc_cmd_bind_descriptor_set(vc_cmd_record record, vc_handle pipeline, vc_descriptor_set set, u32 set_dest)
 {
-    _vc_command_buffer_intern *buf   = (_vc_command_buffer_intern *)record;
-    _vc_descriptor_set_intern *set_i = vc_handles_manager_deref(&buf->record_ctx->handles_manager, set);
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    _vc_descriptor_set_intern set_i;
+    vc_handles_manager_read(&buf->record_ctx->handles_manager, set, &set_i, sizeof(set_i) );
 
     VkPipelineLayout layout        = VK_NULL_HANDLE;
     VkPipelineBindPoint bind_point = 0;
     _vc_cmd_generic_pipeline_deref(record, pipeline, &bind_point, NULL, &layout);
 
-    vkCmdBindDescriptorSets(buf->buffer, bind_point, layout, set_dest, 1, &set_i->set, 0, NULL);
+    if(_vc_cmd_track_set(buf, bind_point, layout, set_dest, set_i.set, set_i.offset) )
+    {
+        return;
+    }
+
+    if(set_i.buffer_layout == NULL)
+    {
+        vkCmdBindDescriptorSets(buf->buffer, bind_point, layout, set_dest, 1, &set_i.set, 0, NULL);
+        return;
+    }
+
+    // Descriptor buffer backend: the buffer is bound once per recording, binding a set only sets its offset
+    vc_descriptor_buffer *db = &buf->record_ctx->descriptor_buffer;
+    if(!buf->descriptor_buffer_bound)
+    {
+        VkDescriptorBufferBindingInfoEXT binding_i =
+        {
+            .sType   = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+            .address = db->address,
+            .usage   = db->usage,
+        };
+        db->cmd_bind_buffers(buf->buffer, 1, &binding_i);
+        buf->descriptor_buffer_bound = TRUE;
+    }
+
+    u32 buffer_index = 0;
+    db->cmd_set_offsets(buf->buffer, bind_point, layout, set_dest, 1, &buffer_index, &set_i.offset);
 }
 
 void
@@ -218,6 +353,61 @@ vc_cmd_push_constants(vc_cmd_record record, vc_handle pipeline, VkShaderStageFla
     vkCmdPushConstants(buf->buffer, layout, stage, offset, size, data);
 }
 
+void _vc_descriptor_set_writer_reset(vc_descriptor_set_writer *writer);
+
+void
+vc_cmd_push_descriptor_set(vc_cmd_record record, vc_handle pipeline, u32 set_index, vc_descriptor_set_writer *writer)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx *ctx                    = buf->record_ctx;
+
+    if(!ctx->supported_features.push_descriptor)
+    {
+        vc_error("Cannot push a descriptor set, the push_descriptor feature is not supported.");
+        _vc_descriptor_set_writer_reset(writer);
+        return;
+    }
+
+    if(writer->count == 0)
+    {
+        return;
+    }
+
+    VkPipelineLayout layout        = VK_NULL_HANDLE;
+    VkPipelineBindPoint bind_point = 0;
+    _vc_cmd_generic_pipeline_deref(record, pipeline, &bind_point, NULL, &layout);
+
+    // The writes are recorded into the command buffer, no set is involved
+    _vc_cmd_forget_sets(buf, bind_point, layout, set_index);
+    ctx->device_functions.cmd_push_descriptor_set(buf->buffer, bind_point, layout, set_index, writer->count, writer->writes);
+    _vc_descriptor_set_writer_reset(writer);
+}
+
+void
+vc_cmd_push_descriptor_set_with_template(vc_cmd_record record, vc_handle pipeline, vc_descriptor_update_template update_template, const vc_descriptor_data *data)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!buf->record_ctx->supported_features.push_descriptor)
+    {
+        vc_error("Cannot push a descriptor set, the push_descriptor feature is not supported.");
+        return;
+    }
+
+    _vc_descriptor_update_template_intern *template_i = vc_handles_manager_deref(&buf->record_ctx->handles_manager, update_template);
+    if(!template_i->push)
+    {
+        vc_error("Descriptor update template not compiled for push descriptors.");
+        return;
+    }
+
+    VkPipelineLayout layout        = VK_NULL_HANDLE;
+    VkPipelineBindPoint bind_point = 0;
+    _vc_cmd_generic_pipeline_deref(record, pipeline, &bind_point, NULL, &layout);
+
+    _vc_cmd_forget_sets(buf, bind_point, layout, template_i->set_index);
+    buf->record_ctx->device_functions.cmd_push_descriptor_set_with_template(buf->buffer, template_i->update_template, layout, template_i->set_index, data);
+}
+
 // ## DYNAMIC RENDERING ##
 
 VkRenderingAttachmentInfoKHR
@@ -247,6 +437,172 @@ _vc_attach_info_to_vk_info(vc_ctx *ctx, vc_rendering_attachment_info info)
     return out_info;
 }
 
+// Sets the vertex input of the following draws, with shader objects
+void
+_vc_cmd_vertex_input(_vc_command_buffer_intern *buf, u32 binding_count, const vc_vertex_binding *bindings)
+{
+    u32 attribute_count = 0;
+    for(u32 i = 0; i < binding_count; i++)
+    {
+        attribute_count += bindings[i].attribute_count;
+    }
+
+    VkVertexInputBindingDescription2EXT *vk_bindings     = alloca(sizeof(VkVertexInputBindingDescription2EXT) * (binding_count + 1) );
+    VkVertexInputAttributeDescription2EXT *vk_attributes = alloca(sizeof(VkVertexInputAttributeDescription2EXT) * (attribute_count + 1) );
+    u32 idx                                              = 0;
+    for(u32 i = 0; i < binding_count; i++)
+    {
+        vk_bindings[i] = (VkVertexInputBindingDescription2EXT) {
+            .sType     = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+            .binding   = bindings[i].binding,
+            .stride    = bindings[i].stride,
+            .inputRate = bindings[i].input_rate,
+            .divisor   = 1,
+        };
+
+        for(u32 j = 0; j < bindings[i].attribute_count; j++)
+        {
+            vk_attributes[idx++] = (VkVertexInputAttributeDescription2EXT) {
+                .sType    = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+                .location = bindings[i].attributes[j].location,
+                .binding  = bindings[i].binding,
+                .format   = bindings[i].attributes[j].format,
+                .offset   = bindings[i].attributes[j].offset,
+            };
+        }
+    }
+
+    buf->record_ctx->device_functions.cmd_set_vertex_input(buf->buffer, binding_count, vk_bindings, attribute_count, vk_attributes);
+}
+
+// Sets groups of dynamic states to their default values, see vc_dynamic_state_flags
+void
+_vc_cmd_dynamic_state_defaults(_vc_command_buffer_intern *buf, vc_dynamic_state_flags groups)
+{
+    VkCommandBuffer cmd          = buf->buffer;
+    vc_ctx_device_functions *fns = &buf->record_ctx->device_functions;
+
+    // Outside of a rendering there is no default viewport nor scissor
+    b8 has_render_area = buf->render_area.extent.width > 0 && buf->render_area.extent.height > 0;
+    if( (groups & VC_DYNAMIC_VIEWPORT) && has_render_area)
+    {
+        VkViewport viewport =
+        {
+            .x        = (f32)buf->render_area.offset.x,
+            .y        = (f32)buf->render_area.offset.y,
+            .width    = (f32)buf->render_area.extent.width,
+            .height   = (f32)buf->render_area.extent.height,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+        };
+        vkCmdSetViewportWithCount(cmd, 1, &viewport);
+    }
+
+    if( (groups & _VC_DYNAMIC_SCISSOR) && has_render_area)
+    {
+        vkCmdSetScissorWithCount(cmd, 1, &buf->render_area);
+    }
+
+    if(groups & VC_DYNAMIC_CULL_MODE)
+    {
+        vkCmdSetCullMode(cmd, VK_CULL_MODE_NONE);
+        vkCmdSetFrontFace(cmd, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+    }
+
+    if(groups & VC_DYNAMIC_TOPOLOGY)
+    {
+        vkCmdSetPrimitiveTopology(cmd, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        vkCmdSetPrimitiveRestartEnable(cmd, VK_FALSE);
+    }
+
+    if(groups & VC_DYNAMIC_DEPTH_TEST)
+    {
+        vkCmdSetDepthTestEnable(cmd, VK_FALSE);
+        vkCmdSetDepthWriteEnable(cmd, VK_FALSE);
+        vkCmdSetDepthCompareOp(cmd, VK_COMPARE_OP_LESS);
+    }
+
+    if(groups & VC_DYNAMIC_DEPTH_BOUNDS)
+    {
+        vkCmdSetDepthBoundsTestEnable(cmd, VK_FALSE);
+        vkCmdSetDepthBounds(cmd, 0.0f, 1.0f);
+    }
+
+    if(groups & VC_DYNAMIC_DEPTH_BIAS)
+    {
+        vkCmdSetDepthBiasEnable(cmd, VK_FALSE);
+        vkCmdSetDepthBias(cmd, 0.0f, 0.0f, 0.0f);
+    }
+
+    if(groups & VC_DYNAMIC_STENCIL)
+    {
+        vkCmdSetStencilTestEnable(cmd, VK_FALSE);
+        vkCmdSetStencilOp(cmd, VK_STENCIL_FACE_FRONT_AND_BACK, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_ALWAYS);
+        vkCmdSetStencilCompareMask(cmd, VK_STENCIL_FACE_FRONT_AND_BACK, 0xFF);
+        vkCmdSetStencilWriteMask(cmd, VK_STENCIL_FACE_FRONT_AND_BACK, 0xFF);
+        vkCmdSetStencilReference(cmd, VK_STENCIL_FACE_FRONT_AND_BACK, 0);
+    }
+
+    if(groups & VC_DYNAMIC_LINE_WIDTH)
+    {
+        vkCmdSetLineWidth(cmd, 1.0f);
+    }
+
+    if(groups & VC_DYNAMIC_BLEND_CONSTANTS)
+    {
+        f32 constants[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        vkCmdSetBlendConstants(cmd, constants);
+    }
+
+    if(groups & VC_DYNAMIC_POLYGON_MODE)
+    {
+        fns->cmd_set_polygon_mode(cmd, VK_POLYGON_MODE_FILL);
+    }
+
+    if(groups & VC_DYNAMIC_DEPTH_CLAMP)
+    {
+        fns->cmd_set_depth_clamp_enable(cmd, VK_FALSE);
+    }
+
+    if( (groups & VC_DYNAMIC_BLEND) && buf->color_attachment_count > 0)
+    {
+        u32 count                          = buf->color_attachment_count;
+        VkBool32 *enables                  = alloca(sizeof(VkBool32) * count);
+        VkColorBlendEquationEXT *equations = alloca(sizeof(VkColorBlendEquationEXT) * count);
+        VkColorComponentFlags *masks       = alloca(sizeof(VkColorComponentFlags) * count);
+        for(u32 i = 0; i < count; i++)
+        {
+            enables[i]   = VK_FALSE;
+            equations[i] = (VkColorBlendEquationEXT) {
+                .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+                .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+                .colorBlendOp        = VK_BLEND_OP_ADD,
+                .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+                .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+                .alphaBlendOp        = VK_BLEND_OP_ADD,
+            };
+            masks[i] = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        }
+        fns->cmd_set_color_blend_enable(cmd, 0, count, enables);
+        fns->cmd_set_color_blend_equation(cmd, 0, count, equations);
+        fns->cmd_set_color_write_mask(cmd, 0, count, masks);
+    }
+
+    if(groups & VC_DYNAMIC_MULTISAMPLE)
+    {
+        VkSampleMask sample_mask = 0xFFFFFFFF;
+        vkCmdSetRasterizerDiscardEnable(cmd, VK_FALSE);
+        fns->cmd_set_rasterization_samples(cmd, VK_SAMPLE_COUNT_1_BIT);
+        fns->cmd_set_sample_mask(cmd, VK_SAMPLE_COUNT_1_BIT, &sample_mask);
+        fns->cmd_set_alpha_to_coverage_enable(cmd, VK_FALSE);
+    }
+
+    if(groups & VC_DYNAMIC_VERTEX_INPUT)
+    {
+        _vc_cmd_vertex_input(buf, buf->vertex_input != NULL ? 1 : 0, buf->vertex_input);
+    }
+}
+
 void
 vc_cmd_begin_rendering(vc_cmd_record record, vc_rendering_info info)
 {
@@ -290,6 +646,12 @@ vc_cmd_begin_rendering(vc_cmd_record record, vc_rendering_info info)
     }
 
     vkCmdBeginRendering(buf->buffer, &rend_info);
+
+    // Every dynamic state starts from its default
+    buf->render_area            = info.render_area;
+    buf->color_attachment_count = info.color_attachments_count;
+    _vc_cmd_dynamic_state_defaults(buf, _vc_cmd_stale_bits(_vc_cmd_dynamic_states_recorded(buf->record_ctx) ) );
+    buf->stale_dynamic_states = 0;
 }
 
 void
@@ -303,6 +665,11 @@ void
 vc_cmd_draw(vc_cmd_record record, u32 vertex_count, u32 instance_count, u32 first_vertex, u32 first_instance)
 {
     _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(buf->skip_draws)
+    {
+        return;
+    }
+
     vkCmdDraw(buf->buffer, vertex_count, instance_count, first_vertex, first_instance);
 }
 
@@ -310,10 +677,339 @@ void
 vc_cmd_bind_pipeline(vc_cmd_record record, vc_gfx_pipeline pipeline)
 {
     _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    _vc_gfx_pipeline_intern *pipe  = vc_handles_manager_deref(&buf->record_ctx->handles_manager, pipeline);
 
-    VkPipelineBindPoint bind_point = 0;
-    VkPipeline vk_pipeline         = _vc_cmd_generic_pipeline_deref(record, pipeline, &bind_point, NULL, NULL);
+    // The fallback while the pipeline compiles
+    VkPipeline vk_pipeline = _vc_pipeline_bindable(buf->record_ctx, pipe);
+
+    // Draws would use whatever was bound before, they are skipped until a pipeline binds
+    buf->skip_draws = vk_pipeline == VK_NULL_HANDLE;
+    if(buf->skip_draws)
+    {
+        vc_error("Graphics pipeline has nothing to bind (its compilation failed), draws are skipped until the next bind.");
+        return;
+    }
 
     vkCmdBindPipeline(buf->buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
+
+    // The dynamic states are the ones of the pipeline bound, which may be a fallback
+    _vc_gfx_pipeline_intern *bound = pipe;
+    while(vk_pipeline != bound->pipeline && vk_pipeline != bound->linked && bound->fallback != VC_NULL_HANDLE)
+    {
+        bound = vc_handles_manager_deref(&buf->record_ctx->handles_manager, bound->fallback);
+    }
+
+    // States overwritten by a previous pipeline get their defaults back, the ones this pipeline bakes are overwritten
+    vc_dynamic_state_flags dynamic = _vc_cmd_stale_bits(bound->dynamic_states);
+    vc_dynamic_state_flags stale   = buf->stale_dynamic_states & dynamic;
+    if(stale != 0)
+    {
+        _vc_cmd_dynamic_state_defaults(buf, stale);
+    }
+    buf->stale_dynamic_states = _vc_cmd_stale_bits(_vc_cmd_dynamic_states_recorded(buf->record_ctx) ) & ~dynamic;
+}
+
+// ## DYNAMIC STATE
+
+void
+vc_cmd_set_viewport(vc_cmd_record record, u32 viewport_count, const VkViewport *viewports)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_VIEWPORT, "viewports") )
+    {
+        return;
+    }
+
+    vkCmdSetViewportWithCount(buf->buffer, viewport_count, viewports);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_VIEWPORT;
+}
+
+void
+vc_cmd_set_scissor(vc_cmd_record record, u32 scissor_count, const VkRect2D *scissors)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_VIEWPORT, "scissors") )
+    {
+        return;
+    }
+
+    vkCmdSetScissorWithCount(buf->buffer, scissor_count, scissors);
+    buf->stale_dynamic_states &= ~_VC_DYNAMIC_SCISSOR;
+}
+
+void
+vc_cmd_set_cull_mode(vc_cmd_record record, VkCullModeFlags cull_mode, VkFrontFace front_face)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_CULL_MODE, "cull mode") )
+    {
+        return;
+    }
+
+    vkCmdSetCullMode(buf->buffer, cull_mode);
+    vkCmdSetFrontFace(buf->buffer, front_face);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_CULL_MODE;
+}
+
+void
+vc_cmd_set_topology(vc_cmd_record record, VkPrimitiveTopology topology, b8 primitive_restart)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_TOPOLOGY, "topology") )
+    {
+        return;
+    }
+
+    vkCmdSetPrimitiveTopology(buf->buffer, topology);
+    vkCmdSetPrimitiveRestartEnable(buf->buffer, primitive_restart);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_TOPOLOGY;
 }
 
+void
+vc_cmd_set_depth_test(vc_cmd_record record, b8 test, b8 write, VkCompareOp compare_op)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_DEPTH_TEST, "depth test") )
+    {
+        return;
+    }
+
+    vkCmdSetDepthTestEnable(buf->buffer, test);
+    vkCmdSetDepthWriteEnable(buf->buffer, write);
+    vkCmdSetDepthCompareOp(buf->buffer, compare_op);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_DEPTH_TEST;
+}
+
+void
+vc_cmd_set_depth_bounds(vc_cmd_record record, b8 test, f32 min, f32 max)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_DEPTH_BOUNDS, "depth bounds") )
+    {
+        return;
+    }
+
+    vkCmdSetDepthBoundsTestEnable(buf->buffer, test);
+    vkCmdSetDepthBounds(buf->buffer, min, max);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_DEPTH_BOUNDS;
+}
+
+void
+vc_cmd_set_depth_bias(vc_cmd_record record, b8 enable, f32 constant, f32 clamp, f32 slope)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_DEPTH_BIAS, "depth bias") )
+    {
+        return;
+    }
+
+    vkCmdSetDepthBiasEnable(buf->buffer, enable);
+    vkCmdSetDepthBias(buf->buffer, constant, clamp, slope);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_DEPTH_BIAS;
+}
+
+void
+vc_cmd_set_stencil(vc_cmd_record record, b8 test, VkStencilOpState front, VkStencilOpState back)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_STENCIL, "stencil state") )
+    {
+        return;
+    }
+
+    vkCmdSetStencilTestEnable(buf->buffer, test);
+
+    VkStencilOpState faces[2]        = { front, back };
+    VkStencilFaceFlags face_flags[2] = { VK_STENCIL_FACE_FRONT_BIT, VK_STENCIL_FACE_BACK_BIT };
+    for(u32 i = 0; i < 2; i++)
+    {
+        vkCmdSetStencilOp(buf->buffer, face_flags[i], faces[i].failOp, faces[i].passOp, faces[i].depthFailOp, faces[i].compareOp);
+        vkCmdSetStencilCompareMask(buf->buffer, face_flags[i], faces[i].compareMask);
+        vkCmdSetStencilWriteMask(buf->buffer, face_flags[i], faces[i].writeMask);
+        vkCmdSetStencilReference(buf->buffer, face_flags[i], faces[i].reference);
+    }
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_STENCIL;
+}
+
+void
+vc_cmd_set_line_width(vc_cmd_record record, f32 line_width)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_LINE_WIDTH, "line width") )
+    {
+        return;
+    }
+
+    vkCmdSetLineWidth(buf->buffer, line_width);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_LINE_WIDTH;
+}
+
+void
+vc_cmd_set_blend_constants(vc_cmd_record record, const f32 blend_constants[4])
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_BLEND_CONSTANTS, "blend constants") )
+    {
+        return;
+    }
+
+    vkCmdSetBlendConstants(buf->buffer, blend_constants);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_BLEND_CONSTANTS;
+}
+
+void
+vc_cmd_set_polygon_mode(vc_cmd_record record, VkPolygonMode polygon_mode)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_POLYGON_MODE, "polygon mode") )
+    {
+        return;
+    }
+
+    buf->record_ctx->device_functions.cmd_set_polygon_mode(buf->buffer, polygon_mode);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_POLYGON_MODE;
+}
+
+void
+vc_cmd_set_depth_clamp(vc_cmd_record record, b8 enable)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_DEPTH_CLAMP, "depth clamp") )
+    {
+        return;
+    }
+
+    buf->record_ctx->device_functions.cmd_set_depth_clamp_enable(buf->buffer, enable);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_DEPTH_CLAMP;
+}
+
+void
+vc_cmd_set_blend(vc_cmd_record record, u32 first_attachment, u32 attachment_count, const VkPipelineColorBlendAttachmentState *blends)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx_device_functions *fns   = &buf->record_ctx->device_functions;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_BLEND, "blend state") )
+    {
+        return;
+    }
+
+
+    VkBool32 *enables                  = alloca(sizeof(VkBool32) * attachment_count);
+    VkColorBlendEquationEXT *equations = alloca(sizeof(VkColorBlendEquationEXT) * attachment_count);
+    VkColorComponentFlags *masks       = alloca(sizeof(VkColorComponentFlags) * attachment_count);
+    for(u32 i = 0; i < attachment_count; i++)
+    {
+        enables[i]   = blends[i].blendEnable;
+        equations[i] = (VkColorBlendEquationEXT) {
+            .srcColorBlendFactor = blends[i].srcColorBlendFactor,
+            .dstColorBlendFactor = blends[i].dstColorBlendFactor,
+            .colorBlendOp        = blends[i].colorBlendOp,
+            .srcAlphaBlendFactor = blends[i].srcAlphaBlendFactor,
+            .dstAlphaBlendFactor = blends[i].dstAlphaBlendFactor,
+            .alphaBlendOp        = blends[i].alphaBlendOp,
+        };
+        masks[i] = blends[i].colorWriteMask;
+    }
+    fns->cmd_set_color_blend_enable(buf->buffer, first_attachment, attachment_count, enables);
+    fns->cmd_set_color_blend_equation(buf->buffer, first_attachment, attachment_count, equations);
+    fns->cmd_set_color_write_mask(buf->buffer, first_attachment, attachment_count, masks);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_BLEND;
+}
+
+void
+vc_cmd_set_multisample(vc_cmd_record record, VkSampleCountFlagBits sample_count, b8 alpha_to_coverage)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx_device_functions *fns   = &buf->record_ctx->device_functions;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_MULTISAMPLE, "multisample state") )
+    {
+        return;
+    }
+
+
+    // Up to 64 samples
+    VkSampleMask sample_masks[2] = { 0xFFFFFFFF, 0xFFFFFFFF };
+    fns->cmd_set_rasterization_samples(buf->buffer, sample_count);
+    fns->cmd_set_sample_mask(buf->buffer, sample_count, sample_masks);
+    fns->cmd_set_alpha_to_coverage_enable(buf->buffer, alpha_to_coverage);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_MULTISAMPLE;
+}
+
+void
+vc_cmd_set_vertex_input(vc_cmd_record record, u32 binding_count, const vc_vertex_binding *bindings)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    if(!_vc_cmd_dynamic_state_settable(buf, VC_DYNAMIC_VERTEX_INPUT, "vertex input") )
+    {
+        return;
+    }
+
+    _vc_cmd_vertex_input(buf, binding_count, bindings);
+    buf->stale_dynamic_states &= ~VC_DYNAMIC_VERTEX_INPUT;
+}
+
+// ## SHADER OBJECTS
+
+void
+vc_cmd_bind_shaders(vc_cmd_record record, u32 count, const vc_shader *shaders)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx *ctx                    = buf->record_ctx;
+
+    // Graphics stages are bound together, the ones left out are unbound
+    VkShaderStageFlagBits stages[3]       = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_COMPUTE_BIT };
+    VkShaderEXT vk_shaders[3]             = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
+    b8 graphics                           = FALSE;
+    b8 compute                            = FALSE;
+    const vc_vertex_binding *vertex_input = NULL;
+    for(u32 i = 0; i < count; i++)
+    {
+        _vc_shader_intern *shader_i = vc_handles_manager_deref(&ctx->handles_manager, shaders[i]);
+        switch (shader_i->stage)
+        {
+        case VK_SHADER_STAGE_VERTEX_BIT:
+            vk_shaders[0] = shader_i->shader;
+            vertex_input  = shader_i->vertex_input;
+            graphics      = TRUE;
+            break;
+
+        case VK_SHADER_STAGE_FRAGMENT_BIT:
+            vk_shaders[1] = shader_i->shader;
+            graphics      = TRUE;
+            break;
+
+        case VK_SHADER_STAGE_COMPUTE_BIT:
+            vk_shaders[2] = shader_i->shader;
+            compute       = TRUE;
+            break;
+
+        default:
+            vc_error("Only vertex, fragment and compute shaders can be bound.");
+            break;
+        }
+    }
+
+    if(compute)
+    {
+        ctx->device_functions.cmd_bind_shaders(buf->buffer, 1, &stages[2], &vk_shaders[2]);
+    }
+
+    if(graphics)
+    {
+        ctx->device_functions.cmd_bind_shaders(buf->buffer, 2, stages, vk_shaders);
+
+        // Every state is dynamic with shader objects: the ones overwritten by a pipeline get their defaults back, and
+        // the vertex input follows the vertex shader
+        buf->vertex_input = vertex_input;
+        buf->skip_draws   = FALSE;
+        _vc_cmd_dynamic_state_defaults(buf, buf->stale_dynamic_states | VC_DYNAMIC_VERTEX_INPUT);
+        buf->stale_dynamic_states = 0;
+    }
+}
+
+void
+vc_cmd_dispatch(vc_cmd_record record, u32 groups_x, u32 groups_y, u32 groups_z)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vkCmdDispatch(buf->buffer, groups_x, groups_y, groups_z);
+}
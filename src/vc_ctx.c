@@ -10,8 +10,11 @@
 #include "base/base.h"
 #include "base/data_structures/darray.h"
 
+#define _VC_WRITER_ARENA_SIZE (256 * 1024) // Per frame slot, see vc_descriptor_set_writer_init_transient
+
 b8                             vc_priv_check_layers(char **layers, u32 count);
 b8                             vc_priv_check_instance_extensions(char **extensions, u32 count);
+void                           _vc_pipeline_dedup_create(vc_ctx   *ctx);
 VKAPI_ATTR VkBool32 VKAPI_CALL vc_priv_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData);
 
 // "Dynamic" functions
@@ -170,11 +173,30 @@ vc_ctx_create(vc_ctx                *ctx,
     vc_handles_manager_set_destroy_function_usr_data(&ctx->handles_manager, ctx);
 
     // Post init
-    vc_ds_alloc_create(&ctx->ds_allocator, NULL, 0, 16);
+    vc_ds_registry_create(&ctx->ds_registry, NULL, 0);
     vc_slc_create(&ctx->set_layout_cache);
+    vc_ocache_create(&ctx->shader_modules);
+    vc_ocache_create(&ctx->pipeline_layouts);
+    vc_ocache_create(&ctx->shader_reflections);
+    vc_ocache_create(&ctx->reflected_layouts);
+    vc_ocache_create(&ctx->pipeline_libraries);
+    vc_set_cache_create(&ctx->set_cache, 1024);
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        mem_linear_create(&ctx->writer_arenas[i], mem_allocate(_VC_WRITER_ARENA_SIZE, MEMORY_TAG_RENDERER), _VC_WRITER_ARENA_SIZE);
+    }
+    vc_upload_queue_create(&ctx->uploads);
+    vc_readback_pool_create(&ctx->readbacks);
+    ctx->bindless.created          = FALSE; // Created on demand, see vc_bindless_create
+    ctx->descriptor_buffer.created = FALSE; // Created along with the device, if supported
+    ctx->pipeline_cache.cache      = VK_NULL_HANDLE; // Created along with the device
+    vc_pipeline_compiler_create(&ctx->pipeline_compiler);
+    _vc_pipeline_dedup_create(ctx);
+    ctx->optimize_linked_pipelines = TRUE;
 
     // Features
-    
+    ctx->api_version = app_info.apiVersion;
+
     if(app_info.apiVersion >= VK_MAKE_VERSION(1, 3, 0))
     {
         ctx->supported_features.dynamic_rendering = TRUE;
@@ -183,9 +205,25 @@ vc_ctx_create(vc_ctx                *ctx,
     return TRUE;
 }
 
+void _vc_descriptor_sets_handle_changed(vc_ctx *ctx, vc_handle hndl);
+void _vc_pipeline_caches_destroy(vc_ctx   *ctx);
+b8   _vc_pipeline_release(vc_ctx *ctx, vc_handle hndl);
+
 void
 vc_handle_destroy(vc_ctx *ctx, vc_handle hndl)
 {
+    vc_handle_type type = vc_handles_manager_get_type(&ctx->handles_manager, hndl);
+    if(type == VC_HANDLE_IMAGE_VIEW || type == VC_HANDLE_BUFFER || type == VC_HANDLE_SAMPLER)
+    {
+        _vc_descriptor_sets_handle_changed(ctx, hndl);
+    }
+
+    // Pipelines are shared by the users of equal descriptions
+    if( (type == VC_HANDLE_GFX_PIPELINE || type == VC_HANDLE_COMPUTE_PIPELINE) && !_vc_pipeline_release(ctx, hndl) )
+    {
+        return;
+    }
+
     vc_handles_manager_destroy_handle(&ctx->handles_manager, hndl);
 }
 
@@ -201,11 +239,32 @@ vc_ctx_destroy(vc_ctx   *ctx)
         vc_imgui_cleanup(ctx);
     }
 
+    if(ctx->current_device != VK_NULL_HANDLE)
+    {
+        vc_trace("Retiring frames in flight");
+        vc_frames_destroy(&ctx->frames, ctx->current_device);
+        vc_defrag_end(ctx);
+    }
+    vc_upload_queue_destroy(&ctx->uploads, ctx->main_allocator);
+    vc_readback_pool_destroy(&ctx->readbacks, ctx->main_allocator);
+    vc_bindless_destroy(&ctx->bindless, ctx->current_device);
+
     vc_trace("Destroying all objects");
     vc_handles_manager_destroy(&ctx->handles_manager);
+    vc_pipeline_compiler_destroy(&ctx->pipeline_compiler);
 
+    _vc_pipeline_caches_destroy(ctx);
     vc_slc_destroy(&ctx->set_layout_cache, ctx->current_device);
-    vc_ds_alloc_destroy(&ctx->ds_allocator, ctx->current_device);
+    vc_set_cache_destroy(&ctx->set_cache);
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        mem_free(mem_linear_destroy(&ctx->writer_arenas[i]) );
+    }
+    vc_ds_registry_destroy(&ctx->ds_registry, ctx->current_device);
+    vc_descriptor_buffer_destroy(&ctx->descriptor_buffer, ctx->main_allocator);
+
+    vc_pcache_save(&ctx->pipeline_cache, ctx->current_device);
+    vc_pcache_destroy(&ctx->pipeline_cache, ctx->current_device);
 
     // Device destruction
     if(ctx->current_device != VK_NULL_HANDLE)
@@ -0,0 +1,537 @@
+/**
+ * @file
+ * @brief Incremental defragmentation of the GPU memory, built on top of the VMA defragmentation passes.
+ *
+ * Each step begins a VMA pass, recreates the moved buffers/images on their new memory, records the copies and swaps the
+ * objects inside the handles. The pass is ended (and the old objects destroyed) when the frame in which the step was
+ * recorded retires, as the GPU might still be using the old memory until then.
+ */
+
+#include "vulcain.h"
+#include "handles/vc_internal_types.h"
+#include "vc_enum_util.h"
+#include "base/data_structures/darray.h"
+#include <alloca.h>
+
+void _vc_descriptor_sets_handle_changed(vc_ctx *ctx, vc_handle hndl);
+
+void
+_vc_defrag_finish(vc_ctx   *ctx)
+{
+    VmaDefragmentationStats stats =
+    {
+        0
+    };
+
+    vmaEndDefragmentation(ctx->main_allocator, ctx->defrag.vma_ctx, &stats);
+    ctx->defrag.running        = FALSE;
+    ctx->defrag.stop_requested = FALSE;
+    ctx->defrag.vma_ctx        = VK_NULL_HANDLE;
+
+    vc_debug("Defragmentation finished: %u allocations moved (%lu bytes), %u memory blocks freed (%lu bytes).",
+             stats.allocationsMoved, stats.bytesMoved, stats.deviceMemoryBlocksFreed, stats.bytesFreed);
+}
+
+void
+_vc_defrag_pass_destroy(_vc_defrag_pass   *pass)
+{
+    darray_destroy(pass->old_buffers);
+    darray_destroy(pass->old_images);
+    darray_destroy(pass->old_views);
+    mem_free(pass);
+}
+
+// Called when the frame in which the pass was recorded retires
+void
+_vc_defrag_pass_end(vc_ctx *ctx, _vc_defrag_pass *pass)
+{
+    for(u32 i = 0; i < darray_length(pass->old_views); i++)
+    {
+        vkDestroyImageView(ctx->current_device, pass->old_views[i], NULL);
+    }
+
+    for(u32 i = 0; i < darray_length(pass->old_buffers); i++)
+    {
+        vkDestroyBuffer(ctx->current_device, pass->old_buffers[i], NULL);
+    }
+
+    for(u32 i = 0; i < darray_length(pass->old_images); i++)
+    {
+        vkDestroyImage(ctx->current_device, pass->old_images[i], NULL);
+    }
+
+    // Frees the old memory, moved allocations now point to their new place
+    VkResult res = vmaEndDefragmentationPass(ctx->main_allocator, ctx->defrag.vma_ctx, &pass->pass_info);
+
+    ctx->defrag.pending_pass = NULL;
+    _vc_defrag_pass_destroy(pass);
+
+    if(res == VK_SUCCESS || ctx->defrag.stop_requested)
+    {
+        _vc_defrag_finish(ctx);
+    }
+}
+
+b8
+vc_defrag_begin(vc_ctx *ctx, u32 max_moves_per_step, u64 max_bytes_per_step)
+{
+    if(ctx->defrag.running)
+    {
+        vc_warn("A defragmentation is already running.");
+        return FALSE;
+    }
+
+    VmaDefragmentationInfo defrag_i =
+    {
+        .flags                 = 0,
+        .pool                  = VK_NULL_HANDLE,
+        .maxAllocationsPerPass = max_moves_per_step,
+        .maxBytesPerPass       = max_bytes_per_step,
+    };
+
+    VK_CHECKR(vmaBeginDefragmentation(ctx->main_allocator, &defrag_i, &ctx->defrag.vma_ctx), "Could not begin defragmentation.");
+
+    ctx->defrag.running        = TRUE;
+    ctx->defrag.stop_requested = FALSE;
+    ctx->defrag.pending_pass   = NULL;
+
+    return TRUE;
+}
+
+void
+vc_defrag_end(vc_ctx   *ctx)
+{
+    if(!ctx->defrag.running)
+    {
+        return;
+    }
+
+    if(ctx->defrag.pending_pass != NULL)
+    {
+        ctx->defrag.stop_requested = TRUE;
+        return;
+    }
+
+    _vc_defrag_finish(ctx);
+}
+
+b8
+vc_defrag_is_running(vc_ctx   *ctx)
+{
+    return ctx->defrag.running;
+}
+
+void
+vc_defrag_set_moved_callback(vc_ctx *ctx, vc_defrag_moved_func func, void *usr_data)
+{
+    ctx->defrag.moved_callback = func;
+    ctx->defrag.moved_usr_data = usr_data;
+}
+
+// Returns TRUE if the allocation is part of the pending pass, whatever its operation, and marks its move destroyed:
+// VMA then frees it (with its new place) at the end of the pass.
+b8
+_vc_defrag_abandon(vc_ctx *ctx, VmaAllocation alloc)
+{
+    _vc_defrag_pass *pass = ctx->defrag.pending_pass;
+    if(pass == NULL)
+    {
+        return FALSE;
+    }
+
+    for(u32 i = 0; i < pass->pass_info.moveCount; i++)
+    {
+        VmaDefragmentationMove *move = &pass->pass_info.pMoves[i];
+        if(move->srcAllocation == alloc)
+        {
+            move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+// Called by the buffer destroy function. Returns TRUE if the allocation belongs to the pending pass, in which case the
+// buffer is destroyed with the pass, as the recorded copy may still be reading or writing it.
+b8
+_vc_defrag_release_buffer(vc_ctx *ctx, VmaAllocation alloc, VkBuffer buffer)
+{
+    if(!_vc_defrag_abandon(ctx, alloc) )
+    {
+        return FALSE;
+    }
+
+    darray_push(ctx->defrag.pending_pass->old_buffers, buffer);
+    return TRUE;
+}
+
+// Same as _vc_defrag_release_buffer, for images
+b8
+_vc_defrag_release_image(vc_ctx *ctx, VmaAllocation alloc, VkImage image)
+{
+    if(!_vc_defrag_abandon(ctx, alloc) )
+    {
+        return FALSE;
+    }
+
+    darray_push(ctx->defrag.pending_pass->old_images, image);
+    return TRUE;
+}
+
+void
+_vc_defrag_notify(vc_ctx *ctx, vc_handle moved)
+{
+    _vc_descriptor_sets_handle_changed(ctx, moved);
+
+    if(ctx->defrag.moved_callback != NULL)
+    {
+        ctx->defrag.moved_callback(ctx->defrag.moved_usr_data, moved);
+    }
+}
+
+// Recreates the buffer on the new memory, and records its copy
+b8
+_vc_defrag_move_buffer(vc_ctx *ctx, _vc_defrag_pass *pass, VkCommandBuffer cmd, VmaDefragmentationMove *move, vc_buffer hndl)
+{
+    _vc_buffer_intern *buf = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+
+    // Device addresses may be stored anywhere on the GPU, they cannot change. Bindless descriptors may be in use by frames in flight.
+    VkBufferUsageFlags transfer = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if( (buf->usage & transfer) != transfer || buf->address != 0 || buf->bindless_refs > 0 )
+    {
+        return FALSE;
+    }
+
+    VkBufferCreateInfo buf_ci =
+    {
+        .sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size        = buf->size,
+        .flags       = buf->flags,
+        .usage       = buf->usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    VkBuffer new_buffer = VK_NULL_HANDLE;
+    VK_CHECKR(vkCreateBuffer(ctx->current_device, &buf_ci, NULL, &new_buffer), "Could not create a buffer to defragment into.");
+
+    if(vmaBindBufferMemory(ctx->main_allocator, move->dstTmpAllocation, new_buffer) != VK_SUCCESS)
+    {
+        vc_error("Could not bind a moved buffer.");
+        vkDestroyBuffer(ctx->current_device, new_buffer, NULL);
+        return FALSE;
+    }
+
+    VkBufferCopy region =
+    {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size      = buf->size,
+    };
+    vkCmdCopyBuffer(cmd, buf->buffer, new_buffer, 1, &region);
+
+    darray_push(pass->old_buffers, buf->buffer);
+    buf->buffer = new_buffer;
+
+    return TRUE;
+}
+
+// Recreates the image on the new memory. Copies are recorded later, once all layout transitions are known.
+b8
+_vc_defrag_create_image(vc_ctx *ctx, VmaDefragmentationMove *move, vc_image hndl, VkImage *new_image)
+{
+    _vc_image_intern *img = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+
+    if(img->externally_managed || img->resting_layout == VK_IMAGE_LAYOUT_UNDEFINED || img->bindless_refs > 0)
+    {
+        return FALSE;
+    }
+
+    VK_CHECKR(vkCreateImage(ctx->current_device, &img->create_info, NULL, new_image), "Could not create an image to defragment into.");
+
+    if(vmaBindImageMemory(ctx->main_allocator, move->dstTmpAllocation, *new_image) != VK_SUCCESS)
+    {
+        vc_error("Could not bind a moved image.");
+        vkDestroyImage(ctx->current_device, *new_image, NULL);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+_vc_defrag_record_image_copy(VkCommandBuffer cmd, _vc_image_intern *img, VkImage new_image)
+{
+    VkImageAspectFlags aspects = vc_format_get_aspects(img->image_format);
+    VkExtent3D extent          = img->create_info.extent;
+    u32 mip_count              = img->create_info.mipLevels;
+
+    VkImageCopy *regions = alloca(sizeof(VkImageCopy) * mip_count);
+    for(u32 i = 0; i < mip_count; i++)
+    {
+        VkImageSubresourceLayers layers =
+        {
+            .aspectMask     = aspects,
+            .mipLevel       = i,
+            .baseArrayLayer = 0,
+            .layerCount     = img->create_info.arrayLayers,
+        };
+
+        regions[i] = (VkImageCopy)
+        {
+            .srcSubresource = layers,
+            .dstSubresource = layers,
+            .extent         = (VkExtent3D)
+            {
+                .width  = (extent.width >> i) > 0 ? (extent.width >> i) : 1,
+                .height = (extent.height >> i) > 0 ? (extent.height >> i) : 1,
+                .depth  = (extent.depth >> i) > 0 ? (extent.depth >> i) : 1,
+            },
+        };
+    }
+
+    vkCmdCopyImage(cmd,
+                   img->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   new_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   mip_count, regions);
+}
+
+VkImageMemoryBarrier
+_vc_defrag_image_barrier(_vc_image_intern *img, VkImage image,
+                         VkAccessFlags src_access, VkAccessFlags dst_access,
+                         VkImageLayout old_layout, VkImageLayout new_layout)
+{
+    return (VkImageMemoryBarrier)
+           {
+               .sType         = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+               .image         = image,
+
+               .srcAccessMask = src_access,
+               .dstAccessMask = dst_access,
+
+               .oldLayout = old_layout,
+               .newLayout = new_layout,
+
+               .subresourceRange    = (VkImageSubresourceRange)
+               {
+                   .aspectMask     = vc_format_get_aspects(img->image_format),
+                   .baseMipLevel   = 0,
+                   .levelCount     = VK_REMAINING_MIP_LEVELS,
+                   .baseArrayLayer = 0,
+                   .layerCount     = VK_REMAINING_ARRAY_LAYERS,
+               },
+
+               .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+               .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+           };
+}
+
+// Recreates all the views of a moved image, and adds them to the moved views
+void
+_vc_defrag_recreate_views(vc_ctx *ctx, _vc_defrag_pass *pass, vc_image image, vc_image_view **moved_views)
+{
+    _vc_image_intern *img = vc_handles_manager_deref(&ctx->handles_manager, image);
+
+    u32 count = darray_length(ctx->handles_manager.destroy_queue);
+    for(u32 i = 0; i < count; i++)
+    {
+        vc_handle hndl = ctx->handles_manager.destroy_queue[i];
+        if(vc_handles_manager_get_type(&ctx->handles_manager, hndl) != VC_HANDLE_IMAGE_VIEW)
+        {
+            continue;
+        }
+
+        _vc_image_view_intern *view = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+        if(view->image != image)
+        {
+            continue;
+        }
+
+        view->create_info.image = img->image;
+
+        VkImageView new_view = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateImageView(ctx->current_device, &view->create_info, NULL, &new_view), "Could not recreate a moved image view.");
+
+        darray_push(pass->old_views, view->view);
+        view->view = new_view;
+
+        darray_push(*moved_views, hndl);
+    }
+}
+
+b8
+vc_cmd_defrag_step(vc_cmd_record    record)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx *ctx                    = buf->record_ctx;
+
+    if(!ctx->defrag.running || ctx->defrag.pending_pass != NULL)
+    {
+        return FALSE;
+    }
+
+    _vc_defrag_pass *pass = mem_allocate(sizeof(_vc_defrag_pass), MEMORY_TAG_RENDERER);
+    pass->pass_info   = (VmaDefragmentationPassMoveInfo)
+    {
+        0
+    };
+    pass->old_buffers = darray_create(VkBuffer);
+    pass->old_images  = darray_create(VkImage);
+    pass->old_views   = darray_create(VkImageView);
+
+    VkResult res = vmaBeginDefragmentationPass(ctx->main_allocator, ctx->defrag.vma_ctx, &pass->pass_info);
+    if(res != VK_INCOMPLETE)
+    {
+        // VK_SUCCESS means nothing is left to move
+        _vc_defrag_pass_destroy(pass);
+        VK_CHECK(res, "Could not begin a defragmentation pass.");
+        _vc_defrag_finish(ctx);
+        return FALSE;
+    }
+
+    u32 move_count = pass->pass_info.moveCount;
+
+    // Images are only recreated in the first loop, as their copies need to be surrounded by layout transitions
+    vc_image *moved_images              = darray_create(vc_image);
+    VkImage *new_images                 = darray_create(VkImage);
+    VkImageMemoryBarrier *pre_barriers  = darray_create(VkImageMemoryBarrier);
+    VkImageMemoryBarrier *post_barriers = darray_create(VkImageMemoryBarrier);
+    vc_image_view *moved_views          = darray_create(vc_image_view);
+
+    // Every write to the moved ressources must be done before copying
+    VkMemoryBarrier pre_mem_barrier =
+    {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &pre_mem_barrier, 0, NULL, 0, NULL);
+
+    // Worker threads may read the swapped objects (descriptor writes), or create views while they are recreated
+    pthread_mutex_lock(&ctx->handles_manager.lock);
+
+    u32 moved_count = 0;
+    for(u32 i = 0; i < move_count; i++)
+    {
+        VmaDefragmentationMove *move = &pass->pass_info.pMoves[i];
+
+        VmaAllocationInfo alloc_info;
+        vmaGetAllocationInfo(ctx->main_allocator, move->srcAllocation, &alloc_info);
+        vc_handle hndl = (vc_handle)alloc_info.pUserData;
+
+        // Host visible allocations may be mapped by the application, so they stay in place
+        VkMemoryPropertyFlags mem_props = 0;
+        vmaGetAllocationMemoryProperties(ctx->main_allocator, move->srcAllocation, &mem_props);
+
+        b8 moved = FALSE;
+        if(hndl != VC_NULL_HANDLE && !(mem_props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) )
+        {
+            switch (vc_handles_manager_get_type(&ctx->handles_manager, hndl))
+            {
+            case VC_HANDLE_BUFFER:
+                moved = _vc_defrag_move_buffer(ctx, pass, buf->buffer, move, hndl);
+                break;
+
+            case VC_HANDLE_IMAGE:
+            {
+                VkImage new_image = VK_NULL_HANDLE;
+                moved = _vc_defrag_create_image(ctx, move, hndl, &new_image);
+                if(moved)
+                {
+                    _vc_image_intern *img = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+
+                    VkImageMemoryBarrier old_bar = _vc_defrag_image_barrier(img, img->image, 0, VK_ACCESS_TRANSFER_READ_BIT, img->resting_layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+                    VkImageMemoryBarrier new_bar = _vc_defrag_image_barrier(img, new_image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+                    VkImageMemoryBarrier rest_bar = _vc_defrag_image_barrier(img, new_image, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, img->resting_layout);
+
+                    darray_push(pre_barriers, old_bar);
+                    darray_push(pre_barriers, new_bar);
+                    darray_push(post_barriers, rest_bar);
+                    darray_push(moved_images, hndl);
+                    darray_push(new_images, new_image);
+                }
+                break;
+            }
+
+            default:
+                break;
+            }
+        }
+
+        if(moved)
+        {
+            moved_count++;
+        }
+        else
+        {
+            move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        }
+    }
+
+    // Images
+    u32 image_count = darray_length(moved_images);
+    if(image_count > 0)
+    {
+        vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, darray_length(pre_barriers), pre_barriers);
+
+        for(u32 i = 0; i < image_count; i++)
+        {
+            _vc_image_intern *img = vc_handles_manager_deref(&ctx->handles_manager, moved_images[i]);
+            _vc_defrag_record_image_copy(buf->buffer, img, new_images[i]);
+
+            darray_push(pass->old_images, img->image);
+            img->image = new_images[i];
+
+            _vc_defrag_recreate_views(ctx, pass, moved_images[i], &moved_views);
+        }
+
+        vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, darray_length(post_barriers), post_barriers);
+    }
+
+    pthread_mutex_unlock(&ctx->handles_manager.lock);
+
+    // The moved ressources can be used by the rest of the frame
+    VkMemoryBarrier post_mem_barrier =
+    {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &post_mem_barrier, 0, NULL, 0, NULL);
+
+    // Notify once every object has been swapped, outside of the handles lock as notifications take the set cache lock
+    for(u32 i = 0; i < darray_length(moved_views); i++)
+    {
+        _vc_defrag_notify(ctx, moved_views[i]);
+    }
+    for(u32 i = 0; i < move_count; i++)
+    {
+        VmaDefragmentationMove *move = &pass->pass_info.pMoves[i];
+        if(move->operation != VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+        {
+            continue;
+        }
+
+        VmaAllocationInfo alloc_info;
+        vmaGetAllocationInfo(ctx->main_allocator, move->srcAllocation, &alloc_info);
+        _vc_defrag_notify(ctx, (vc_handle)alloc_info.pUserData);
+    }
+
+    darray_destroy(moved_images);
+    darray_destroy(moved_views);
+    darray_destroy(new_images);
+    darray_destroy(pre_barriers);
+    darray_destroy(post_barriers);
+
+    if(moved_count == 0)
+    {
+        // Nothing was recorded, the pass can end right away
+        _vc_defrag_pass_end(ctx, pass);
+        return FALSE;
+    }
+
+    ctx->defrag.pending_pass = pass;
+    vc_frames_defer(&ctx->frames, (vc_frame_retire_func)_vc_defrag_pass_end, pass);
+
+    return TRUE;
+}
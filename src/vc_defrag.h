@@ -0,0 +1,46 @@
+#ifndef __VC_DEFRAG__
+#define __VC_DEFRAG__
+
+/*
+ * Incremental GPU memory defragmentation.
+ * Since buffers and images are only ever reached through handles, their allocation can be moved without the application
+ * noticing: the copies are recorded into a command buffer, and the Vulkan objects referenced by the handles are swapped.
+ * Old objects (and the old memory) are released when the frame in which the copies were recorded retires.
+ */
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include "handles/vc_handles.h"
+
+/**
+ * @brief Function called when the Vulkan object behind a handle changes because of a move
+ *
+ * @param usr_data The user data given with the callback
+ * @param moved The buffer, image or image view handle whose underlying object changed
+ * @note Descriptor sets referencing the handle must be rewritten before their next use. The old objects remain valid until
+ *       the frame in which the move was recorded retires.
+ */
+typedef void (*vc_defrag_moved_func)(void *usr_data, vc_handle moved);
+
+typedef struct
+{
+    VmaDefragmentationPassMoveInfo    pass_info;
+
+    // Objects replaced during this pass, or destroyed while it was pending, destroyed once the pass retires
+    VkBuffer                         *old_buffers; // darray
+    VkImage                          *old_images; // darray
+    VkImageView                      *old_views; // darray
+} _vc_defrag_pass;
+
+typedef struct
+{
+    b8                           running;
+    b8                           stop_requested;
+    VmaDefragmentationContext    vma_ctx;
+    _vc_defrag_pass             *pending_pass; // The pass awaiting retirement, if any
+
+    vc_defrag_moved_func         moved_callback;
+    void                        *moved_usr_data;
+} vc_defrag_state;
+
+#endif // __VC_DEFRAG__
@@ -8,6 +8,19 @@
 
 
 // db prefix stands for device builder
+
+// Feature structures of the optional features, chained into the device create info
+typedef struct
+{
+    VkPhysicalDeviceFeatures                                base; // Core features, passed as pEnabledFeatures
+    VkPhysicalDeviceBufferDeviceAddressFeatures             bda;
+    VkPhysicalDeviceDescriptorIndexingFeatures              indexing;
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT             descriptor_buffer;
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT      graphics_pipeline_library;
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT        extended_dynamic_state3;
+    VkPhysicalDeviceShaderObjectFeaturesEXT                 shader_object;
+} _vc_db_optional_features;
+
 typedef struct
 {
     vc_queue        hndl;
@@ -30,6 +43,10 @@ typedef struct
     char                      **extension_requests;  // darray
     vc_queue                   *presentation_dest;
     vc_windowing_system         win_sys;
+    char                       *pipeline_cache_path; // NULL if the pipeline cache is not persisted
+
+    _vc_db_optional_features    optional_features;
+    b8                          push_descriptor_available; // The extension is enabled, even if descriptor buffers are used instead
 } _vc_db;
 
 // Represents a simple system, to allocate queues based on requests
@@ -48,7 +65,10 @@ _vc_queue_allocator _vc_db_queue_allocator_init(VkPhysicalDevice    dev);
 void                _vc_db_queue_allocator_produce_ci(_vc_queue_allocator *alloc, VkDeviceQueueCreateInfo **queue_darray);
 b8                  _vc_db_queue_allocator_enable_present(_vc_queue_allocator *alloc, VkSurfaceKHR surface, u32 *family, u32 *index);
 b8                  _vc_device_creation_physcial_device_supports_extensions(VkPhysicalDevice device, char **extensions, u32 ext_count);
+void                _vc_db_enable_optional_features(_vc_db *device_builder, VkPhysicalDevice phy, VkBaseOutStructure *chain_tail);
+void                _vc_db_load_device_functions(vc_ctx   *ctx);
 void                _vc_setup_vma(vc_ctx   *ctx);
+u32                 _vc_db_device_api_version(vc_ctx *ctx, VkPhysicalDevice phy);
 
 i32
 _vc_device_creation_queue_comp(VkQueueFlags *a, VkQueueFlagBits *b)
@@ -72,10 +92,12 @@ vc_device_builder_begin(vc_ctx   *ctx)
     // On heap, object wont live long
     _vc_db *device_builder = mem_allocate(sizeof(_vc_db), MEMORY_TAG_RENDER_DATA);
 
-    device_builder->ctx                = ctx;
-    device_builder->queue_requests     = darray_create(_vc_db_queue_request);
-    device_builder->extension_requests = darray_create(char *);
-    device_builder->presentation_dest  = VC_NULL_HANDLE;
+    device_builder->ctx                       = ctx;
+    device_builder->queue_requests            = darray_create(_vc_db_queue_request);
+    device_builder->extension_requests        = darray_create(char *);
+    device_builder->presentation_dest         = VC_NULL_HANDLE;
+    device_builder->pipeline_cache_path       = NULL;
+    device_builder->push_descriptor_available = FALSE;
     return device_builder;
 }
 
@@ -297,10 +319,13 @@ vc_device_builder_end(vc_device_builder    builder)
 
     VkPhysicalDeviceDynamicRenderingFeatures feat =
     {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+        .sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
         .dynamicRendering = VK_TRUE,
     };
 
+    // Chains the features that are enabled when available, may request extensions
+    _vc_db_enable_optional_features(device_builder, selected_phy, (VkBaseOutStructure *)&feat);
+
     VkDeviceCreateInfo device_ci =
     {
         .sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
@@ -311,7 +336,7 @@ vc_device_builder_end(vc_device_builder    builder)
         .ppEnabledLayerNames     = NULL,
         .enabledExtensionCount   = darray_length(device_builder->extension_requests),
         .ppEnabledExtensionNames = (const char **)device_builder->extension_requests,
-        .pEnabledFeatures        = NULL,
+        .pEnabledFeatures        = &device_builder->optional_features.base,
     };
 
     VkDevice device = VK_NULL_HANDLE;
@@ -387,10 +412,35 @@ vc_device_builder_end(vc_device_builder    builder)
         vkDestroySurfaceKHR(device_builder->ctx->vk_instance, dummy_surface, NULL);
     }
 
+    vc_ctx *ctx               = device_builder->ctx;
+    char *pipeline_cache_path = device_builder->pipeline_cache_path;
+    b8 push_descriptor        = device_builder->push_descriptor_available;
     mem_free(device_builder);
     vc_trace("Device creation finished.");
     vc_debug("Create vulkan memory allocator");
-    _vc_setup_vma(device_builder->ctx);
+    _vc_db_load_device_functions(ctx);
+    _vc_setup_vma(ctx);
+
+    if(ctx->supported_features.descriptor_buffer &&
+       !vc_descriptor_buffer_create(&ctx->descriptor_buffer, ctx->current_physical_device, device, ctx->main_allocator, ctx->device_functions.get_buffer_device_address))
+    {
+        vc_warn("Falling back to descriptor pools.");
+        ctx->supported_features.descriptor_buffer = FALSE;
+
+        // Push descriptors were only left out for the descriptor buffer
+        ctx->supported_features.push_descriptor = push_descriptor;
+        _vc_db_load_device_functions(ctx);
+        vc_debug("\tpush_descriptor: %s", push_descriptor ? "enabled" : "unsupported");
+    }
+
+    vc_debug("Create pipeline cache");
+    vc_pcache_create(&ctx->pipeline_cache, ctx->current_physical_device, device, _vc_db_device_api_version(ctx, ctx->current_physical_device), pipeline_cache_path);
+    if(pipeline_cache_path != NULL)
+    {
+        mem_free(pipeline_cache_path);
+    }
+
+    vc_frames_create(&ctx->frames, device, ctx);
 }
 
 /**
@@ -452,6 +502,23 @@ vc_device_builder_request_extension(vc_device_builder builder, const char *exten
     darray_push(device_builder->extension_requests, dest);
 }
 
+void
+vc_device_builder_set_pipeline_cache_file(vc_device_builder builder, const char *path)
+{
+    _vc_db *device_builder = builder;
+    if(device_builder->pipeline_cache_path != NULL)
+    {
+        mem_free(device_builder->pipeline_cache_path);
+    }
+
+    u64 path_length = strlen(path);
+    char *dest      = mem_allocate(path_length + 1, MEMORY_TAG_RENDERER);
+    mem_memcpy( dest, (void *)path, path_length );
+    dest[path_length] = '\0';
+
+    device_builder->pipeline_cache_path = dest;
+}
+
 void
 vc_device_builder_set_score_func(vc_device_builder builder, vc_device_score_function func, void *usr_data)
 {
@@ -629,10 +696,16 @@ _vc_setup_vma(vc_ctx   *ctx)
         .vkGetDeviceProcAddr   = &vkGetDeviceProcAddr,
     };
 
+    VmaAllocatorCreateFlags flags = 0;
+    if(ctx->supported_features.buffer_device_address)
+    {
+        flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    }
+
     VmaAllocatorCreateInfo vma_ci =
     {
-        .flags            = 0,
-        .vulkanApiVersion = VK_API_VERSION_1_1,
+        .flags            = flags,
+        .vulkanApiVersion = _vc_db_device_api_version(ctx, ctx->current_physical_device),
         .physicalDevice   = ctx->current_physical_device,
         .device           = ctx->current_device,
         .instance         = ctx->vk_instance,
@@ -642,3 +715,391 @@ _vc_setup_vma(vc_ctx   *ctx)
     vmaCreateAllocator(&vma_ci, &ctx->main_allocator);
 }
 
+// Returns the Vulkan version usable with a device: the lowest of the instance's and the device's.
+u32
+_vc_db_device_api_version(vc_ctx *ctx, VkPhysicalDevice phy)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(phy, &props);
+
+    return props.apiVersion < ctx->api_version ? props.apiVersion : ctx->api_version;
+}
+
+b8
+_vc_db_extension_requested(_vc_db *device_builder, const char *extension_name)
+{
+    for(u32 i = 0; i < darray_length(device_builder->extension_requests); i++)
+    {
+        if(strcmp(device_builder->extension_requests[i], extension_name) == 0)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Appends a structure to a pNext chain, and returns the new tail
+VkBaseOutStructure *
+_vc_db_chain_append(VkBaseOutStructure *tail, void *structure)
+{
+    tail->pNext = structure;
+    return structure;
+}
+
+// Wether a feature structure can be chained for a device: core in its version (never if 0), or provided by an extension
+b8
+_vc_db_feature_available(VkPhysicalDevice phy, u32 api_version, u32 core_version, char *extension)
+{
+    if(core_version != 0 && api_version >= core_version)
+    {
+        return TRUE;
+    }
+    return _vc_device_creation_physcial_device_supports_extensions(phy, &extension, 1);
+}
+
+/**
+ * @brief Enables the features vulcain can make use of, when the selected device supports them.
+ *        The corresponding supported_features flags are set in the context.
+ *
+ * @param device_builder The device builder
+ * @param phy The selected physical device
+ * @param chain_tail The last structure of the device create info pNext chain
+ */
+void
+_vc_db_enable_optional_features(_vc_db *device_builder, VkPhysicalDevice phy, VkBaseOutStructure *chain_tail)
+{
+    vc_ctx *ctx                     = device_builder->ctx;
+    _vc_db_optional_features *feats = &device_builder->optional_features;
+    u32 api_version                 = _vc_db_device_api_version(ctx, phy);
+
+    vc_debug("Optional features :");
+
+    // -- Sampler anisotropy (core, in the base features)
+    {
+        VkPhysicalDeviceFeatures base_supported;
+        vkGetPhysicalDeviceFeatures(phy, &base_supported);
+
+        feats->base = (VkPhysicalDeviceFeatures)
+        {
+            .samplerAnisotropy = base_supported.samplerAnisotropy,
+        };
+
+        ctx->supported_features.sampler_anisotropy = base_supported.samplerAnisotropy;
+        vc_debug("\tsampler_anisotropy: %s", base_supported.samplerAnisotropy ? "enabled" : "unsupported");
+    }
+
+    if(api_version < VK_API_VERSION_1_1)
+    {
+        vc_debug("Device does not support Vulkan 1.1, optional features are disabled.");
+        return;
+    }
+
+    // Query what the device supports, the structures of features neither core nor provided by an extension of the
+    // device are left out of the query (and stay zeroed)
+    _vc_db_optional_features supported =
+    {
+        .bda =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+        },
+        .indexing =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+        },
+        .descriptor_buffer =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+        },
+        .graphics_pipeline_library =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+        },
+        .extended_dynamic_state3 =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+        },
+        .shader_object =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT,
+        },
+    };
+
+    VkPhysicalDeviceFeatures2 features =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    };
+    VkBaseOutStructure *query_tail = (VkBaseOutStructure *)&features;
+    if(_vc_db_feature_available(phy, api_version, VK_API_VERSION_1_2, "VK_KHR_buffer_device_address") )
+    {
+        query_tail = _vc_db_chain_append(query_tail, &supported.bda);
+    }
+    if(_vc_db_feature_available(phy, api_version, VK_API_VERSION_1_2, "VK_EXT_descriptor_indexing") )
+    {
+        query_tail = _vc_db_chain_append(query_tail, &supported.indexing);
+    }
+    if(_vc_db_feature_available(phy, api_version, 0, "VK_EXT_descriptor_buffer") )
+    {
+        query_tail = _vc_db_chain_append(query_tail, &supported.descriptor_buffer);
+    }
+    if(_vc_db_feature_available(phy, api_version, 0, "VK_EXT_graphics_pipeline_library") )
+    {
+        query_tail = _vc_db_chain_append(query_tail, &supported.graphics_pipeline_library);
+    }
+    if(_vc_db_feature_available(phy, api_version, 0, "VK_EXT_extended_dynamic_state3") )
+    {
+        query_tail = _vc_db_chain_append(query_tail, &supported.extended_dynamic_state3);
+    }
+    if(_vc_db_feature_available(phy, api_version, 0, "VK_EXT_shader_object") )
+    {
+        query_tail = _vc_db_chain_append(query_tail, &supported.shader_object);
+    }
+    vkGetPhysicalDeviceFeatures2(phy, &features);
+
+    // -- Buffer device address (core in 1.2)
+    {
+        char *ext        = "VK_KHR_buffer_device_address";
+        b8 core          = api_version >= VK_API_VERSION_1_2;
+        b8 ext_supported = _vc_device_creation_physcial_device_supports_extensions(phy, &ext, 1);
+        b8 enable        = supported.bda.bufferDeviceAddress && (core || ext_supported);
+
+        if(enable)
+        {
+            if(!core && !_vc_db_extension_requested(device_builder, ext))
+            {
+                vc_device_builder_request_extension(device_builder, ext);
+            }
+
+            feats->bda = (VkPhysicalDeviceBufferDeviceAddressFeatures)
+            {
+                .sType               = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+                .bufferDeviceAddress = VK_TRUE,
+            };
+            chain_tail = _vc_db_chain_append(chain_tail, &feats->bda);
+        }
+
+        ctx->supported_features.buffer_device_address = enable;
+        vc_debug("\tbuffer_device_address: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Descriptor indexing (core in 1.2), only the parts needed by the bindless heap
+    {
+        char *ext                                      = "VK_EXT_descriptor_indexing";
+        b8 core                                        = api_version >= VK_API_VERSION_1_2;
+        b8 ext_supported                               = _vc_device_creation_physcial_device_supports_extensions(phy, &ext, 1);
+        VkPhysicalDeviceDescriptorIndexingFeatures *sp = &supported.indexing;
+        b8 enable                                      = (core || ext_supported) &&
+                                                         sp->runtimeDescriptorArray &&
+                                                         sp->descriptorBindingPartiallyBound &&
+                                                         sp->descriptorBindingUpdateUnusedWhilePending &&
+                                                         sp->descriptorBindingSampledImageUpdateAfterBind &&
+                                                         sp->descriptorBindingStorageImageUpdateAfterBind &&
+                                                         sp->descriptorBindingStorageBufferUpdateAfterBind;
+
+        if(enable)
+        {
+            if(!core && !_vc_db_extension_requested(device_builder, ext))
+            {
+                vc_device_builder_request_extension(device_builder, ext);
+            }
+
+            feats->indexing = (VkPhysicalDeviceDescriptorIndexingFeatures)
+            {
+                .sType                                         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+                .runtimeDescriptorArray                        = VK_TRUE,
+                .descriptorBindingPartiallyBound               = VK_TRUE,
+                .descriptorBindingUpdateUnusedWhilePending     = VK_TRUE,
+                .descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE,
+                .descriptorBindingStorageImageUpdateAfterBind  = VK_TRUE,
+                .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+
+                // Lets shaders index with per invocation values (nonuniformEXT)
+                .shaderSampledImageArrayNonUniformIndexing  = sp->shaderSampledImageArrayNonUniformIndexing,
+                .shaderStorageImageArrayNonUniformIndexing  = sp->shaderStorageImageArrayNonUniformIndexing,
+                .shaderStorageBufferArrayNonUniformIndexing = sp->shaderStorageBufferArrayNonUniformIndexing,
+            };
+            chain_tail = _vc_db_chain_append(chain_tail, &feats->indexing);
+        }
+
+        ctx->supported_features.descriptor_indexing = enable;
+        vc_debug("\tdescriptor_indexing: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Descriptor buffer, replaces descriptor pools and sets when available (descriptors are written at buffer addresses)
+    {
+        char *ext = "VK_EXT_descriptor_buffer";
+        b8 enable = ctx->supported_features.buffer_device_address &&
+                    supported.descriptor_buffer.descriptorBuffer &&
+                    _vc_device_creation_physcial_device_supports_extensions(phy, &ext, 1);
+
+        if(enable)
+        {
+            if(!_vc_db_extension_requested(device_builder, ext))
+            {
+                vc_device_builder_request_extension(device_builder, ext);
+            }
+
+            feats->descriptor_buffer = (VkPhysicalDeviceDescriptorBufferFeaturesEXT)
+            {
+                .sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+                .descriptorBuffer = VK_TRUE,
+            };
+            chain_tail = _vc_db_chain_append(chain_tail, &feats->descriptor_buffer);
+        }
+
+        ctx->supported_features.descriptor_buffer = enable;
+        vc_debug("\tdescriptor_buffer: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Push descriptors (extension only, no feature structure), not used along with descriptor buffers. The extension
+    // is still enabled, in case the descriptor buffer cannot be created and descriptor pools are used instead.
+    {
+        char *ext    = "VK_KHR_push_descriptor";
+        b8 available = _vc_device_creation_physcial_device_supports_extensions(phy, &ext, 1);
+        b8 enable    = available && !ctx->supported_features.descriptor_buffer;
+
+        if(available && !_vc_db_extension_requested(device_builder, ext))
+        {
+            vc_device_builder_request_extension(device_builder, ext);
+        }
+
+        device_builder->push_descriptor_available = available;
+        ctx->supported_features.push_descriptor   = enable;
+        vc_debug("\tpush_descriptor: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Graphics pipeline libraries, graphics pipelines are then fast-linked from separately compiled parts
+    {
+        char *exts[2] = { "VK_KHR_pipeline_library", "VK_EXT_graphics_pipeline_library" };
+        b8 enable     = supported.graphics_pipeline_library.graphicsPipelineLibrary &&
+                        _vc_device_creation_physcial_device_supports_extensions(phy, exts, 2);
+
+        if(enable)
+        {
+            for(u32 i = 0; i < 2; i++)
+            {
+                if(!_vc_db_extension_requested(device_builder, exts[i]))
+                {
+                    vc_device_builder_request_extension(device_builder, exts[i]);
+                }
+            }
+
+            feats->graphics_pipeline_library = (VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT)
+            {
+                .sType                   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+                .graphicsPipelineLibrary = VK_TRUE,
+            };
+            chain_tail = _vc_db_chain_append(chain_tail, &feats->graphics_pipeline_library);
+        }
+
+        ctx->supported_features.graphics_pipeline_library = enable;
+        vc_debug("\tgraphics_pipeline_library: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Extended dynamic state 1 and 2, core in 1.3 (only their required parts are used, no feature to enable)
+    {
+        b8 enable = api_version >= VK_API_VERSION_1_3;
+
+        ctx->supported_features.extended_dynamic_state = enable;
+        vc_debug("\textended_dynamic_state: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Extended dynamic state 3, only the states of vc_dynamic_state_flags
+    {
+        char *ext                                            = "VK_EXT_extended_dynamic_state3";
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT *sp = &supported.extended_dynamic_state3;
+        b8 enable                                            = ctx->supported_features.extended_dynamic_state &&
+                                                               sp->extendedDynamicState3PolygonMode &&
+                                                               sp->extendedDynamicState3DepthClampEnable &&
+                                                               sp->extendedDynamicState3ColorBlendEnable &&
+                                                               sp->extendedDynamicState3ColorBlendEquation &&
+                                                               sp->extendedDynamicState3ColorWriteMask &&
+                                                               _vc_device_creation_physcial_device_supports_extensions(phy, &ext, 1);
+
+        if(enable)
+        {
+            if(!_vc_db_extension_requested(device_builder, ext))
+            {
+                vc_device_builder_request_extension(device_builder, ext);
+            }
+
+            feats->extended_dynamic_state3 = (VkPhysicalDeviceExtendedDynamicState3FeaturesEXT)
+            {
+                .sType                                   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+                .extendedDynamicState3PolygonMode        = VK_TRUE,
+                .extendedDynamicState3DepthClampEnable   = VK_TRUE,
+                .extendedDynamicState3ColorBlendEnable   = VK_TRUE,
+                .extendedDynamicState3ColorBlendEquation = VK_TRUE,
+                .extendedDynamicState3ColorWriteMask     = VK_TRUE,
+            };
+            chain_tail = _vc_db_chain_append(chain_tail, &feats->extended_dynamic_state3);
+        }
+
+        ctx->supported_features.extended_dynamic_state3 = enable;
+        vc_debug("\textended_dynamic_state3: %s", enable ? "enabled" : "unsupported");
+    }
+
+    // -- Shader objects, the dynamic state commands they need come with the extension
+    {
+        char *ext = "VK_EXT_shader_object";
+        b8 enable = ctx->supported_features.extended_dynamic_state &&
+                    supported.shader_object.shaderObject &&
+                    _vc_device_creation_physcial_device_supports_extensions(phy, &ext, 1);
+
+        if(enable)
+        {
+            if(!_vc_db_extension_requested(device_builder, ext))
+            {
+                vc_device_builder_request_extension(device_builder, ext);
+            }
+
+            feats->shader_object = (VkPhysicalDeviceShaderObjectFeaturesEXT)
+            {
+                .sType        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT,
+                .shaderObject = VK_TRUE,
+            };
+            chain_tail = _vc_db_chain_append(chain_tail, &feats->shader_object);
+        }
+
+        ctx->supported_features.shader_object = enable;
+        vc_debug("\tshader_object: %s", enable ? "enabled" : "unsupported");
+    }
+}
+
+void
+_vc_db_load_device_functions(vc_ctx   *ctx)
+{
+    if(ctx->supported_features.buffer_device_address)
+    {
+        ctx->device_functions.get_buffer_device_address = (PFN_vkGetBufferDeviceAddressKHR)vkGetDeviceProcAddr(ctx->current_device, "vkGetBufferDeviceAddress");
+        if(ctx->device_functions.get_buffer_device_address == NULL)
+        {
+            ctx->device_functions.get_buffer_device_address = (PFN_vkGetBufferDeviceAddressKHR)vkGetDeviceProcAddr(ctx->current_device, "vkGetBufferDeviceAddressKHR");
+        }
+    }
+
+    if(ctx->supported_features.push_descriptor)
+    {
+        ctx->device_functions.cmd_push_descriptor_set               = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(ctx->current_device, "vkCmdPushDescriptorSetKHR");
+        ctx->device_functions.cmd_push_descriptor_set_with_template = (PFN_vkCmdPushDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(ctx->current_device, "vkCmdPushDescriptorSetWithTemplateKHR");
+    }
+
+    if(ctx->supported_features.extended_dynamic_state3 || ctx->supported_features.shader_object)
+    {
+        ctx->device_functions.cmd_set_polygon_mode         = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetPolygonModeEXT");
+        ctx->device_functions.cmd_set_depth_clamp_enable   = (PFN_vkCmdSetDepthClampEnableEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetDepthClampEnableEXT");
+        ctx->device_functions.cmd_set_color_blend_enable   = (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetColorBlendEnableEXT");
+        ctx->device_functions.cmd_set_color_blend_equation = (PFN_vkCmdSetColorBlendEquationEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetColorBlendEquationEXT");
+        ctx->device_functions.cmd_set_color_write_mask     = (PFN_vkCmdSetColorWriteMaskEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetColorWriteMaskEXT");
+    }
+
+    if(ctx->supported_features.shader_object)
+    {
+        ctx->device_functions.create_shaders                   = (PFN_vkCreateShadersEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCreateShadersEXT");
+        ctx->device_functions.destroy_shader                   = (PFN_vkDestroyShaderEXT)vkGetDeviceProcAddr(ctx->current_device, "vkDestroyShaderEXT");
+        ctx->device_functions.cmd_bind_shaders                 = (PFN_vkCmdBindShadersEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdBindShadersEXT");
+        ctx->device_functions.cmd_set_vertex_input             = (PFN_vkCmdSetVertexInputEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetVertexInputEXT");
+        ctx->device_functions.cmd_set_rasterization_samples    = (PFN_vkCmdSetRasterizationSamplesEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetRasterizationSamplesEXT");
+        ctx->device_functions.cmd_set_sample_mask              = (PFN_vkCmdSetSampleMaskEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetSampleMaskEXT");
+        ctx->device_functions.cmd_set_alpha_to_coverage_enable = (PFN_vkCmdSetAlphaToCoverageEnableEXT)vkGetDeviceProcAddr(ctx->current_device, "vkCmdSetAlphaToCoverageEnableEXT");
+    }
+}
@@ -63,6 +63,15 @@ void              vc_device_builder_request_extension(vc_device_builder builder,
  */
 void              vc_device_builder_set_score_func(vc_device_builder builder, vc_device_score_function func, void *usr_data);
 
+/**
+ * @brief Persists the pipeline cache of the device in a file: it is loaded when the device is created, if it was written
+ *        by the same device and driver, and written back when the context is destroyed, or by vc_pipeline_cache_save
+ *
+ * @param builder The device builder
+ * @param path The path of the cache file, copied
+ */
+void              vc_device_builder_set_pipeline_cache_file(vc_device_builder builder, const char *path);
+
 
 /**
  * @brief Requests a queue in the device created by the builder
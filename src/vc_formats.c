@@ -39,3 +39,117 @@ vc_format_query_format(vc_ctx *ctx, vc_format_query query, vc_format_set candida
     return FALSE;
 }
 
+VkImageAspectFlags
+vc_format_get_aspects(VkFormat    format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+// Block extents of the ASTC formats, by pairs of UNORM and SRGB formats from VK_FORMAT_ASTC_4x4_UNORM_BLOCK
+static const u32 _vc_astc_block_extents[14][2] =
+{
+    { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+};
+
+u32
+vc_format_aspect_block_size(VkFormat format, VkImageAspectFlagBits aspect, u32 *block_width, u32 *block_height)
+{
+    *block_width  = 1;
+    *block_height = 1;
+
+    // Depth and stencil are copied separately, stencil as one byte per texel
+    if(aspect == VK_IMAGE_ASPECT_STENCIL_BIT)
+    {
+        return 1;
+    }
+
+    switch (format)
+    {
+    case VK_FORMAT_R4G4_UNORM_PACK8:
+    case VK_FORMAT_R8_UNORM ... VK_FORMAT_R8_SRGB:
+        return 1;
+
+    case VK_FORMAT_R4G4B4A4_UNORM_PACK16 ... VK_FORMAT_A1R5G5B5_UNORM_PACK16:
+    case VK_FORMAT_R8G8_UNORM ... VK_FORMAT_R8G8_SRGB:
+    case VK_FORMAT_R16_UNORM ... VK_FORMAT_R16_SFLOAT:
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+        return 2;
+
+    case VK_FORMAT_R8G8B8_UNORM ... VK_FORMAT_B8G8R8_SRGB:
+        return 3;
+
+    case VK_FORMAT_R8G8B8A8_UNORM ... VK_FORMAT_A2B10G10R10_SINT_PACK32:
+    case VK_FORMAT_R16G16_UNORM ... VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R32_UINT ... VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+    case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return 4;
+
+    case VK_FORMAT_R16G16B16_UNORM ... VK_FORMAT_R16G16B16_SFLOAT:
+        return 6;
+
+    case VK_FORMAT_R16G16B16A16_UNORM ... VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_UINT ... VK_FORMAT_R32G32_SFLOAT:
+    case VK_FORMAT_R64_UINT ... VK_FORMAT_R64_SFLOAT:
+        return 8;
+
+    case VK_FORMAT_R32G32B32_UINT ... VK_FORMAT_R32G32B32_SFLOAT:
+        return 12;
+
+    case VK_FORMAT_R32G32B32A32_UINT ... VK_FORMAT_R32G32B32A32_SFLOAT:
+    case VK_FORMAT_R64G64_UINT ... VK_FORMAT_R64G64_SFLOAT:
+        return 16;
+
+    case VK_FORMAT_R64G64B64_UINT ... VK_FORMAT_R64G64B64_SFLOAT:
+        return 24;
+
+    case VK_FORMAT_R64G64B64A64_UINT ... VK_FORMAT_R64G64B64A64_SFLOAT:
+        return 32;
+
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK ... VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK ... VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK ... VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK ... VK_FORMAT_EAC_R11_SNORM_BLOCK:
+        *block_width  = 4;
+        *block_height = 4;
+        return 8;
+
+    case VK_FORMAT_BC2_UNORM_BLOCK ... VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK ... VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK ... VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK ... VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+        *block_width  = 4;
+        *block_height = 4;
+        return 16;
+
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK ... VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
+        *block_width  = _vc_astc_block_extents[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2][0];
+        *block_height = _vc_astc_block_extents[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2][1];
+        return 16;
+
+    default:
+        return 0;
+    }
+}
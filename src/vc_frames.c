@@ -0,0 +1,197 @@
+#include "vc_frames.h"
+#include "vc_enum_util.h"
+#include "base/data_structures/darray.h"
+
+void
+vc_frames_create(vc_frame_manager *mgr, VkDevice dev, void *usr_ctx)
+{
+    VkFenceCreateInfo fence_ci =
+    {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = 0,
+    };
+
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        VK_CHECK(vkCreateFence(dev, &fence_ci, NULL, &mgr->slots[i].fence), "Could not create a frame fence.");
+        mgr->slots[i].frame_number = 0;
+        mgr->slots[i].submitted    = FALSE;
+        mgr->slots[i].retire_tasks = darray_create(_vc_frame_retire_task);
+    }
+
+    // Frame 0 is considered complete. Frame 1 is the frame recorded before the first call to vc_frame_begin (loading etc.)
+    mgr->current_frame   = 1;
+    mgr->completed_frame = 0;
+    mgr->usr_ctx         = usr_ctx;
+
+    mgr->slots[mgr->current_frame % VC_FRAMES_IN_FLIGHT].frame_number = mgr->current_frame;
+}
+
+void
+_vc_frames_run_tasks(vc_frame_manager *mgr, _vc_frame_slot *slot)
+{
+    // Tasks may defer new tasks, swap the list out first
+    _vc_frame_retire_task *tasks = slot->retire_tasks;
+    slot->retire_tasks = darray_create(_vc_frame_retire_task);
+
+    u32 count = darray_length(tasks);
+    for(u32 i = 0; i < count; i++)
+    {
+        tasks[i].func(mgr->usr_ctx, tasks[i].task_data);
+    }
+
+    darray_destroy(tasks);
+}
+
+void
+vc_frames_destroy(vc_frame_manager *mgr, VkDevice dev)
+{
+    // Retire in order of submission
+    for(u32 i = 1; i <= VC_FRAMES_IN_FLIGHT; i++)
+    {
+        _vc_frame_slot *slot = &mgr->slots[(mgr->current_frame + i) % VC_FRAMES_IN_FLIGHT];
+        _vc_frames_run_tasks(mgr, slot);
+    }
+
+    for(u32 i = 0; i < VC_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyFence(dev, mgr->slots[i].fence, NULL);
+        darray_destroy(mgr->slots[i].retire_tasks);
+    }
+}
+
+// Makes sure the GPU is done with the frame in the slot
+void
+_vc_frames_slot_wait(vc_frame_manager *mgr, VkDevice dev, _vc_frame_slot *slot)
+{
+    if(slot->frame_number <= mgr->completed_frame)
+    {
+        return;
+    }
+
+    if(slot->submitted)
+    {
+        VK_CHECK(vkWaitForFences(dev, 1, &slot->fence, VK_TRUE, UINT64_MAX), "Could not wait for a frame fence.");
+    }
+    else
+    {
+        // The frame never got its fence, the only safe option is to wait for everything.
+        vc_trace("Frame %lu was never ended, waiting for device idle.", slot->frame_number);
+        vkDeviceWaitIdle(dev);
+    }
+
+    mgr->completed_frame = slot->frame_number;
+}
+
+void
+vc_frames_advance(vc_frame_manager *mgr, VkDevice dev)
+{
+    mgr->current_frame++;
+    _vc_frame_slot *slot = &mgr->slots[mgr->current_frame % VC_FRAMES_IN_FLIGHT];
+
+    _vc_frames_slot_wait(mgr, dev, slot);
+
+    if(slot->submitted)
+    {
+        VK_CHECK(vkResetFences(dev, 1, &slot->fence), "Could not reset a frame fence.");
+    }
+
+    slot->frame_number = mgr->current_frame;
+    slot->submitted    = FALSE;
+
+    // Retired tasks deferring new work will push it in the new frame
+    _vc_frames_run_tasks(mgr, slot);
+}
+
+void
+vc_frames_submit(vc_frame_manager *mgr, VkQueue queue)
+{
+    _vc_frame_slot *slot = &mgr->slots[mgr->current_frame % VC_FRAMES_IN_FLIGHT];
+
+    if(slot->submitted)
+    {
+        vc_warn("Frame %lu was ended more than once.", mgr->current_frame);
+        return;
+    }
+
+    // An empty submission signals its fence once all previously submitted work on the queue has completed
+    VK_CHECK(vkQueueSubmit(queue, 0, NULL, slot->fence), "Could not submit a frame fence.");
+    slot->submitted = TRUE;
+}
+
+void
+vc_frames_defer(vc_frame_manager *mgr, vc_frame_retire_func func, void *task_data)
+{
+    _vc_frame_slot *slot       = &mgr->slots[mgr->current_frame % VC_FRAMES_IN_FLIGHT];
+    _vc_frame_retire_task task =
+    {
+        .func      = func,
+        .task_data = task_data,
+    };
+
+    darray_push(slot->retire_tasks, task);
+}
+
+b8
+vc_frames_is_complete(vc_frame_manager *mgr, VkDevice dev, u64 frame_number)
+{
+    if(frame_number <= mgr->completed_frame)
+    {
+        return TRUE;
+    }
+
+    _vc_frame_slot *slot = &mgr->slots[frame_number % VC_FRAMES_IN_FLIGHT];
+    if(slot->frame_number != frame_number)
+    {
+        // Slot was reused, which implies the frame was waited for
+        return slot->frame_number > frame_number;
+    }
+
+    if(!slot->submitted)
+    {
+        return FALSE;
+    }
+
+    if(vkGetFenceStatus(dev, slot->fence) == VK_SUCCESS)
+    {
+        mgr->completed_frame = frame_number;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+b8
+vc_frames_is_submitted(vc_frame_manager *mgr, u64 frame_number)
+{
+    if(frame_number <= mgr->completed_frame)
+    {
+        return TRUE;
+    }
+
+    _vc_frame_slot *slot = &mgr->slots[frame_number % VC_FRAMES_IN_FLIGHT];
+    if(slot->frame_number != frame_number)
+    {
+        // Slot was reused, which implies the frame was waited for
+        return slot->frame_number > frame_number;
+    }
+
+    return slot->submitted;
+}
+
+void
+vc_frames_wait(vc_frame_manager *mgr, VkDevice dev, u64 frame_number)
+{
+    if(frame_number <= mgr->completed_frame)
+    {
+        return;
+    }
+
+    _vc_frame_slot *slot = &mgr->slots[frame_number % VC_FRAMES_IN_FLIGHT];
+    if(slot->frame_number != frame_number)
+    {
+        return;
+    }
+
+    _vc_frames_slot_wait(mgr, dev, slot);
+}
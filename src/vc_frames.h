@@ -0,0 +1,118 @@
+#ifndef __VC_FRAMES__
+#define __VC_FRAMES__
+
+/*
+ * Frames in flight tracking.
+ * Each frame owns a fence, signaled once every piece of work submitted for the frame has completed on the GPU.
+ * Work that must wait for the GPU to be done with a frame (freeing staging memory, destroying moved ressources...)
+ * is deferred to the frame, and runs when the frame "retires", that is when its slot is about to be reused.
+ */
+
+#include <vulkan/vulkan.h>
+#include "base/types.h"
+
+#define VC_FRAMES_IN_FLIGHT 2
+
+/**
+ * @brief Function called when a frame retires
+ *
+ * @param usr_ctx The user context of the frame manager
+ * @param task_data The data given when the task was deferred
+ */
+typedef void (*vc_frame_retire_func)(void *usr_ctx, void *task_data);
+
+typedef struct
+{
+    vc_frame_retire_func    func;
+    void                   *task_data;
+} _vc_frame_retire_task;
+
+typedef struct
+{
+    VkFence                  fence;
+    u64                      frame_number; // The frame using this slot
+    b8                       submitted; // Wether the fence has been submitted for frame_number
+    _vc_frame_retire_task   *retire_tasks; // darray
+} _vc_frame_slot;
+
+typedef struct
+{
+    _vc_frame_slot    slots[VC_FRAMES_IN_FLIGHT];
+    u64               current_frame;
+    u64               completed_frame; // Every frame up to this one is known to be finished on the GPU
+
+    void             *usr_ctx;
+} vc_frame_manager;
+
+/**
+ * @brief Creates a frame manager
+ *
+ * @param mgr The frame manager
+ * @param dev The device
+ * @param usr_ctx The user context given to retire tasks
+ */
+void vc_frames_create(vc_frame_manager *mgr, VkDevice dev, void *usr_ctx);
+
+/**
+ * @brief Destroys the frame manager, running all pending retire tasks
+ *
+ * @param mgr The frame manager
+ * @param dev The device
+ * @attention The device must be idle.
+ */
+void vc_frames_destroy(vc_frame_manager *mgr, VkDevice dev);
+
+/**
+ * @brief Advances to the next frame, waiting for the frame that used the same slot and retiring it
+ *
+ * @param mgr The frame manager
+ * @param dev The device
+ */
+void vc_frames_advance(vc_frame_manager *mgr, VkDevice dev);
+
+/**
+ * @brief Submits the current frame's fence on a queue
+ *
+ * @param mgr The frame manager
+ * @param queue The queue on which the last work of the frame was submitted
+ */
+void vc_frames_submit(vc_frame_manager *mgr, VkQueue queue);
+
+/**
+ * @brief Defers a task to the retirement of the current frame
+ *
+ * @param mgr The frame manager
+ * @param func The task function
+ * @param task_data Data passed to the function
+ */
+void vc_frames_defer(vc_frame_manager *mgr, vc_frame_retire_func func, void *task_data);
+
+/**
+ * @brief Checks, without blocking, wether a frame has finished on the GPU
+ *
+ * @param mgr The frame manager
+ * @param dev The device
+ * @param frame_number The frame to check
+ * @return TRUE if the GPU is done with the frame
+ */
+b8   vc_frames_is_complete(vc_frame_manager *mgr, VkDevice dev, u64 frame_number);
+
+/**
+ * @brief Checks wether a frame has been ended, so its fence will eventually be signaled
+ *
+ * @param mgr The frame manager
+ * @param frame_number The frame to check
+ * @return TRUE if the frame was submitted
+ */
+b8   vc_frames_is_submitted(vc_frame_manager *mgr, u64 frame_number);
+
+/**
+ * @brief Blocks until a frame has finished on the GPU
+ *
+ * @param mgr The frame manager
+ * @param dev The device
+ * @param frame_number The frame to wait for
+ */
+void vc_frames_wait(vc_frame_manager *mgr, VkDevice dev, u64 frame_number);
+
+#endif // __VC_FRAMES__
@@ -3,13 +3,23 @@
 #include "vc_enum_util.h"
 #include <alloca.h>
 
+b8 _vc_defrag_release_image(vc_ctx *ctx, VmaAllocation alloc, VkImage image);
+
 void
 _vc_image_destroy(vc_ctx *ctx, _vc_image_intern *i)
 {
-    if(!i->externally_managed)
+    if(i->externally_managed)
+    {
+        return;
+    }
+
+    if(_vc_defrag_release_image(ctx, i->alloc, i->image))
     {
-        vmaDestroyImage(ctx->main_allocator, i->image, i->alloc);
+        // The allocation is part of a defragmentation pass, the defragmenter frees it with the image
+        return;
     }
+
+    vmaDestroyImage(ctx->main_allocator, i->image, i->alloc);
 }
 
 void
@@ -18,6 +28,12 @@ _vc_image_view_destroy(vc_ctx *ctx, _vc_image_view_intern *i)
     vkDestroyImageView(ctx->current_device, i->view, NULL);
 }
 
+void
+_vc_sampler_destroy(vc_ctx *ctx, _vc_sampler_intern *i)
+{
+    vkDestroySampler(ctx->current_device, i->sampler, NULL);
+}
+
 vc_image
 vc_image_allocate(vc_ctx *ctx, vc_image_create_info create_info)
 {
@@ -56,7 +72,10 @@ vc_image_allocate(vc_ctx *ctx, vc_image_create_info create_info)
         .arrayLayers = create_info.array_layer_count,
         .samples     = create_info.sample_count,
         .tiling      = create_info.tiling,
-        .usage       = create_info.usage,
+        .usage       = create_info.usage |
+                       ( (create_info.resting_layout != VK_IMAGE_LAYOUT_UNDEFINED) ?
+                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT :
+                         0 ),
         .sharingMode = create_info.sharing_exclusive ?
                        VK_SHARING_MODE_EXCLUSIVE :
                        VK_SHARING_MODE_CONCURRENT,
@@ -79,10 +98,17 @@ vc_image_allocate(vc_ctx *ctx, vc_image_create_info create_info)
 
     img.externally_managed = FALSE;
     img.image_format       = create_info.image_format;
+    img.resting_layout     = create_info.sharing_exclusive ? create_info.resting_layout : VK_IMAGE_LAYOUT_UNDEFINED;
 
     VK_CHECKH(vmaCreateImage(ctx->main_allocator, &img_ci, &alloc_ci, &img.image, &img.alloc, NULL), "Could not allocate an image");
 
+    img.create_info                       = img_ci;
+    img.create_info.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+    img.create_info.queueFamilyIndexCount = 0;
+    img.create_info.pQueueFamilyIndices   = NULL;
+
     vc_image hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_IMAGE, &img);
+    vmaSetAllocationUserData(ctx->main_allocator, img.alloc, (void *)hndl); // Lets the defragmenter find the handle back
     vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_IMAGE, (vc_handle_destroy_func)_vc_image_destroy);
 
     return hndl;
@@ -109,6 +135,9 @@ vc_image_view_create(vc_ctx *ctx, vc_image image, VkImageViewType type, VkCompon
         0
     };
 
+    view_i.image       = image;
+    view_i.create_info = info;
+
     VK_CHECKH(vkCreateImageView(ctx->current_device, &info, NULL, &view_i.view), "Could not create an image view.");
 
     vc_image_view hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_IMAGE_VIEW, &view_i);
@@ -117,3 +146,51 @@ vc_image_view_create(vc_ctx *ctx, vc_image image, VkImageViewType type, VkCompon
     return hndl;
 }
 
+vc_sampler
+vc_sampler_create(vc_ctx *ctx, vc_sampler_create_info create_info)
+{
+    if(create_info.max_anisotropy > 0.0f)
+    {
+        if(!ctx->supported_features.sampler_anisotropy)
+        {
+            vc_warn("Anisotropic filtering requested, but the sampler_anisotropy feature is not supported. It is disabled.");
+            create_info.max_anisotropy = 0.0f;
+        }
+        else
+        {
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(ctx->current_physical_device, &props);
+            create_info.max_anisotropy = MIN(create_info.max_anisotropy, props.limits.maxSamplerAnisotropy);
+        }
+    }
+
+    VkSamplerCreateInfo info =
+    {
+        .sType            = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter        = create_info.mag_filter,
+        .minFilter        = create_info.min_filter,
+        .mipmapMode       = create_info.mipmap_mode,
+        .addressModeU     = create_info.address_mode,
+        .addressModeV     = create_info.address_mode,
+        .addressModeW     = create_info.address_mode,
+        .mipLodBias       = 0.0f,
+        .anisotropyEnable = create_info.max_anisotropy > 0.0f,
+        .maxAnisotropy    = create_info.max_anisotropy,
+        .compareEnable    = VK_FALSE,
+        .minLod           = 0.0f,
+        .maxLod           = VK_LOD_CLAMP_NONE,
+        .borderColor      = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+    };
+
+    _vc_sampler_intern sampler_i =
+    {
+        0
+    };
+
+    VK_CHECKH(vkCreateSampler(ctx->current_device, &info, NULL, &sampler_i.sampler), "Could not create a sampler.");
+
+    vc_sampler hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_SAMPLER, &sampler_i);
+    vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_SAMPLER, (vc_handle_destroy_func)_vc_sampler_destroy);
+
+    return hndl;
+}
@@ -0,0 +1,180 @@
+#include "vc_object_cache.h"
+
+#include "base/data_structures/darray.h"
+#include "base/hash.h"
+#include "base/memory.h"
+
+#define _VC_OCACHE_START_SIZE 64
+
+_vc_ocache_table *
+_vc_ocache_table_create(u32 size)
+{
+    _vc_ocache_table *table = mem_allocate(sizeof(_vc_ocache_table) + sizeof(_vc_ocache_entry *) * size, MEMORY_TAG_RENDERER);
+    table->mask = size - 1;
+    mem_memset(table->slots, 0, sizeof(_vc_ocache_entry *) * size);
+    return table;
+}
+
+void
+vc_ocache_create(vc_object_cache   *cache)
+{
+    cache->table      = _vc_ocache_table_create(_VC_OCACHE_START_SIZE);
+    cache->count      = 0;
+    cache->old_tables = darray_create(_vc_ocache_table *);
+    cache->hits       = 0;
+    pthread_mutex_init(&cache->insert_lock, NULL);
+}
+
+_vc_ocache_entry *
+_vc_ocache_lookup(_vc_ocache_table *table, u64 hash, const void *key, u64 key_size)
+{
+    for(u32 i = hash & table->mask; ; i = (i + 1) & table->mask)
+    {
+        _vc_ocache_entry *e = __atomic_load_n(&table->slots[i], __ATOMIC_ACQUIRE);
+        if(e == NULL)
+        {
+            return NULL;
+        }
+
+        if(e->hash == hash && e->key_size == key_size && mem_memcmp(e->key, (void *)key, key_size) == 0)
+        {
+            return e;
+        }
+    }
+}
+
+void
+_vc_ocache_table_insert(_vc_ocache_table *table, _vc_ocache_entry *entry)
+{
+    u32 i = entry->hash & table->mask;
+    while(table->slots[i] != NULL)
+    {
+        i = (i + 1) & table->mask;
+    }
+
+    // Readers see the entry fully written
+    __atomic_store_n(&table->slots[i], entry, __ATOMIC_RELEASE);
+}
+
+// Must be called with the insert lock held
+_vc_ocache_entry *
+_vc_ocache_insert(vc_object_cache *cache, u64 hash, const void *key, u64 key_size, u64 object)
+{
+    _vc_ocache_entry *entry = mem_allocate(sizeof(_vc_ocache_entry) + key_size, MEMORY_TAG_RENDERER);
+    entry->hash     = hash;
+    entry->object   = object;
+    entry->key_size = key_size;
+    mem_memcpy(entry->key, (void *)key, key_size);
+
+    // Keep the table at most half full, old tables stay alive for the readers still probing them
+    _vc_ocache_table *table = cache->table;
+    if( (cache->count + 1) * 2 > table->mask + 1 )
+    {
+        _vc_ocache_table *grown = _vc_ocache_table_create( (table->mask + 1) * 2 );
+        for(u32 i = 0; i <= table->mask; i++)
+        {
+            if(table->slots[i] != NULL)
+            {
+                _vc_ocache_table_insert(grown, table->slots[i]);
+            }
+        }
+
+        darray_push(cache->old_tables, table);
+        __atomic_store_n(&cache->table, grown, __ATOMIC_RELEASE);
+        table = grown;
+    }
+
+    _vc_ocache_table_insert(table, entry);
+    cache->count++;
+
+    return entry;
+}
+
+u64
+vc_ocache_get(vc_object_cache *cache, const void *key, u64 key_size, vc_ocache_create_func create, void *usr_data)
+{
+    u64 hash = hash_bytes(key, key_size, 0);
+
+    _vc_ocache_entry *entry = _vc_ocache_lookup(__atomic_load_n(&cache->table, __ATOMIC_ACQUIRE), hash, key, key_size);
+    if(entry != NULL)
+    {
+        __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+        return entry->object;
+    }
+
+    pthread_mutex_lock(&cache->insert_lock);
+
+    // Another thread may have created it in the meantime
+    entry = _vc_ocache_lookup(cache->table, hash, key, key_size);
+    if(entry == NULL)
+    {
+        u64 object = create(usr_data, key, key_size);
+        entry      = object != 0 ? _vc_ocache_insert(cache, hash, key, key_size, object) : NULL;
+    }
+
+    pthread_mutex_unlock(&cache->insert_lock);
+
+    return entry != NULL ? entry->object : 0;
+}
+
+u64
+vc_ocache_get_unlocked(vc_object_cache *cache, const void *key, u64 key_size, vc_ocache_create_func create, vc_ocache_destroy_func destroy, void *usr_data)
+{
+    u64 hash = hash_bytes(key, key_size, 0);
+
+    _vc_ocache_entry *entry = _vc_ocache_lookup(__atomic_load_n(&cache->table, __ATOMIC_ACQUIRE), hash, key, key_size);
+    if(entry != NULL)
+    {
+        __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+        return entry->object;
+    }
+
+    u64 object = create(usr_data, key, key_size);
+    if(object == 0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache->insert_lock);
+
+    // Another thread may have created it in the meantime, its object wins
+    entry      = _vc_ocache_lookup(cache->table, hash, key, key_size);
+    b8 created = entry == NULL;
+    if(created)
+    {
+        entry = _vc_ocache_insert(cache, hash, key, key_size, object);
+    }
+
+    pthread_mutex_unlock(&cache->insert_lock);
+
+    if(!created)
+    {
+        destroy(usr_data, object);
+    }
+
+    return entry->object;
+}
+
+void
+vc_ocache_destroy(vc_object_cache *cache, vc_ocache_destroy_func destroy, void *usr_data)
+{
+    _vc_ocache_table *table = cache->table;
+    for(u32 i = 0; i <= table->mask; i++)
+    {
+        if(table->slots[i] != NULL)
+        {
+            destroy(usr_data, table->slots[i]->object);
+            mem_free(table->slots[i]);
+        }
+    }
+    mem_free(table);
+
+    for(u32 i = 0; i < darray_length(cache->old_tables); i++)
+    {
+        mem_free(cache->old_tables[i]);
+    }
+    darray_destroy(cache->old_tables);
+
+    pthread_mutex_destroy(&cache->insert_lock);
+    cache->table = NULL;
+}
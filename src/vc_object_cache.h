@@ -0,0 +1,75 @@
+#ifndef __VC_OBJECT_CACHE__
+#define __VC_OBJECT_CACHE__
+
+/*
+ * Hash consed Vulkan objects: equal keys always give the same object.
+ * Used for set layouts, for the objects that pipelines share (shader modules keyed by their SPIR-V, pipeline layouts
+ * keyed by their set layouts and push constant ranges, pipeline libraries) and for shader reflections.
+ * Keys are hashed with wyhash and fully compared on hash matches. The table uses open addressing, entries are never
+ * removed, and lookups do not take any lock: only insertions are serialized.
+ */
+
+#include <pthread.h>
+#include "base/types.h"
+
+// Creates the object of a key, returns 0 on failure
+typedef u64 (*vc_ocache_create_func)(void *usr_data, const void *key, u64 key_size);
+typedef void (*vc_ocache_destroy_func)(void *usr_data, u64 object);
+
+typedef struct
+{
+    u64    hash;
+    u64    object; // A non dispatchable Vulkan handle, or a pointer
+    u64    key_size;
+    u8     key[];
+} _vc_ocache_entry;
+
+typedef struct
+{
+    u32                  mask;
+    _vc_ocache_entry    *slots[]; // Published atomically, NULL if empty
+} _vc_ocache_table;
+
+typedef struct
+{
+    _vc_ocache_table     *table; // Published atomically
+    u32                   count;
+
+    pthread_mutex_t       insert_lock;
+    _vc_ocache_table    **old_tables; // darray, readers may still be probing them, freed with the cache
+
+    u64                   hits; // Atomic
+} vc_object_cache;
+
+void vc_ocache_create(vc_object_cache   *cache);
+
+/**
+ * @brief Returns the object of a key, creating it the first time
+ *
+ * @param cache The cache
+ * @param key The key, compared byte for byte
+ * @param key_size The size of the key
+ * @param create The function creating the object, called with the insert lock held
+ * @param usr_data The data passed to create
+ * @return The object, owned by the cache, 0 if it could not be created
+ */
+u64  vc_ocache_get(vc_object_cache *cache, const void *key, u64 key_size, vc_ocache_create_func create, void *usr_data);
+
+/**
+ * @brief Returns the object of a key, creating it the first time without holding the insert lock
+ *
+ * @param cache The cache
+ * @param key The key, compared byte for byte
+ * @param key_size The size of the key
+ * @param create The function creating the object, may be called by several threads for the same key
+ * @param destroy The function destroying the objects of the threads that lost the race to insert theirs
+ * @param usr_data The data passed to create and destroy
+ * @return The object, owned by the cache, 0 if it could not be created
+ * @note For objects slow to create, so that insertions of other keys do not wait for them.
+ */
+u64  vc_ocache_get_unlocked(vc_object_cache *cache, const void *key, u64 key_size, vc_ocache_create_func create, vc_ocache_destroy_func destroy, void *usr_data);
+
+// Destroys every object of the cache
+void vc_ocache_destroy(vc_object_cache *cache, vc_ocache_destroy_func destroy, void *usr_data);
+
+#endif // __VC_OBJECT_CACHE__
@@ -1,44 +1,1923 @@
 #include "vulcain.h"
 #include "handles/vc_internal_types.h"
 #include "vc_enum_util.h"
+#include "base/hash.h"
+#include "base/data_structures/darray.h"
 #include <alloca.h>
+#include <string.h>
 
+// Everything the create info of a graphics pipeline points to, kept alive while the pipeline compiles
+typedef struct
+{
+    vc_pipeline_job                           job; // First member, the state is found from its job
+
+    VkGraphicsPipelineCreateInfo              graphics_ci;
+    VkPipelineShaderStageCreateInfo           stages[2];
+    VkPipelineVertexInputStateCreateInfo      vert_in_ci;
+    VkPipelineInputAssemblyStateCreateInfo    assembly_ci;
+    VkPipelineTessellationStateCreateInfo     tesselation_ci;
+    VkPipelineViewportStateCreateInfo         viewport_ci;
+    VkPipelineRasterizationStateCreateInfo    raster_ci;
+    VkPipelineMultisampleStateCreateInfo      ms_ci;
+    VkPipelineDepthStencilStateCreateInfo     depth_stencil_ci;
+    VkPipelineColorBlendStateCreateInfo       blend_ci;
+    VkPipelineDynamicStateCreateInfo          dynamic_ci;
+    vc_dynamic_state_flags                    dynamic; // The groups not baked
+    VkPipelineRenderingCreateInfo             rendering_info_ci;
+    VkPipelineCreationFeedbackCreateInfo      feedback_ci;
+    VkPipelineCreationFeedback                feedback;
+    VkSpecializationInfo                      spec_infos[2];
+    const vc_shader_reflection               *reflections[2]; // Of the vertex and fragment shaders, NULL if they could not be reflected
+
+    // With the graphics_pipeline_library feature, the parts of the pipeline and the create info of its optimized link
+    VkPipeline                                libraries[4];
+    VkPipelineLibraryCreateInfoKHR            library_ci;
+    VkGraphicsPipelineCreateInfo              link_ci;
+    VkPipelineCreationFeedbackCreateInfo      link_feedback_ci;
+
+    mem_linear                                arrays; // Copies of the arrays of the description, allocated after the state
+} _vc_gfx_pipeline_state;
+
+typedef struct
+{
+    vc_pipeline_job                         job; // First member, the state is found from its job
+
+    VkComputePipelineCreateInfo             comp_ci;
+    VkPipelineCreationFeedbackCreateInfo    feedback_ci;
+    VkPipelineCreationFeedback              feedback;
+    VkSpecializationInfo                    spec_info;
+    const vc_shader_reflection             *reflection; // NULL if the shader could not be reflected
+
+    mem_linear                              arrays; // Copies of the arrays of the description, allocated after the state
+} _vc_compute_pipeline_state;
+
+b8 _vc_pipeline_resolve(vc_ctx *ctx, _vc_pipeline_intern *pipe, b8 wait);
+void _vc_pipeline_dedup_destroy(vc_ctx   *ctx);
+void _vc_pipeline_variants_free(_vc_pipeline_variant   *variants);
+void _vc_pipeline_library_destroy(vc_ctx *ctx, u64 library);
+
+void
+_vc_pipeline_destroy(vc_ctx *ctx, _vc_pipeline_intern *pipe)
+{
+    // A pipeline still compiling is waited for, the layout belongs to the layout cache
+    _vc_pipeline_resolve(ctx, pipe, TRUE);
+
+    vkDestroyPipeline(ctx->current_device, pipe->pipeline, NULL);
+    vkDestroyPipeline(ctx->current_device, pipe->linked, NULL);
+    if(pipe->desc_key != NULL)
+    {
+        mem_free(pipe->desc_key);
+    }
+
+    // Variants are handles of their own, they were released with the last reference (or are destroyed with the context)
+    if(pipe->state != NULL)
+    {
+        mem_free(pipe->state);
+    }
+    _vc_pipeline_variants_free(pipe->variants);
+}
+
+// Returns the creation feedback structure to chain into a pipeline create info, NULL if feedback is not available
+const void *
+_vc_pipeline_feedback_chain(vc_ctx *ctx, VkPipelineCreationFeedbackCreateInfo *feedback_ci, VkPipelineCreationFeedback *feedback, const void *next)
+{
+    *feedback    = (VkPipelineCreationFeedback) {
+        0
+    };
+    *feedback_ci = (VkPipelineCreationFeedbackCreateInfo) {
+        .sType                     = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+        .pNext                     = next,
+        .pPipelineCreationFeedback = feedback,
+    };
+
+    return ctx->pipeline_cache.feedback ? feedback_ci : next;
+}
+
+b8
+vc_pipeline_cache_save(vc_ctx   *ctx)
+{
+    return vc_pcache_save(&ctx->pipeline_cache, ctx->current_device);
+}
+
+// Pipelines must be created knowing their sets live in a descriptor buffer
+VkPipelineCreateFlags
+_vc_pipeline_create_flags(vc_ctx   *ctx)
+{
+    return ctx->supported_features.descriptor_buffer ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+}
+
+/* ---------------- Shared objects ---------------- */
+
+// Pipeline layout cache key: set layout count, push constant range count, the set layouts, then each range
+#define _VC_LAYOUT_KEY_HEADER_WORDS 2
+#define _VC_LAYOUT_KEY_RANGE_WORDS  3
+
+u64
+_vc_pipeline_layout_create(vc_ctx *ctx, const u64 *key, u64 key_size)
+{
+    u32 set_layout_count                = key[0];
+    u32 range_count                     = key[1];
+    const u64 *set_layout_words         = &key[_VC_LAYOUT_KEY_HEADER_WORDS];
+    const u64 *range_words              = &set_layout_words[set_layout_count];
+    VkDescriptorSetLayout *set_layouts  = alloca(sizeof(VkDescriptorSetLayout) * (set_layout_count + 1) );
+    VkPushConstantRange *push_constants = alloca(sizeof(VkPushConstantRange) * (range_count + 1) );
+    for(u32 i = 0; i < set_layout_count; i++)
+    {
+        set_layouts[i] = (VkDescriptorSetLayout)set_layout_words[i];
+    }
+    for(u32 i = 0; i < range_count; i++)
+    {
+        push_constants[i] = (VkPushConstantRange) {
+            .stageFlags = range_words[i * _VC_LAYOUT_KEY_RANGE_WORDS + 0],
+            .offset     = range_words[i * _VC_LAYOUT_KEY_RANGE_WORDS + 1],
+            .size       = range_words[i * _VC_LAYOUT_KEY_RANGE_WORDS + 2],
+        };
+    }
+
+    VkPipelineLayoutCreateInfo layout_ci =
+    {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount         = set_layout_count,
+        .pSetLayouts            = set_layouts,
+        .pushConstantRangeCount = range_count,
+        .pPushConstantRanges    = push_constants,
+    };
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VK_CHECK(vkCreatePipelineLayout(ctx->current_device, &layout_ci, NULL, &layout), "Could not create a pipeline's layout.");
+    return (u64)layout;
+}
+
+u64
+_vc_shader_module_create(vc_ctx *ctx, const u8 *code, u64 code_size)
+{
+    VkShaderModuleCreateInfo mod_ci =
+    {
+        .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pCode    = (const u32 *)code,
+        .codeSize = code_size,
+    };
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateShaderModule(ctx->current_device, &mod_ci, NULL, &module), "Could not create shader module.");
+    return (u64)module;
+}
+
+void
+_vc_pipeline_layout_destroy(vc_ctx *ctx, u64 layout)
+{
+    vkDestroyPipelineLayout(ctx->current_device, (VkPipelineLayout)layout, NULL);
+}
+
+void
+_vc_shader_module_destroy(vc_ctx *ctx, u64 module)
+{
+    vkDestroyShaderModule(ctx->current_device, (VkShaderModule)module, NULL);
+}
+
+/**
+ * @brief Returns the pipeline layout of a layout info, shared by every pipeline with an equal layout info. As set
+ *        layouts are hash consed too, pipelines with equal layouts are layout compatible, so bound sets stay bound
+ *        across pipeline switches.
+ *
+ * @param ctx The context
+ * @param layout_info The layout info
+ * @return The layout, owned by the layout cache, VK_NULL_HANDLE on failure
+ */
+VkPipelineLayout
+_vc_pipeline_layout_get(vc_ctx *ctx, vc_pipeline_layout_info layout_info)
+{
+    u32 key_length = _VC_LAYOUT_KEY_HEADER_WORDS + layout_info.set_layout_count + _VC_LAYOUT_KEY_RANGE_WORDS * layout_info.push_constants_count;
+    u64 *key       = alloca(sizeof(u64) * key_length);
+
+    key[0] = layout_info.set_layout_count;
+    key[1] = layout_info.push_constants_count;
+
+    u64 *words = &key[_VC_LAYOUT_KEY_HEADER_WORDS];
+    for(u32 i = 0; i < layout_info.set_layout_count; i++)
+    {
+        _vc_descriptor_set_layout_intern sl_i;
+        vc_handles_manager_read(&ctx->handles_manager, layout_info.set_layouts[i], &sl_i, sizeof(sl_i) );
+        *words++ = (u64)sl_i.layout;
+    }
+    for(u32 i = 0; i < layout_info.push_constants_count; i++)
+    {
+        *words++ = layout_info.push_constants[i].stageFlags;
+        *words++ = layout_info.push_constants[i].offset;
+        *words++ = layout_info.push_constants[i].size;
+    }
+
+    return (VkPipelineLayout)vc_ocache_get(&ctx->pipeline_layouts, key, sizeof(u64) * key_length, (vc_ocache_create_func)_vc_pipeline_layout_create, ctx);
+}
+
+// Returns the shader module of some SPIR-V, shared by every pipeline using the same code
+VkShaderModule
+_vc_shader_module_get(vc_ctx *ctx, const u8 *code, u64 code_size)
+{
+    return (VkShaderModule)vc_ocache_get(&ctx->shader_modules, code, code_size, (vc_ocache_create_func)_vc_shader_module_create, ctx);
+}
+
+/* ---------------- Reflection ---------------- */
+
+#define _VC_REFLECTED_SETS_MAX 8
+
+typedef struct
+{
+    vc_shader_reflection           reflection; // First member, the entry is returned as its reflection
+    vc_vertex_binding              vertex_binding; // The vertex inputs packed in a single binding, in location order
+    vc_vertex_binding_attribute   *attributes;
+} _vc_reflection_entry;
+
+// Layout of the shaders of a pipeline
+typedef struct
+{
+    vc_descriptor_set_layout    sets[_VC_REFLECTED_SETS_MAX];
+    VkPushConstantRange         push_constants;
+    vc_pipeline_layout_info     info; // Points to the arrays above
+} _vc_reflected_layout;
+
+void _vc_descriptor_set_layout_builder_init(vc_descriptor_set_layout_builder   *builder);
+
+u64
+_vc_reflection_create(vc_ctx *ctx, const u8 *code, u64 code_size)
+{
+    _vc_reflection_entry *entry = mem_allocate(sizeof(_vc_reflection_entry), MEMORY_TAG_RENDERER);
+    if(!vc_spirv_reflect(code, code_size, &entry->reflection) )
+    {
+        mem_free(entry);
+        return 0;
+    }
+
+    u32 input_count = entry->reflection.vertex_input_count;
+    entry->attributes = mem_allocate(sizeof(vc_vertex_binding_attribute) * (input_count + 1), MEMORY_TAG_RENDERER);
+
+    u32 offset = 0;
+    for(u32 i = 0; i < input_count; i++)
+    {
+        entry->attributes[i] = (vc_vertex_binding_attribute) {
+            .location = entry->reflection.vertex_inputs[i].location,
+            .format   = entry->reflection.vertex_inputs[i].format,
+            .offset   = offset,
+        };
+        offset += vc_spirv_format_size(entry->reflection.vertex_inputs[i].format);
+    }
+
+    entry->vertex_binding = (vc_vertex_binding) {
+        .binding         = 0,
+        .stride          = offset,
+        .attribute_count = input_count,
+        .attributes      = entry->attributes,
+        .input_rate      = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+
+    return (u64)entry;
+}
+
+void
+_vc_reflection_destroy(vc_ctx *ctx, u64 object)
+{
+    _vc_reflection_entry *entry = (_vc_reflection_entry *)object;
+    vc_spirv_reflection_free(&entry->reflection);
+    mem_free(entry->attributes);
+    mem_free(entry);
+}
+
+// Adds the bindings of a shader to the set layouts, merging the bindings shared with other stages
+b8
+_vc_reflected_layout_add_bindings(vc_descriptor_set_layout_builder *builders, u32 *set_count, const vc_shader_reflection *reflection)
+{
+    for(u32 i = 0; i < reflection->binding_count; i++)
+    {
+        const vc_spirv_binding *binding = &reflection->bindings[i];
+        if(binding->set >= _VC_REFLECTED_SETS_MAX)
+        {
+            vc_error("Cannot reflect the layout of a shader using set %u, only %u sets are supported.", binding->set, _VC_REFLECTED_SETS_MAX);
+            return FALSE;
+        }
+
+        u32 count = binding->count;
+        if(count == 0)
+        {
+            vc_warn("The runtime sized array at set %u, binding %u is reflected as a single descriptor.", binding->set, binding->binding);
+            count = 1;
+        }
+
+        vc_descriptor_set_layout_builder *builder = &builders[binding->set];
+        VkDescriptorSetLayoutBinding *existing    = NULL;
+        for(u32 b = 0; builder->bindings != NULL && b < darray_length(builder->bindings); b++)
+        {
+            if(builder->bindings[b].binding == binding->binding)
+            {
+                existing = &builder->bindings[b];
+            }
+        }
+
+        if(existing == NULL)
+        {
+            vc_descriptor_set_layout_builder_add_bindings(builder, binding->binding, count, binding->type, reflection->stage);
+        }
+        else if(existing->descriptorType != binding->type)
+        {
+            vc_error("Set %u, binding %u has different descriptor types in different stages.", binding->set, binding->binding);
+            return FALSE;
+        }
+        else
+        {
+            existing->stageFlags     |= reflection->stage;
+            existing->descriptorCount = count > existing->descriptorCount ? count : existing->descriptorCount;
+        }
+
+        *set_count = binding->set + 1 > *set_count ? binding->set + 1 : *set_count;
+    }
+
+    return TRUE;
+}
+
+u64
+_vc_reflected_layout_create(vc_ctx *ctx, const vc_shader_reflection **reflections, u64 key_size)
+{
+    u32 shader_count = key_size / sizeof(const vc_shader_reflection *);
+
+    vc_descriptor_set_layout_builder builders[_VC_REFLECTED_SETS_MAX] =
+    {
+        { 0 }
+    };
+    u32 set_count = 0;
+    b8 success    = TRUE;
+
+    // The push constant blocks of every stage are merged in a single range
+    VkPushConstantRange push_constants =
+    {
+        .offset = U32_MAX,
+    };
+    u32 push_constants_end = 0;
+
+    for(u32 i = 0; i < shader_count && success; i++)
+    {
+        success = _vc_reflected_layout_add_bindings(builders, &set_count, reflections[i]);
+
+        if(reflections[i]->push_constant_size > 0)
+        {
+            u32 start = reflections[i]->push_constant_offset;
+            u32 end   = start + reflections[i]->push_constant_size;
+
+            push_constants.stageFlags |= reflections[i]->stage;
+            push_constants.offset      = start < push_constants.offset ? start : push_constants.offset;
+            push_constants_end         = end > push_constants_end ? end : push_constants_end;
+        }
+    }
+
+    if(!success)
+    {
+        for(u32 s = 0; s < _VC_REFLECTED_SETS_MAX; s++)
+        {
+            if(builders[s].bindings != NULL)
+            {
+                darray_destroy(builders[s].bindings);
+            }
+        }
+        return 0;
+    }
+
+    _vc_reflected_layout *layout = mem_allocate(sizeof(_vc_reflected_layout), MEMORY_TAG_RENDERER);
+    for(u32 s = 0; s < set_count; s++)
+    {
+        // Sets skipped by the shaders are empty
+        if(builders[s].bindings == NULL)
+        {
+            _vc_descriptor_set_layout_builder_init(&builders[s]);
+        }
+        layout->sets[s] = vc_descriptor_set_layout_builder_build(ctx, &builders[s], 0);
+    }
+
+    push_constants.size    = push_constants_end > 0 ? push_constants_end - push_constants.offset : 0;
+    layout->push_constants = push_constants;
+    layout->info           = (vc_pipeline_layout_info) {
+        .set_layout_count     = set_count,
+        .set_layouts          = layout->sets,
+        .push_constants_count = push_constants_end > 0 ? 1 : 0,
+        .push_constants       = &layout->push_constants,
+    };
+
+    return (u64)layout;
+}
+
+void
+_vc_reflected_layout_destroy(vc_ctx *ctx, u64 object)
+{
+    // The set layouts are handles, destroyed with the other handles
+    mem_free( (_vc_reflected_layout *)object );
+}
+
+const vc_shader_reflection *
+vc_shader_reflect(vc_ctx *ctx, u8 *code, u64 code_size)
+{
+    return (const vc_shader_reflection *)vc_ocache_get(&ctx->shader_reflections, code, code_size, (vc_ocache_create_func)_vc_reflection_create, ctx);
+}
+
+vc_pipeline_layout_info
+vc_pipeline_layout_reflect(vc_ctx *ctx, u32 shader_count, u8 **codes, u64 *code_sizes)
+{
+    const vc_shader_reflection **reflections = alloca(sizeof(const vc_shader_reflection *) * (shader_count + 1) );
+    for(u32 i = 0; i < shader_count; i++)
+    {
+        reflections[i] = vc_shader_reflect(ctx, codes[i], code_sizes[i]);
+        if(reflections[i] == NULL)
+        {
+            return (vc_pipeline_layout_info) {
+                0
+            };
+        }
+    }
+
+    // Reflections live as long as the context, their addresses identify the shaders
+    _vc_reflected_layout *layout = (_vc_reflected_layout *)vc_ocache_get(&ctx->reflected_layouts, reflections, sizeof(const vc_shader_reflection *) * shader_count,
+                                                                         (vc_ocache_create_func)_vc_reflected_layout_create, ctx);
+    if(layout == NULL)
+    {
+        return (vc_pipeline_layout_info) {
+            0
+        };
+    }
+
+    return layout->info;
+}
+
+// Returns the vertex inputs of a vertex shader packed in a single binding, NULL if it has none or cannot be reflected
+const vc_vertex_binding *
+_vc_reflected_vertex_binding(vc_ctx *ctx, u8 *code, u64 code_size)
+{
+    const _vc_reflection_entry *entry = (const _vc_reflection_entry *)vc_shader_reflect(ctx, code, code_size);
+    if(entry == NULL || entry->vertex_binding.attribute_count == 0)
+    {
+        return NULL;
+    }
+    return &entry->vertex_binding;
+}
+
+// An empty layout info is reflected from the shader
+void
+_vc_compute_pipeline_desc_reflect(vc_ctx *ctx, vc_compute_pipeline_desc *desc)
+{
+    if(desc->layout_info.set_layout_count == 0 && desc->layout_info.push_constants_count == 0)
+    {
+        desc->layout_info = vc_pipeline_layout_reflect(ctx, 1, &desc->code, &desc->code_size);
+    }
+}
+
+// An empty layout info and an empty vertex input are reflected from the shaders
+void
+_vc_gfx_pipeline_desc_reflect(vc_ctx *ctx, vc_graphics_pipeline_desc *desc)
+{
+    if(desc->layout_info.set_layout_count == 0 && desc->layout_info.push_constants_count == 0)
+    {
+        u8 *codes[2]      = { desc->shader_code.vertex_code, desc->shader_code.fragment_code };
+        u64 code_sizes[2] = { desc->shader_code.vertex_code_size, desc->shader_code.fragment_code_size };
+        desc->layout_info = vc_pipeline_layout_reflect(ctx, 2, codes, code_sizes);
+    }
+
+    if(desc->vertex_binding_count == 0)
+    {
+        const vc_vertex_binding *binding = _vc_reflected_vertex_binding(ctx, desc->shader_code.vertex_code, desc->shader_code.vertex_code_size);
+        if(binding != NULL)
+        {
+            desc->vertex_binding_count = 1;
+            desc->vertex_bindings      = (vc_vertex_binding *)binding;
+        }
+    }
+}
+
+void
+_vc_pipeline_caches_destroy(vc_ctx   *ctx)
+{
+    vc_debug("Pipeline object caches: %u shader modules (%lu reuses), %u pipeline layouts (%lu reuses), %u reflected shaders (%lu reuses), %u pipeline libraries (%lu reuses).",
+             ctx->shader_modules.count, ctx->shader_modules.hits, ctx->pipeline_layouts.count, ctx->pipeline_layouts.hits,
+             ctx->shader_reflections.count, ctx->shader_reflections.hits, ctx->pipeline_libraries.count, ctx->pipeline_libraries.hits);
+
+    vc_ocache_destroy(&ctx->shader_modules, (vc_ocache_destroy_func)_vc_shader_module_destroy, ctx);
+    vc_ocache_destroy(&ctx->pipeline_layouts, (vc_ocache_destroy_func)_vc_pipeline_layout_destroy, ctx);
+    vc_ocache_destroy(&ctx->shader_reflections, (vc_ocache_destroy_func)_vc_reflection_destroy, ctx);
+    vc_ocache_destroy(&ctx->reflected_layouts, (vc_ocache_destroy_func)_vc_reflected_layout_destroy, ctx);
+    vc_ocache_destroy(&ctx->pipeline_libraries, (vc_ocache_destroy_func)_vc_pipeline_library_destroy, ctx);
+    _vc_pipeline_dedup_destroy(ctx);
+}
+
+/* ---------------- Dynamic states ---------------- */
+
+typedef struct
+{
+    vc_dynamic_state_flags    group;
+    VkDynamicState            state;
+} _vc_dynamic_state_entry;
+
+// The Vulkan dynamic states of each group
+const _vc_dynamic_state_entry _vc_dynamic_states[] =
+{
+    { VC_DYNAMIC_VIEWPORT,        VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT        },
+    { VC_DYNAMIC_VIEWPORT,        VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT         },
+    { VC_DYNAMIC_CULL_MODE,       VK_DYNAMIC_STATE_CULL_MODE                  },
+    { VC_DYNAMIC_CULL_MODE,       VK_DYNAMIC_STATE_FRONT_FACE                 },
+    { VC_DYNAMIC_TOPOLOGY,        VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY         },
+    { VC_DYNAMIC_TOPOLOGY,        VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE   },
+    { VC_DYNAMIC_DEPTH_TEST,      VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE          },
+    { VC_DYNAMIC_DEPTH_TEST,      VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE         },
+    { VC_DYNAMIC_DEPTH_TEST,      VK_DYNAMIC_STATE_DEPTH_COMPARE_OP           },
+    { VC_DYNAMIC_DEPTH_BOUNDS,    VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE   },
+    { VC_DYNAMIC_DEPTH_BOUNDS,    VK_DYNAMIC_STATE_DEPTH_BOUNDS               },
+    { VC_DYNAMIC_DEPTH_BIAS,      VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE          },
+    { VC_DYNAMIC_DEPTH_BIAS,      VK_DYNAMIC_STATE_DEPTH_BIAS                 },
+    { VC_DYNAMIC_STENCIL,         VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE        },
+    { VC_DYNAMIC_STENCIL,         VK_DYNAMIC_STATE_STENCIL_OP                 },
+    { VC_DYNAMIC_STENCIL,         VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK       },
+    { VC_DYNAMIC_STENCIL,         VK_DYNAMIC_STATE_STENCIL_WRITE_MASK         },
+    { VC_DYNAMIC_STENCIL,         VK_DYNAMIC_STATE_STENCIL_REFERENCE          },
+    { VC_DYNAMIC_LINE_WIDTH,      VK_DYNAMIC_STATE_LINE_WIDTH                 },
+    { VC_DYNAMIC_BLEND_CONSTANTS, VK_DYNAMIC_STATE_BLEND_CONSTANTS            },
+    { VC_DYNAMIC_POLYGON_MODE,    VK_DYNAMIC_STATE_POLYGON_MODE_EXT           },
+    { VC_DYNAMIC_DEPTH_CLAMP,     VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT     },
+    { VC_DYNAMIC_BLEND,           VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT     },
+    { VC_DYNAMIC_BLEND,           VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT   },
+    { VC_DYNAMIC_BLEND,           VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT       },
+};
+
+#define _VC_DYNAMIC_STATE_COUNT (sizeof(_vc_dynamic_states) / sizeof(_vc_dynamic_state_entry) )
+
+// The groups the device can make dynamic
+vc_dynamic_state_flags
+_vc_dynamic_states_supported(vc_ctx   *ctx)
+{
+    vc_dynamic_state_flags supported = 0;
+    if(ctx->supported_features.extended_dynamic_state)
+    {
+        supported |= VC_DYNAMIC_VIEWPORT | VC_DYNAMIC_CULL_MODE | VC_DYNAMIC_TOPOLOGY | VC_DYNAMIC_DEPTH_TEST | VC_DYNAMIC_DEPTH_BOUNDS |
+                     VC_DYNAMIC_DEPTH_BIAS | VC_DYNAMIC_STENCIL | VC_DYNAMIC_LINE_WIDTH | VC_DYNAMIC_BLEND_CONSTANTS;
+    }
+    if(ctx->supported_features.extended_dynamic_state3)
+    {
+        supported |= VC_DYNAMIC_POLYGON_MODE | VC_DYNAMIC_DEPTH_CLAMP | VC_DYNAMIC_BLEND;
+    }
+    return supported;
+}
+
+// Dynamic topologies stay in the class of the topology of the pipeline, represented by its list topology
+VkPrimitiveTopology
+_vc_topology_class(VkPrimitiveTopology    topology)
+{
+    switch (topology)
+    {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+/**
+ * @brief Bakes the groups the device cannot make dynamic, and replaces the values of the dynamic groups by fixed ones,
+ *        so that descriptions differing only by dynamic states have the same key
+ */
+void
+_vc_gfx_pipeline_desc_normalize(vc_ctx *ctx, vc_graphics_pipeline_desc *desc)
+{
+    vc_dynamic_state_flags dynamic = _vc_dynamic_states_supported(ctx) & ~desc->static_states;
+    for(u32 i = 0; i < desc->dynamic_state_count; i++)
+    {
+        // A fixed viewport count cannot be mixed with the states giving it
+        if(desc->dynamic_states[i] == VK_DYNAMIC_STATE_VIEWPORT || desc->dynamic_states[i] == VK_DYNAMIC_STATE_SCISSOR)
+        {
+            dynamic &= ~VC_DYNAMIC_VIEWPORT;
+        }
+    }
+    desc->static_states = VC_DYNAMIC_ALL & ~dynamic;
+
+    if(dynamic & VC_DYNAMIC_VIEWPORT)
+    {
+        desc->viewport_scissor_count = 0;
+        desc->viewports              = NULL;
+        desc->scissors               = NULL;
+    }
+    if(dynamic & VC_DYNAMIC_CULL_MODE)
+    {
+        desc->cull_mode  = VK_CULL_MODE_NONE;
+        desc->front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    }
+    if(dynamic & VC_DYNAMIC_TOPOLOGY)
+    {
+        desc->topology = _vc_topology_class(desc->topology);
+    }
+    if(dynamic & VC_DYNAMIC_DEPTH_TEST)
+    {
+        desc->depth_test       = FALSE;
+        desc->depth_write      = FALSE;
+        desc->depth_compare_op = VK_COMPARE_OP_LESS;
+    }
+    if(dynamic & VC_DYNAMIC_DEPTH_BOUNDS)
+    {
+        desc->depth_bound_test_enable = FALSE;
+        desc->depth_bounds_min        = 0.0f;
+        desc->depth_bounds_max        = 1.0f;
+    }
+    if(dynamic & VC_DYNAMIC_DEPTH_BIAS)
+    {
+        desc->enable_depth_bias   = FALSE;
+        desc->depth_bias_clamp    = 0.0f;
+        desc->depth_bias_constant = 0.0f;
+        desc->depth_bias_slope    = 0.0f;
+    }
+    if(dynamic & VC_DYNAMIC_STENCIL)
+    {
+        desc->stencil_test = FALSE;
+        mem_memset(&desc->front_faces_stencil_op, 0, sizeof(VkStencilOpState) );
+        mem_memset(&desc->back_faces_stencil_op, 0, sizeof(VkStencilOpState) );
+    }
+    if(dynamic & VC_DYNAMIC_LINE_WIDTH)
+    {
+        desc->line_width = 1.0f;
+    }
+    if(dynamic & VC_DYNAMIC_BLEND_CONSTANTS)
+    {
+        mem_memset(desc->blend_constants, 0, sizeof(desc->blend_constants) );
+    }
+    if(dynamic & VC_DYNAMIC_POLYGON_MODE)
+    {
+        desc->polygon_mode = VK_POLYGON_MODE_FILL;
+    }
+    if(dynamic & VC_DYNAMIC_DEPTH_CLAMP)
+    {
+        desc->enable_depth_clamp = FALSE;
+    }
+    if(dynamic & VC_DYNAMIC_BLEND)
+    {
+        desc->attachment_blends = NULL;
+    }
+}
+
+// Lists the dynamic states of a normalized description: its own, then the ones of its dynamic groups it does not list
+u32
+_vc_gfx_pipeline_dynamic_states(const vc_graphics_pipeline_desc *desc, VkDynamicState *states)
+{
+    u32 count = 0;
+    for(u32 i = 0; i < desc->dynamic_state_count; i++)
+    {
+        states[count++] = desc->dynamic_states[i];
+    }
+
+    for(u32 i = 0; i < _VC_DYNAMIC_STATE_COUNT; i++)
+    {
+        if(desc->static_states & _vc_dynamic_states[i].group)
+        {
+            continue;
+        }
+
+        b8 listed = FALSE;
+        for(u32 j = 0; j < desc->dynamic_state_count && !listed; j++)
+        {
+            listed = desc->dynamic_states[j] == _vc_dynamic_states[i].state;
+        }
+        if(!listed)
+        {
+            states[count++] = _vc_dynamic_states[i].state;
+        }
+    }
+
+    return count;
+}
+
+/* ---------------- Preparation ---------------- */
+
+// Copies an array of the description into the state, NULL arrays stay NULL
+void *
+_vc_pipeline_state_copy(mem_linear *arrays, const void *data, u64 size)
+{
+    if(data == NULL || size == 0)
+    {
+        return NULL;
+    }
+
+    void *copy = mem_linear_alloc(arrays, size, 8);
+    mem_memcpy(copy, (void *)data, size);
+    return copy;
+}
+
+// Returns the layout of a prepared pipeline
+VkPipelineLayout
+_vc_pipeline_state_layout(vc_pipeline_job   *job)
+{
+    if(job->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        return ( (_vc_compute_pipeline_state *)job )->comp_ci.layout;
+    }
+    return ( (_vc_gfx_pipeline_state *)job )->graphics_ci.layout;
+}
+
+// Returns the dynamic state groups of a prepared pipeline
+vc_dynamic_state_flags
+_vc_pipeline_state_dynamic(vc_pipeline_job   *job)
+{
+    if(job->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        return 0;
+    }
+    return ( (_vc_gfx_pipeline_state *)job )->dynamic;
+}
+
+// Accounts the creation feedback of a pipeline
+void
+_vc_pipeline_state_feedback(vc_ctx *ctx, vc_pipeline_job *job)
+{
+    if(job->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        _vc_compute_pipeline_state *state = (_vc_compute_pipeline_state *)job;
+        vc_pcache_feedback(&ctx->pipeline_cache, "compute pipeline", &state->feedback);
+    }
+    else
+    {
+        _vc_gfx_pipeline_state *state = (_vc_gfx_pipeline_state *)job;
+        vc_pcache_feedback(&ctx->pipeline_cache, "graphics pipeline", &state->feedback);
+    }
+}
+
+// Returns the shader stages of a prepared pipeline, and the reflection of each, for its variants
+u32
+_vc_pipeline_state_stages(vc_pipeline_job *job, VkPipelineShaderStageCreateInfo **stages, const vc_shader_reflection **reflections)
+{
+    if(job->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        _vc_compute_pipeline_state *state = (_vc_compute_pipeline_state *)job;
+        *stages        = &state->comp_ci.stage;
+        reflections[0] = state->reflection;
+        return 1;
+    }
+
+    _vc_gfx_pipeline_state *state = (_vc_gfx_pipeline_state *)job;
+    *stages        = state->stages;
+    reflections[0] = state->reflections[0];
+    reflections[1] = state->reflections[1];
+    return 2;
+}
+
+/**
+ * @brief Returns the size of a specialization constant
+ *
+ * @param reflection The reflection of the shader, may be NULL
+ * @param id The SpecId of the constant
+ * @return The size of the constant, 0 if the shader does not declare it
+ */
+u32
+_vc_spec_constant_size(const vc_shader_reflection *reflection, u32 id)
+{
+    for(u32 i = 0; reflection != NULL && i < reflection->spec_constant_count; i++)
+    {
+        if(reflection->spec_constants[i].id == id)
+        {
+            return reflection->spec_constants[i].size;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Builds the specialization info of a shader stage, with the constants the shader declares. Every constant is
+ *        given a slot of 8 bytes in the data.
+ *
+ * @param arrays The arrays of the state, the map entries and the data are allocated from
+ * @param info The specialization info to fill
+ * @param reflection The reflection of the shader
+ * @param spec The constants
+ * @return The specialization info, NULL if the shader declares none of the constants
+ */
+const VkSpecializationInfo *
+_vc_pipeline_specialize(mem_linear *arrays, VkSpecializationInfo *info, const vc_shader_reflection *reflection, const vc_specialization *spec)
+{
+    if(spec->constant_count == 0)
+    {
+        return NULL;
+    }
+
+    VkSpecializationMapEntry *entries = mem_linear_alloc(arrays, sizeof(VkSpecializationMapEntry) * spec->constant_count, 8);
+    u8 *data                          = mem_linear_alloc(arrays, sizeof(u64) * spec->constant_count, 8);
+    u32 entry_count                   = 0;
+    for(u32 i = 0; i < spec->constant_count; i++)
+    {
+        u32 size = _vc_spec_constant_size(reflection, spec->constants[i].id);
+        if(size == 0)
+        {
+            continue;
+        }
+
+        // The members of the value all start at its address
+        entries[entry_count] = (VkSpecializationMapEntry) {
+            .constantID = spec->constants[i].id,
+            .offset     = entry_count * sizeof(u64),
+            .size       = size,
+        };
+        mem_memcpy(data + entry_count * sizeof(u64), (void *)&spec->constants[i].uint64_value, size);
+        entry_count++;
+    }
+
+    if(entry_count == 0)
+    {
+        return NULL;
+    }
+
+    *info = (VkSpecializationInfo) {
+        .mapEntryCount = entry_count,
+        .pMapEntries   = entries,
+        .dataSize      = entry_count * sizeof(u64),
+        .pData         = data,
+    };
+    return info;
+}
+
+/**
+ * @brief Builds the create info of a compute pipeline, with its shader module and layout
+ *
+ * @param ctx The context
+ * @param desc The description, only used during the call
+ * @return The state of the pipeline, NULL on failure
+ */
+vc_pipeline_job *
+_vc_compute_pipeline_prepare(vc_ctx *ctx, const vc_compute_pipeline_desc *desc)
+{
+    VkShaderModule comp_module = _vc_shader_module_get(ctx, desc->code, desc->code_size);
+    VkPipelineLayout layout    = _vc_pipeline_layout_get(ctx, desc->layout_info);
+    if(comp_module == VK_NULL_HANDLE || layout == VK_NULL_HANDLE)
+    {
+        vc_error("Could not prepare a compute pipeline.");
+        return NULL;
+    }
+
+    // The entry point and the specialization are copied after the state
+    u64 entry_point_size              = strlen(desc->entry_point) + 1;
+    u64 arrays_size                   = entry_point_size + (sizeof(VkSpecializationMapEntry) + sizeof(u64) ) * desc->specialization.constant_count + 8 * 4;
+    _vc_compute_pipeline_state *state = mem_allocate(sizeof(_vc_compute_pipeline_state) + arrays_size, MEMORY_TAG_RENDERER);
+    mem_linear_create(&state->arrays, state + 1, arrays_size);
+
+    state->reflection = vc_shader_reflect(ctx, desc->code, desc->code_size);
+
+    state->comp_ci = (VkComputePipelineCreateInfo) {
+        .sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext              = _vc_pipeline_feedback_chain(ctx, &state->feedback_ci, &state->feedback, NULL),
+        .flags              = _vc_pipeline_create_flags(ctx),
+        .layout             = layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .stage              =
+        {
+            .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+            .flags               = 0, // TODO: Might want to support flags here,
+            .module              = comp_module,
+            .pName               = _vc_pipeline_state_copy(&state->arrays, desc->entry_point, entry_point_size),
+            .pSpecializationInfo = _vc_pipeline_specialize(&state->arrays, &state->spec_info, state->reflection, &desc->specialization),
+        },
+    };
+
+    state->job = (vc_pipeline_job) {
+        .dev         = ctx->current_device,
+        .cache       = ctx->pipeline_cache.cache,
+        .bind_point  = VK_PIPELINE_BIND_POINT_COMPUTE,
+        .create_info = &state->comp_ci,
+    };
+
+    return &state->job;
+}
+
+/**
+ * @brief Builds the create info of a graphics pipeline, with its shader modules and layout
+ *
+ * @param ctx The context
+ * @param desc The description, only used during the call (its arrays are copied)
+ * @param dyn_info The dynamic rendering information, only used during the call
+ * @return The state of the pipeline, NULL on failure
+ */
+vc_pipeline_job *
+_vc_gfx_pipeline_prepare(vc_ctx *ctx, const vc_graphics_pipeline_desc *desc, const vc_pipeline_rendering_info *dyn_info)
+{
+    // ## SHADER MODULES
+    VkShaderModule vert_module = _vc_shader_module_get(ctx, desc->shader_code.vertex_code, desc->shader_code.vertex_code_size);
+    VkShaderModule frag_module = _vc_shader_module_get(ctx, desc->shader_code.fragment_code, desc->shader_code.fragment_code_size);
+
+    /* ---------------- Pipeline layout ---------------- */
+    VkPipelineLayout pipe_layout = _vc_pipeline_layout_get(ctx, desc->layout_info);
+
+    if(vert_module == VK_NULL_HANDLE || frag_module == VK_NULL_HANDLE || pipe_layout == VK_NULL_HANDLE)
+    {
+        vc_error("Could not prepare a graphics pipeline.");
+        return NULL;
+    }
+
+    /* ---------------- State ---------------- */
+    u32 total_attributes = 0;
+    for(u32 i = 0; i < desc->vertex_binding_count; i++)
+    {
+        total_attributes += desc->vertex_bindings[i].attribute_count;
+    }
+
+    // Every array is copied after the state, with room for its alignment
+    u64 vert_entry_size = strlen(desc->shader_code.vertex_entry_point) + 1;
+    u64 frag_entry_size = strlen(desc->shader_code.fragment_entry_point) + 1;
+    u64 arrays_size     =
+        sizeof(VkVertexInputBindingDescription) * desc->vertex_binding_count +
+        sizeof(VkVertexInputAttributeDescription) * total_attributes +
+        (sizeof(VkViewport) + sizeof(VkRect2D) ) * desc->viewport_scissor_count +
+        sizeof(VkPipelineColorBlendAttachmentState) * desc->attachment_count +
+        sizeof(VkDynamicState) * (desc->dynamic_state_count + _VC_DYNAMIC_STATE_COUNT) +
+        sizeof(VkFormat) * dyn_info->color_attachment_count +
+        vert_entry_size + frag_entry_size +
+        (sizeof(VkSpecializationMapEntry) + sizeof(u64) ) * (desc->shader_code.vertex_specialization.constant_count + desc->shader_code.fragment_specialization.constant_count) +
+        8 * 16;
+
+    _vc_gfx_pipeline_state *state = mem_allocate(sizeof(_vc_gfx_pipeline_state) + arrays_size, MEMORY_TAG_RENDERER);
+    mem_linear_create(&state->arrays, state + 1, arrays_size);
+
+    /* ---------------- INPUT STATE ---------------- */
+    VkVertexInputBindingDescription *input_bindings     = mem_linear_alloc(&state->arrays, sizeof(VkVertexInputBindingDescription) * desc->vertex_binding_count, 8);
+    VkVertexInputAttributeDescription *input_attributes = mem_linear_alloc(&state->arrays, sizeof(VkVertexInputAttributeDescription) * total_attributes, 8);
+    u32 idx                                             = 0;
+
+    // Prepare bindings and attributes
+    for(u32 i = 0; i < desc->vertex_binding_count; i++)
+    {
+        input_bindings[i] = (VkVertexInputBindingDescription)
+        {
+            .binding   = desc->vertex_bindings[i].binding,
+            .stride    = desc->vertex_bindings[i].stride,
+            .inputRate = desc->vertex_bindings[i].input_rate,
+        };
+
+        for(u32 j = 0; j < desc->vertex_bindings[i].attribute_count; j++)
+        {
+            input_attributes[idx++] = (VkVertexInputAttributeDescription)
+            {
+                .location = desc->vertex_bindings[i].attributes[j].location,
+                .binding  = desc->vertex_bindings[i].binding,
+                .format   = desc->vertex_bindings[i].attributes[j].format,
+                .offset   = desc->vertex_bindings[i].attributes[j].offset,
+            };
+        }
+    }
+
+    state->vert_in_ci = (VkPipelineVertexInputStateCreateInfo) {
+        .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+
+        .vertexBindingDescriptionCount   = desc->vertex_binding_count,
+        .pVertexBindingDescriptions      = input_bindings,
+
+        .vertexAttributeDescriptionCount = total_attributes,
+        .pVertexAttributeDescriptions    = input_attributes,
+    };
+
+    /* ---------------- Input assembly ---------------- */
+    state->assembly_ci = (VkPipelineInputAssemblyStateCreateInfo) {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology               = desc->topology,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    /* ---------------- Tesselation ---------------- */
+    state->tesselation_ci = (VkPipelineTessellationStateCreateInfo) {
+        .sType              = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO,
+        .patchControlPoints = 0, // TODO: Expose that, as well as tesselation shader
+    };
+
+    /* ---------------- Pipeline Viewport ---------------- */
+    state->viewport_ci = (VkPipelineViewportStateCreateInfo) {
+        .sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = desc->viewport_scissor_count,
+        .scissorCount  = desc->viewport_scissor_count,
+        .pViewports    = _vc_pipeline_state_copy(&state->arrays, desc->viewports, sizeof(VkViewport) * desc->viewport_scissor_count),
+        .pScissors     = _vc_pipeline_state_copy(&state->arrays, desc->scissors, sizeof(VkRect2D) * desc->viewport_scissor_count),
+    };
+
+    /* ---------------- Rasterization ---------------- */
+    state->raster_ci = (VkPipelineRasterizationStateCreateInfo) {
+        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable        = (desc->enable_depth_clamp ? VK_TRUE : VK_FALSE),
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode             = desc->polygon_mode,
+        .cullMode                = desc->cull_mode,
+        .frontFace               = desc->front_face,
+        .depthBiasEnable         = (desc->enable_depth_bias ? VK_TRUE : VK_FALSE),
+        .depthBiasConstantFactor = desc->depth_bias_constant,
+        .depthBiasClamp          = desc->depth_bias_clamp,
+        .depthBiasSlopeFactor    = desc->depth_bias_slope,
+        .lineWidth               = desc->line_width,
+    };
+
+    /* ---------------- Multisample state ---------------- */
+    state->ms_ci = (VkPipelineMultisampleStateCreateInfo) {
+        .sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = desc->sample_count,
+        .sampleShadingEnable  = (desc->sample_shading ? VK_TRUE : VK_FALSE),
+        .minSampleShading     = desc->sample_shading_min_factor,
+
+        // TODO: Investigate this (can be dynamic by the way)
+        .pSampleMask          = NULL,
+    };
+
+    /* ---------------- Depth/stencil ---------------- */
+    state->depth_stencil_ci = (VkPipelineDepthStencilStateCreateInfo) {
+        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+
+        .depthTestEnable       = desc->depth_test,
+        .depthWriteEnable      = desc->depth_write,
+        .depthCompareOp        = desc->depth_compare_op,
+        .depthBoundsTestEnable = desc->depth_bound_test_enable,
+
+        .stencilTestEnable     = desc->stencil_test,
+        .front                 = desc->front_faces_stencil_op,
+        .back                  = desc->back_faces_stencil_op,
+        .minDepthBounds        = desc->depth_bounds_min,
+        .maxDepthBounds        = desc->depth_bounds_max,
+    };
+
+    /* ---------------- Blend ---------------- */
+    state->blend_ci = (VkPipelineColorBlendStateCreateInfo) {
+        .sType             = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable     = VK_FALSE, //TODO: Investigate LogicOp
+        .attachmentCount   = desc->attachment_count, //TODO: Maybe this can be infered from the render pass ?
+        .pAttachments      = _vc_pipeline_state_copy(&state->arrays, desc->attachment_blends, sizeof(VkPipelineColorBlendAttachmentState) * desc->attachment_count),
+
+        .blendConstants[0] = desc->blend_constants[0],
+        .blendConstants[1] = desc->blend_constants[1],
+        .blendConstants[2] = desc->blend_constants[2],
+        .blendConstants[3] = desc->blend_constants[3],
+    };
+
+    /* ---------------- Dynamic ---------------- */
+    VkDynamicState *dynamic_states = mem_linear_alloc(&state->arrays, sizeof(VkDynamicState) * (desc->dynamic_state_count + _VC_DYNAMIC_STATE_COUNT), 8);
+    state->dynamic                 = VC_DYNAMIC_ALL & ~desc->static_states;
+    state->dynamic_ci              = (VkPipelineDynamicStateCreateInfo) {
+        .sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = _vc_gfx_pipeline_dynamic_states(desc, dynamic_states),
+        .pDynamicStates    = dynamic_states,
+    };
+
+    /* ---------------- Rendering info ---------------- */
+    state->rendering_info_ci = (VkPipelineRenderingCreateInfo) {
+        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .viewMask                = dyn_info->view_mask,
+        .colorAttachmentCount    = dyn_info->color_attachment_count,
+        .pColorAttachmentFormats = _vc_pipeline_state_copy(&state->arrays, dyn_info->color_attachment_formats, sizeof(VkFormat) * dyn_info->color_attachment_count),
+        .depthAttachmentFormat   = dyn_info->depth_attachment_format,
+        .stencilAttachmentFormat = dyn_info->stencil_attachment_format,
+    };
+
+    /* ---------------- Stages ---------------- */
+    state->reflections[0] = vc_shader_reflect(ctx, desc->shader_code.vertex_code, desc->shader_code.vertex_code_size);
+    state->reflections[1] = vc_shader_reflect(ctx, desc->shader_code.fragment_code, desc->shader_code.fragment_code_size);
+
+    state->stages[0] = (VkPipelineShaderStageCreateInfo) {
+        .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage               = VK_SHADER_STAGE_VERTEX_BIT,
+        .module              = vert_module,
+        .pName               = _vc_pipeline_state_copy(&state->arrays, desc->shader_code.vertex_entry_point, vert_entry_size),
+        .pSpecializationInfo = _vc_pipeline_specialize(&state->arrays, &state->spec_infos[0], state->reflections[0], &desc->shader_code.vertex_specialization),
+    };
+    state->stages[1] = (VkPipelineShaderStageCreateInfo) {
+        .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage               = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module              = frag_module,
+        .pName               = _vc_pipeline_state_copy(&state->arrays, desc->shader_code.fragment_entry_point, frag_entry_size),
+        .pSpecializationInfo = _vc_pipeline_specialize(&state->arrays, &state->spec_infos[1], state->reflections[1], &desc->shader_code.fragment_specialization),
+    };
+
+    state->graphics_ci = (VkGraphicsPipelineCreateInfo) {
+        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext               = _vc_pipeline_feedback_chain(ctx, &state->feedback_ci, &state->feedback, &state->rendering_info_ci),
+        .flags               = _vc_pipeline_create_flags(ctx),
+        .stageCount          = 2, // TODO: Add support for geometry shader etc..
+        .pStages             = state->stages,
+        .pVertexInputState   = &state->vert_in_ci,
+        .pInputAssemblyState = &state->assembly_ci,
+        .pTessellationState  = &state->tesselation_ci,
+        .pViewportState      = &state->viewport_ci,
+        .pRasterizationState = &state->raster_ci,
+        .pMultisampleState   = &state->ms_ci,
+        .pDepthStencilState  = &state->depth_stencil_ci,
+        .pColorBlendState    = &state->blend_ci,
+        .pDynamicState       = &state->dynamic_ci,
+        .layout              = pipe_layout,
+        .basePipelineHandle  = VK_NULL_HANDLE,
+        .basePipelineIndex   = 0,
+    };
+
+    state->job = (vc_pipeline_job) {
+        .dev         = ctx->current_device,
+        .cache       = ctx->pipeline_cache.cache,
+        .bind_point  = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .create_info = &state->graphics_ci,
+    };
+
+    return &state->job;
+}
+
+/* ---------------- Deduplication ---------------- */
+
+// Canonical description of a pipeline, built field by field so that no padding is hashed
+typedef struct
+{
+    u8     *data;
+    u64     size;
+    u64     capacity;
+    u64     hash;
+} _vc_pipeline_key;
+
+#define _VC_KEY_PUSH(key, value) \
+        _vc_pipeline_key_push(key, &(value), sizeof(value) )
+
+void
+_vc_pipeline_key_push(_vc_pipeline_key *key, const void *data, u64 size)
+{
+    if(key->size + size > key->capacity)
+    {
+        u64 capacity = key->capacity * 2 > key->size + size ? key->capacity * 2 : key->size + size + 256;
+        u8 *grown    = mem_allocate(capacity, MEMORY_TAG_RENDERER);
+        if(key->data != NULL)
+        {
+            mem_memcpy(grown, key->data, key->size);
+            mem_free(key->data);
+        }
+        key->data     = grown;
+        key->capacity = capacity;
+    }
+
+    mem_memcpy(key->data + key->size, (void *)data, size);
+    key->size += size;
+}
+
+// Arrays are preceded by wether they are present, so that a NULL array differs from an array of zeroes
+void
+_vc_pipeline_key_push_array(_vc_pipeline_key *key, const void *data, u64 size)
+{
+    b8 present = data != NULL;
+    _VC_KEY_PUSH(key, present);
+    if(present)
+    {
+        _vc_pipeline_key_push(key, data, size);
+    }
+}
+
+void
+_vc_pipeline_key_push_string(_vc_pipeline_key *key, const char *string)
+{
+    _vc_pipeline_key_push(key, string, strlen(string) + 1);
+}
+
+// Only the constants declared by the shader change the pipeline, with the bytes of their size
+void
+_vc_pipeline_key_push_specialization(_vc_pipeline_key *key, const vc_shader_reflection *reflection, const vc_specialization *spec)
+{
+    u32 declared = 0;
+    for(u32 i = 0; i < spec->constant_count; i++)
+    {
+        declared += _vc_spec_constant_size(reflection, spec->constants[i].id) > 0 ? 1 : 0;
+    }
+
+    _VC_KEY_PUSH(key, declared);
+    for(u32 i = 0; i < spec->constant_count; i++)
+    {
+        u32 size = _vc_spec_constant_size(reflection, spec->constants[i].id);
+        if(size > 0)
+        {
+            _VC_KEY_PUSH(key, spec->constants[i].id);
+            _vc_pipeline_key_push(key, &spec->constants[i].uint64_value, size);
+        }
+    }
+}
+
+b8
+_vc_pipeline_key_equal(const _vc_pipeline_key *a, const _vc_pipeline_key *b)
+{
+    return a->hash == b->hash && a->size == b->size && mem_memcmp(a->data, b->data, a->size) == 0;
+}
+
+void
+_vc_pipeline_key_free(_vc_pipeline_key   *key)
+{
+    if(key->data != NULL)
+    {
+        mem_free(key->data);
+        key->data = NULL;
+    }
+}
+
+// Shader code is identified by its module, and layouts by their VkPipelineLayout, as both are hash consed
+void
+_vc_compute_pipeline_key(vc_ctx *ctx, const vc_compute_pipeline_desc *desc, _vc_pipeline_key *key)
+{
+    *key = (_vc_pipeline_key) {
+        0
+    };
+
+    VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+    VkShaderModule comp_module     = _vc_shader_module_get(ctx, desc->code, desc->code_size);
+    VkPipelineLayout layout        = _vc_pipeline_layout_get(ctx, desc->layout_info);
+
+    _VC_KEY_PUSH(key, bind_point);
+    _VC_KEY_PUSH(key, comp_module);
+    _VC_KEY_PUSH(key, layout);
+    _vc_pipeline_key_push_string(key, desc->entry_point);
+    _vc_pipeline_key_push_specialization(key, vc_shader_reflect(ctx, desc->code, desc->code_size), &desc->specialization);
+
+    key->hash = hash_bytes(key->data, key->size, 0);
+}
+
+void
+_vc_gfx_pipeline_key(vc_ctx *ctx, const vc_graphics_pipeline_desc *desc, const vc_pipeline_rendering_info *dyn_info, _vc_pipeline_key *key)
+{
+    *key = (_vc_pipeline_key) {
+        0
+    };
+
+    VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    VkShaderModule vert_module     = _vc_shader_module_get(ctx, desc->shader_code.vertex_code, desc->shader_code.vertex_code_size);
+    VkShaderModule frag_module     = _vc_shader_module_get(ctx, desc->shader_code.fragment_code, desc->shader_code.fragment_code_size);
+    VkPipelineLayout layout        = _vc_pipeline_layout_get(ctx, desc->layout_info);
+
+    _VC_KEY_PUSH(key, bind_point);
+    _VC_KEY_PUSH(key, vert_module);
+    _VC_KEY_PUSH(key, frag_module);
+    _VC_KEY_PUSH(key, layout);
+    _vc_pipeline_key_push_string(key, desc->shader_code.vertex_entry_point);
+    _vc_pipeline_key_push_string(key, desc->shader_code.fragment_entry_point);
+    _vc_pipeline_key_push_specialization(key, vc_shader_reflect(ctx, desc->shader_code.vertex_code, desc->shader_code.vertex_code_size), &desc->shader_code.vertex_specialization);
+    _vc_pipeline_key_push_specialization(key, vc_shader_reflect(ctx, desc->shader_code.fragment_code, desc->shader_code.fragment_code_size), &desc->shader_code.fragment_specialization);
+
+    // Vertex input
+    _VC_KEY_PUSH(key, desc->vertex_binding_count);
+    for(u32 i = 0; i < desc->vertex_binding_count; i++)
+    {
+        const vc_vertex_binding *binding = &desc->vertex_bindings[i];
+        _VC_KEY_PUSH(key, binding->binding);
+        _VC_KEY_PUSH(key, binding->stride);
+        _VC_KEY_PUSH(key, binding->input_rate);
+        _VC_KEY_PUSH(key, binding->attribute_count);
+        _vc_pipeline_key_push_array(key, binding->attributes, sizeof(vc_vertex_binding_attribute) * binding->attribute_count);
+    }
+    _VC_KEY_PUSH(key, desc->topology);
+
+    // Viewports
+    _VC_KEY_PUSH(key, desc->viewport_scissor_count);
+    _vc_pipeline_key_push_array(key, desc->viewports, sizeof(VkViewport) * desc->viewport_scissor_count);
+    _vc_pipeline_key_push_array(key, desc->scissors, sizeof(VkRect2D) * desc->viewport_scissor_count);
+
+    // Depth and stencil
+    _VC_KEY_PUSH(key, desc->depth_test);
+    _VC_KEY_PUSH(key, desc->depth_write);
+    _VC_KEY_PUSH(key, desc->depth_compare_op);
+    _VC_KEY_PUSH(key, desc->depth_bound_test_enable);
+    _VC_KEY_PUSH(key, desc->depth_bounds_min);
+    _VC_KEY_PUSH(key, desc->depth_bounds_max);
+    _VC_KEY_PUSH(key, desc->stencil_test);
+    _VC_KEY_PUSH(key, desc->front_faces_stencil_op);
+    _VC_KEY_PUSH(key, desc->back_faces_stencil_op);
+
+    // Rasterization
+    _VC_KEY_PUSH(key, desc->enable_depth_clamp);
+    _VC_KEY_PUSH(key, desc->polygon_mode);
+    _VC_KEY_PUSH(key, desc->cull_mode);
+    _VC_KEY_PUSH(key, desc->front_face);
+    _VC_KEY_PUSH(key, desc->line_width);
+    _VC_KEY_PUSH(key, desc->enable_depth_bias);
+    _VC_KEY_PUSH(key, desc->depth_bias_clamp);
+    _VC_KEY_PUSH(key, desc->depth_bias_constant);
+    _VC_KEY_PUSH(key, desc->depth_bias_slope);
+
+    // Multisampling
+    _VC_KEY_PUSH(key, desc->sample_count);
+    _VC_KEY_PUSH(key, desc->sample_shading);
+    _VC_KEY_PUSH(key, desc->sample_shading_min_factor);
+
+    // Attachments and dynamic states
+    _VC_KEY_PUSH(key, desc->attachment_count);
+    _vc_pipeline_key_push_array(key, desc->attachment_blends, sizeof(VkPipelineColorBlendAttachmentState) * desc->attachment_count);
+    _VC_KEY_PUSH(key, desc->blend_constants);
+    _VC_KEY_PUSH(key, desc->static_states);
+    _VC_KEY_PUSH(key, desc->dynamic_state_count);
+    _vc_pipeline_key_push_array(key, desc->dynamic_states, sizeof(VkDynamicState) * desc->dynamic_state_count);
+
+    // Rendering info
+    _VC_KEY_PUSH(key, dyn_info->view_mask);
+    _VC_KEY_PUSH(key, dyn_info->color_attachment_count);
+    _vc_pipeline_key_push_array(key, dyn_info->color_attachment_formats, sizeof(VkFormat) * dyn_info->color_attachment_count);
+    _VC_KEY_PUSH(key, dyn_info->depth_attachment_format);
+    _VC_KEY_PUSH(key, dyn_info->stencil_attachment_format);
+
+    key->hash = hash_bytes(key->data, key->size, 0);
+}
+
+// The map is keyed by hashes that are already computed
+u64
+_vc_pipeline_desc_hash(void *hash, u64 size)
+{
+    return *(u64 *)hash;
+}
+
+void
+_vc_pipeline_dedup_create(vc_ctx   *ctx)
+{
+    hashmap_create(&ctx->pipelines_by_desc, 256, sizeof(u64), sizeof(vc_handle), _vc_pipeline_desc_hash);
+    pthread_mutex_init(&ctx->pipelines_lock, NULL);
+}
+
+void
+_vc_pipeline_dedup_destroy(vc_ctx   *ctx)
+{
+    hashmap_destroy(&ctx->pipelines_by_desc);
+    pthread_mutex_destroy(&ctx->pipelines_lock);
+}
+
+// Returns the pipeline of an equal description with a new reference, VC_NULL_HANDLE if there is none
+vc_handle
+_vc_pipeline_dedup_acquire(vc_ctx *ctx, const _vc_pipeline_key *key)
+{
+    vc_handle found = VC_NULL_HANDLE;
+
+    pthread_mutex_lock(&ctx->pipelines_lock);
+    vc_handle *hndl = hashmap_lookup(&ctx->pipelines_by_desc, (void *)&key->hash);
+    if(hndl != NULL)
+    {
+        // Hash collisions are simply not deduplicated
+        _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, *hndl);
+        if(pipe->desc_key_size == key->size && mem_memcmp(pipe->desc_key, key->data, key->size) == 0)
+        {
+            pipe->refs++;
+            found = *hndl;
+        }
+    }
+    pthread_mutex_unlock(&ctx->pipelines_lock);
+
+    return found;
+}
+
+// Registers a new pipeline under its description, the pipeline takes the key
+void
+_vc_pipeline_dedup_insert(vc_ctx *ctx, vc_handle hndl, _vc_pipeline_key *key)
+{
+    pthread_mutex_lock(&ctx->pipelines_lock);
+    if(hashmap_lookup(&ctx->pipelines_by_desc, &key->hash) == NULL)
+    {
+        hashmap_insert(&ctx->pipelines_by_desc, &key->hash, &hndl);
+
+        _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+        pipe->desc_hash     = key->hash;
+        pipe->desc_key      = key->data;
+        pipe->desc_key_size = key->size;
+        key->data           = NULL;
+    }
+    pthread_mutex_unlock(&ctx->pipelines_lock);
+}
+
+vc_handle
+_vc_pipeline_retain(vc_ctx *ctx, vc_handle hndl)
+{
+    pthread_mutex_lock(&ctx->pipelines_lock);
+    _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+    pipe->refs++;
+    pthread_mutex_unlock(&ctx->pipelines_lock);
+
+    return hndl;
+}
+
+void
+_vc_pipeline_variants_free(_vc_pipeline_variant   *variants)
+{
+    if(variants == NULL)
+    {
+        return;
+    }
+
+    for(u32 i = 0; i < darray_length(variants); i++)
+    {
+        mem_free(variants[i].constants);
+    }
+    darray_destroy(variants);
+}
+
+/**
+ * @brief Drops a reference to a pipeline. The last reference makes the pipeline no longer found by its description,
+ *        and releases its variants.
+ *
+ * @param ctx The context
+ * @param hndl The pipeline
+ * @return Wether it was the last reference
+ */
+b8
+_vc_pipeline_release(vc_ctx *ctx, vc_handle hndl)
+{
+    _vc_pipeline_variant *variants = NULL;
+
+    pthread_mutex_lock(&ctx->pipelines_lock);
+    _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+    pipe->refs--;
+
+    b8 last = pipe->refs == 0;
+    if(last && pipe->desc_key != NULL)
+    {
+        hashmap_remove(&ctx->pipelines_by_desc, &pipe->desc_hash);
+    }
+    if(last)
+    {
+        variants       = pipe->variants;
+        pipe->variants = NULL;
+    }
+    pthread_mutex_unlock(&ctx->pipelines_lock);
+
+    // Variants take the lock to be released
+    for(u32 i = 0; variants != NULL && i < darray_length(variants); i++)
+    {
+        vc_handle_destroy(ctx, variants[i].pipeline);
+    }
+    _vc_pipeline_variants_free(variants);
+
+    return last;
+}
+
+/* ---------------- Pipeline libraries ---------------- */
+
+// With the graphics_pipeline_library feature, graphics pipelines are split in four parts, each compiled once as a
+// library and cached by the state it depends on. Pipelines are then fast-linked from their parts, and optionally
+// recompiled with link time optimization in the background.
+
+#define _VC_LIBRARY_PART_COUNT 4
+
+const VkGraphicsPipelineLibraryFlagsEXT _vc_library_parts[_VC_LIBRARY_PART_COUNT] =
+{
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+typedef struct
+{
+    vc_ctx                                *ctx;
+    const VkGraphicsPipelineCreateInfo    *create_info;
+} _vc_library_request;
+
+// Called without the insert lock of the library cache held: threads missing the same part may compile it concurrently,
+// the library of the first one to insert it is kept and the others are destroyed
+u64
+_vc_pipeline_library_create(_vc_library_request *request, const void *key, u64 key_size)
+{
+    VkPipeline library = VK_NULL_HANDLE;
+    VkResult res       = vkCreateGraphicsPipelines(request->ctx->current_device, request->ctx->pipeline_cache.cache, 1, request->create_info, NULL, &library);
+    if(res != VK_SUCCESS)
+    {
+        vc_error("Could not create a pipeline library (%s).", vc_priv_VkResult_to_str(res) );
+        return 0;
+    }
+
+    return (u64)library;
+}
+
+void
+_vc_pipeline_library_destroy(vc_ctx *ctx, u64 library)
+{
+    vkDestroyPipeline(ctx->current_device, (VkPipeline)library, NULL);
+}
+
+void
+_vc_pipeline_library_discard(_vc_library_request *request, u64 library)
+{
+    _vc_pipeline_library_destroy(request->ctx, library);
+}
+
+// Shaders are identified by their module, entry point and specialization
+void
+_vc_library_key_push_stage(_vc_pipeline_key *key, const VkPipelineShaderStageCreateInfo *stage)
+{
+    _VC_KEY_PUSH(key, stage->module);
+    _vc_pipeline_key_push_string(key, stage->pName);
+
+    const VkSpecializationInfo *spec = stage->pSpecializationInfo;
+    u32 entry_count                  = spec != NULL ? spec->mapEntryCount : 0;
+    _VC_KEY_PUSH(key, entry_count);
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        u32 size = (u32)spec->pMapEntries[i].size;
+        _VC_KEY_PUSH(key, spec->pMapEntries[i].constantID);
+        _VC_KEY_PUSH(key, size);
+        _vc_pipeline_key_push(key, (const u8 *)spec->pData + spec->pMapEntries[i].offset, size);
+    }
+}
+
+// Builds the key of a part from the state it depends on
+void
+_vc_library_key(_vc_gfx_pipeline_state *state, VkGraphicsPipelineLibraryFlagsEXT part, _vc_pipeline_key *key)
+{
+    *key = (_vc_pipeline_key) {
+        0
+    };
+
+    _VC_KEY_PUSH(key, part);
+    _VC_KEY_PUSH(key, state->graphics_ci.flags);
+    _VC_KEY_PUSH(key, state->dynamic_ci.dynamicStateCount);
+    _vc_pipeline_key_push_array(key, state->dynamic_ci.pDynamicStates, sizeof(VkDynamicState) * state->dynamic_ci.dynamicStateCount);
+
+    switch (part)
+    {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        // Both descriptions are made of 32 bits members only
+        _VC_KEY_PUSH(key, state->vert_in_ci.vertexBindingDescriptionCount);
+        _vc_pipeline_key_push_array(key, state->vert_in_ci.pVertexBindingDescriptions,
+                                    sizeof(VkVertexInputBindingDescription) * state->vert_in_ci.vertexBindingDescriptionCount);
+        _VC_KEY_PUSH(key, state->vert_in_ci.vertexAttributeDescriptionCount);
+        _vc_pipeline_key_push_array(key, state->vert_in_ci.pVertexAttributeDescriptions,
+                                    sizeof(VkVertexInputAttributeDescription) * state->vert_in_ci.vertexAttributeDescriptionCount);
+        _VC_KEY_PUSH(key, state->assembly_ci.topology);
+        _VC_KEY_PUSH(key, state->assembly_ci.primitiveRestartEnable);
+        break;
+
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        _VC_KEY_PUSH(key, state->graphics_ci.layout);
+        _vc_library_key_push_stage(key, &state->stages[0]);
+        _VC_KEY_PUSH(key, state->viewport_ci.viewportCount);
+        _vc_pipeline_key_push_array(key, state->viewport_ci.pViewports, sizeof(VkViewport) * state->viewport_ci.viewportCount);
+        _vc_pipeline_key_push_array(key, state->viewport_ci.pScissors, sizeof(VkRect2D) * state->viewport_ci.scissorCount);
+        _VC_KEY_PUSH(key, state->raster_ci.depthClampEnable);
+        _VC_KEY_PUSH(key, state->raster_ci.rasterizerDiscardEnable);
+        _VC_KEY_PUSH(key, state->raster_ci.polygonMode);
+        _VC_KEY_PUSH(key, state->raster_ci.cullMode);
+        _VC_KEY_PUSH(key, state->raster_ci.frontFace);
+        _VC_KEY_PUSH(key, state->raster_ci.depthBiasEnable);
+        _VC_KEY_PUSH(key, state->raster_ci.depthBiasConstantFactor);
+        _VC_KEY_PUSH(key, state->raster_ci.depthBiasClamp);
+        _VC_KEY_PUSH(key, state->raster_ci.depthBiasSlopeFactor);
+        _VC_KEY_PUSH(key, state->raster_ci.lineWidth);
+        _VC_KEY_PUSH(key, state->tesselation_ci.patchControlPoints);
+        _VC_KEY_PUSH(key, state->rendering_info_ci.viewMask);
+        break;
+
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        _VC_KEY_PUSH(key, state->graphics_ci.layout);
+        _vc_library_key_push_stage(key, &state->stages[1]);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.depthTestEnable);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.depthWriteEnable);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.depthCompareOp);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.depthBoundsTestEnable);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.stencilTestEnable);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.front);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.back);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.minDepthBounds);
+        _VC_KEY_PUSH(key, state->depth_stencil_ci.maxDepthBounds);
+        _VC_KEY_PUSH(key, state->ms_ci.rasterizationSamples);
+        _VC_KEY_PUSH(key, state->ms_ci.sampleShadingEnable);
+        _VC_KEY_PUSH(key, state->ms_ci.minSampleShading);
+        _VC_KEY_PUSH(key, state->rendering_info_ci.viewMask);
+        break;
+
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+        _VC_KEY_PUSH(key, state->blend_ci.logicOpEnable);
+        _VC_KEY_PUSH(key, state->blend_ci.attachmentCount);
+        _vc_pipeline_key_push_array(key, state->blend_ci.pAttachments, sizeof(VkPipelineColorBlendAttachmentState) * state->blend_ci.attachmentCount);
+        _VC_KEY_PUSH(key, state->blend_ci.blendConstants);
+        _VC_KEY_PUSH(key, state->ms_ci.rasterizationSamples);
+        _VC_KEY_PUSH(key, state->ms_ci.sampleShadingEnable);
+        _VC_KEY_PUSH(key, state->ms_ci.minSampleShading);
+        _VC_KEY_PUSH(key, state->rendering_info_ci.viewMask);
+        _VC_KEY_PUSH(key, state->rendering_info_ci.colorAttachmentCount);
+        _vc_pipeline_key_push_array(key, state->rendering_info_ci.pColorAttachmentFormats, sizeof(VkFormat) * state->rendering_info_ci.colorAttachmentCount);
+        _VC_KEY_PUSH(key, state->rendering_info_ci.depthAttachmentFormat);
+        _VC_KEY_PUSH(key, state->rendering_info_ci.stencilAttachmentFormat);
+        break;
+
+    default:
+        break;
+    }
+
+    key->hash = hash_bytes(key->data, key->size, 0);
+}
+
+// Returns the create info of a part of a graphics pipeline, the library info of the part is chained into it
+VkGraphicsPipelineCreateInfo
+_vc_library_create_info(_vc_gfx_pipeline_state *state, VkGraphicsPipelineLibraryCreateInfoEXT *part_ci)
+{
+    VkGraphicsPipelineCreateInfo create_info =
+    {
+        .sType         = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext         = part_ci,
+        .flags         = state->graphics_ci.flags | VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT,
+        .pDynamicState = &state->dynamic_ci,
+    };
+
+    switch (part_ci->flags)
+    {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        create_info.pVertexInputState   = &state->vert_in_ci;
+        create_info.pInputAssemblyState = &state->assembly_ci;
+        break;
+
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        create_info.stageCount          = 1;
+        create_info.pStages             = &state->stages[0];
+        create_info.pViewportState      = &state->viewport_ci;
+        create_info.pRasterizationState = &state->raster_ci;
+        create_info.pTessellationState  = &state->tesselation_ci;
+        create_info.layout              = state->graphics_ci.layout;
+        break;
+
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        create_info.stageCount         = 1;
+        create_info.pStages            = &state->stages[1];
+        create_info.pDepthStencilState = &state->depth_stencil_ci;
+        create_info.pMultisampleState  = &state->ms_ci;
+        create_info.layout             = state->graphics_ci.layout;
+        break;
+
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+        create_info.pColorBlendState  = &state->blend_ci;
+        create_info.pMultisampleState = &state->ms_ci;
+        break;
+
+    default:
+        break;
+    }
+
+    return create_info;
+}
+
+/**
+ * @brief Fast-links a prepared graphics pipeline from its parts, compiling the parts that are not cached yet. The job
+ *        of the state then links the optimized pipeline from the same parts.
+ *
+ * @param ctx The context
+ * @param job The prepared pipeline
+ * @param linked[out] The linked pipeline
+ * @return The result of the creation
+ */
+VkResult
+_vc_gfx_pipeline_link(vc_ctx *ctx, vc_pipeline_job *job, VkPipeline *linked)
+{
+    _vc_gfx_pipeline_state *state = (_vc_gfx_pipeline_state *)job;
+    for(u32 i = 0; i < _VC_LIBRARY_PART_COUNT; i++)
+    {
+        // The rendering info is only read by the parts needing it
+        VkGraphicsPipelineLibraryCreateInfoEXT part_ci =
+        {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+            .pNext = &state->rendering_info_ci,
+            .flags = _vc_library_parts[i],
+        };
+        VkGraphicsPipelineCreateInfo create_info = _vc_library_create_info(state, &part_ci);
+        _vc_library_request request              =
+        {
+            .ctx         = ctx,
+            .create_info = &create_info,
+        };
+
+        _vc_pipeline_key key;
+        _vc_library_key(state, _vc_library_parts[i], &key);
+        state->libraries[i] = (VkPipeline)vc_ocache_get_unlocked(&ctx->pipeline_libraries, key.data, key.size, (vc_ocache_create_func)_vc_pipeline_library_create,
+                                                                  (vc_ocache_destroy_func)_vc_pipeline_library_discard, &request);
+        _vc_pipeline_key_free(&key);
+
+        if(state->libraries[i] == VK_NULL_HANDLE)
+        {
+            return VK_ERROR_UNKNOWN;
+        }
+    }
+
+    state->library_ci = (VkPipelineLibraryCreateInfoKHR) {
+        .sType        = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .libraryCount = _VC_LIBRARY_PART_COUNT,
+        .pLibraries   = state->libraries,
+    };
+
+    VkGraphicsPipelineCreateInfo link_ci =
+    {
+        .sType  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext  = &state->library_ci,
+        .flags  = state->graphics_ci.flags,
+        .layout = state->graphics_ci.layout,
+    };
+    VkResult res = vkCreateGraphicsPipelines(ctx->current_device, ctx->pipeline_cache.cache, 1, &link_ci, NULL, linked);
+    if(res != VK_SUCCESS)
+    {
+        return res;
+    }
+
+    state->link_ci        = link_ci;
+    state->link_ci.pNext  = _vc_pipeline_feedback_chain(ctx, &state->link_feedback_ci, &state->feedback, &state->library_ci);
+    state->link_ci.flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+    state->job.create_info = &state->link_ci;
+    return VK_SUCCESS;
+}
+
+// Binds the fast-linked pipeline until the optimized one is compiled in the background
 void
-_vc_compute_pipeline_destroy(vc_ctx *ctx, _vc_compute_pipeline_intern *c)
+_vc_gfx_pipeline_optimize(vc_ctx *ctx, vc_handle hndl)
 {
-    vkDestroyPipelineLayout(ctx->current_device, c->layout, NULL);
-    vkDestroyPipeline(ctx->current_device, c->pipeline, NULL);
+    if(!ctx->optimize_linked_pipelines)
+    {
+        return;
+    }
+
+    // The handle is neither returned nor found by its description yet, no other thread can resolve it
+    _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, hndl);
+    pipe->linked              = pipe->pipeline;
+    pipe->pipeline            = VK_NULL_HANDLE;
+    vc_pipeline_compiler_submit(&ctx->pipeline_compiler, pipe->state);
+    __atomic_store_n(&pipe->pending, pipe->state, __ATOMIC_RELEASE);
 }
 
-void
-_vc_gfx_pipeline_destroy(vc_ctx *ctx, _vc_gfx_pipeline_intern *c)
+/* ---------------- Creation ---------------- */
+
+// The pipeline takes the state, kept to create its variants, NULL for variants
+vc_handle
+_vc_pipeline_register(vc_ctx *ctx, VkPipelineBindPoint bind_point, VkPipeline pipeline, VkPipelineLayout layout, vc_handle fallback, vc_pipeline_job *pending, vc_pipeline_job *state)
 {
-    vkDestroyPipelineLayout(ctx->current_device, c->layout, NULL);
-    vkDestroyPipeline(ctx->current_device, c->pipeline, NULL);
+    b8 compute = bind_point == VK_PIPELINE_BIND_POINT_COMPUTE;
+
+    _vc_pipeline_intern pipe_i =
+    {
+        .type     = compute ? VC_PIPELINE_COMPUTE : VC_PIPELINE_GRAPHICS,
+        .pipeline = pipeline,
+        .linked   = VK_NULL_HANDLE,
+        .layout   = layout,
+        .fallback = fallback,
+        .pending  = pending,
+        .refs     = 1,
+        .desc_key = NULL,
+        .state    = state,
+        .variants = NULL,
+
+        .dynamic_states = state != NULL ? _vc_pipeline_state_dynamic(state) : 0,
+    };
+
+    vc_handle_type type = compute ? VC_HANDLE_COMPUTE_PIPELINE : VC_HANDLE_GFX_PIPELINE;
+    vc_handle hndl      = vc_handles_manager_walloc(&ctx->handles_manager, type, &pipe_i);
+    vc_handles_manager_set_destroy_function(&ctx->handles_manager, type, (vc_handle_destroy_func)_vc_pipeline_destroy);
+    return hndl;
 }
 
-VkPipelineLayout
-_vc_pipeline_layout_create(vc_ctx *ctx, vc_pipeline_layout_info layout_info)
+/**
+ * @brief Creates prepared pipelines of the same kind with a single call. Pipelines prepared twice in the batch are
+ *        only created once, and every new pipeline is registered under its description.
+ *
+ * @param ctx The context
+ * @param bind_point The kind of pipelines
+ * @param count The number of pipelines
+ * @param jobs The prepared pipelines, NULL for the existing pipelines and the ones whose preparation failed, the states
+ *             are taken by the new pipelines or freed
+ * @param keys The descriptions of the pipelines, taken by the new pipelines
+ * @param pipelines[in, out] The existing pipelines, or VC_NULL_HANDLE. All VC_NULL_HANDLE if one of them failed.
+ * @return Wether every pipeline could be created
+ */
+b8
+_vc_pipelines_create(vc_ctx *ctx, VkPipelineBindPoint bind_point, u32 count, vc_pipeline_job **jobs, _vc_pipeline_key *keys, vc_handle *pipelines)
 {
-    VkPipelineLayout layout            = VK_NULL_HANDLE;
-    VkDescriptorSetLayout *set_layouts = alloca(sizeof(VkDescriptorSetLayout) * layout_info.set_layout_count);
-    for(u32 i = 0; i < layout_info.set_layout_count; i++)
+    u32 *sources             = mem_allocate(sizeof(u32) * count, MEMORY_TAG_RENDERER); // Index of the job creating each pipeline
+    vc_pipeline_job **unique = mem_allocate(sizeof(vc_pipeline_job *) * count, MEMORY_TAG_RENDERER);
+    u32 unique_count         = 0;
+    b8 success               = TRUE;
+
+    for(u32 i = 0; i < count; i++)
+    {
+        sources[i] = i;
+        if(pipelines[i] != VC_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        if(jobs[i] == NULL)
+        {
+            success = FALSE;
+            continue;
+        }
+
+        // The first equal job is always the one creating the pipeline
+        for(u32 j = 0; j < i; j++)
+        {
+            if(jobs[j] != NULL && _vc_pipeline_key_equal(&keys[i], &keys[j]) )
+            {
+                sources[i] = j;
+                break;
+            }
+        }
+
+        if(sources[i] == i)
+        {
+            unique[unique_count++] = jobs[i];
+        }
+    }
+
+    VkPipeline *vk_pipelines = mem_allocate(sizeof(VkPipeline) * (unique_count + 1), MEMORY_TAG_RENDERER);
+    mem_memset(vk_pipelines, 0, sizeof(VkPipeline) * (unique_count + 1) );
+
+    if(success && unique_count > 0)
     {
-        _vc_descriptor_set_layout_intern *sl_i = vc_handles_manager_deref(&ctx->handles_manager, layout_info.set_layouts[i]);
-        set_layouts[i] = sl_i->layout;
+        VkResult res = VK_SUCCESS;
+        if(bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+        {
+            VkComputePipelineCreateInfo *comp_cis = mem_allocate(sizeof(VkComputePipelineCreateInfo) * unique_count, MEMORY_TAG_RENDERER);
+            for(u32 i = 0; i < unique_count; i++)
+            {
+                comp_cis[i] = *(const VkComputePipelineCreateInfo *)unique[i]->create_info;
+            }
+            res = vkCreateComputePipelines(ctx->current_device, ctx->pipeline_cache.cache, unique_count, comp_cis, NULL, vk_pipelines);
+            mem_free(comp_cis);
+        }
+        else if(ctx->supported_features.graphics_pipeline_library)
+        {
+            for(u32 i = 0; i < unique_count && res == VK_SUCCESS; i++)
+            {
+                res = _vc_gfx_pipeline_link(ctx, unique[i], &vk_pipelines[i]);
+            }
+        }
+        else
+        {
+            VkGraphicsPipelineCreateInfo *graphics_cis = mem_allocate(sizeof(VkGraphicsPipelineCreateInfo) * unique_count, MEMORY_TAG_RENDERER);
+            for(u32 i = 0; i < unique_count; i++)
+            {
+                graphics_cis[i] = *(const VkGraphicsPipelineCreateInfo *)unique[i]->create_info;
+            }
+            res = vkCreateGraphicsPipelines(ctx->current_device, ctx->pipeline_cache.cache, unique_count, graphics_cis, NULL, vk_pipelines);
+            mem_free(graphics_cis);
+        }
+
+        if(res != VK_SUCCESS)
+        {
+            vc_error("Could not create %u pipelines (%s).", unique_count, vc_priv_VkResult_to_str(res) );
+            success = FALSE;
+        }
     }
 
-    VkPipelineLayoutCreateInfo layout_ci =
+    u32 created = 0;
+    for(u32 i = 0; i < count; i++)
     {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount         = layout_info.set_layout_count,
-        .pSetLayouts            = set_layouts,
-        .pushConstantRangeCount = layout_info.push_constants_count,
-        .pPushConstantRanges    = layout_info.push_constants,
-    };
+        if(jobs[i] == NULL)
+        {
+            // Existing pipelines lose the reference they were given
+            if(!success && pipelines[i] != VC_NULL_HANDLE)
+            {
+                vc_handle_destroy(ctx, pipelines[i]);
+                pipelines[i] = VC_NULL_HANDLE;
+            }
+            continue;
+        }
+
+        if(sources[i] == i)
+        {
+            VkPipeline vk_pipeline = vk_pipelines[created++];
+            if(success)
+            {
+                _vc_pipeline_state_feedback(ctx, jobs[i]);
+                pipelines[i] = _vc_pipeline_register(ctx, bind_point, vk_pipeline, _vc_pipeline_state_layout(jobs[i]), VC_NULL_HANDLE, NULL, jobs[i]);
+                if(bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS && ctx->supported_features.graphics_pipeline_library)
+                {
+                    _vc_gfx_pipeline_optimize(ctx, pipelines[i]);
+                }
+                _vc_pipeline_dedup_insert(ctx, pipelines[i], &keys[i]);
+                continue;
+            }
+            else
+            {
+                // Some of the pipelines may have been created
+                vkDestroyPipeline(ctx->current_device, vk_pipeline, NULL);
+            }
+        }
+        else
+        {
+            pipelines[i] = success ? _vc_pipeline_retain(ctx, pipelines[sources[i]]) : VC_NULL_HANDLE;
+        }
+
+        mem_free(jobs[i]);
+    }
+
+    mem_free(vk_pipelines);
+    mem_free(unique);
+    mem_free(sources);
+    return success;
+}
 
-    VK_CHECKH(vkCreatePipelineLayout(ctx->current_device, &layout_ci, NULL, &layout), "Could not create a pipeline's layout.");
-    return layout;
+vc_handle
+_vc_pipeline_create_async(vc_ctx *ctx, vc_pipeline_job *job, _vc_pipeline_key *key, vc_handle fallback)
+{
+    if(job == NULL)
+    {
+        return VC_NULL_HANDLE;
+    }
+
+    // The handle is registered once the job is submitted, the job may be done before that
+    VkPipelineBindPoint bind_point = job->bind_point;
+    VkPipelineLayout layout        = _vc_pipeline_state_layout(job);
+    vc_pipeline_compiler_submit(&ctx->pipeline_compiler, job);
+
+    vc_handle hndl = _vc_pipeline_register(ctx, bind_point, VK_NULL_HANDLE, layout, fallback, job, job);
+    _vc_pipeline_dedup_insert(ctx, hndl, key);
+    return hndl;
 }
 
 vc_compute_pipeline
@@ -52,54 +1931,60 @@ vc_compute_pipeline_create(
     vc_pipeline_layout_info    layout_info
     )
 {
-    // Shader stage
-
-    VkShaderModuleCreateInfo mod_ci =
+    vc_compute_pipeline_desc desc =
     {
-        .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .pCode    = (const u32 *)code,
-        .codeSize = code_size,
+        .code        = code,
+        .code_size   = code_size,
+        .entry_point = entry_point,
+        .layout_info = layout_info,
     };
 
-    VkShaderModule comp_module = VK_NULL_HANDLE;
-    VK_CHECKH(vkCreateShaderModule(ctx->current_device, &mod_ci, NULL, &comp_module), "Could not create shader module.");
+    vc_compute_pipeline hndl = VC_NULL_HANDLE;
+    vc_compute_pipelines_create(ctx, 1, &desc, &hndl);
+    return hndl;
+}
 
-    VkPipelineShaderStageCreateInfo comp_stage =
+b8
+vc_compute_pipelines_create(vc_ctx *ctx, u32 count, const vc_compute_pipeline_desc *descs, vc_compute_pipeline *pipelines)
+{
+    vc_pipeline_job **jobs = mem_allocate(sizeof(vc_pipeline_job *) * count, MEMORY_TAG_RENDERER);
+    _vc_pipeline_key *keys = mem_allocate(sizeof(_vc_pipeline_key) * count, MEMORY_TAG_RENDERER);
+    for(u32 i = 0; i < count; i++)
     {
-        .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
-        .flags               = 0, // TODO: Might want to support flags here,
-        .module              = comp_module,
-        .pName               = entry_point,
-        .pSpecializationInfo = NULL,
-    };
+        vc_compute_pipeline_desc desc = descs[i];
+        _vc_compute_pipeline_desc_reflect(ctx, &desc);
 
-    // PIPELINE LAYOUT
-
-    _vc_compute_pipeline_intern comp_i =
-    {
-        0
-    };
+        _vc_compute_pipeline_key(ctx, &desc, &keys[i]);
+        pipelines[i] = _vc_pipeline_dedup_acquire(ctx, &keys[i]);
+        jobs[i]      = pipelines[i] != VC_NULL_HANDLE ? NULL : _vc_compute_pipeline_prepare(ctx, &desc);
+    }
 
-    comp_i.layout = _vc_pipeline_layout_create(ctx, layout_info);
+    b8 success = _vc_pipelines_create(ctx, VK_PIPELINE_BIND_POINT_COMPUTE, count, jobs, keys, pipelines);
 
-    VkComputePipelineCreateInfo comp_ci =
+    for(u32 i = 0; i < count; i++)
     {
-        .sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .flags              = 0,
-        .layout             = comp_i.layout,
-        .basePipelineHandle = VK_NULL_HANDLE,
-        .stage              = comp_stage,
-    };
+        _vc_pipeline_key_free(&keys[i]);
+    }
+    mem_free(keys);
+    mem_free(jobs);
+    return success;
+}
 
-    VK_CHECKH(vkCreateComputePipelines(ctx->current_device, VK_NULL_HANDLE, 1, &comp_ci, NULL, &comp_i.pipeline), "Could not create compute pipeline.");
-    vkDestroyShaderModule(ctx->current_device, comp_module, NULL);
+vc_compute_pipeline
+vc_compute_pipeline_create_async(vc_ctx *ctx, vc_compute_pipeline_desc desc, vc_compute_pipeline fallback)
+{
+    _vc_compute_pipeline_desc_reflect(ctx, &desc);
 
-    comp_i.type = VC_PIPELINE_COMPUTE;
+    _vc_pipeline_key key;
+    _vc_compute_pipeline_key(ctx, &desc, &key);
 
-    vc_compute_pipeline hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_COMPUTE_PIPELINE, &comp_i);
-    vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_COMPUTE_PIPELINE, (vc_handle_destroy_func)_vc_compute_pipeline_destroy);
+    vc_compute_pipeline hndl = _vc_pipeline_dedup_acquire(ctx, &key);
+    if(hndl == VC_NULL_HANDLE)
+    {
+        hndl = _vc_pipeline_create_async(ctx, _vc_compute_pipeline_prepare(ctx, &desc), &key, fallback);
+    }
 
+    _vc_pipeline_key_free(&key);
     return hndl;
 }
 
@@ -110,236 +1995,394 @@ vc_gfx_pipeline_dynamic_create(
     vc_pipeline_rendering_info    dyn_info
     )
 {
-    // ## SHADER MODULES
-    VkShaderModuleCreateInfo vert_ci =
-    {
-        .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = desc.shader_code.vertex_code_size,
-        .pCode    = (const u32 *)desc.shader_code.vertex_code,
-    };
+    vc_gfx_pipeline hndl = VC_NULL_HANDLE;
+    vc_gfx_pipelines_dynamic_create(ctx, 1, &desc, &dyn_info, &hndl);
+    return hndl;
+}
 
-    VkShaderModuleCreateInfo frag_ci =
+b8
+vc_gfx_pipelines_dynamic_create(vc_ctx *ctx, u32 count, const vc_graphics_pipeline_desc *descs, const vc_pipeline_rendering_info *dyn_infos, vc_gfx_pipeline *pipelines)
+{
+    vc_pipeline_job **jobs = mem_allocate(sizeof(vc_pipeline_job *) * count, MEMORY_TAG_RENDERER);
+    _vc_pipeline_key *keys = mem_allocate(sizeof(_vc_pipeline_key) * count, MEMORY_TAG_RENDERER);
+    for(u32 i = 0; i < count; i++)
     {
-        .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = desc.shader_code.fragment_code_size,
-        .pCode    = (const u32 *)desc.shader_code.fragment_code,
-    };
+        vc_graphics_pipeline_desc desc = descs[i];
+        _vc_gfx_pipeline_desc_reflect(ctx, &desc);
+        _vc_gfx_pipeline_desc_normalize(ctx, &desc);
 
-    VkShaderModule vert_module;
-    VkShaderModule frag_module;
-
-    VK_CHECKH(vkCreateShaderModule(ctx->current_device, &vert_ci, NULL, &vert_module), "Could not create a graphical pipline's vertex shader module.");
-    VK_CHECKH(vkCreateShaderModule(ctx->current_device, &frag_ci, NULL, &frag_module), "Could not create a graphical pipline's fragment shader module.");
+        _vc_gfx_pipeline_key(ctx, &desc, &dyn_infos[i], &keys[i]);
+        pipelines[i] = _vc_pipeline_dedup_acquire(ctx, &keys[i]);
+        jobs[i]      = pipelines[i] != VC_NULL_HANDLE ? NULL : _vc_gfx_pipeline_prepare(ctx, &desc, &dyn_infos[i]);
+    }
 
-    /* ---------------- INPUT STATE ---------------- */
-    VkVertexInputBindingDescription *input_bindings = alloca(sizeof(VkVertexInputBindingDescription) * desc.vertex_binding_count);
-    u32 total_attributes                            = 0;
+    b8 success = _vc_pipelines_create(ctx, VK_PIPELINE_BIND_POINT_GRAPHICS, count, jobs, keys, pipelines);
 
-    // Prepare bindings
-    for(int i = 0; i < desc.vertex_binding_count; i++)
+    for(u32 i = 0; i < count; i++)
     {
-        input_bindings[i] = (VkVertexInputBindingDescription)
-        {
-            .binding   = desc.vertex_bindings[i].binding,
-            .stride    = desc.vertex_bindings[i].stride,
-            .inputRate = desc.vertex_bindings[i].input_rate,
-        };
+        _vc_pipeline_key_free(&keys[i]);
+    }
+    mem_free(keys);
+    mem_free(jobs);
+    return success;
+}
+
+vc_gfx_pipeline
+vc_gfx_pipeline_dynamic_create_async(vc_ctx *ctx, vc_graphics_pipeline_desc desc, vc_pipeline_rendering_info dyn_info, vc_gfx_pipeline fallback)
+{
+    _vc_gfx_pipeline_desc_reflect(ctx, &desc);
+    _vc_gfx_pipeline_desc_normalize(ctx, &desc);
+
+    _vc_pipeline_key key;
+    _vc_gfx_pipeline_key(ctx, &desc, &dyn_info, &key);
 
-        total_attributes += desc.vertex_bindings[i].attribute_count;
+    vc_gfx_pipeline hndl = _vc_pipeline_dedup_acquire(ctx, &key);
+    if(hndl == VC_NULL_HANDLE)
+    {
+        hndl = _vc_pipeline_create_async(ctx, _vc_gfx_pipeline_prepare(ctx, &desc, &dyn_info), &key, fallback);
     }
 
-    VkVertexInputAttributeDescription *input_attributes = alloca(sizeof(VkVertexInputAttributeDescription) * total_attributes);
-    u32 idx                                             = 0;
+    _vc_pipeline_key_free(&key);
+    return hndl;
+}
 
-    // Prepare attributes
-    for(int i = 0; i < desc.vertex_binding_count; i++)
+/* ---------------- Asynchronous pipelines ---------------- */
+
+/**
+ * @brief Takes the result of the compilation of a pipeline if it is done, thread safe
+ *
+ * @param ctx The context
+ * @param pipe The pipeline
+ * @param wait Wether to wait for the compilation
+ * @return Wether the pipeline is compiled (FALSE if the compilation failed)
+ */
+b8
+_vc_pipeline_resolve(vc_ctx *ctx, _vc_pipeline_intern *pipe, b8 wait)
+{
+    if(__atomic_load_n(&pipe->pending, __ATOMIC_ACQUIRE) != NULL)
     {
-        for(int j = 0; j < desc.vertex_bindings[i].attribute_count; j++)
+        vc_pipeline_job *job = vc_pipeline_compiler_take(&ctx->pipeline_compiler, &pipe->pending, &pipe->pipeline, wait);
+        if(job != NULL)
         {
-            input_attributes[idx++] = (VkVertexInputAttributeDescription)
+            if(job->result != VK_SUCCESS)
             {
-                .location = desc.vertex_bindings[i].attributes[j].location,
-                .binding  = desc.vertex_bindings[i].binding,
-                .format   = desc.vertex_bindings[i].attributes[j].format,
-                .offset   = desc.vertex_bindings[i].attributes[j].offset,
-            };
+                vc_error("Could not compile a pipeline asynchronously (%s).", vc_priv_VkResult_to_str(job->result) );
+            }
+            _vc_pipeline_state_feedback(ctx, job);
+        }
+
+        if(__atomic_load_n(&pipe->pending, __ATOMIC_ACQUIRE) != NULL)
+        {
+            return FALSE;
         }
     }
 
-    VkPipelineVertexInputStateCreateInfo vert_in_ci =
+    return pipe->pipeline != VK_NULL_HANDLE;
+}
+
+VkPipeline
+_vc_pipeline_bindable(vc_ctx *ctx, _vc_pipeline_intern *pipe)
+{
+    // Without fallback nor fast-linked pipeline, the compilation is waited for
+    if(_vc_pipeline_resolve(ctx, pipe, pipe->fallback == VC_NULL_HANDLE && pipe->linked == VK_NULL_HANDLE) )
     {
-        .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        return pipe->pipeline;
+    }
 
-        .vertexBindingDescriptionCount = desc.vertex_binding_count,
-        .pVertexBindingDescriptions    = input_bindings,
+    if(pipe->linked != VK_NULL_HANDLE)
+    {
+        return pipe->linked;
+    }
 
-        .vertexAttributeDescriptionCount = total_attributes,
-        .pVertexAttributeDescriptions    = input_attributes,
-    };
+    if(pipe->fallback == VC_NULL_HANDLE)
+    {
+        return VK_NULL_HANDLE;
+    }
 
-    /* ---------------- Input assembly ---------------- */
-    VkPipelineInputAssemblyStateCreateInfo assembly_ci =
+    return _vc_pipeline_bindable(ctx, vc_handles_manager_deref(&ctx->handles_manager, pipe->fallback) );
+}
+
+b8
+vc_pipeline_is_ready(vc_ctx *ctx, vc_handle pipeline)
+{
+    _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, pipeline);
+    return _vc_pipeline_resolve(ctx, pipe, FALSE) || pipe->linked != VK_NULL_HANDLE;
+}
+
+void
+vc_pipelines_wait(vc_ctx   *ctx)
+{
+    vc_pipeline_compiler_wait_all(&ctx->pipeline_compiler);
+}
+
+/* ---------------- Variants ---------------- */
+
+// Returns the variant of a pipeline with equal constants with a new reference, VC_NULL_HANDLE if there is none. Requires the pipelines lock.
+vc_handle
+_vc_pipeline_variant_find(vc_ctx *ctx, _vc_pipeline_intern *pipe, u64 hash, u64 *constants, u32 constant_count)
+{
+    for(u32 i = 0; pipe->variants != NULL && i < darray_length(pipe->variants); i++)
     {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology               = desc.topology,
-        .primitiveRestartEnable = VK_FALSE,
-    };
+        _vc_pipeline_variant *variant = &pipe->variants[i];
+        if(variant->hash == hash && variant->constant_count == constant_count &&
+           mem_memcmp(variant->constants, constants, sizeof(u64) * 2 * constant_count) == 0)
+        {
+            _vc_pipeline_intern *variant_pipe = vc_handles_manager_deref(&ctx->handles_manager, variant->pipeline);
+            variant_pipe->refs++;
+            return variant->pipeline;
+        }
+    }
 
-    /* ---------------- Tesselation ---------------- */
-    VkPipelineTessellationStateCreateInfo tesselation_ci =
+    return VC_NULL_HANDLE;
+}
+
+/**
+ * @brief Normalizes the constants of a variant: sorted by id, without the ones no stage declares, and with the bytes of
+ *        their size only, so that equal variants have equal constants
+ *
+ * @param reflections The reflections of the stages of the pipeline
+ * @param stage_count The number of stages
+ * @param spec The constants
+ * @param constants[out] Id and value pairs, with room for a pair per constant of spec
+ * @return The number of pairs
+ */
+u32
+_vc_pipeline_variant_constants(const vc_shader_reflection **reflections, u32 stage_count, const vc_specialization *spec, u64 *constants)
+{
+    u32 count = 0;
+    for(u32 i = 0; i < spec->constant_count; i++)
     {
-        .sType              = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO,
-        .patchControlPoints = 0, // TODO: Expose that, as well as tesselation shader
-    };
+        u32 id   = spec->constants[i].id;
+        u32 size = 0;
+        for(u32 s = 0; s < stage_count && size == 0; s++)
+        {
+            size = _vc_spec_constant_size(reflections[s], id);
+        }
 
-    /* ---------------- Pipeline Viewport ---------------- */
-    VkPipelineViewportStateCreateInfo viewport_ci =
+        if(size == 0)
+        {
+            vc_warn("Specialization constant %u is not declared by the pipeline, it is ignored.", id);
+            continue;
+        }
+
+        // The value keeps the bytes of the constant at its start
+        u64 value = 0;
+        mem_memcpy(&value, (void *)&spec->constants[i].uint64_value, size);
+
+        u32 at = 0;
+        while(at < count && constants[at * 2] < id)
+        {
+            at++;
+        }
+
+        // A constant given twice keeps its last value
+        if(at == count || constants[at * 2] != id)
+        {
+            mem_memmove(&constants[(at + 1) * 2], &constants[at * 2], sizeof(u64) * 2 * (count - at) );
+            count++;
+        }
+        constants[at * 2]     = id;
+        constants[at * 2 + 1] = value;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Builds the specialization info of a stage of a variant: the constants of the base pipeline, replaced or
+ *        completed by the constants of the variant that the stage declares
+ *
+ * @param base The specialization info of the stage in the base pipeline, may be NULL
+ * @param reflection The reflection of the shader of the stage
+ * @param constants The normalized constants of the variant
+ * @param constant_count The number of constants
+ * @param info The specialization info to fill
+ * @param entries[out] Room for the entries of the base and the constants of the variant
+ * @param data[out] Room for as many slots of 8 bytes
+ * @return The specialization info, NULL if the stage has no constant
+ */
+const VkSpecializationInfo *
+_vc_pipeline_variant_specialize(
+    const VkSpecializationInfo    *base,
+    const vc_shader_reflection    *reflection,
+    const u64                     *constants,
+    u32                            constant_count,
+    VkSpecializationInfo          *info,
+    VkSpecializationMapEntry      *entries,
+    u64                           *data
+    )
+{
+    u32 entry_count = 0;
+    for(u32 i = 0; base != NULL && i < base->mapEntryCount; i++)
     {
-        .sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .viewportCount = desc.viewport_scissor_count,
-        .scissorCount  = desc.viewport_scissor_count,
-        .pViewports    = desc.viewports,
-        .pScissors     = desc.scissors,
-    };
+        entries[entry_count]        = base->pMapEntries[i];
+        entries[entry_count].offset = entry_count * sizeof(u64);
+        data[entry_count]           = 0;
+        mem_memcpy(&data[entry_count], (u8 *)base->pData + base->pMapEntries[i].offset, base->pMapEntries[i].size);
+        entry_count++;
+    }
 
-    /* ---------------- Rasterization ---------------- */
-    VkPipelineRasterizationStateCreateInfo raster_ci =
+    for(u32 c = 0; c < constant_count; c++)
     {
-        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .depthClampEnable        = (desc.enable_depth_clamp ? VK_TRUE : VK_FALSE),
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode             = desc.polygon_mode,
-        .cullMode                = desc.cull_mode,
-        .frontFace               = desc.front_face,
-        .depthBiasEnable         = (desc.enable_depth_bias ? VK_TRUE : VK_FALSE),
-        .depthBiasConstantFactor = desc.depth_bias_constant,
-        .depthBiasClamp          = desc.depth_bias_clamp,
-        .depthBiasSlopeFactor    = desc.depth_bias_slope,
-        .lineWidth               = desc.line_width,
-    };
+        u32 id   = (u32)constants[c * 2];
+        u32 size = _vc_spec_constant_size(reflection, id);
+        if(size == 0)
+        {
+            continue;
+        }
 
-    /* ---------------- Multisample state ---------------- */
-    VkPipelineMultisampleStateCreateInfo ms_ci =
+        u32 e = 0;
+        while(e < entry_count && entries[e].constantID != id)
+        {
+            e++;
+        }
+
+        if(e == entry_count)
+        {
+            entries[entry_count++] = (VkSpecializationMapEntry) {
+                .constantID = id,
+                .offset     = e * sizeof(u64),
+                .size       = size,
+            };
+        }
+        data[e] = constants[c * 2 + 1];
+    }
+
+    if(entry_count == 0)
     {
-        .sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .rasterizationSamples = desc.sample_count,
-        .sampleShadingEnable  = (desc.sample_shading ? VK_TRUE : VK_FALSE),
-        .minSampleShading     = desc.sample_shading_min_factor,
+        return NULL;
+    }
 
-        // TODO: Investigate this (can be dynamic by the way)
-        .pSampleMask          = NULL,
+    *info = (VkSpecializationInfo) {
+        .mapEntryCount = entry_count,
+        .pMapEntries   = entries,
+        .dataSize      = entry_count * sizeof(u64),
+        .pData         = data,
     };
+    return info;
+}
 
-    /* ---------------- Depth/stencil ---------------- */
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_ci =
+// Creates the pipeline of a variant from the state of its base, synchronously
+VkPipeline
+_vc_pipeline_variant_compile(vc_ctx *ctx, vc_pipeline_job *state, u64 *constants, u32 constant_count)
+{
+    VkPipelineShaderStageCreateInfo *base_stages = NULL;
+    const vc_shader_reflection *reflections[2]   = { 0 };
+    u32 stage_count                              = _vc_pipeline_state_stages(state, &base_stages, reflections);
+
+    VkPipelineShaderStageCreateInfo stages[2];
+    VkSpecializationInfo spec_infos[2];
+    for(u32 s = 0; s < stage_count; s++)
     {
-        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        const VkSpecializationInfo *base  = base_stages[s].pSpecializationInfo;
+        u32 entry_count                   = (base != NULL ? base->mapEntryCount : 0) + constant_count + 1;
+        VkSpecializationMapEntry *entries = alloca(sizeof(VkSpecializationMapEntry) * entry_count);
+        u64 *data                         = alloca(sizeof(u64) * entry_count);
 
-        .depthTestEnable       = desc.depth_test,
-        .depthWriteEnable      = desc.depth_write,
-        .depthCompareOp        = desc.depth_compare_op,
-        .depthBoundsTestEnable = desc.depth_bound_test_enable,
+        stages[s]                     = base_stages[s];
+        stages[s].pSpecializationInfo = _vc_pipeline_variant_specialize(base, reflections[s], constants, constant_count, &spec_infos[s], entries, data);
+    }
 
-        .stencilTestEnable = desc.stencil_test,
-        .front             = desc.front_faces_stencil_op,
-        .back              = desc.back_faces_stencil_op,
-        .minDepthBounds    = desc.depth_bounds_min,
-        .maxDepthBounds    = desc.depth_bounds_max,
-    };
+    VkPipelineCreationFeedbackCreateInfo feedback_ci;
+    VkPipelineCreationFeedback feedback;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult res        = VK_SUCCESS;
+    if(state->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        VkComputePipelineCreateInfo comp_ci = *(const VkComputePipelineCreateInfo *)state->create_info;
+        comp_ci.pNext = _vc_pipeline_feedback_chain(ctx, &feedback_ci, &feedback, NULL);
+        comp_ci.stage = stages[0];
+        res           = vkCreateComputePipelines(ctx->current_device, ctx->pipeline_cache.cache, 1, &comp_ci, NULL, &pipeline);
+    }
+    else
+    {
+        VkGraphicsPipelineCreateInfo graphics_ci = ( (_vc_gfx_pipeline_state *)state )->graphics_ci; // The job may link the pipeline from libraries
+        graphics_ci.pNext   = _vc_pipeline_feedback_chain(ctx, &feedback_ci, &feedback, &( (_vc_gfx_pipeline_state *)state )->rendering_info_ci);
+        graphics_ci.pStages = stages;
+        res                 = vkCreateGraphicsPipelines(ctx->current_device, ctx->pipeline_cache.cache, 1, &graphics_ci, NULL, &pipeline);
+    }
 
-    /* ---------------- Blend ---------------- */
-    VkPipelineColorBlendStateCreateInfo blend_ci =
+    if(res != VK_SUCCESS)
     {
-        .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .logicOpEnable   = VK_FALSE,   //TODO: Investigate LogicOp
-        .attachmentCount = desc.attachment_count,   //TODO: Maybe this can be infered from the render pass ?
-        .pAttachments    = desc.attachment_blends,
+        vc_error("Could not create a pipeline variant (%s).", vc_priv_VkResult_to_str(res) );
+        return VK_NULL_HANDLE;
+    }
 
-        .blendConstants[0] = desc.blend_constants[0],
-        .blendConstants[1] = desc.blend_constants[1],
-        .blendConstants[2] = desc.blend_constants[2],
-        .blendConstants[3] = desc.blend_constants[3],
-    };
+    vc_pcache_feedback(&ctx->pipeline_cache, "pipeline variant", &feedback);
+    return pipeline;
+}
 
-    /* ---------------- Dynamic ---------------- */
-    VkPipelineDynamicStateCreateInfo dynamic_ci =
+vc_handle
+vc_pipeline_variant(vc_ctx *ctx, vc_handle base, vc_specialization specialization)
+{
+    _vc_pipeline_intern *pipe = vc_handles_manager_deref(&ctx->handles_manager, base);
+    if(pipe->state == NULL)
     {
-        .sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .dynamicStateCount = desc.dynamic_state_count,
-        .pDynamicStates    = desc.dynamic_states,
-    };
+        vc_error("Pipeline variants can only be created from a base pipeline.");
+        return VC_NULL_HANDLE;
+    }
 
+    // The state lives as long as the base pipeline, and is only read
+    vc_pipeline_job *state                     = pipe->state;
+    VkPipelineShaderStageCreateInfo *stages    = NULL;
+    const vc_shader_reflection *reflections[2] = { 0 };
+    u32 stage_count                            = _vc_pipeline_state_stages(state, &stages, reflections);
 
+    u64 *constants     = alloca(sizeof(u64) * 2 * (specialization.constant_count + 1) );
+    u32 constant_count = _vc_pipeline_variant_constants(reflections, stage_count, &specialization, constants);
+    u64 hash           = hash_bytes(constants, sizeof(u64) * 2 * constant_count, 0);
 
-    /* ---------------- Pipeline layout ---------------- */
-    VkPipelineLayout pipe_layout = _vc_pipeline_layout_create(ctx, desc.layout_info);
+    pthread_mutex_lock(&ctx->pipelines_lock);
+    vc_handle hndl = _vc_pipeline_variant_find(ctx, pipe, hash, constants, constant_count);
+    pthread_mutex_unlock(&ctx->pipelines_lock);
 
-    /* ---------------- Rendering info ---------------- */
-    VkPipelineRenderingCreateInfo rendering_info_ci =
+    if(hndl != VC_NULL_HANDLE)
     {
-        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
-        .viewMask                = dyn_info.view_mask,
-        .colorAttachmentCount    = dyn_info.color_attachment_count,
-        .pColorAttachmentFormats = (VkFormat *)dyn_info.color_attachment_formats,
-        .depthAttachmentFormat   = dyn_info.depth_attachment_format,
-        .stencilAttachmentFormat = dyn_info.stencil_attachment_format,
-    };
+        return hndl;
+    }
+
+    VkPipeline vk_pipeline = _vc_pipeline_variant_compile(ctx, state, constants, constant_count);
+    if(vk_pipeline == VK_NULL_HANDLE)
+    {
+        return VC_NULL_HANDLE;
+    }
+
+    // The reference the variant is created with belongs to its base
+    vc_handle created = _vc_pipeline_register(ctx, state->bind_point, vk_pipeline, _vc_pipeline_state_layout(state), VC_NULL_HANDLE, NULL, NULL);
 
-    VkGraphicsPipelineCreateInfo graphics_ci =
+    pthread_mutex_lock(&ctx->pipelines_lock);
+    ( (_vc_pipeline_intern *)vc_handles_manager_deref(&ctx->handles_manager, created) )->dynamic_states = pipe->dynamic_states;
+    hndl = _vc_pipeline_variant_find(ctx, pipe, hash, constants, constant_count);
+    if(hndl == VC_NULL_HANDLE)
     {
-        .sType      = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext      = &rendering_info_ci,
-        .stageCount = 2, // TODO: Add support for geometry shader etc..
-        .pStages    = (VkPipelineShaderStageCreateInfo[2])
+        _vc_pipeline_variant variant =
         {
-            [0] =
-            {
-                .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .stage               = VK_SHADER_STAGE_VERTEX_BIT,
-                .module              = vert_module,
-                .pName               = desc.shader_code.vertex_entry_point,
-                .pSpecializationInfo = NULL,
-            },
-            [1] =
-            {
-                .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .stage               = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .module              = frag_module,
-                .pName               = desc.shader_code.fragment_entry_point,
-                .pSpecializationInfo = NULL,
-            },
-        },
-        .pVertexInputState   = &vert_in_ci,
-        .pInputAssemblyState = &assembly_ci,
-        .pTessellationState  = &tesselation_ci,
-        .pViewportState      = &viewport_ci,
-        .pRasterizationState = &raster_ci,
-        .pMultisampleState   = &ms_ci,
-        .pDepthStencilState  = &depth_stencil_ci,
-        .pColorBlendState    = &blend_ci,
-        .pDynamicState       = &dynamic_ci,
-        .layout              = pipe_layout,
-        .basePipelineHandle  = VK_NULL_HANDLE,
-        .basePipelineIndex   = 0,
-    };
+            .hash           = hash,
+            .constant_count = constant_count,
+            .constants      = mem_allocate(sizeof(u64) * 2 * (constant_count + 1), MEMORY_TAG_RENDERER),
+            .pipeline       = created,
+        };
+        mem_memcpy(variant.constants, constants, sizeof(u64) * 2 * constant_count);
 
-    VkPipeline pipeline = VK_NULL_HANDLE;
-    VK_CHECKH(vkCreateGraphicsPipelines(ctx->current_device, VK_NULL_HANDLE, 1, &graphics_ci, NULL, &pipeline), "Could not create a graphics pipeline.");
+        if(pipe->variants == NULL)
+        {
+            pipe->variants = darray_create(_vc_pipeline_variant);
+        }
+        darray_push(pipe->variants, variant);
 
-    /* ---------------- Cleanup ---------------- */
+        _vc_pipeline_intern *variant_pipe = vc_handles_manager_deref(&ctx->handles_manager, created);
+        variant_pipe->refs++;
 
-    vkDestroyShaderModule(ctx->current_device, vert_module, NULL);
-    vkDestroyShaderModule(ctx->current_device, frag_module, NULL);
+        hndl    = created;
+        created = VC_NULL_HANDLE;
+    }
+    pthread_mutex_unlock(&ctx->pipelines_lock);
 
-    _vc_gfx_pipeline_intern pipe_i =
+    // Another thread created the same variant meanwhile
+    if(created != VC_NULL_HANDLE)
     {
-        .layout   = pipe_layout,
-        .pipeline = pipeline,
-        .type     = VC_PIPELINE_GRAPHICS,
-    };
+        vc_handle_destroy(ctx, created);
+    }
 
-    vc_gfx_pipeline hndl = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_GFX_PIPELINE, &pipe_i);
-    vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_GFX_PIPELINE, (vc_handle_destroy_func)_vc_gfx_pipeline_destroy);
     return hndl;
 }
-
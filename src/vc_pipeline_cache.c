@@ -0,0 +1,234 @@
+#include "vc_pipeline_cache.h"
+#include "vulcain.h"
+#include "vc_enum_util.h"
+#include "base/hash.h"
+#include <stdio.h>
+#include <string.h>
+
+#define _VC_PCACHE_MAGIC   0x43504356 // "VCPC"
+#define _VC_PCACHE_VERSION 1
+
+// Fills the identity of the device and driver
+void
+_vc_pcache_identity(VkPhysicalDevice phy, u32 api_version, _vc_pcache_header *identity)
+{
+    *identity = (_vc_pcache_header) {
+        .magic   = _VC_PCACHE_MAGIC,
+        .version = _VC_PCACHE_VERSION,
+    };
+
+    VkPhysicalDeviceIDProperties id_props =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+    };
+    VkPhysicalDeviceProperties2 props =
+    {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &id_props,
+    };
+
+    if(api_version >= VK_API_VERSION_1_1)
+    {
+        vkGetPhysicalDeviceProperties2(phy, &props);
+        mem_memcpy(identity->driver_uuid, id_props.driverUUID, VK_UUID_SIZE);
+    }
+    else
+    {
+        vkGetPhysicalDeviceProperties(phy, &props.properties);
+    }
+
+    identity->vendor_id      = props.properties.vendorID;
+    identity->device_id      = props.properties.deviceID;
+    identity->driver_version = props.properties.driverVersion;
+    mem_memcpy(identity->pipeline_cache_uuid, props.properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Reads the cache data of a file, NULL if there is none or if it was not written by this device and driver
+void *
+_vc_pcache_read(const char *path, const _vc_pcache_header *identity, u64 *data_size)
+{
+    u64 file_size = 0;
+    u8 *file      = fio_read_whole_file(path, &file_size);
+    if(file == NULL)
+    {
+        vc_info("No pipeline cache file at '%s', starting from an empty cache.", path);
+        return NULL;
+    }
+
+    _vc_pcache_header header;
+    if(file_size < sizeof(header) )
+    {
+        vc_warn("Pipeline cache file '%s' is truncated, ignoring it.", path);
+        mem_free(file);
+        return NULL;
+    }
+    mem_memcpy(&header, file, sizeof(header) );
+
+    // Only the identity is compared, the size and checksum are checked against the data
+    _vc_pcache_header expected = *identity;
+    expected.data_size = header.data_size;
+    expected.checksum  = header.checksum;
+    if(mem_memcmp(&header, &expected, sizeof(header) ) != 0)
+    {
+        vc_info("Pipeline cache file '%s' was written by another device or driver, ignoring it.", path);
+        mem_free(file);
+        return NULL;
+    }
+
+    if(header.data_size != file_size - sizeof(header) || hash_bytes(file + sizeof(header), header.data_size, 0) != header.checksum)
+    {
+        vc_warn("Pipeline cache file '%s' is damaged, ignoring it.", path);
+        mem_free(file);
+        return NULL;
+    }
+
+    void *data = mem_allocate(header.data_size, MEMORY_TAG_RENDERER);
+    mem_memcpy(data, file + sizeof(header), header.data_size);
+    mem_free(file);
+
+    *data_size = header.data_size;
+    return data;
+}
+
+b8
+vc_pcache_create(vc_pipeline_cache *cache, VkPhysicalDevice phy, VkDevice dev, u32 api_version, const char *path)
+{
+    *cache = (vc_pipeline_cache) {
+        .cache    = VK_NULL_HANDLE,
+        .path     = NULL,
+        .feedback = api_version >= VK_API_VERSION_1_3,
+    };
+    _vc_pcache_identity(phy, api_version, &cache->identity);
+
+    void *data    = NULL;
+    u64 data_size = 0;
+    if(path != NULL)
+    {
+        cache->path = mem_allocate(strlen(path) + 1, MEMORY_TAG_RENDERER);
+        strcpy(cache->path, path);
+
+        data = _vc_pcache_read(path, &cache->identity, &data_size);
+    }
+
+    VkPipelineCacheCreateInfo cache_ci =
+    {
+        .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data_size,
+        .pInitialData    = data,
+    };
+    VkResult res = vkCreatePipelineCache(dev, &cache_ci, NULL, &cache->cache);
+    if(res != VK_SUCCESS && data != NULL)
+    {
+        // The driver may still reject the data, start over empty
+        vc_warn("Pipeline cache data of '%s' rejected by the driver (%s), ignoring it.", path, vc_priv_VkResult_to_str(res) );
+        cache_ci.initialDataSize = 0;
+        cache_ci.pInitialData    = NULL;
+        res                      = vkCreatePipelineCache(dev, &cache_ci, NULL, &cache->cache);
+    }
+
+    if(data != NULL)
+    {
+        vc_info("Loaded %lu bytes of pipeline cache from '%s'.", data_size, path);
+        mem_free(data);
+    }
+
+    VK_CHECKR(res, "Could not create the pipeline cache.");
+    return TRUE;
+}
+
+b8
+vc_pcache_save(vc_pipeline_cache *cache, VkDevice dev)
+{
+    if(cache->path == NULL || cache->cache == VK_NULL_HANDLE)
+    {
+        return FALSE;
+    }
+
+    u64 data_size = 0;
+    VK_CHECKR(vkGetPipelineCacheData(dev, cache->cache, &data_size, NULL), "Could not get the pipeline cache size.");
+
+    u8 *data = mem_allocate(sizeof(_vc_pcache_header) + data_size, MEMORY_TAG_RENDERER);
+    VkResult res = vkGetPipelineCacheData(dev, cache->cache, &data_size, data + sizeof(_vc_pcache_header) );
+    if(res != VK_SUCCESS)
+    {
+        vc_error("Could not get the pipeline cache data (%s).", vc_priv_VkResult_to_str(res) );
+        mem_free(data);
+        return FALSE;
+    }
+
+    _vc_pcache_header header = cache->identity;
+    header.data_size = data_size;
+    header.checksum  = hash_bytes(data + sizeof(header), data_size, 0);
+    mem_memcpy(data, &header, sizeof(header) );
+
+    // Written next to the file, then renamed over it
+    u64 path_length = strlen(cache->path);
+    char *tmp_path  = mem_allocate(path_length + 5, MEMORY_TAG_RENDERER);
+    sprintf(tmp_path, "%s.tmp", cache->path);
+
+    b8 success = FALSE;
+    FILE *f    = fopen(tmp_path, "wb");
+    if(f != NULL)
+    {
+        success = fwrite(data, sizeof(header) + data_size, 1, f) == 1;
+        success = (fclose(f) == 0) && success;
+        success = success && rename(tmp_path, cache->path) == 0;
+        if(!success)
+        {
+            remove(tmp_path);
+        }
+    }
+
+    if(success)
+    {
+        vc_info("Saved %lu bytes of pipeline cache to '%s'.", data_size, cache->path);
+    }
+    else
+    {
+        vc_error("Could not write the pipeline cache to '%s'.", cache->path);
+    }
+
+    mem_free(tmp_path);
+    mem_free(data);
+    return success;
+}
+
+void
+vc_pcache_destroy(vc_pipeline_cache *cache, VkDevice dev)
+{
+    if(cache->cache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    if(cache->pipelines > 0)
+    {
+        vc_info("Pipeline cache: %lu of %lu pipelines were cache hits, %.1f ms spent creating pipelines.",
+                cache->cache_hits, cache->pipelines, cache->creation_ns / 1e6);
+    }
+
+    vkDestroyPipelineCache(dev, cache->cache, NULL);
+    if(cache->path != NULL)
+    {
+        mem_free(cache->path);
+    }
+
+    cache->cache = VK_NULL_HANDLE;
+    cache->path  = NULL;
+}
+
+void
+vc_pcache_feedback(vc_pipeline_cache *cache, const char *name, const VkPipelineCreationFeedback *feedback)
+{
+    if( !(feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) )
+    {
+        return;
+    }
+
+    b8 hit = (feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) != 0;
+    __atomic_fetch_add(&cache->pipelines, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cache->cache_hits, hit ? 1 : 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cache->creation_ns, feedback->duration, __ATOMIC_RELAXED);
+
+    vc_debug("Created %s in %.2f ms (%s).", name, feedback->duration / 1e6, hit ? "pipeline cache hit" : "compiled");
+}
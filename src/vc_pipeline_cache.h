@@ -0,0 +1,74 @@
+#ifndef __VC_PIPELINE_CACHE__
+#define __VC_PIPELINE_CACHE__
+
+/*
+ * Persistent pipeline cache.
+ * Every pipeline of the context is created through a single VkPipelineCache, loaded from a file when the device is
+ * created and written back when the context is destroyed. The file starts with a header identifying the device and
+ * driver it was written by, and a checksum of the cache data: a file written by another device or driver, or damaged,
+ * is ignored. Files are written to a temporary file first and renamed, so a crash never leaves a truncated cache.
+ */
+
+#include <vulkan/vulkan.h>
+#include "base/types.h"
+
+typedef struct
+{
+    u32    magic;
+    u32    version;
+    u32    vendor_id;
+    u32    device_id;
+    u32    driver_version;
+    u32    reserved; // Keeps the header free of padding, it is compared byte for byte
+    u8     pipeline_cache_uuid[VK_UUID_SIZE];
+    u8     driver_uuid[VK_UUID_SIZE]; // Zero before Vulkan 1.1
+    u64    data_size;
+    u64    checksum; // Of the data following the header
+} _vc_pcache_header;
+
+typedef struct
+{
+    VkPipelineCache      cache;
+    char                *path; // NULL if the cache is not persisted
+    _vc_pcache_header    identity; // Header of the files written by this device, without size nor checksum
+    b8                   feedback; // Wether pipeline creation feedback is available (Vulkan 1.3)
+
+    // Creation feedback, atomic
+    u64                  pipelines;
+    u64                  cache_hits;
+    u64                  creation_ns;
+} vc_pipeline_cache;
+
+/**
+ * @brief Creates the pipeline cache, with the data of the file if it is valid for the device
+ *
+ * @param cache The cache
+ * @param phy The physical device
+ * @param dev The device
+ * @param api_version The Vulkan version usable with the device
+ * @param path The cache file (NULL for a cache that is not persisted)
+ * @return Wether the cache could be created
+ */
+b8   vc_pcache_create(vc_pipeline_cache *cache, VkPhysicalDevice phy, VkDevice dev, u32 api_version, const char *path);
+
+/**
+ * @brief Writes the cache to its file, atomically
+ *
+ * @param cache The cache
+ * @param dev The device
+ * @return Wether the cache could be written (FALSE if it is not persisted)
+ */
+b8   vc_pcache_save(vc_pipeline_cache *cache, VkDevice dev);
+
+void vc_pcache_destroy(vc_pipeline_cache *cache, VkDevice dev);
+
+/**
+ * @brief Accounts and logs the creation feedback of a pipeline
+ *
+ * @param cache The cache
+ * @param name A name for the pipeline in the logs
+ * @param feedback The feedback of the whole pipeline
+ */
+void vc_pcache_feedback(vc_pipeline_cache *cache, const char *name, const VkPipelineCreationFeedback *feedback);
+
+#endif // __VC_PIPELINE_CACHE__
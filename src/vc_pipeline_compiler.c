@@ -0,0 +1,109 @@
+#include "vc_pipeline_compiler.h"
+
+void
+vc_pipeline_compiler_create(vc_pipeline_compiler   *compiler)
+{
+    compiler->workers_created = FALSE;
+    pthread_mutex_init(&compiler->lock, NULL);
+    pthread_cond_init(&compiler->job_done, NULL);
+}
+
+void
+vc_pipeline_compiler_destroy(vc_pipeline_compiler   *compiler)
+{
+    if(compiler->workers_created)
+    {
+        thread_pool_destroy(&compiler->workers);
+        compiler->workers_created = FALSE;
+    }
+
+    pthread_cond_destroy(&compiler->job_done);
+    pthread_mutex_destroy(&compiler->lock);
+}
+
+// Worker job
+void
+_vc_pipeline_compile(vc_pipeline_job   *job)
+{
+    if(job->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        job->result = vkCreateComputePipelines(job->dev, job->cache, 1, job->create_info, NULL, &job->pipeline);
+    }
+    else
+    {
+        job->result = vkCreateGraphicsPipelines(job->dev, job->cache, 1, job->create_info, NULL, &job->pipeline);
+    }
+
+    pthread_mutex_lock(&job->compiler->lock);
+    __atomic_store_n(&job->done, TRUE, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&job->compiler->job_done);
+    pthread_mutex_unlock(&job->compiler->lock);
+}
+
+void
+vc_pipeline_compiler_submit(vc_pipeline_compiler *compiler, vc_pipeline_job *job)
+{
+    job->compiler = compiler;
+    job->pipeline = VK_NULL_HANDLE;
+    job->result   = VK_NOT_READY;
+    job->done     = FALSE;
+
+    // Async pipelines may be created from several threads, the first one creates the workers
+    pthread_mutex_lock(&compiler->lock);
+    if(!compiler->workers_created)
+    {
+        compiler->workers_created = thread_pool_create(&compiler->workers, 0);
+    }
+    b8 workers_created = compiler->workers_created;
+    pthread_mutex_unlock(&compiler->lock);
+
+    if(!workers_created)
+    {
+        _vc_pipeline_compile(job);
+        return;
+    }
+
+    thread_pool_submit(&compiler->workers, (thread_pool_job_func)_vc_pipeline_compile, job);
+}
+
+b8
+vc_pipeline_job_done(vc_pipeline_job   *job)
+{
+    return __atomic_load_n(&job->done, __ATOMIC_ACQUIRE);
+}
+
+vc_pipeline_job *
+vc_pipeline_compiler_take(vc_pipeline_compiler *compiler, vc_pipeline_job **pending, VkPipeline *pipeline, b8 wait)
+{
+    pthread_mutex_lock(&compiler->lock);
+
+    vc_pipeline_job *job = *pending;
+    while(wait && job != NULL && !vc_pipeline_job_done(job) )
+    {
+        pthread_cond_wait(&compiler->job_done, &compiler->lock);
+        job = *pending; // May have been taken by another thread in the meantime
+    }
+
+    if(job != NULL && vc_pipeline_job_done(job) )
+    {
+        // Threads seeing no pending job see the pipeline
+        *pipeline = job->pipeline;
+        __atomic_store_n(pending, NULL, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        job = NULL;
+    }
+
+    pthread_mutex_unlock(&compiler->lock);
+    return job;
+}
+
+void
+vc_pipeline_compiler_wait_all(vc_pipeline_compiler   *compiler)
+{
+    if(compiler->workers_created)
+    {
+        thread_pool_wait_idle(&compiler->workers);
+    }
+}
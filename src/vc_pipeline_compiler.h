@@ -0,0 +1,72 @@
+#ifndef __VC_PIPELINE_COMPILER__
+#define __VC_PIPELINE_COMPILER__
+
+/*
+ * Asynchronous pipeline compilation.
+ * Pipelines created asynchronously are compiled by a pool of worker threads, created on the first asynchronous
+ * pipeline, with one thread per core. A job only runs vkCreate*Pipelines: its create info, and everything it points
+ * to, must stay alive until the job is done.
+ */
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include "base/types.h"
+#include "base/thread_pool.h"
+
+typedef struct vc_pipeline_compiler vc_pipeline_compiler;
+
+typedef struct
+{
+    vc_pipeline_compiler    *compiler;
+    VkDevice                 dev;
+    VkPipelineCache          cache;
+
+    VkPipelineBindPoint      bind_point; // Graphics or compute
+    const void              *create_info; // A VkGraphicsPipelineCreateInfo, or a VkComputePipelineCreateInfo
+
+    // Results
+    VkPipeline               pipeline;
+    VkResult                 result;
+    b8                       done; // Atomic
+} vc_pipeline_job;
+
+struct vc_pipeline_compiler
+{
+    thread_pool        workers;
+    b8                 workers_created; // Created on the first job, under the lock
+
+    pthread_mutex_t    lock;
+    pthread_cond_t     job_done;
+};
+
+void             vc_pipeline_compiler_create(vc_pipeline_compiler   *compiler);
+
+// Waits for every job, and destroys the workers
+void             vc_pipeline_compiler_destroy(vc_pipeline_compiler   *compiler);
+
+/**
+ * @brief Submits a job, it is compiled on the calling thread if the workers could not be created
+ *
+ * @param compiler The compiler
+ * @param job The job, with its device, cache, bind point and create info set
+ */
+void             vc_pipeline_compiler_submit(vc_pipeline_compiler *compiler, vc_pipeline_job *job);
+
+// Returns wether a job is done, without blocking
+b8               vc_pipeline_job_done(vc_pipeline_job   *job);
+
+/**
+ * @brief Takes a job out of the pointer referencing it once it is done, thread safe
+ *
+ * @param compiler The compiler
+ * @param pending The pointer to the job, set to NULL (with a release store) when the job is taken
+ * @param pipeline Where to store the pipeline of the job, before pending is cleared
+ * @param wait Wether to wait for the job to be done
+ * @return The job, to be freed by the caller, or NULL if it is not done or was taken by another thread
+ */
+vc_pipeline_job *vc_pipeline_compiler_take(vc_pipeline_compiler *compiler, vc_pipeline_job **pending, VkPipeline *pipeline, b8 wait);
+
+// Blocks until every submitted job is done
+void             vc_pipeline_compiler_wait_all(vc_pipeline_compiler   *compiler);
+
+#endif // __VC_PIPELINE_COMPILER__
@@ -0,0 +1,284 @@
+/**
+ * @file
+ * @brief Asynchronous GPU to CPU readbacks, completed by frame fences.
+ */
+
+#include "vulcain.h"
+#include "handles/vc_internal_types.h"
+#include "vc_enum_util.h"
+#include "base/data_structures/darray.h"
+
+// Readback buffers are allocated by multiples of this size, so they can be reused by readbacks of similar sizes
+#define VC_READBACK_GRANULARITY (64 * 1024)
+
+b8 _vc_host_buffer_create(vc_ctx *ctx, u64 size, VkBufferUsageFlags usage, VmaAllocationCreateFlags host_access, VkBuffer *buffer, VmaAllocation *alloc, void **mapped);
+
+void
+vc_readback_pool_create(vc_readback_pool   *pool)
+{
+    pool->slots = darray_create(_vc_readback_slot);
+}
+
+void
+vc_readback_pool_destroy(vc_readback_pool *pool, VmaAllocator allocator)
+{
+    for(u32 i = 0; i < darray_length(pool->slots); i++)
+    {
+        vmaDestroyBuffer(allocator, pool->slots[i].buffer, pool->slots[i].alloc);
+    }
+    darray_destroy(pool->slots);
+    pool->slots = NULL;
+}
+
+// Tickets pack the generation of the slot in the high bits, and the slot index + 1 in the low bits
+vc_readback_ticket
+_vc_readback_ticket_pack(u32 index, u32 generation)
+{
+    return ( (u64)generation << 32 ) | (u64)(index + 1);
+}
+
+_vc_readback_slot *
+_vc_readback_ticket_deref(vc_ctx *ctx, vc_readback_ticket ticket)
+{
+    u32 index      = (u32)(ticket & 0xFFFFFFFF);
+    u32 generation = (u32)(ticket >> 32);
+
+    if(index == 0 || index > darray_length(ctx->readbacks.slots) )
+    {
+        vc_error("Invalid readback ticket.");
+        return NULL;
+    }
+
+    _vc_readback_slot *slot = &ctx->readbacks.slots[index - 1];
+    if(!slot->in_use || slot->generation != generation)
+    {
+        vc_error("Readback ticket was already released.");
+        return NULL;
+    }
+
+    return slot;
+}
+
+// Finds the smallest free buffer able to hold size bytes, or allocates a new one
+i32
+_vc_readback_acquire_slot(vc_ctx *ctx, u64 size)
+{
+    vc_readback_pool *pool = &ctx->readbacks;
+
+    i32 best = -1;
+    for(u32 i = 0; i < darray_length(pool->slots); i++)
+    {
+        _vc_readback_slot *slot = &pool->slots[i];
+        if(slot->in_use || slot->capacity < size)
+        {
+            continue;
+        }
+
+        if(best == -1 || slot->capacity < pool->slots[best].capacity)
+        {
+            best = i;
+        }
+    }
+
+    if(best != -1)
+    {
+        return best;
+    }
+
+    _vc_readback_slot slot =
+    {
+        0
+    };
+    slot.capacity = (size + VC_READBACK_GRANULARITY - 1) / VC_READBACK_GRANULARITY * VC_READBACK_GRANULARITY;
+
+    // Random host access prefers cached memory, reading from uncached memory is very slow
+    if(!_vc_host_buffer_create(ctx, slot.capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, &slot.buffer, &slot.alloc, &slot.mapped))
+    {
+        return -1;
+    }
+
+    darray_push(pool->slots, slot);
+    return darray_length(pool->slots) - 1;
+}
+
+// Returns the size of the tightly packed texels of an image region, 0 if the copy cannot be sized
+u64
+_vc_readback_image_size(_vc_image_intern *img, const vc_readback_region *region)
+{
+    // Copies to buffers are made aspect by aspect
+    VkImageAspectFlags aspect = region->subresource.aspectMask;
+    if(aspect == 0 || (aspect & (aspect - 1) ) != 0)
+    {
+        return 0;
+    }
+
+    u32 block_width  = 1;
+    u32 block_height = 1;
+    u64 block_size   = vc_format_aspect_block_size(img->image_format, aspect, &block_width, &block_height);
+
+    VkExtent3D extent = region->image_extent;
+    u64 blocks_x      = (extent.width + block_width - 1) / block_width;
+    u64 blocks_y      = (extent.height + block_height - 1) / block_height;
+    return blocks_x * blocks_y * extent.depth * region->subresource.layerCount * block_size;
+}
+
+vc_readback_ticket
+vc_cmd_readback(vc_cmd_record record, vc_handle source, vc_readback_region region)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx *ctx                    = buf->record_ctx;
+
+    vc_handle_type type = vc_handles_manager_get_type(&ctx->handles_manager, source);
+    if(type != VC_HANDLE_BUFFER && type != VC_HANDLE_IMAGE)
+    {
+        vc_error("Readbacks can only be made from buffers and images.");
+        return 0;
+    }
+
+    // The copy writes the whole region, the slot must hold it
+    if(type == VC_HANDLE_IMAGE)
+    {
+        _vc_image_intern *img = vc_handles_manager_deref(&ctx->handles_manager, source);
+        u64 image_size        = _vc_readback_image_size(img, &region);
+        if(image_size == 0)
+        {
+            vc_error("Cannot read back a region of an image of format %s (one aspect at a time).", vc_priv_VkFormat_to_str(img->image_format) );
+            return 0;
+        }
+        if(region.size < image_size)
+        {
+            vc_error("Readback of %lu bytes from an image region of %lu bytes.", region.size, image_size);
+            return 0;
+        }
+    }
+
+    i32 index = _vc_readback_acquire_slot(ctx, region.size);
+    if(index == -1)
+    {
+        return 0;
+    }
+
+    _vc_readback_slot *slot = &ctx->readbacks.slots[index];
+
+    // Make previous writes visible to the copy
+    VkMemoryBarrier pre_barrier =
+    {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &pre_barrier, 0, NULL, 0, NULL);
+
+    if(type == VC_HANDLE_BUFFER)
+    {
+        _vc_buffer_intern *src = vc_handles_manager_deref(&ctx->handles_manager, source);
+
+        VkBufferCopy copy =
+        {
+            .srcOffset = region.offset,
+            .dstOffset = 0,
+            .size      = region.size,
+        };
+        vkCmdCopyBuffer(buf->buffer, src->buffer, slot->buffer, 1, &copy);
+    }
+    else
+    {
+        _vc_image_intern *src = vc_handles_manager_deref(&ctx->handles_manager, source);
+
+        VkBufferImageCopy copy =
+        {
+            .bufferOffset      = 0,
+            .bufferRowLength   = 0, // Tightly packed
+            .bufferImageHeight = 0,
+            .imageSubresource  = region.subresource,
+            .imageOffset       = region.image_offset,
+            .imageExtent       = region.image_extent,
+        };
+        vkCmdCopyImageToBuffer(buf->buffer, src->image, region.image_layout, slot->buffer, 1, &copy);
+    }
+
+    // Make the copy visible to the host once the frame fence is signaled
+    VkMemoryBarrier host_barrier =
+    {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, NULL, 0, NULL);
+
+    slot->in_use = TRUE;
+    slot->generation++;
+    slot->frame = ctx->frames.current_frame;
+    slot->size  = region.size;
+
+    return _vc_readback_ticket_pack(index, slot->generation);
+}
+
+b8
+vc_readback_poll(vc_ctx *ctx, vc_readback_ticket ticket, void **data)
+{
+    _vc_readback_slot *slot = _vc_readback_ticket_deref(ctx, ticket);
+    if(slot == NULL)
+    {
+        return FALSE;
+    }
+
+    if(!vc_frames_is_complete(&ctx->frames, ctx->current_device, slot->frame))
+    {
+        return FALSE;
+    }
+
+    if(data)
+    {
+        vmaInvalidateAllocation(ctx->main_allocator, slot->alloc, 0, slot->size);
+        *data = slot->mapped;
+    }
+    return TRUE;
+}
+
+void *
+vc_readback_wait(vc_ctx *ctx, vc_readback_ticket ticket)
+{
+    _vc_readback_slot *slot = _vc_readback_ticket_deref(ctx, ticket);
+    if(slot == NULL)
+    {
+        return NULL;
+    }
+
+    // Waiting on a frame that was never ended would wait for the copy forever
+    if(!vc_frames_is_submitted(&ctx->frames, slot->frame) )
+    {
+        vc_error("Cannot wait for a readback of frame %lu, the frame has not been ended.", slot->frame);
+        return NULL;
+    }
+
+    vc_frames_wait(&ctx->frames, ctx->current_device, slot->frame);
+
+    vmaInvalidateAllocation(ctx->main_allocator, slot->alloc, 0, slot->size);
+    return slot->mapped;
+}
+
+void
+vc_readback_release(vc_ctx *ctx, vc_readback_ticket ticket)
+{
+    _vc_readback_slot *slot = _vc_readback_ticket_deref(ctx, ticket);
+    if(slot == NULL)
+    {
+        return;
+    }
+
+    // The copy is still to be submitted, reusing the buffer now would let a later readback overwrite it
+    if(!vc_frames_is_submitted(&ctx->frames, slot->frame) )
+    {
+        vc_error("Cannot release a readback of frame %lu, the frame has not been ended.", slot->frame);
+        return;
+    }
+
+    if(!vc_frames_is_complete(&ctx->frames, ctx->current_device, slot->frame))
+    {
+        // The GPU may still write into the buffer, it cannot be reused before
+        vc_frames_wait(&ctx->frames, ctx->current_device, slot->frame);
+    }
+
+    slot->in_use = FALSE;
+}
@@ -0,0 +1,47 @@
+#ifndef __VC_READBACK__
+#define __VC_READBACK__
+
+/*
+ * Asynchronous readbacks of buffers and images to the CPU.
+ * Copies are recorded into pooled host cached buffers, and a ticket is handed back. The ticket completes once the frame
+ * in which the copy was recorded has finished on the GPU, no device wide wait is needed.
+ */
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include "base/types.h"
+
+typedef struct
+{
+    VkBuffer         buffer;
+    VmaAllocation    alloc;
+    void            *mapped;
+    u64              capacity;
+
+    b8               in_use;
+    u32              generation; // Incremented each time the slot is reused, invalidates older tickets
+    u64              frame; // The frame in which the copy was recorded
+    u64              size; // The size of the data read back
+} _vc_readback_slot;
+
+typedef struct
+{
+    _vc_readback_slot   *slots; // darray
+} vc_readback_pool;
+
+/**
+ * @brief Creates a readback pool
+ *
+ * @param pool The readback pool
+ */
+void vc_readback_pool_create(vc_readback_pool   *pool);
+
+/**
+ * @brief Destroys a readback pool and all its buffers
+ *
+ * @param pool The readback pool
+ * @param allocator The allocator the buffers were allocated with
+ */
+void vc_readback_pool_destroy(vc_readback_pool *pool, VmaAllocator allocator);
+
+#endif // __VC_READBACK__
@@ -0,0 +1,150 @@
+#include "vulcain.h"
+#include "handles/vc_internal_types.h"
+#include "vc_enum_util.h"
+#include <alloca.h>
+
+VkPipelineLayout _vc_pipeline_layout_get(vc_ctx *ctx, vc_pipeline_layout_info layout_info);
+const VkSpecializationInfo *_vc_pipeline_specialize(mem_linear *arrays, VkSpecializationInfo *info, const vc_shader_reflection *reflection, const vc_specialization *spec);
+const vc_vertex_binding *_vc_reflected_vertex_binding(vc_ctx *ctx, u8 *code, u64 code_size);
+
+void
+_vc_shader_destroy(vc_ctx *ctx, _vc_shader_intern *shader)
+{
+    // The layout belongs to the layout cache
+    ctx->device_functions.destroy_shader(ctx->current_device, shader->shader, NULL);
+}
+
+b8
+_vc_shader_layout_empty(const vc_shader_desc   *desc)
+{
+    return desc->layout_info.set_layout_count == 0 && desc->layout_info.push_constants_count == 0;
+}
+
+vc_shader
+vc_shader_create(vc_ctx *ctx, vc_shader_desc desc)
+{
+    vc_shader hndl = VC_NULL_HANDLE;
+    vc_shaders_create(ctx, 1, &desc, &hndl);
+    return hndl;
+}
+
+b8
+vc_shaders_create(vc_ctx *ctx, u32 count, const vc_shader_desc *descs, vc_shader *shaders)
+{
+    for(u32 i = 0; i < count; i++)
+    {
+        shaders[i] = VC_NULL_HANDLE;
+    }
+
+    if(!ctx->supported_features.shader_object)
+    {
+        vc_error("Cannot create shaders, the shader_object feature is not supported.");
+        return FALSE;
+    }
+
+    // Empty layout infos are reflected from every shader of the call, so the shaders can be bound together
+    vc_pipeline_layout_info reflected_layout = { 0 };
+    u8 **codes                               = alloca(sizeof(u8 *) * (count + 1) );
+    u64 *code_sizes                          = alloca(sizeof(u64) * (count + 1) );
+    b8 reflect                               = FALSE;
+    u64 arrays_size                          = 8 * 2 * count;
+    for(u32 i = 0; i < count; i++)
+    {
+        codes[i]      = descs[i].code;
+        code_sizes[i] = descs[i].code_size;
+        reflect      |= _vc_shader_layout_empty(&descs[i]);
+        arrays_size  += (sizeof(VkSpecializationMapEntry) + sizeof(u64) ) * descs[i].specialization.constant_count;
+    }
+    if(reflect)
+    {
+        reflected_layout = vc_pipeline_layout_reflect(ctx, count, codes, code_sizes);
+    }
+
+    VkShaderCreateInfoEXT *shader_cis = alloca(sizeof(VkShaderCreateInfoEXT) * (count + 1) );
+    VkSpecializationInfo *spec_infos  = alloca(sizeof(VkSpecializationInfo) * (count + 1) );
+    VkPipelineLayout *layouts         = alloca(sizeof(VkPipelineLayout) * (count + 1) );
+    VkShaderEXT *vk_shaders           = alloca(sizeof(VkShaderEXT) * (count + 1) );
+
+    mem_linear arrays;
+    void *arrays_memory = mem_allocate(arrays_size, MEMORY_TAG_RENDERER);
+    mem_linear_create(&arrays, arrays_memory, arrays_size);
+
+    for(u32 i = 0; i < count; i++)
+    {
+        const vc_shader_desc *desc          = &descs[i];
+        vc_pipeline_layout_info layout_info = _vc_shader_layout_empty(desc) ? reflected_layout : desc->layout_info;
+
+        // Shader objects take the set layouts, the pipeline layout is kept to bind descriptor sets
+        layouts[i] = _vc_pipeline_layout_get(ctx, layout_info);
+        VkDescriptorSetLayout *set_layouts = alloca(sizeof(VkDescriptorSetLayout) * (layout_info.set_layout_count + 1) );
+        for(u32 j = 0; j < layout_info.set_layout_count; j++)
+        {
+            _vc_descriptor_set_layout_intern sl_i;
+            vc_handles_manager_read(&ctx->handles_manager, layout_info.set_layouts[j], &sl_i, sizeof(sl_i) );
+            set_layouts[j] = sl_i.layout;
+        }
+
+        VkShaderStageFlags next_stages = desc->next_stages;
+        if(next_stages == 0 && desc->stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            next_stages = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+
+        const vc_shader_reflection *reflection = vc_shader_reflect(ctx, desc->code, desc->code_size);
+        shader_cis[i] = (VkShaderCreateInfoEXT) {
+            .sType                  = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+            .stage                  = desc->stage,
+            .nextStage              = next_stages,
+            .codeType               = VK_SHADER_CODE_TYPE_SPIRV_EXT,
+            .codeSize               = desc->code_size,
+            .pCode                  = desc->code,
+            .pName                  = desc->entry_point,
+            .setLayoutCount         = layout_info.set_layout_count,
+            .pSetLayouts            = set_layouts,
+            .pushConstantRangeCount = layout_info.push_constants_count,
+            .pPushConstantRanges    = layout_info.push_constants,
+            .pSpecializationInfo    = _vc_pipeline_specialize(&arrays, &spec_infos[i], reflection, &desc->specialization),
+        };
+    }
+
+    for(u32 i = 0; i < count; i++)
+    {
+        vk_shaders[i] = VK_NULL_HANDLE;
+    }
+    VkResult res = ctx->device_functions.create_shaders(ctx->current_device, count, shader_cis, NULL, vk_shaders);
+    mem_free(arrays_memory);
+
+    if(res != VK_SUCCESS)
+    {
+        vc_error("Could not create %u shaders (%s).", count, vc_priv_VkResult_to_str(res) );
+        for(u32 i = 0; i < count; i++)
+        {
+            if(vk_shaders[i] != VK_NULL_HANDLE)
+            {
+                ctx->device_functions.destroy_shader(ctx->current_device, vk_shaders[i], NULL);
+            }
+        }
+        return FALSE;
+    }
+
+    for(u32 i = 0; i < count; i++)
+    {
+        _vc_shader_intern shader_i =
+        {
+            .type         = VC_PIPELINE_SHADER,
+            .shader       = vk_shaders[i],
+            .stage        = descs[i].stage,
+            .layout       = layouts[i],
+            .vertex_input = NULL,
+        };
+        if(descs[i].stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            shader_i.vertex_input = _vc_reflected_vertex_binding(ctx, descs[i].code, descs[i].code_size);
+        }
+
+        shaders[i] = vc_handles_manager_walloc(&ctx->handles_manager, VC_HANDLE_SHADER, &shader_i);
+    }
+    vc_handles_manager_set_destroy_function(&ctx->handles_manager, VC_HANDLE_SHADER, (vc_handle_destroy_func)_vc_shader_destroy);
+
+    return TRUE;
+}
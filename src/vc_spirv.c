@@ -0,0 +1,855 @@
+#include "vc_spirv.h"
+#include "vulcain.h"
+#include "base/data_structures/darray.h"
+#include "base/memory.h"
+#include <string.h>
+
+#define _VC_SPV_MAGIC 0x07230203
+
+// Opcodes
+#define _VC_SPV_OP_ENTRY_POINT                  15
+#define _VC_SPV_OP_EXECUTION_MODE               16
+#define _VC_SPV_OP_TYPE_BOOL                    20
+#define _VC_SPV_OP_TYPE_INT                     21
+#define _VC_SPV_OP_TYPE_FLOAT                   22
+#define _VC_SPV_OP_TYPE_VECTOR                  23
+#define _VC_SPV_OP_TYPE_MATRIX                  24
+#define _VC_SPV_OP_TYPE_IMAGE                   25
+#define _VC_SPV_OP_TYPE_SAMPLER                 26
+#define _VC_SPV_OP_TYPE_SAMPLED_IMAGE           27
+#define _VC_SPV_OP_TYPE_ARRAY                   28
+#define _VC_SPV_OP_TYPE_RUNTIME_ARRAY           29
+#define _VC_SPV_OP_TYPE_STRUCT                  30
+#define _VC_SPV_OP_TYPE_POINTER                 32
+#define _VC_SPV_OP_CONSTANT                     43
+#define _VC_SPV_OP_CONSTANT_COMPOSITE           44
+#define _VC_SPV_OP_SPEC_CONSTANT_TRUE           48
+#define _VC_SPV_OP_SPEC_CONSTANT_FALSE          49
+#define _VC_SPV_OP_SPEC_CONSTANT                50
+#define _VC_SPV_OP_SPEC_CONSTANT_COMPOSITE      51
+#define _VC_SPV_OP_FUNCTION                     54
+#define _VC_SPV_OP_VARIABLE                     59
+#define _VC_SPV_OP_DECORATE                     71
+#define _VC_SPV_OP_MEMBER_DECORATE              72
+#define _VC_SPV_OP_EXECUTION_MODE_ID            331
+#define _VC_SPV_OP_TYPE_ACCELERATION_STRUCTURE  5341
+
+// Decorations
+#define _VC_SPV_DECORATION_SPEC_ID              1
+#define _VC_SPV_DECORATION_BLOCK                2
+#define _VC_SPV_DECORATION_BUFFER_BLOCK         3
+#define _VC_SPV_DECORATION_ARRAY_STRIDE         6
+#define _VC_SPV_DECORATION_MATRIX_STRIDE        7
+#define _VC_SPV_DECORATION_BUILTIN              11
+#define _VC_SPV_DECORATION_LOCATION             30
+#define _VC_SPV_DECORATION_BINDING              33
+#define _VC_SPV_DECORATION_DESCRIPTOR_SET       34
+#define _VC_SPV_DECORATION_OFFSET               35
+
+// Storage classes
+#define _VC_SPV_STORAGE_UNIFORM_CONSTANT        0
+#define _VC_SPV_STORAGE_INPUT                   1
+#define _VC_SPV_STORAGE_UNIFORM                 2
+#define _VC_SPV_STORAGE_PUSH_CONSTANT           9
+#define _VC_SPV_STORAGE_STORAGE_BUFFER          12
+
+#define _VC_SPV_EXECUTION_MODE_LOCAL_SIZE       17
+#define _VC_SPV_EXECUTION_MODE_LOCAL_SIZE_ID    38
+#define _VC_SPV_BUILTIN_WORKGROUP_SIZE          25
+#define _VC_SPV_DIM_BUFFER                      5
+#define _VC_SPV_DIM_SUBPASS_DATA                6
+
+// Nesting of the types followed by the reflection, deeper (or cyclic) types are malformed
+#define _VC_SPV_MAX_TYPE_DEPTH                  64
+
+// Decorations found on an id
+#define _VC_SPV_HAS_SET          (1 << 0)
+#define _VC_SPV_HAS_BINDING      (1 << 1)
+#define _VC_SPV_HAS_LOCATION     (1 << 2)
+#define _VC_SPV_HAS_SPEC_ID      (1 << 3)
+#define _VC_SPV_BLOCK            (1 << 4)
+#define _VC_SPV_BUFFER_BLOCK     (1 << 5)
+#define _VC_SPV_BUILTIN          (1 << 6)
+
+typedef struct
+{
+    u32    opcode; // 0 if the id is not declared
+    u32    offset; // Word of the declaring instruction
+
+    u32    flags;
+    u32    set;
+    u32    binding;
+    u32    location;
+    u32    spec_id;
+    u32    builtin;
+    u32    array_stride;
+} _vc_spv_id;
+
+typedef struct
+{
+    u32    type;
+    u32    member;
+    u32    offset;
+    u32    matrix_stride;
+} _vc_spv_member;
+
+typedef struct
+{
+    const u32         *words;
+    u32                word_count;
+    u32                bound;
+
+    _vc_spv_id        *ids;
+    _vc_spv_member    *members; // darray
+} _vc_spv_module;
+
+// Vertex input formats, by scalar kind (float, int, uint), width (16, 32, 64) and component count
+static const VkFormat _vc_spv_formats[3][3][4] =
+{
+    {
+        { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT },
+        { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+        { VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT },
+    },
+    {
+        { VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT },
+        { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+        { VK_FORMAT_R64_SINT, VK_FORMAT_R64G64_SINT, VK_FORMAT_R64G64B64_SINT, VK_FORMAT_R64G64B64A64_SINT },
+    },
+    {
+        { VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT },
+        { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT },
+        { VK_FORMAT_R64_UINT, VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64A64_UINT },
+    },
+};
+
+u32
+vc_spirv_format_size(VkFormat    format)
+{
+    for(u32 kind = 0; kind < 3; kind++)
+    {
+        for(u32 width = 0; width < 3; width++)
+        {
+            for(u32 count = 0; count < 4; count++)
+            {
+                if(_vc_spv_formats[kind][width][count] == format)
+                {
+                    return (count + 1) * (2 << width);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Returns the instruction declaring an id, NULL if there is none
+const u32 *
+_vc_spv_instruction(_vc_spv_module *module, u32 id)
+{
+    if(id >= module->bound || module->ids[id].opcode == 0)
+    {
+        return NULL;
+    }
+    return &module->words[module->ids[id].offset];
+}
+
+u32
+_vc_spv_opcode(_vc_spv_module *module, u32 id)
+{
+    return id < module->bound ? module->ids[id].opcode : 0;
+}
+
+// Returns the value of an integer constant, or the default value of a specialization constant
+b8
+_vc_spv_constant(_vc_spv_module *module, u32 id, u32 *value)
+{
+    const u32 *inst = _vc_spv_instruction(module, id);
+    u32 opcode      = _vc_spv_opcode(module, id);
+    if(inst == NULL || (opcode != _VC_SPV_OP_CONSTANT && opcode != _VC_SPV_OP_SPEC_CONSTANT) )
+    {
+        return FALSE;
+    }
+
+    *value = inst[3];
+    return TRUE;
+}
+
+const _vc_spv_member *
+_vc_spv_member_get(_vc_spv_module *module, u32 type, u32 member)
+{
+    for(u32 i = 0; i < darray_length(module->members); i++)
+    {
+        if(module->members[i].type == type && module->members[i].member == member)
+        {
+            return &module->members[i];
+        }
+    }
+    return NULL;
+}
+
+// Returns the size of a type in a block, from its offsets and strides
+u32
+_vc_spv_type_size(_vc_spv_module *module, u32 type, u32 matrix_stride, u32 depth)
+{
+    const u32 *inst = _vc_spv_instruction(module, type);
+    if(inst == NULL || depth >= _VC_SPV_MAX_TYPE_DEPTH)
+    {
+        return 0;
+    }
+
+    switch (module->ids[type].opcode)
+    {
+    case _VC_SPV_OP_TYPE_BOOL:
+        return sizeof(VkBool32);
+
+    case _VC_SPV_OP_TYPE_INT:
+    case _VC_SPV_OP_TYPE_FLOAT:
+        return inst[2] / 8;
+
+    case _VC_SPV_OP_TYPE_VECTOR:
+        return inst[3] * _vc_spv_type_size(module, inst[2], 0, depth + 1);
+
+    case _VC_SPV_OP_TYPE_MATRIX:
+        return inst[3] * (matrix_stride != 0 ? matrix_stride : _vc_spv_type_size(module, inst[2], 0, depth + 1) );
+
+    case _VC_SPV_OP_TYPE_ARRAY:
+    {
+        u32 length = 0;
+        _vc_spv_constant(module, inst[3], &length);
+
+        u32 stride = module->ids[type].array_stride;
+        return length * (stride != 0 ? stride : _vc_spv_type_size(module, inst[2], matrix_stride, depth + 1) );
+    }
+
+    case _VC_SPV_OP_TYPE_STRUCT:
+    {
+        u32 member_count = (inst[0] >> 16) - 2;
+        u32 size         = 0;
+        for(u32 m = 0; m < member_count; m++)
+        {
+            const _vc_spv_member *member = _vc_spv_member_get(module, type, m);
+            u32 offset                   = member ? member->offset : size;
+            u32 end                      = offset + _vc_spv_type_size(module, inst[2 + m], member ? member->matrix_stride : 0, depth + 1);
+            size                         = end > size ? end : size;
+        }
+        return size;
+    }
+
+    default:
+        // Runtime arrays have no size
+        return 0;
+    }
+}
+
+// Finds the descriptor type of a variable, and its number of descriptors
+b8
+_vc_spv_descriptor_type(_vc_spv_module *module, u32 storage_class, u32 type, VkDescriptorType *descriptor_type, u32 *count)
+{
+    *count = 1;
+    for(u32 depth = 0; _vc_spv_opcode(module, type) == _VC_SPV_OP_TYPE_ARRAY || _vc_spv_opcode(module, type) == _VC_SPV_OP_TYPE_RUNTIME_ARRAY; depth++)
+    {
+        if(depth >= _VC_SPV_MAX_TYPE_DEPTH)
+        {
+            return FALSE;
+        }
+
+        const u32 *array = _vc_spv_instruction(module, type);
+        u32 length       = 0;
+        if(module->ids[type].opcode == _VC_SPV_OP_TYPE_ARRAY)
+        {
+            _vc_spv_constant(module, array[3], &length);
+        }
+
+        *count *= length;
+        type    = array[2];
+    }
+
+    const u32 *inst = _vc_spv_instruction(module, type);
+    if(inst == NULL)
+    {
+        return FALSE;
+    }
+
+    u32 flags = module->ids[type].flags;
+    switch (module->ids[type].opcode)
+    {
+    case _VC_SPV_OP_TYPE_SAMPLER:
+        *descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        return TRUE;
+
+    case _VC_SPV_OP_TYPE_SAMPLED_IMAGE:
+        *descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        return TRUE;
+
+    case _VC_SPV_OP_TYPE_IMAGE:
+    {
+        // Sampled is 2 for storage images
+        u32 dim    = inst[3];
+        b8 storage = inst[7] == 2;
+        if(dim == _VC_SPV_DIM_SUBPASS_DATA)
+        {
+            *descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        else if(dim == _VC_SPV_DIM_BUFFER)
+        {
+            *descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        else
+        {
+            *descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        return TRUE;
+    }
+
+    case _VC_SPV_OP_TYPE_ACCELERATION_STRUCTURE:
+        *descriptor_type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        return TRUE;
+
+    case _VC_SPV_OP_TYPE_STRUCT:
+        if(storage_class == _VC_SPV_STORAGE_STORAGE_BUFFER || (flags & _VC_SPV_BUFFER_BLOCK) )
+        {
+            *descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            return TRUE;
+        }
+        if(flags & _VC_SPV_BLOCK)
+        {
+            *descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            return TRUE;
+        }
+        return FALSE;
+
+    default:
+        return FALSE;
+    }
+}
+
+// Finds the format of a vertex input type, VK_FORMAT_UNDEFINED for types spanning several locations
+VkFormat
+_vc_spv_vertex_format(_vc_spv_module *module, u32 type)
+{
+    u32 components = 1;
+    if(_vc_spv_opcode(module, type) == _VC_SPV_OP_TYPE_VECTOR)
+    {
+        const u32 *vector = _vc_spv_instruction(module, type);
+        components = vector[3];
+        type       = vector[2];
+    }
+
+    const u32 *scalar = _vc_spv_instruction(module, type);
+    u32 opcode        = _vc_spv_opcode(module, type);
+    if(scalar == NULL || (opcode != _VC_SPV_OP_TYPE_FLOAT && opcode != _VC_SPV_OP_TYPE_INT) || components == 0 || components > 4)
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    u32 kind  = opcode == _VC_SPV_OP_TYPE_FLOAT ? 0 : (scalar[3] ? 1 : 2);
+    u32 width = scalar[2] == 16 ? 0 : (scalar[2] == 32 ? 1 : (scalar[2] == 64 ? 2 : 3) );
+    if(width == 3)
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    return _vc_spv_formats[kind][width][components - 1];
+}
+
+// Returns the word count below which an instruction misses operands the reflection reads, 0 for the ignored ones
+u32
+_vc_spv_min_word_count(u32  opcode)
+{
+    switch (opcode)
+    {
+    case _VC_SPV_OP_TYPE_BOOL:
+    case _VC_SPV_OP_TYPE_SAMPLER:
+    case _VC_SPV_OP_TYPE_STRUCT:
+    case _VC_SPV_OP_TYPE_ACCELERATION_STRUCTURE:
+        return 2;
+
+    case _VC_SPV_OP_TYPE_FLOAT:
+    case _VC_SPV_OP_TYPE_SAMPLED_IMAGE:
+    case _VC_SPV_OP_TYPE_RUNTIME_ARRAY:
+    case _VC_SPV_OP_CONSTANT_COMPOSITE:
+    case _VC_SPV_OP_SPEC_CONSTANT_TRUE:
+    case _VC_SPV_OP_SPEC_CONSTANT_FALSE:
+    case _VC_SPV_OP_SPEC_CONSTANT_COMPOSITE:
+    case _VC_SPV_OP_EXECUTION_MODE:
+    case _VC_SPV_OP_EXECUTION_MODE_ID:
+        return 3;
+
+    case _VC_SPV_OP_ENTRY_POINT:
+    case _VC_SPV_OP_TYPE_INT:
+    case _VC_SPV_OP_TYPE_VECTOR:
+    case _VC_SPV_OP_TYPE_MATRIX:
+    case _VC_SPV_OP_TYPE_ARRAY:
+    case _VC_SPV_OP_TYPE_POINTER:
+    case _VC_SPV_OP_CONSTANT:
+    case _VC_SPV_OP_SPEC_CONSTANT:
+    case _VC_SPV_OP_VARIABLE:
+        return 4;
+
+    case _VC_SPV_OP_TYPE_IMAGE:
+        return 9;
+
+    default:
+        return 0;
+    }
+}
+
+// First pass: finds the declaration and decorations of every id
+b8
+_vc_spv_index(_vc_spv_module   *module)
+{
+    for(u32 w = 5; w < module->word_count; )
+    {
+        u32 opcode     = module->words[w] & 0xFFFF;
+        u32 word_count = module->words[w] >> 16;
+        if(word_count == 0 || w + word_count > module->word_count)
+        {
+            vc_error("SPIR-V reflection: truncated instruction at word %u.", w);
+            return FALSE;
+        }
+        if(word_count < _vc_spv_min_word_count(opcode) )
+        {
+            vc_error("SPIR-V reflection: instruction %u at word %u is missing operands.", opcode, w);
+            return FALSE;
+        }
+
+        const u32 *inst = &module->words[w];
+        if(opcode == _VC_SPV_OP_FUNCTION)
+        {
+            // Declarations always precede the functions
+            break;
+        }
+
+        u32 result = 0;
+        switch (opcode)
+        {
+        case _VC_SPV_OP_TYPE_BOOL:
+        case _VC_SPV_OP_TYPE_INT:
+        case _VC_SPV_OP_TYPE_FLOAT:
+        case _VC_SPV_OP_TYPE_VECTOR:
+        case _VC_SPV_OP_TYPE_MATRIX:
+        case _VC_SPV_OP_TYPE_IMAGE:
+        case _VC_SPV_OP_TYPE_SAMPLER:
+        case _VC_SPV_OP_TYPE_SAMPLED_IMAGE:
+        case _VC_SPV_OP_TYPE_ARRAY:
+        case _VC_SPV_OP_TYPE_RUNTIME_ARRAY:
+        case _VC_SPV_OP_TYPE_STRUCT:
+        case _VC_SPV_OP_TYPE_POINTER:
+        case _VC_SPV_OP_TYPE_ACCELERATION_STRUCTURE:
+            result = inst[1];
+            break;
+
+        case _VC_SPV_OP_CONSTANT:
+        case _VC_SPV_OP_CONSTANT_COMPOSITE:
+        case _VC_SPV_OP_SPEC_CONSTANT_TRUE:
+        case _VC_SPV_OP_SPEC_CONSTANT_FALSE:
+        case _VC_SPV_OP_SPEC_CONSTANT:
+        case _VC_SPV_OP_SPEC_CONSTANT_COMPOSITE:
+        case _VC_SPV_OP_VARIABLE:
+            result = inst[2];
+            break;
+
+        case _VC_SPV_OP_DECORATE:
+        {
+            u32 target = inst[1];
+            if(target >= module->bound || word_count < 3)
+            {
+                break;
+            }
+
+            _vc_spv_id *id = &module->ids[target];
+            u32 value      = word_count > 3 ? inst[3] : 0;
+            switch (inst[2])
+            {
+            case _VC_SPV_DECORATION_DESCRIPTOR_SET:
+                id->flags |= _VC_SPV_HAS_SET;
+                id->set = value;
+                break;
+
+            case _VC_SPV_DECORATION_BINDING:
+                id->flags |= _VC_SPV_HAS_BINDING;
+                id->binding = value;
+                break;
+
+            case _VC_SPV_DECORATION_LOCATION:
+                id->flags |= _VC_SPV_HAS_LOCATION;
+                id->location = value;
+                break;
+
+            case _VC_SPV_DECORATION_SPEC_ID:
+                id->flags |= _VC_SPV_HAS_SPEC_ID;
+                id->spec_id = value;
+                break;
+
+            case _VC_SPV_DECORATION_BUILTIN:
+                id->flags |= _VC_SPV_BUILTIN;
+                id->builtin = value;
+                break;
+
+            case _VC_SPV_DECORATION_BLOCK:
+                id->flags |= _VC_SPV_BLOCK;
+                break;
+
+            case _VC_SPV_DECORATION_BUFFER_BLOCK:
+                id->flags |= _VC_SPV_BUFFER_BLOCK;
+                break;
+
+            case _VC_SPV_DECORATION_ARRAY_STRIDE:
+                id->array_stride = value;
+                break;
+
+            default:
+                break;
+            }
+            break;
+        }
+
+        case _VC_SPV_OP_MEMBER_DECORATE:
+        {
+            if(word_count < 5 || (inst[3] != _VC_SPV_DECORATION_OFFSET && inst[3] != _VC_SPV_DECORATION_MATRIX_STRIDE) )
+            {
+                break;
+            }
+
+            _vc_spv_member *member = (_vc_spv_member *)_vc_spv_member_get(module, inst[1], inst[2]);
+            if(member == NULL)
+            {
+                _vc_spv_member new_member =
+                {
+                    .type   = inst[1],
+                    .member = inst[2],
+                };
+                darray_push(module->members, new_member);
+                member = &module->members[darray_length(module->members) - 1];
+            }
+
+            if(inst[3] == _VC_SPV_DECORATION_OFFSET)
+            {
+                member->offset = inst[4];
+            }
+            else
+            {
+                member->matrix_stride = inst[4];
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        if(result != 0 && result < module->bound)
+        {
+            module->ids[result].opcode = opcode;
+            module->ids[result].offset = w;
+        }
+
+        w += word_count;
+    }
+
+    return TRUE;
+}
+
+// Second pass: finds the entry point and its execution modes
+void
+_vc_spv_reflect_entry_point(_vc_spv_module *module, vc_shader_reflection *reflection)
+{
+    u32 entry_id = 0;
+    for(u32 w = 5; w < module->word_count; )
+    {
+        const u32 *inst = &module->words[w];
+        u32 opcode      = inst[0] & 0xFFFF;
+        u32 word_count  = inst[0] >> 16;
+        if(opcode == _VC_SPV_OP_FUNCTION)
+        {
+            break;
+        }
+
+        if(opcode == _VC_SPV_OP_ENTRY_POINT && entry_id == 0)
+        {
+            entry_id = inst[2];
+            switch (inst[1])
+            {
+            case 0:
+                reflection->stage = VK_SHADER_STAGE_VERTEX_BIT;
+                break;
+
+            case 1:
+                reflection->stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+                break;
+
+            case 2:
+                reflection->stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+                break;
+
+            case 3:
+                reflection->stage = VK_SHADER_STAGE_GEOMETRY_BIT;
+                break;
+
+            case 4:
+                reflection->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+                break;
+
+            case 5:
+                reflection->stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                break;
+
+            default:
+                reflection->stage = 0;
+                break;
+            }
+
+            // The name is a nul terminated string packed in the following words
+            u64 max_length   = (word_count - 3) * sizeof(u32);
+            const char *name = (const char *)&inst[3];
+            u64 length       = strnlen(name, max_length);
+            length           = length < VC_SPIRV_ENTRY_POINT_MAX - 1 ? length : VC_SPIRV_ENTRY_POINT_MAX - 1;
+            mem_memcpy(reflection->entry_point, (void *)name, length);
+            reflection->entry_point[length] = '\0';
+        }
+        else if(opcode == _VC_SPV_OP_EXECUTION_MODE && inst[1] == entry_id && inst[2] == _VC_SPV_EXECUTION_MODE_LOCAL_SIZE && word_count >= 6)
+        {
+            reflection->workgroup_size[0] = inst[3];
+            reflection->workgroup_size[1] = inst[4];
+            reflection->workgroup_size[2] = inst[5];
+        }
+        else if(opcode == _VC_SPV_OP_EXECUTION_MODE_ID && inst[1] == entry_id && inst[2] == _VC_SPV_EXECUTION_MODE_LOCAL_SIZE_ID && word_count >= 6)
+        {
+            for(u32 i = 0; i < 3; i++)
+            {
+                _vc_spv_constant(module, inst[3 + i], &reflection->workgroup_size[i]);
+            }
+        }
+
+        w += word_count;
+    }
+}
+
+// Sorts the vertex inputs by location (insertion sort, shaders have few inputs)
+void
+_vc_spv_sort_vertex_inputs(vc_spirv_vertex_input *inputs, u32 count)
+{
+    for(u32 i = 1; i < count; i++)
+    {
+        vc_spirv_vertex_input current = inputs[i];
+        u32 j                         = i;
+        while(j > 0 && inputs[j - 1].location > current.location)
+        {
+            inputs[j] = inputs[j - 1];
+            j--;
+        }
+        inputs[j] = current;
+    }
+}
+
+// Moves the content of a darray to an allocation of its exact size, NULL if it is empty
+void *
+_vc_spv_take(void *array, u64 stride, u32 *count)
+{
+    *count = darray_length(array);
+
+    void *data = NULL;
+    if(*count > 0)
+    {
+        data = mem_allocate(stride * *count, MEMORY_TAG_RENDERER);
+        mem_memcpy(data, array, stride * *count);
+    }
+    darray_destroy(array);
+    return data;
+}
+
+b8
+vc_spirv_reflect(const u8 *code, u64 code_size, vc_shader_reflection *reflection)
+{
+    *reflection = (vc_shader_reflection) {
+        .workgroup_size = { 1, 1, 1 },
+    };
+
+    const u32 *words = (const u32 *)code;
+    if(code_size < 5 * sizeof(u32) || words[0] != _VC_SPV_MAGIC)
+    {
+        vc_error("SPIR-V reflection: the code is not a SPIR-V module.");
+        return FALSE;
+    }
+
+    _vc_spv_module module =
+    {
+        .words      = words,
+        .word_count = code_size / sizeof(u32),
+        .bound      = words[3],
+        .members    = darray_create(_vc_spv_member),
+    };
+    module.ids = mem_allocate(sizeof(_vc_spv_id) * module.bound, MEMORY_TAG_RENDERER);
+    mem_memset(module.ids, 0, sizeof(_vc_spv_id) * module.bound);
+
+    if(!_vc_spv_index(&module) )
+    {
+        mem_free(module.ids);
+        darray_destroy(module.members);
+        return FALSE;
+    }
+
+    _vc_spv_reflect_entry_point(&module, reflection);
+
+    vc_spirv_binding *bindings             = darray_create(vc_spirv_binding);
+    vc_spirv_spec_constant *spec_constants = darray_create(vc_spirv_spec_constant);
+    vc_spirv_vertex_input *vertex_inputs   = darray_create(vc_spirv_vertex_input);
+
+    u32 push_constant_end = 0;
+    for(u32 id = 1; id < module.bound; id++)
+    {
+        const u32 *inst  = _vc_spv_instruction(&module, id);
+        _vc_spv_id *info = &module.ids[id];
+        if(inst == NULL)
+        {
+            continue;
+        }
+
+        // The specialization constant sizes are the ones of their types, booleans being VkBool32
+        if( (info->flags & _VC_SPV_HAS_SPEC_ID) &&
+            (info->opcode == _VC_SPV_OP_SPEC_CONSTANT || info->opcode == _VC_SPV_OP_SPEC_CONSTANT_TRUE || info->opcode == _VC_SPV_OP_SPEC_CONSTANT_FALSE) )
+        {
+            vc_spirv_spec_constant constant =
+            {
+                .id = info->spec_id,
+            };
+
+            const u32 *type = _vc_spv_instruction(&module, inst[1]);
+            if(info->opcode != _VC_SPV_OP_SPEC_CONSTANT)
+            {
+                constant.kind          = VC_SPIRV_BOOL;
+                constant.size          = sizeof(VkBool32);
+                constant.default_value = info->opcode == _VC_SPV_OP_SPEC_CONSTANT_TRUE;
+            }
+            else if(type != NULL && (_vc_spv_opcode(&module, inst[1]) == _VC_SPV_OP_TYPE_INT || _vc_spv_opcode(&module, inst[1]) == _VC_SPV_OP_TYPE_FLOAT) )
+            {
+                constant.kind          = _vc_spv_opcode(&module, inst[1]) == _VC_SPV_OP_TYPE_FLOAT ? VC_SPIRV_FLOAT : (type[3] ? VC_SPIRV_INT : VC_SPIRV_UINT);
+                constant.size          = type[2] / 8;
+                constant.default_value = inst[3];
+                if(constant.size == 8 && (inst[0] >> 16) > 4)
+                {
+                    constant.default_value |= (u64)inst[4] << 32;
+                }
+            }
+            darray_push(spec_constants, constant);
+            continue;
+        }
+
+        // The WorkgroupSize builtin overrides the execution mode
+        if( (info->flags & _VC_SPV_BUILTIN) && info->builtin == _VC_SPV_BUILTIN_WORKGROUP_SIZE &&
+            (info->opcode == _VC_SPV_OP_CONSTANT_COMPOSITE || info->opcode == _VC_SPV_OP_SPEC_CONSTANT_COMPOSITE) && (inst[0] >> 16) >= 6 )
+        {
+            for(u32 i = 0; i < 3; i++)
+            {
+                _vc_spv_constant(&module, inst[3 + i], &reflection->workgroup_size[i]);
+            }
+            continue;
+        }
+
+        if(info->opcode != _VC_SPV_OP_VARIABLE)
+        {
+            continue;
+        }
+
+        u32 storage_class  = inst[3];
+        const u32 *pointer = _vc_spv_instruction(&module, inst[1]);
+        if(pointer == NULL || _vc_spv_opcode(&module, inst[1]) != _VC_SPV_OP_TYPE_POINTER)
+        {
+            continue;
+        }
+        u32 type = pointer[3];
+
+        if(storage_class == _VC_SPV_STORAGE_PUSH_CONSTANT)
+        {
+            // Push constants start at their first member
+            const u32 *block = _vc_spv_instruction(&module, type);
+            if(block == NULL || _vc_spv_opcode(&module, type) != _VC_SPV_OP_TYPE_STRUCT)
+            {
+                continue;
+            }
+
+            u32 start = U32_MAX;
+            for(u32 m = 0; m < (block[0] >> 16) - 2; m++)
+            {
+                const _vc_spv_member *member = _vc_spv_member_get(&module, type, m);
+                u32 offset                   = member ? member->offset : 0;
+                start                        = offset < start ? offset : start;
+            }
+            start = start == U32_MAX ? 0 : start;
+
+            u32 end = _vc_spv_type_size(&module, type, 0, 0);
+            reflection->push_constant_offset = start;
+            push_constant_end                = end > push_constant_end ? end : push_constant_end;
+        }
+        else if(storage_class == _VC_SPV_STORAGE_UNIFORM_CONSTANT || storage_class == _VC_SPV_STORAGE_UNIFORM ||
+                storage_class == _VC_SPV_STORAGE_STORAGE_BUFFER)
+        {
+            if( !(info->flags & _VC_SPV_HAS_BINDING) )
+            {
+                continue;
+            }
+
+            vc_spirv_binding binding =
+            {
+                .set     = info->set,
+                .binding = info->binding,
+            };
+            if(!_vc_spv_descriptor_type(&module, storage_class, type, &binding.type, &binding.count) )
+            {
+                vc_warn("SPIR-V reflection: unknown descriptor type at set %u, binding %u.", binding.set, binding.binding);
+                continue;
+            }
+            darray_push(bindings, binding);
+        }
+        else if(storage_class == _VC_SPV_STORAGE_INPUT && reflection->stage == VK_SHADER_STAGE_VERTEX_BIT &&
+                (info->flags & _VC_SPV_HAS_LOCATION) && !(info->flags & _VC_SPV_BUILTIN) )
+        {
+            vc_spirv_vertex_input input =
+            {
+                .location = info->location,
+                .format   = _vc_spv_vertex_format(&module, type),
+            };
+            if(input.format == VK_FORMAT_UNDEFINED)
+            {
+                vc_warn("SPIR-V reflection: the vertex input at location %u spans several locations, it is not reflected.", input.location);
+                continue;
+            }
+            darray_push(vertex_inputs, input);
+        }
+    }
+
+    if(push_constant_end > 0)
+    {
+        reflection->push_constant_size = push_constant_end - reflection->push_constant_offset;
+    }
+
+    reflection->bindings       = _vc_spv_take(bindings, sizeof(vc_spirv_binding), &reflection->binding_count);
+    reflection->spec_constants = _vc_spv_take(spec_constants, sizeof(vc_spirv_spec_constant), &reflection->spec_constant_count);
+    reflection->vertex_inputs  = _vc_spv_take(vertex_inputs, sizeof(vc_spirv_vertex_input), &reflection->vertex_input_count);
+    _vc_spv_sort_vertex_inputs(reflection->vertex_inputs, reflection->vertex_input_count);
+
+    mem_free(module.ids);
+    darray_destroy(module.members);
+    return TRUE;
+}
+
+void
+vc_spirv_reflection_free(vc_shader_reflection   *reflection)
+{
+    if(reflection->bindings != NULL)
+    {
+        mem_free(reflection->bindings);
+    }
+    if(reflection->spec_constants != NULL)
+    {
+        mem_free(reflection->spec_constants);
+    }
+    if(reflection->vertex_inputs != NULL)
+    {
+        mem_free(reflection->vertex_inputs);
+    }
+
+    *reflection = (vc_shader_reflection) {
+        0
+    };
+}
@@ -0,0 +1,83 @@
+#ifndef __VC_SPIRV__
+#define __VC_SPIRV__
+
+/*
+ * Minimal SPIR-V reflection.
+ * Only the declarations of a module are parsed (everything before its first function), to find what pipelines need
+ * to know about a shader: its descriptor bindings, push constant block, workgroup size, specialization constants and
+ * vertex inputs. Modules with several entry points are reflected for the first one.
+ */
+
+#include <vulkan/vulkan.h>
+#include "base/types.h"
+
+#define VC_SPIRV_ENTRY_POINT_MAX 64
+
+typedef enum
+{
+    VC_SPIRV_BOOL,
+    VC_SPIRV_INT,
+    VC_SPIRV_UINT,
+    VC_SPIRV_FLOAT,
+} vc_spirv_scalar_kind;
+
+typedef struct
+{
+    u32                 set;
+    u32                 binding;
+    VkDescriptorType    type;
+    u32                 count; // 0 for runtime sized arrays
+} vc_spirv_binding;
+
+typedef struct
+{
+    u32                     id; // SpecId
+    vc_spirv_scalar_kind    kind;
+    u32                     size; // In bytes, booleans are VkBool32
+    u64                     default_value;
+} vc_spirv_spec_constant;
+
+typedef struct
+{
+    u32         location;
+    VkFormat    format;
+} vc_spirv_vertex_input;
+
+typedef struct
+{
+    VkShaderStageFlagBits     stage;
+    char                      entry_point[VC_SPIRV_ENTRY_POINT_MAX];
+
+    u32                       binding_count;
+    vc_spirv_binding         *bindings;
+
+    // Zero sized if the shader has no push constants
+    u32                       push_constant_offset;
+    u32                       push_constant_size;
+
+    u32                       workgroup_size[3]; // Compute shaders only
+
+    u32                       spec_constant_count;
+    vc_spirv_spec_constant   *spec_constants;
+
+    // Vertex shaders only, by location
+    u32                       vertex_input_count;
+    vc_spirv_vertex_input    *vertex_inputs;
+} vc_shader_reflection;
+
+/**
+ * @brief Reflects a SPIR-V module
+ *
+ * @param code The module, aligned on 4 bytes
+ * @param code_size The size of the module in bytes
+ * @param reflection[out] The reflection, freed with vc_spirv_reflection_free
+ * @return Wether the module could be parsed
+ */
+b8   vc_spirv_reflect(const u8 *code, u64 code_size, vc_shader_reflection *reflection);
+
+void vc_spirv_reflection_free(vc_shader_reflection   *reflection);
+
+// Returns the size of a vertex input format, 0 if it is not a format reflected by vc_spirv_reflect
+u32  vc_spirv_format_size(VkFormat    format);
+
+#endif // __VC_SPIRV__
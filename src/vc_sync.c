@@ -2,6 +2,8 @@
 #include "vulcain.h"
 #include "vc_enum_util.h"
 
+void _vc_descriptor_sets_frame_reset(vc_ctx *ctx, u32 slot);
+
 void
 _vc_semaphore_destroy(vc_ctx *ctx, _vc_semaphore_intern *s)
 {
@@ -29,3 +31,18 @@ vc_semaphore_create(vc_ctx   *ctx)
     return hndl;
 }
 
+void
+vc_frame_begin(vc_ctx   *ctx)
+{
+    vc_frames_advance(&ctx->frames, ctx->current_device);
+
+    // The slot of the new frame has retired, its transient and evicted descriptor sets can go
+    _vc_descriptor_sets_frame_reset(ctx, ctx->frames.current_frame % VC_FRAMES_IN_FLIGHT);
+}
+
+void
+vc_frame_end(vc_ctx *ctx, vc_queue queue)
+{
+    _vc_queue_intern *q = vc_handles_manager_deref(&ctx->handles_manager, queue);
+    vc_frames_submit(&ctx->frames, q->queue);
+}
@@ -0,0 +1,484 @@
+/**
+ * @file
+ * @brief Image upload path: staging, copy of the first mip level, and mip chain generation.
+ */
+
+#include "vulcain.h"
+#include "handles/vc_internal_types.h"
+#include "vc_enum_util.h"
+#include "base/data_structures/darray.h"
+
+b8 _vc_host_buffer_create(vc_ctx *ctx, u64 size, VkBufferUsageFlags usage, VmaAllocationCreateFlags host_access, VkBuffer *buffer, VmaAllocation *alloc, void **mapped);
+
+// Files read at once by the upload queue
+#define VC_UPLOAD_READ_QUEUE_DEPTH 64
+
+void
+vc_upload_queue_create(vc_upload_queue   *queue)
+{
+    queue->pending        = darray_create(_vc_upload_request *);
+    queue->reader_created = FALSE;
+}
+
+void
+_vc_upload_request_free(VmaAllocator allocator, _vc_upload_request *req)
+{
+    vmaDestroyBuffer(allocator, req->staging, req->staging_alloc);
+    mem_free(req);
+}
+
+void
+vc_upload_queue_destroy(vc_upload_queue *queue, VmaAllocator allocator)
+{
+    // Reads in flight write into the staging buffers
+    if(queue->reader_created)
+    {
+        fio_async_destroy(&queue->reader);
+    }
+
+    if(darray_length(queue->pending) > 0)
+    {
+        vc_warn("%u image uploads were never flushed.", darray_length(queue->pending));
+    }
+
+    for(u32 i = 0; i < darray_length(queue->pending); i++)
+    {
+        _vc_upload_request_free(allocator, queue->pending[i]);
+    }
+    darray_destroy(queue->pending);
+    queue->pending = NULL;
+}
+
+// Retire task, the uploads of a flush are complete on the GPU
+void
+_vc_upload_retire(vc_ctx *ctx, _vc_upload_request **requests)
+{
+    for(u32 i = 0; i < darray_length(requests); i++)
+    {
+        _vc_upload_request *req = requests[i];
+        if(req->callback)
+        {
+            req->callback(req->usr_data, req->image, TRUE);
+        }
+        _vc_upload_request_free(ctx->main_allocator, req);
+    }
+    darray_destroy(requests);
+}
+
+// Returns the size of the tightly packed texels of an aspect of the mip level 0 of an image, for every array layer, 0 if
+// the format is not handled
+u64
+_vc_upload_aspect_size(_vc_image_intern *img, VkImageAspectFlagBits aspect)
+{
+    u32 block_width  = 1;
+    u32 block_height = 1;
+    u64 block_size   = vc_format_aspect_block_size(img->image_format, aspect, &block_width, &block_height);
+
+    VkExtent3D extent = img->create_info.extent;
+    u64 blocks_x      = (extent.width + block_width - 1) / block_width;
+    u64 blocks_y      = (extent.height + block_height - 1) / block_height;
+    return blocks_x * blocks_y * extent.depth * img->create_info.arrayLayers * block_size;
+}
+
+// Returns the size of the data of an upload to an image: each aspect one after the other (depth, then stencil)
+u64
+_vc_upload_image_size(_vc_image_intern   *img)
+{
+    VkImageAspectFlags aspects = vc_format_get_aspects(img->image_format);
+    u64 size                   = 0;
+    for(u32 bit = 1; bit <= VK_IMAGE_ASPECT_STENCIL_BIT; bit <<= 1)
+    {
+        if(aspects & bit)
+        {
+            u64 aspect_size = _vc_upload_aspect_size(img, bit);
+            if(aspect_size == 0)
+            {
+                return 0;
+            }
+            size += aspect_size;
+        }
+    }
+    return size;
+}
+
+// Checks the image can receive the upload, and creates the request with its staging buffer
+_vc_upload_request *
+_vc_upload_request_create(vc_ctx *ctx, vc_image image, u64 size, b8 generate_mips, void **mapped)
+{
+    _vc_image_intern *img = vc_handles_manager_deref(&ctx->handles_manager, image);
+
+    if( !(img->create_info.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) )
+    {
+        vc_error("Attempted to upload to an image without VK_IMAGE_USAGE_TRANSFER_DST_BIT.");
+        return NULL;
+    }
+
+    if(generate_mips && img->create_info.mipLevels > 1 && !(img->create_info.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) )
+    {
+        vc_error("Mip generation requires the image to have VK_IMAGE_USAGE_TRANSFER_SRC_BIT.");
+        return NULL;
+    }
+
+    // The copy reads the whole level 0 from the staging buffer
+    u64 image_size = _vc_upload_image_size(img);
+    if(image_size == 0)
+    {
+        vc_error("Cannot upload to an image of format %s.", vc_priv_VkFormat_to_str(img->image_format) );
+        return NULL;
+    }
+    if(size < image_size)
+    {
+        vc_error("Upload of %lu bytes to an image of %lu bytes.", size, image_size);
+        return NULL;
+    }
+
+    _vc_upload_request *req = mem_allocate(sizeof(_vc_upload_request), MEMORY_TAG_RENDERER);
+    *req = (_vc_upload_request)
+    {
+        .image         = image,
+        .generate_mips = generate_mips,
+        .size          = size,
+    };
+
+    if(!_vc_host_buffer_create(ctx, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, &req->staging, &req->staging_alloc, mapped))
+    {
+        mem_free(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+b8
+vc_image_upload(vc_ctx *ctx, vc_image image, void *data, u64 size, b8 generate_mips)
+{
+    void *mapped            = NULL;
+    _vc_upload_request *req = _vc_upload_request_create(ctx, image, size, generate_mips, &mapped);
+    if(req == NULL)
+    {
+        return FALSE;
+    }
+
+    mem_memcpy(mapped, data, size);
+    vmaFlushAllocation(ctx->main_allocator, req->staging_alloc, 0, size);
+    req->loaded = TRUE;
+
+    darray_push(ctx->uploads.pending, req);
+    return TRUE;
+}
+
+// Called by the reader, from vc_cmd_flush_uploads
+void
+_vc_upload_file_read(_vc_upload_request *req, i64 result)
+{
+    if(result != (i64)req->size)
+    {
+        req->failed = TRUE;
+        return;
+    }
+
+    req->loaded = TRUE;
+}
+
+b8
+vc_image_upload_file(vc_ctx *ctx, vc_image image, const char *filepath, u64 offset, u64 size, b8 generate_mips, vc_upload_callback callback, void *usr_data)
+{
+    if(size == 0)
+    {
+        u64 file_size = 0;
+        if(!fio_get_file_size(filepath, &file_size) || file_size <= offset)
+        {
+            vc_error("Could not upload file '%s' (cannot access file, or file too small).", filepath);
+            return FALSE;
+        }
+        size = file_size - offset;
+    }
+
+    if(!ctx->uploads.reader_created)
+    {
+        if(!fio_async_create(&ctx->uploads.reader, VC_UPLOAD_READ_QUEUE_DEPTH, 0))
+        {
+            vc_error("Could not create the asynchronous file reader.");
+            return FALSE;
+        }
+        ctx->uploads.reader_created = TRUE;
+    }
+
+    void *mapped            = NULL;
+    _vc_upload_request *req = _vc_upload_request_create(ctx, image, size, generate_mips, &mapped);
+    if(req == NULL)
+    {
+        return FALSE;
+    }
+    req->callback = callback;
+    req->usr_data = usr_data;
+
+    // Read straight into the staging memory
+    if(!fio_async_read(&ctx->uploads.reader, filepath, offset, size, mapped, (fio_async_callback)_vc_upload_file_read, req))
+    {
+        vc_error("Could not open file '%s' for upload.", filepath);
+        _vc_upload_request_free(ctx->main_allocator, req);
+        return FALSE;
+    }
+
+    darray_push(ctx->uploads.pending, req);
+    return TRUE;
+}
+
+VkImageMemoryBarrier
+_vc_upload_barrier(VkImage image, VkImageAspectFlags aspects, u32 base_mip, u32 mip_count,
+                   VkAccessFlags src_access, VkAccessFlags dst_access,
+                   VkImageLayout old_layout, VkImageLayout new_layout)
+{
+    return (VkImageMemoryBarrier)
+           {
+               .sType         = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+               .image         = image,
+
+               .srcAccessMask = src_access,
+               .dstAccessMask = dst_access,
+
+               .oldLayout = old_layout,
+               .newLayout = new_layout,
+
+               .subresourceRange    = (VkImageSubresourceRange)
+               {
+                   .aspectMask     = aspects,
+                   .baseMipLevel   = base_mip,
+                   .levelCount     = mip_count,
+                   .baseArrayLayer = 0,
+                   .layerCount     = VK_REMAINING_ARRAY_LAYERS,
+               },
+
+               .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+               .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+           };
+}
+
+// Returns the filter to generate mips with, or FALSE if the format cannot be blitted
+b8
+_vc_upload_blit_filter(vc_ctx *ctx, _vc_image_intern *img, VkFilter *filter)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(ctx->current_physical_device, img->image_format, &props);
+
+    VkFormatFeatureFlags feats = img->create_info.tiling == VK_IMAGE_TILING_LINEAR ?
+                                 props.linearTilingFeatures :
+                                 props.optimalTilingFeatures;
+
+    VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if( (feats & blit) != blit)
+    {
+        return FALSE;
+    }
+
+    // Depth/stencil and integer formats cannot be filtered linearly
+    *filter = (feats & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    return TRUE;
+}
+
+// Records the generation of mip levels 1..n from level 0, which must be in TRANSFER_DST layout (as all other levels).
+// Leaves every level in the final layout.
+void
+_vc_upload_record_mips(VkCommandBuffer cmd, _vc_image_intern *img, VkImageAspectFlags aspects, VkFilter filter, VkImageLayout final_layout)
+{
+    u32 mip_count = img->create_info.mipLevels;
+    i32 width     = img->create_info.extent.width;
+    i32 height    = img->create_info.extent.height;
+    i32 depth     = img->create_info.extent.depth;
+
+    for(u32 i = 1; i < mip_count; i++)
+    {
+        // Previous level becomes the source
+        VkImageMemoryBarrier src_bar = _vc_upload_barrier(img->image, aspects, i - 1, 1,
+                                                          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &src_bar);
+
+        i32 next_width  = width > 1 ? width / 2 : 1;
+        i32 next_height = height > 1 ? height / 2 : 1;
+        i32 next_depth  = depth > 1 ? depth / 2 : 1;
+
+        VkImageBlit blit =
+        {
+            .srcSubresource = (VkImageSubresourceLayers)
+            {
+                .aspectMask     = aspects,
+                .mipLevel       = i - 1,
+                .baseArrayLayer = 0,
+                .layerCount     = img->create_info.arrayLayers,
+            },
+            .srcOffsets     =
+            {
+                [0] = { 0, 0, 0 },
+                [1] = { width, height, depth },
+            },
+            .dstSubresource = (VkImageSubresourceLayers)
+            {
+                .aspectMask     = aspects,
+                .mipLevel       = i,
+                .baseArrayLayer = 0,
+                .layerCount     = img->create_info.arrayLayers,
+            },
+            .dstOffsets     =
+            {
+                [0] = { 0, 0, 0 },
+                [1] = { next_width, next_height, next_depth },
+            },
+        };
+
+        vkCmdBlitImage(cmd,
+                       img->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       img->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, filter);
+
+        width  = next_width;
+        height = next_height;
+        depth  = next_depth;
+    }
+
+    VkImageMemoryBarrier final_bars[2] =
+    {
+        [0] = _vc_upload_barrier(img->image, aspects, 0, mip_count - 1,
+                                 VK_ACCESS_TRANSFER_READ_BIT, 0,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, final_layout),
+        [1] = _vc_upload_barrier(img->image, aspects, mip_count - 1, 1,
+                                 VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout),
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 2, final_bars);
+}
+
+void
+vc_cmd_flush_uploads(vc_cmd_record    record)
+{
+    _vc_command_buffer_intern *buf = (_vc_command_buffer_intern *)record;
+    vc_ctx *ctx                    = buf->record_ctx;
+
+    if(ctx->uploads.reader_created)
+    {
+        fio_async_poll(&ctx->uploads.reader);
+    }
+
+    // Split loaded uploads from the ones still being read
+    _vc_upload_request **ready = darray_create(_vc_upload_request *);
+    for(u32 i = 0; i < darray_length(ctx->uploads.pending); )
+    {
+        _vc_upload_request *req = ctx->uploads.pending[i];
+
+        if(req->failed)
+        {
+            vc_error("Could not read the file of an image upload.");
+            darray_pop_at(ctx->uploads.pending, i, NULL);
+            if(req->callback)
+            {
+                req->callback(req->usr_data, req->image, FALSE);
+            }
+            _vc_upload_request_free(ctx->main_allocator, req);
+            continue;
+        }
+
+        if(req->loaded)
+        {
+            vmaFlushAllocation(ctx->main_allocator, req->staging_alloc, 0, req->size);
+            darray_pop_at(ctx->uploads.pending, i, NULL);
+            darray_push(ready, req);
+            continue;
+        }
+
+        i++;
+    }
+
+    u32 count = darray_length(ready);
+    if(count == 0)
+    {
+        darray_destroy(ready);
+        return;
+    }
+
+    // Every image goes to TRANSFER_DST at once
+    VkImageMemoryBarrier *bars = darray_create(VkImageMemoryBarrier);
+    for(u32 i = 0; i < count; i++)
+    {
+        _vc_image_intern *img    = vc_handles_manager_deref(&ctx->handles_manager, ready[i]->image);
+        VkImageMemoryBarrier bar = _vc_upload_barrier(img->image, vc_format_get_aspects(img->image_format), 0, VK_REMAINING_MIP_LEVELS,
+                                                      0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        darray_push(bars, bar);
+    }
+    vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, count, bars);
+    darray_destroy(bars);
+
+    for(u32 i = 0; i < count; i++)
+    {
+        _vc_upload_request *req    = ready[i];
+        _vc_image_intern *img      = vc_handles_manager_deref(&ctx->handles_manager, req->image);
+        VkImageAspectFlags aspects = vc_format_get_aspects(img->image_format);
+
+        VkImageLayout final_layout = img->resting_layout != VK_IMAGE_LAYOUT_UNDEFINED ?
+                                     img->resting_layout :
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        // One region per aspect, a copy cannot write depth and stencil at once
+        VkBufferImageCopy regions[2];
+        u32 region_count = 0;
+        u64 offset       = 0;
+        for(u32 bit = 1; bit <= VK_IMAGE_ASPECT_STENCIL_BIT; bit <<= 1)
+        {
+            if( !(aspects & bit) )
+            {
+                continue;
+            }
+
+            regions[region_count++] = (VkBufferImageCopy)
+            {
+                .bufferOffset      = offset,
+                .bufferRowLength   = 0, // Tightly packed
+                .bufferImageHeight = 0,
+                .imageSubresource  = (VkImageSubresourceLayers)
+                {
+                    .aspectMask     = bit,
+                    .mipLevel       = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount     = img->create_info.arrayLayers,
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = img->create_info.extent,
+            };
+            offset += _vc_upload_aspect_size(img, bit);
+        }
+        vkCmdCopyBufferToImage(buf->buffer, req->staging, img->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, region_count, regions);
+
+        VkFilter filter = VK_FILTER_LINEAR;
+        b8 gen_mips     = req->generate_mips && img->create_info.mipLevels > 1;
+        if(gen_mips && !_vc_upload_blit_filter(ctx, img, &filter))
+        {
+            vc_warn("Image format %s cannot be blitted, mip levels will not be generated.", vc_priv_VkFormat_to_str(img->image_format));
+            gen_mips = FALSE;
+        }
+
+        if(gen_mips)
+        {
+            _vc_upload_record_mips(buf->buffer, img, aspects, filter, final_layout);
+        }
+        else
+        {
+            VkImageMemoryBarrier bar = _vc_upload_barrier(img->image, aspects, 0, VK_REMAINING_MIP_LEVELS,
+                                                          VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout);
+            vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &bar);
+        }
+    }
+
+    // The uploaded images can be used by the rest of the frame
+    VkMemoryBarrier mem_barrier =
+    {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(buf->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &mem_barrier, 0, NULL, 0, NULL);
+
+    // Staging buffers are kept alive until the GPU is done with this frame
+    vc_frames_defer(&ctx->frames, (vc_frame_retire_func)_vc_upload_retire, ready);
+}
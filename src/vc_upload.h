@@ -0,0 +1,65 @@
+#ifndef __VC_UPLOAD__
+#define __VC_UPLOAD__
+
+/*
+ * Batched uploads of data to GPU images.
+ * Data is copied into host visible staging buffers when the upload is requested (files are read asynchronously, straight
+ * into the staging memory), and every loaded upload is recorded at once into the command buffer given to
+ * vc_cmd_flush_uploads. Staging buffers are freed, and callbacks called, when that frame retires.
+ */
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include "handles/vc_handles.h"
+#include "base/fio_async.h"
+
+/**
+ * @brief Function called when an upload is complete on the GPU, or has failed
+ *
+ * @param usr_data The user data given with the upload
+ * @param image The destination image
+ * @param success FALSE if the upload failed (file could not be read)
+ */
+typedef void (*vc_upload_callback)(void *usr_data, vc_image image, b8 success);
+
+typedef struct
+{
+    vc_image              image;
+    b8                    generate_mips;
+
+    VkBuffer              staging;
+    VmaAllocation         staging_alloc;
+    u64                   size;
+
+    // File uploads are read asynchronously into the staging buffer, and recorded once loaded
+    b8                    loaded;
+    b8                    failed;
+
+    vc_upload_callback    callback;
+    void                 *usr_data;
+} _vc_upload_request;
+
+typedef struct
+{
+    _vc_upload_request   **pending; // darray, uploads waiting for the next flush
+
+    b8                     reader_created; // Created with the first file upload
+    fio_async_reader       reader;
+} vc_upload_queue;
+
+/**
+ * @brief Creates an upload queue
+ *
+ * @param queue The upload queue
+ */
+void vc_upload_queue_create(vc_upload_queue   *queue);
+
+/**
+ * @brief Destroys an upload queue, dropping the uploads that were never flushed
+ *
+ * @param queue The upload queue
+ * @param allocator The allocator the staging buffers were allocated with
+ */
+void vc_upload_queue_destroy(vc_upload_queue *queue, VmaAllocator allocator);
+
+#endif // __VC_UPLOAD__
@@ -9,8 +9,22 @@
 
 // ## TODO: Make those header private
 #include <vk_mem_alloc.h>
+#include "base/allocators/linear_allocator.h"
 #include "descriptors/vc_ds_alloc.h"
+#include "descriptors/vc_ds_registry.h"
+#include "descriptors/vc_set_cache.h"
 #include "descriptors/vc_set_layout_cache.h"
+#include "descriptors/vc_descriptor_buffer.h"
+#include "vc_frames.h"
+#include "vc_defrag.h"
+#include "vc_upload.h"
+#include "vc_readback.h"
+#include "vc_bindless.h"
+#include "vc_pipeline_cache.h"
+#include "vc_pipeline_compiler.h"
+#include "vc_object_cache.h"
+#include "vc_spirv.h"
+#include "base/data_structures/hashmap.h"
 // ##
 
 #include "femtolog.h"
@@ -37,8 +51,37 @@
 typedef struct
 {
     b8    dynamic_rendering;
+    b8    sampler_anisotropy; // Automatically enabled when supported by the device, required by anisotropic samplers
+    b8    buffer_device_address; // Automatically enabled when supported by the device
+    b8    descriptor_indexing; // Automatically enabled when supported by the device, required by the bindless heap
+    b8    push_descriptor; // Automatically enabled when supported by the device (and descriptor_buffer is not), required by vc_cmd_push_descriptor_set
+    b8    descriptor_buffer; // Automatically enabled when supported by the device, descriptor sets then live in a descriptor buffer instead of pools
+    b8    graphics_pipeline_library; // Automatically enabled when supported by the device, graphics pipelines are then fast-linked from cached parts
+    b8    extended_dynamic_state; // Enabled with Vulkan 1.3 devices (extended dynamic state 1 and 2), see vc_dynamic_state_flags
+    b8    extended_dynamic_state3; // Automatically enabled when supported by the device, makes polygon mode, depth clamp and blend dynamic
+    b8    shader_object; // Automatically enabled when supported by the device (with Vulkan 1.3), required by vc_shader
 } vc_ctx_supported_features;
 
+// Device level functions which are not always exported by the loader, loaded at device creation
+typedef struct
+{
+    PFN_vkGetBufferDeviceAddressKHR              get_buffer_device_address;
+    PFN_vkCmdPushDescriptorSetKHR                cmd_push_descriptor_set;
+    PFN_vkCmdPushDescriptorSetWithTemplateKHR    cmd_push_descriptor_set_with_template;
+    PFN_vkCmdSetPolygonModeEXT                   cmd_set_polygon_mode;
+    PFN_vkCmdSetDepthClampEnableEXT              cmd_set_depth_clamp_enable;
+    PFN_vkCmdSetColorBlendEnableEXT              cmd_set_color_blend_enable;
+    PFN_vkCmdSetColorBlendEquationEXT            cmd_set_color_blend_equation;
+    PFN_vkCmdSetColorWriteMaskEXT                cmd_set_color_write_mask;
+    PFN_vkCreateShadersEXT                       create_shaders;
+    PFN_vkDestroyShaderEXT                       destroy_shader;
+    PFN_vkCmdBindShadersEXT                      cmd_bind_shaders;
+    PFN_vkCmdSetVertexInputEXT                   cmd_set_vertex_input;
+    PFN_vkCmdSetRasterizationSamplesEXT          cmd_set_rasterization_samples;
+    PFN_vkCmdSetSampleMaskEXT                    cmd_set_sample_mask;
+    PFN_vkCmdSetAlphaToCoverageEnableEXT         cmd_set_alpha_to_coverage_enable;
+} vc_ctx_device_functions;
+
 // Welcome to vulcain
 typedef struct
 {
@@ -50,6 +93,7 @@ typedef struct
     vc_windowing_system            windowing_system; // In the case a windowing system is being used.
 
     VkInstance                     vk_instance;
+    u32                            api_version; // The Vulkan version requested by the application
     VkDebugUtilsMessengerEXT       debugging_messenger; // Only used if debugging_enabled.
 
     VkPhysicalDevice               current_physical_device;
@@ -58,10 +102,30 @@ typedef struct
     VmaAllocator                   main_allocator; // See if it would be a good idea to allow multiple allocators ...
 
     // TODO: Make those two invisible to the outside world
-    vc_descriptor_set_allocator    ds_allocator;
+    vc_ds_registry                 ds_registry; // Descriptor set allocators, one per thread
     vc_set_layout_cache            set_layout_cache;
+    vc_object_cache                shader_modules; // Keyed by SPIR-V
+    vc_object_cache                pipeline_layouts; // Keyed by set layouts and push constant ranges
+    vc_object_cache                shader_reflections; // Keyed by SPIR-V
+    vc_object_cache                reflected_layouts; // Keyed by the reflections of the shaders of a pipeline
+    vc_object_cache                pipeline_libraries; // Parts of graphics pipelines, keyed by the state they are compiled from
+    vc_set_cache                   set_cache; // Sets returned by vc_descriptor_set_writer_get_cached
+    mem_linear                     writer_arenas[VC_FRAMES_IN_FLIGHT]; // Transient writer storage, reset when the frame retires
+    vc_descriptor_buffer           descriptor_buffer; // Only created with the descriptor_buffer feature
+    vc_pipeline_cache              pipeline_cache; // Every pipeline is created through it
+    vc_pipeline_compiler           pipeline_compiler; // Compiles the asynchronous pipelines
+    hashmap                        pipelines_by_desc; // Canonical description hash to pipeline, guarded by pipelines_lock
+    pthread_mutex_t                pipelines_lock;
+    b8                             optimize_linked_pipelines; // Wether fast-linked pipelines are recompiled with link time optimization in the background, TRUE by default
 
     vc_ctx_supported_features      supported_features;
+    vc_ctx_device_functions        device_functions;
+
+    vc_frame_manager               frames;
+    vc_defrag_state                defrag;
+    vc_upload_queue                uploads;
+    vc_readback_pool               readbacks;
+    vc_bindless_heap               bindless;
 
     // Optional features
     void                          *imgui_ctx;
@@ -82,6 +146,14 @@ typedef struct
 
 // ## VC_CTX ##
 
+/*
+ * Threading: handles are allocated, read and destroyed under the lock of the handles manager, so buffers, images, views,
+ * samplers, pipelines, shaders, set layouts and descriptor sets can be created and destroyed from worker threads, as
+ * long as no other thread still uses a handle being destroyed. Descriptor set allocation, writers and updates are
+ * meant for worker threads as well. Frames, the recording of a given command buffer, vc_cmd_defrag_step and the
+ * creation and destruction of the context stay on a single thread.
+ */
+
 bool vc_ctx_create(vc_ctx                *ctx,
                    VkApplicationInfo      app_info,
                    vc_windowing_system   *windowing_system,
@@ -96,11 +168,49 @@ void     vc_ctx_destroy(vc_ctx   *ctx);
 void     vc_queue_wait_idle(vc_ctx *ctx, vc_queue queue);
 void     vc_device_wait_idle(vc_ctx   *ctx);
 
+// ## FRAMES ##
+
+/**
+ * @brief Begins a new frame. Blocks until the GPU is done with the frame that last used the same frame slot,
+ *        then releases the ressources that were waiting for it (see vc_defrag)
+ *
+ * @param ctx The vulcain context
+ */
+void     vc_frame_begin(vc_ctx   *ctx);
+
+/**
+ * @brief Ends the current frame
+ *
+ * @param ctx The vulcain context
+ * @param queue The queue on which the last command buffer of the frame has been submitted
+ * @note All the work of the frame must have been submitted on the queue before this call.
+ */
+void     vc_frame_end(vc_ctx *ctx, vc_queue queue);
+
 // ## FORMAT UTILS ##
 
 VkFormat vc_format_query_format(vc_ctx *ctx, vc_format_query query, vc_format_set candidates);
 b8       vc_format_query_index(vc_ctx *ctx, vc_format_query query, vc_format_set candidates, u32 *index);
 
+/**
+ * @brief Returns the aspects of an image of the given format
+ *
+ * @param format The format
+ * @return The color aspect, or the depth and/or stencil aspects for depth/stencil formats
+ */
+VkImageAspectFlags vc_format_get_aspects(VkFormat    format);
+
+/**
+ * @brief Returns the size of a texel block of a format, as laid out in buffers by copies of one of its aspects
+ *
+ * @param format The format
+ * @param aspect The aspect copied, depth and stencil are copied separately (stencil as one byte per texel)
+ * @param block_width[out] The width of a block in texels, 1 for uncompressed formats
+ * @param block_height[out] The height of a block in texels, 1 for uncompressed formats
+ * @return The size of a block in bytes, 0 for formats not handled (multi-planar and packed YUV formats)
+ */
+u32                vc_format_aspect_block_size(VkFormat format, VkImageAspectFlagBits aspect, u32 *block_width, u32 *block_height);
+
 // ## SWAPCHAIN ##
 
 /*
@@ -193,11 +303,64 @@ typedef struct
 
     VkImageLayout            initial_layout;
     vc_memory_create_info    memory;
+
+    // The layout in which the image is kept between frames. If not VK_IMAGE_LAYOUT_UNDEFINED, the image can be moved by the defragmenter.
+    // (Only for exclusive images, and implies transfer usage)
+    VkImageLayout            resting_layout;
 } vc_image_create_info;
 
 vc_image      vc_image_allocate(vc_ctx *ctx, vc_image_create_info create_info);
 vc_image_view vc_image_view_create(vc_ctx *ctx, vc_image image, VkImageViewType type, VkComponentMapping component_map, VkImageSubresourceRange range);
 
+typedef struct
+{
+    VkFilter                mag_filter;
+    VkFilter                min_filter;
+    VkSamplerMipmapMode     mipmap_mode;
+    VkSamplerAddressMode    address_mode; // Used for the U, V and W coordinates
+    f32                     max_anisotropy; // 0 disables anisotropic filtering, clamped to the device limit (ignored without the sampler_anisotropy feature)
+} vc_sampler_create_info;
+
+/**
+ * @brief Creates a sampler, sampling every mip level of the images
+ *
+ * @param ctx The vulcain context
+ * @param create_info The sampler parameters
+ * @return A handle to the sampler
+ */
+vc_sampler    vc_sampler_create(vc_ctx *ctx, vc_sampler_create_info create_info);
+
+/**
+ * @brief Uploads data to an image. The upload is staged, and recorded with all other pending uploads by vc_cmd_flush_uploads.
+ *
+ * @param ctx The vulcain context
+ * @param image The destination image, created with VK_IMAGE_USAGE_TRANSFER_DST_BIT (and VK_IMAGE_USAGE_TRANSFER_SRC_BIT to generate mips)
+ * @param data The tightly packed texels of the mip level 0, for every array layer. For depth/stencil formats, the
+ *             depth texels then the stencil texels (one byte each).
+ * @param size The size of the data in bytes, at least the size of the level 0
+ * @param generate_mips Wether the rest of the mip chain should be generated from level 0
+ * @return Wether the upload was staged
+ * @note The previous content of the image is discarded. After the flush, the image is in its resting layout,
+ *       or VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL if it has none.
+ */
+b8            vc_image_upload(vc_ctx *ctx, vc_image image, void *data, u64 size, b8 generate_mips);
+
+/**
+ * @brief Uploads the content of a file to an image. The file is read asynchronously, directly into the staging memory,
+ *        and the upload is recorded by the first vc_cmd_flush_uploads after the read completes.
+ *
+ * @param ctx The vulcain context
+ * @param image The destination image (see vc_image_upload)
+ * @param filepath The file containing the tightly packed texels of the mip level 0, for every array layer
+ * @param offset The offset of the texels in the file
+ * @param size The size of the texels in bytes (0 to read until the end of the file)
+ * @param generate_mips Wether the rest of the mip chain should be generated from level 0
+ * @param callback Called once the upload has completed on the GPU, or has failed (may be NULL)
+ * @param usr_data Passed to the callback
+ * @return FALSE if the upload could not be started
+ */
+b8            vc_image_upload_file(vc_ctx *ctx, vc_image image, const char *filepath, u64 offset, u64 size, b8 generate_mips, vc_upload_callback callback, void *usr_data);
+
 // Useful utils
 #define VC_COMP_MAP_ID \
         (VkComponentMapping) \
@@ -229,9 +392,55 @@ vc_image_view vc_image_view_create(vc_ctx *ctx, vc_image image, VkImageViewType
  * @param usage The usage of the buffer
  * @param mem The memory information about the allocation
  * @return A handle to the buffer
+ * @note Only buffers with both transfer source and destination usages can be moved by the defragmenter.
+ *       Buffers created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT are never moved, and require the buffer_device_address feature.
  */
 vc_buffer vc_buffer_allocate(vc_ctx *ctx, u64 size, VkBufferCreateFlags flags, VkBufferUsageFlags usage, vc_memory_create_info mem);
 
+/**
+ * @brief Returns the GPU address of a buffer, to be accessed from shaders (through push constants for example)
+ *
+ * @param ctx A vulcain context
+ * @param buffer The buffer, created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+ * @return The device address of the buffer, 0 if the buffer has no device address
+ */
+VkDeviceAddress vc_buffer_get_device_address(vc_ctx *ctx, vc_buffer buffer);
+
+// ## DEFRAGMENTATION ##
+
+/**
+ * @brief Starts an incremental defragmentation of the GPU memory. The moves are then recorded with vc_cmd_defrag_step.
+ *
+ * @param ctx The vulcain context
+ * @param max_moves_per_step The maximum number of allocations moved per step (0 for no limit)
+ * @param max_bytes_per_step The maximum number of bytes moved per step (0 for no limit)
+ * @return Wether the defragmentation was started
+ */
+b8   vc_defrag_begin(vc_ctx *ctx, u32 max_moves_per_step, u64 max_bytes_per_step);
+
+/**
+ * @brief Stops the defragmentation. If a step is still in flight, the defragmentation stops when its frame retires.
+ *
+ * @param ctx The vulcain context
+ */
+void vc_defrag_end(vc_ctx   *ctx);
+
+/**
+ * @brief Returns wether a defragmentation is running
+ *
+ * @param ctx The vulcain context
+ */
+b8   vc_defrag_is_running(vc_ctx   *ctx);
+
+/**
+ * @brief Sets the function called for every buffer, image and image view handle whose underlying object was replaced
+ *
+ * @param ctx The vulcain context
+ * @param func The callback
+ * @param usr_data User data passed to the callback
+ */
+void vc_defrag_set_moved_callback(vc_ctx *ctx, vc_defrag_moved_func func, void *usr_data);
+
 // ## DESCRIPTORS ##
 
 // Set layouts
@@ -269,6 +478,9 @@ void                     vc_descriptor_set_layout_builder_add_bindings(vc_descri
  * @param builder The (non non-inited) builder
  * @param flags The flags to create the set layout with
  * @return A handle to the set layout
+ * @note With VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR, no set can be allocated from the layout: its
+ *       descriptors are pushed with vc_cmd_push_descriptor_set. VC_NULL_HANDLE is returned if the push_descriptor
+ *       feature is not supported.
  */
 vc_descriptor_set_layout vc_descriptor_set_layout_builder_build(vc_ctx *ctx, vc_descriptor_set_layout_builder *builder, VkDescriptorSetLayoutCreateFlags flags);
 
@@ -283,18 +495,127 @@ vc_descriptor_set_layout vc_descriptor_set_layout_builder_build(vc_ctx *ctx, vc_
  */
 vc_descriptor_set        vc_descriptor_set_allocate(vc_ctx *ctx, vc_descriptor_set_layout layout);
 
+/**
+ * @brief Allocates a descriptor set that only lives for the current frame
+ *
+ * @param ctx The vulcain context
+ * @param layout The set layout with which to create the descriptor
+ * @return A handle to the allocated descriptor set, invalid once the current frame retires
+ * @note Transient sets are never freed one by one: the pools of the frame are reset at once when it retires.
+ * @note Descriptor sets may be allocated from several threads at once, each thread allocating from its own pools.
+ */
+vc_descriptor_set        vc_descriptor_set_allocate_transient(vc_ctx *ctx, vc_descriptor_set_layout layout);
+
+/**
+ * @brief Allocates several descriptor sets at once, each with its own layout
+ *
+ * @param ctx The vulcain context
+ * @param count The number of sets
+ * @param layouts The layout of each set
+ * @param out_sets The handles of the allocated sets
+ * @return Wether every set could be allocated, the handles are all VC_NULL_HANDLE otherwise
+ * @note Sets are allocated with as few Vulkan calls as the pools allow, and their handles are reserved at once. This is
+ *       much faster than vc_descriptor_set_allocate for the sets of many objects (like materials) at load time.
+ */
+b8                       vc_descriptor_sets_allocate(vc_ctx *ctx, u32 count, const vc_descriptor_set_layout *layouts, vc_descriptor_set *out_sets);
+
+/**
+ * @brief Returns the usage statistics of the descriptor pools of every thread
+ *
+ * @param ctx The vulcain context
+ * @param stats The statistics
+ * @note Pools are sized from ratios of descriptors of each type per set, retuned from the observed allocations as frames
+ *       retire. The waste counters only account for the pools that filled up.
+ */
+void                     vc_descriptor_pool_stats_get(vc_ctx *ctx, vc_ds_stats *stats);
+
+/**
+ * @brief Logs the usage statistics of the descriptor pools, see vc_descriptor_pool_stats_get
+ *
+ * @param ctx The vulcain context
+ */
+void                     vc_descriptor_pool_stats_print(vc_ctx   *ctx);
+
+/**
+ * @brief Saves the tuned descriptor pool ratios, so a later run can start from them
+ *
+ * @param ctx The vulcain context
+ * @param path The path of the file
+ * @return Wether the ratios could be saved
+ */
+b8                       vc_descriptor_pool_ratios_save(vc_ctx *ctx, const char *path);
+
+/**
+ * @brief Loads descriptor pool ratios saved with vc_descriptor_pool_ratios_save
+ *
+ * @param ctx The vulcain context
+ * @param path The path of the file
+ * @return Wether the ratios could be loaded
+ * @note Only pools created afterwards use the loaded ratios, so this is best called right after vc_ctx_create.
+ */
+b8                       vc_descriptor_pool_ratios_load(vc_ctx *ctx, const char *path);
+
+/**
+ * @brief The raw data of a single descriptor, as read by update templates
+ * @note image is read for sampler and image types, buffer for (dynamic) uniform and storage buffers, and texel_buffer for texel buffers.
+ */
+typedef union
+{
+    VkDescriptorImageInfo     image;
+    VkDescriptorBufferInfo    buffer;
+    VkBufferView              texel_buffer;
+} vc_descriptor_data;
+
 /**
  * @brief Representes a writer, which helps writing into descriptor sets
+ * @note A zero initialized writer allocates its storage on its first write, and frees it once submitted (written,
+ *       cached, compiled or pushed). Writers initialized with vc_descriptor_set_writer_init or
+ *       vc_descriptor_set_writer_init_transient never allocate, and keep their storage to be reused once submitted.
  */
 typedef struct
 {
-    // darrays
+    // All in one block, indexed by write
     VkWriteDescriptorSet     *writes;
+    vc_descriptor_data       *infos; // The image or buffer info of each write
+    vc_handle                *resources; // Two per write: the view or buffer, and the sampler
 
-    VkDescriptorImageInfo    *img_infos;
-    VkDescriptorBufferInfo   *buf_infos;
+    u32                       count;
+    u32                       capacity;
+    b8                        fixed; // The storage belongs to someone else, and cannot grow
 } vc_descriptor_set_writer;
 
+// Bytes of writer storage needed per write
+#define VC_DESCRIPTOR_SET_WRITER_WRITE_SIZE (sizeof(VkWriteDescriptorSet) + sizeof(vc_descriptor_data) + 2 * sizeof(vc_handle) )
+
+/**
+ * @brief Initializes a writer on memory owned by the caller
+ *
+ * @param writer The writer
+ * @param memory The storage of the writer, 8 bytes aligned
+ * @param size The size of the storage, the writer holds size / VC_DESCRIPTOR_SET_WRITER_WRITE_SIZE writes
+ * @note Writes past the capacity are ignored, with an error.
+ */
+void vc_descriptor_set_writer_init(vc_descriptor_set_writer *writer, void *memory, u64 size);
+
+/**
+ * @brief Initializes a writer on the transient memory of the current frame
+ *
+ * @param ctx A vulcain context
+ * @param writer The writer
+ * @param capacity The maximum number of writes
+ * @return Wether the frame memory could hold the writer
+ * @note The writer is only valid for the current frame, its storage is reclaimed once the frame retires. This is thread
+ *       safe.
+ */
+b8   vc_descriptor_set_writer_init_transient(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 capacity);
+
+/**
+ * @brief Drops the writes of a writer, without submitting them
+ *
+ * @param writer The writer
+ */
+void vc_descriptor_set_writer_reset(vc_descriptor_set_writer   *writer);
+
 /**
  * @brief Writes a buffer type descriptor into the descriptor set
  *
@@ -333,9 +654,175 @@ void vc_descriptor_set_writer_write_image(vc_ctx *ctx, vc_descriptor_set_writer
  */
 void vc_descriptor_set_writer_write(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_descriptor_set set);
 
+/**
+ * @brief Updates several descriptor sets with the same written information, in a single update
+ *
+ * @param ctx A vulcain context
+ * @param writer The writer
+ * @param set_count The number of sets
+ * @param sets The destination sets
+ */
+void vc_descriptor_set_writer_write_many(vc_ctx *ctx, vc_descriptor_set_writer *writer, u32 set_count, const vc_descriptor_set *sets);
+
+/**
+ * @brief Returns a set holding the written information. If a set of the same layout was written with the exact same
+ *        information before, it is returned as is, without any allocation nor update.
+ *
+ * @param ctx A vulcain context
+ * @param writer The writer
+ * @param layout The layout of the set
+ * @return A handle to the set
+ * @note Cached sets are evicted in least recently used order, and when a view, buffer or sampler they reference is
+ *       destroyed (or moved by the defragmenter). The handle must thus not be kept past the current frame: calling
+ *       this function again every frame is cheap.
+ */
+vc_descriptor_set vc_descriptor_set_writer_get_cached(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_descriptor_set_layout layout);
+
+// Update templates
+
+/**
+ * @brief Compiles the writes of a writer into an update template. Only the destinations and types of the writes are
+ *        kept, the written resources are ignored.
+ *
+ * @param ctx A vulcain context
+ * @param writer The writer, which is reset
+ * @param layout The layout of the sets which will be updated with the template
+ * @return A handle to the template
+ * @note Updates read one vc_descriptor_data per write, in the order the writes were made.
+ */
+vc_descriptor_update_template vc_descriptor_set_writer_compile(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_descriptor_set_layout layout);
+
+/**
+ * @brief Compiles the writes of a writer into a push descriptor template, see vc_cmd_push_descriptor_set_with_template.
+ *        Requires the push_descriptor feature.
+ *
+ * @param ctx A vulcain context
+ * @param writer The writer, which is reset
+ * @param pipeline A pipeline whose layout has a push descriptor set layout at set_index
+ * @param set_index The set number
+ * @return A handle to the template, VC_NULL_HANDLE if push descriptors are not supported
+ */
+vc_descriptor_update_template vc_descriptor_set_writer_compile_push(vc_ctx *ctx, vc_descriptor_set_writer *writer, vc_handle pipeline, u32 set_index);
+
+/**
+ * @brief Updates a set with a template
+ *
+ * @param ctx A vulcain context
+ * @param set The destination set, of the layout the template was compiled against (push templates cannot be used)
+ * @param update_template The template
+ * @param data One vc_descriptor_data per write of the template
+ */
+void               vc_descriptor_set_update_with_template(vc_ctx *ctx, vc_descriptor_set set, vc_descriptor_update_template update_template, const vc_descriptor_data *data);
+
+/**
+ * @brief Returns the data of an image descriptor
+ *
+ * @param ctx A vulcain context
+ * @param view The image view (Can be VC_NULL_HANDLE)
+ * @param sampler A sampler (Can be VC_NULL_HANDLE)
+ * @param layout The layout in which the image will be when accessed/sampled
+ * @note The data only holds raw Vulkan objects: it can be kept and reused for as long as the view and sampler are alive
+ *       (and the image is not moved by the defragmenter).
+ */
+vc_descriptor_data vc_descriptor_data_image(vc_ctx *ctx, vc_image_view view, vc_sampler sampler, VkImageLayout layout);
+
+/**
+ * @brief Returns the data of a buffer descriptor
+ *
+ * @param ctx A vulcain context
+ * @param buffer The buffer handle
+ * @param offset The offset in device units into the buffer
+ * @param range The range in device units into the buffer
+ * @note The data can be kept and reused for as long as the buffer is alive (and is not moved by the defragmenter).
+ */
+vc_descriptor_data vc_descriptor_data_buffer(vc_ctx *ctx, vc_buffer buffer, u64 offset, u64 range);
+
+
+// ## BINDLESS ##
+
+/**
+ * @brief Creates the bindless heap of the context. Requires the descriptor_indexing feature.
+ *
+ * @param ctx The vulcain context
+ * @param sampled_image_count The capacity of the sampled images array (binding VC_BINDLESS_SAMPLED_IMAGES)
+ * @param storage_image_count The capacity of the storage images array (binding VC_BINDLESS_STORAGE_IMAGES)
+ * @param sampler_count The capacity of the samplers array (binding VC_BINDLESS_SAMPLERS)
+ * @param storage_buffer_count The capacity of the storage buffers array (binding VC_BINDLESS_STORAGE_BUFFERS)
+ * @return Wether the heap could be created
+ * @note Capacities are clamped to the update after bind limits of the device. Every binding is visible to all stages.
+ *       With the descriptor_buffer feature, the heap must also fit in the persistent region of the descriptor buffer.
+ */
+b8                       vc_bindless_create(vc_ctx *ctx, u32 sampled_image_count, u32 storage_image_count, u32 sampler_count, u32 storage_buffer_count);
+
+/**
+ * @brief Returns the layout of the bindless set, to create pipelines with
+ *
+ * @param ctx The vulcain context
+ */
+vc_descriptor_set_layout vc_bindless_get_layout(vc_ctx   *ctx);
+
+/**
+ * @brief Returns the bindless set, which only needs to be bound once per command buffer
+ *
+ * @param ctx The vulcain context
+ */
+vc_descriptor_set        vc_bindless_get_set(vc_ctx   *ctx);
+
+/**
+ * @brief Registers an image view as a sampled image
+ *
+ * @param ctx The vulcain context
+ * @param view The view
+ * @param layout The layout the image is in when it is sampled
+ * @return The index of the view in the sampled images array, UINT32_MAX if the array is full
+ * @note While registered, the image of the view is never moved by the defragmenter.
+ */
+u32                      vc_bindless_register_sampled_image(vc_ctx *ctx, vc_image_view view, VkImageLayout layout);
+
+/**
+ * @brief Registers an image view as a storage image (in VK_IMAGE_LAYOUT_GENERAL)
+ *
+ * @param ctx The vulcain context
+ * @param view The view
+ * @return The index of the view in the storage images array, UINT32_MAX if the array is full
+ * @note While registered, the image of the view is never moved by the defragmenter.
+ */
+u32                      vc_bindless_register_storage_image(vc_ctx *ctx, vc_image_view view);
+
+/**
+ * @brief Registers a sampler
+ *
+ * @param ctx The vulcain context
+ * @param sampler The sampler
+ * @return The index of the sampler in the samplers array, UINT32_MAX if the array is full
+ */
+u32                      vc_bindless_register_sampler(vc_ctx *ctx, vc_sampler sampler);
+
+/**
+ * @brief Registers a range of a buffer as a storage buffer
+ *
+ * @param ctx The vulcain context
+ * @param buffer The buffer
+ * @param offset The offset of the range
+ * @param range The size of the range (VK_WHOLE_SIZE for the rest of the buffer)
+ * @return The index of the range in the storage buffers array, UINT32_MAX if the array is full
+ * @note While registered, the buffer is never moved by the defragmenter.
+ */
+u32                      vc_bindless_register_storage_buffer(vc_ctx *ctx, vc_buffer buffer, u64 offset, u64 range);
+
+/**
+ * @brief Releases an index. The index is reused once the GPU is done with the current frame.
+ *
+ * @param ctx The vulcain context
+ * @param binding The binding the index belongs to
+ * @param index The index to release
+ * @attention The resource must be released before it is destroyed.
+ */
+void                     vc_bindless_release(vc_ctx *ctx, vc_bindless_binding binding, u32 index);
 
 // ## PIPELINES ##
 
+// A layout info without set layouts nor push constants is reflected from the shaders of the pipeline
 typedef struct
 {
     u32                         set_layout_count;
@@ -345,15 +832,42 @@ typedef struct
     VkPushConstantRange        *push_constants;
 } vc_pipeline_layout_info;
 
+// - Specialization constants
 typedef struct
 {
-    u8           *vertex_code;
-    u64           vertex_code_size;
-    const char   *vertex_entry_point;
+    u32    id; // The SpecId of the constant
+
+    // The member of the type of the constant
+    union
+    {
+        VkBool32    bool_value;
+        i32         int_value;
+        u32         uint_value;
+        f32         float_value;
+        i64         int64_value;
+        u64         uint64_value;
+        f64         double_value;
+    };
+} vc_spec_constant;
+
+// Constants not declared by a shader are ignored, the sizes of the constants are reflected from the shaders
+typedef struct
+{
+    u32                 constant_count;
+    vc_spec_constant   *constants;
+} vc_specialization;
 
-    u8           *fragment_code;
-    u64           fragment_code_size;
-    const char   *fragment_entry_point;
+typedef struct
+{
+    u8                  *vertex_code;
+    u64                  vertex_code_size;
+    const char          *vertex_entry_point;
+    vc_specialization    vertex_specialization;
+
+    u8                  *fragment_code;
+    u64                  fragment_code_size;
+    const char          *fragment_entry_point;
+    vc_specialization    fragment_specialization;
 } vc_gfx_pipeline_code_info;
 
 // - Vertex bindings
@@ -374,6 +888,30 @@ typedef struct
     VkVertexInputRate              input_rate;
 } vc_vertex_binding;
 
+// - Dynamic states
+// Groups of graphics pipeline states that are dynamic by default, when the device supports it: their values in the
+// description are ignored, pipelines differing only by them are the same pipeline, and they are set while recording
+// with the vc_cmd_set_* commands. vc_cmd_begin_rendering sets every dynamic state to its default value.
+typedef enum
+{
+    VC_DYNAMIC_VIEWPORT        = 1 << 0, // Viewports and scissors, and their count. Default: the render area
+    VC_DYNAMIC_CULL_MODE       = 1 << 1, // Cull mode and front face. Default: no culling, counter clockwise
+    VC_DYNAMIC_TOPOLOGY        = 1 << 2, // Topology, within the class (points, lines, triangles, patches) of the description. Default: triangle list
+    VC_DYNAMIC_DEPTH_TEST      = 1 << 3, // Depth test, write and compare op. Default: disabled, VK_COMPARE_OP_LESS
+    VC_DYNAMIC_DEPTH_BOUNDS    = 1 << 4, // Depth bounds test and bounds. Default: disabled, [0, 1]
+    VC_DYNAMIC_DEPTH_BIAS      = 1 << 5, // Depth bias and its factors. Default: disabled
+    VC_DYNAMIC_STENCIL         = 1 << 6, // Stencil test, ops, masks and reference. Default: disabled
+    VC_DYNAMIC_LINE_WIDTH      = 1 << 7, // Default: 1
+    VC_DYNAMIC_BLEND_CONSTANTS = 1 << 8, // Default: 0
+    VC_DYNAMIC_POLYGON_MODE    = 1 << 9, // extended_dynamic_state3 only. Default: fill
+    VC_DYNAMIC_DEPTH_CLAMP     = 1 << 10, // extended_dynamic_state3 only. Default: disabled
+    VC_DYNAMIC_BLEND           = 1 << 11, // Blend enables, equations and color write masks, extended_dynamic_state3 only. Default: no blending, RGBA written
+    VC_DYNAMIC_MULTISAMPLE     = 1 << 12, // Sample count and alpha to coverage, shader objects only. Default: one sample, every sample written, no alpha to coverage nor rasterizer discard
+    VC_DYNAMIC_VERTEX_INPUT    = 1 << 13, // Shader objects only. Default: the reflected inputs of the bound vertex shader
+
+    VC_DYNAMIC_ALL             = (1 << 14) - 1,
+} vc_dynamic_state_flags;
+
 typedef struct
 {
 
@@ -382,7 +920,8 @@ typedef struct
 
     vc_pipeline_layout_info                layout_info;
 
-    // Assembly state
+    // Assembly state, without vertex bindings the inputs of the vertex shader are reflected in a single binding 0,
+    // tightly packed in location order
     u32                                    vertex_binding_count;
     vc_vertex_binding                     *vertex_bindings;
 
@@ -427,7 +966,9 @@ typedef struct
     VkPipelineColorBlendAttachmentState   *attachment_blends;
     f32                                    blend_constants[4];
 
-    // Dynamic states
+    // Dynamic states, the states of the groups not baked are added to the array (a viewport or scissor state in the
+    // array bakes VC_DYNAMIC_VIEWPORT)
+    vc_dynamic_state_flags                 static_states; // The groups baked into the pipeline from the description, none by default
     u32                                    dynamic_state_count;
     VkDynamicState                        *dynamic_states;
 
@@ -443,6 +984,53 @@ typedef struct
     VkFormat    stencil_attachment_format;
 } vc_pipeline_rendering_info;
 
+typedef struct
+{
+    u8                        *code;
+    u64                        code_size;
+    char                      *entry_point;
+    vc_specialization          specialization;
+
+    vc_pipeline_layout_info    layout_info;
+} vc_compute_pipeline_desc;
+
+/**
+ * @brief Reflects a SPIR-V module: its descriptor bindings, push constants, workgroup size, specialization constants
+ *        and vertex inputs. Reflections are cached by code, a module is only parsed once.
+ *
+ * @param ctx The context
+ * @param code The SPIR-V code
+ * @param code_size The size of the code
+ * @return The reflection, owned by the context, NULL if the code could not be parsed
+ */
+const vc_shader_reflection *vc_shader_reflect(vc_ctx *ctx, u8 *code, u64 code_size);
+
+/**
+ * @brief Reflects the layout of the shaders of a pipeline: a set layout per set used by the shaders (bindings shared
+ *        by several stages are merged), and a single push constant range covering the blocks of every stage. This is
+ *        the layout pipelines are created with when their layout info is empty, the same set layouts are returned for
+ *        the same shaders, so sets can be allocated for these pipelines.
+ *
+ * @param ctx The context
+ * @param shader_count The number of shaders (vertex then fragment for graphics pipelines)
+ * @param codes The SPIR-V code of each shader
+ * @param code_sizes The size of each code
+ * @return The layout info, its arrays are owned by the context. Empty if the shaders could not be reflected.
+ */
+vc_pipeline_layout_info     vc_pipeline_layout_reflect(vc_ctx *ctx, u32 shader_count, u8 **codes, u64 *code_sizes);
+
+/*
+ * Pipelines are deduplicated: creating a pipeline whose description equals the one of a live pipeline (same shader
+ * code, layout, fixed function state and rendering info) returns that pipeline, with a new reference. Every creation
+ * is matched by a vc_handle_destroy, which destroys the pipeline once its last reference is dropped.
+ *
+ * With the graphics_pipeline_library feature, graphics pipelines are fast-linked from four cached parts (vertex input,
+ * pre-rasterization shaders, fragment shader and fragment output), each compiled the first time it is needed: pipelines
+ * differing only by their blend state or attachment formats share their shader parts. When
+ * ctx->optimize_linked_pipelines is set, an optimized pipeline is then compiled in the background, and replaces the
+ * fast-linked one once it is ready.
+ */
+
 vc_gfx_pipeline vc_gfx_pipeline_dynamic_create(
     vc_ctx                       *ctx,
     vc_graphics_pipeline_desc     desc,
@@ -459,13 +1047,136 @@ vc_compute_pipeline vc_compute_pipeline_create(
     vc_pipeline_layout_info    layout_info
     );
 
+/**
+ * @brief Creates graphics pipelines with a single vkCreateGraphicsPipelines call
+ *
+ * @param ctx The context
+ * @param count The number of pipelines
+ * @param descs The descriptions of the pipelines
+ * @param dyn_infos The dynamic rendering information of each pipeline
+ * @param pipelines[out] The pipelines, equal descriptions sharing one pipeline. All VC_NULL_HANDLE if one of them could not be created
+ * @return Wether every pipeline could be created
+ */
+b8                  vc_gfx_pipelines_dynamic_create(vc_ctx *ctx, u32 count, const vc_graphics_pipeline_desc *descs, const vc_pipeline_rendering_info *dyn_infos, vc_gfx_pipeline *pipelines);
+
+/**
+ * @brief Creates compute pipelines with a single vkCreateComputePipelines call
+ *
+ * @param ctx The context
+ * @param count The number of pipelines
+ * @param descs The descriptions of the pipelines
+ * @param pipelines[out] The pipelines, equal descriptions sharing one pipeline. All VC_NULL_HANDLE if one of them could not be created
+ * @return Wether every pipeline could be created
+ */
+b8                  vc_compute_pipelines_create(vc_ctx *ctx, u32 count, const vc_compute_pipeline_desc *descs, vc_compute_pipeline *pipelines);
+
+/**
+ * @brief Creates a graphics pipeline compiled on a worker thread (one worker per core). The handle is returned
+ *        immediately, and can be used as soon as it is returned: until the pipeline is compiled, binding it binds the
+ *        fallback pipeline, or waits for the compilation if there is none. The description is only used during the call.
+ *
+ * @param ctx The context
+ * @param desc The description of the pipeline
+ * @param dyn_info The dynamic rendering information
+ * @param fallback A pipeline bound until this one is compiled, with a compatible layout, or VC_NULL_HANDLE
+ * @return The pipeline
+ */
+vc_gfx_pipeline     vc_gfx_pipeline_dynamic_create_async(vc_ctx *ctx, vc_graphics_pipeline_desc desc, vc_pipeline_rendering_info dyn_info, vc_gfx_pipeline fallback);
+
+/**
+ * @brief Creates a compute pipeline compiled on a worker thread, see vc_gfx_pipeline_dynamic_create_async
+ *
+ * @param ctx The context
+ * @param desc The description of the pipeline
+ * @param fallback A pipeline dispatched until this one is compiled, with a compatible layout, or VC_NULL_HANDLE
+ * @return The pipeline
+ */
+vc_compute_pipeline vc_compute_pipeline_create_async(vc_ctx *ctx, vc_compute_pipeline_desc desc, vc_compute_pipeline fallback);
+
+/**
+ * @brief Returns wether a pipeline can be bound without blocking. Always TRUE for pipelines not created asynchronously,
+ *        fast-linked pipelines being ready while their optimized version compiles.
+ *
+ * @param ctx The context
+ * @param pipeline A graphics or compute pipeline
+ * @return Wether the pipeline is compiled, FALSE if its compilation failed
+ */
+b8                  vc_pipeline_is_ready(vc_ctx *ctx, vc_handle pipeline);
+
+/**
+ * @brief Blocks until every asynchronous pipeline is compiled, for a loading screen for instance
+ *
+ * @param ctx The context
+ */
+void                vc_pipelines_wait(vc_ctx   *ctx);
+
+/**
+ * @brief Returns a variant of a pipeline, with some of its specialization constants replaced. Variants are cached by
+ *        base pipeline and constant values: a variant is compiled the first time it is requested, and returned with a
+ *        new reference afterwards. Constants are set in every stage declaring them.
+ *
+ * @param ctx The context
+ * @param base A graphics or compute pipeline, not a variant
+ * @param specialization The constants to replace
+ * @return The variant, released with vc_handle_destroy, VC_NULL_HANDLE on failure
+ */
+vc_handle           vc_pipeline_variant(vc_ctx *ctx, vc_handle base, vc_specialization specialization);
+
+/**
+ * @brief Writes the pipeline cache to the file given to vc_device_builder_set_pipeline_cache_file, it is also written
+ *        when the context is destroyed. Saving after the pipelines of a loading screen are created keeps the cache
+ *        warm even if the application does not exit cleanly.
+ *
+ * @param ctx The context
+ * @return Wether the cache was written
+ */
+b8 vc_pipeline_cache_save(vc_ctx   *ctx);
+
 typedef enum
 {
     VC_PIPELINE_COMPUTE = 1,
     VC_PIPELINE_GRAPHICS,
+    VC_PIPELINE_SHADER,
     VC_PIPELINE_TYPE_MAX,
 } vc_pipeline_type;
 
+// - Shader objects
+// Pipeline-less shaders, compiled stage by stage and bound with vc_cmd_bind_shaders. Every state is dynamic with
+// shader objects. A shader can be given wherever a pipeline is expected for its layout (descriptor sets, push
+// constants and push descriptor templates).
+typedef struct
+{
+    VkShaderStageFlagBits      stage; // Vertex, fragment or compute
+    VkShaderStageFlags         next_stages; // The stages that may follow, the fragment stage for vertex shaders if 0
+    u8                        *code;
+    u64                        code_size;
+    const char                *entry_point;
+    vc_specialization          specialization;
+
+    vc_pipeline_layout_info    layout_info; // Shaders bound together must have equal layouts
+} vc_shader_desc;
+
+/**
+ * @brief Creates a shader object, requires the shader_object feature
+ *
+ * @param ctx The context
+ * @param desc The description of the shader, an empty layout info is reflected from the shader alone
+ * @return The shader, destroyed with vc_handle_destroy, VC_NULL_HANDLE on failure
+ */
+vc_shader vc_shader_create(vc_ctx *ctx, vc_shader_desc desc);
+
+/**
+ * @brief Creates shader objects with a single vkCreateShadersEXT call, the shaders are not linked: each can be bound
+ *        with any other shader of the same layout.
+ *
+ * @param ctx The context
+ * @param count The number of shaders
+ * @param descs The descriptions of the shaders, empty layout infos are reflected from every shader of the call
+ * @param shaders[out] The shaders. All VC_NULL_HANDLE if one of them could not be created
+ * @return Wether every shader could be created
+ */
+b8        vc_shaders_create(vc_ctx *ctx, u32 count, const vc_shader_desc *descs, vc_shader *shaders);
+
 // ## DYNAMIC RENDERING ##
 
 /**
@@ -527,9 +1238,151 @@ void vc_cmd_bind_descriptor_set(vc_cmd_record record, vc_handle pipeline, vc_des
 void vc_cmd_dispatch_compute(vc_cmd_record record, vc_compute_pipeline pipeline, u32 groups_x, u32 groups_y, u32 groups_z);
 void vc_cmd_push_constants(vc_cmd_record record, vc_handle pipeline, VkShaderStageFlags stage, u32 offset, u32 size, void *data);
 
+/**
+ * @brief Pushes the written information as descriptor set set_index of the pipeline, without any set nor pool
+ *        allocation. Requires the push_descriptor feature.
+ *
+ * @param record The record
+ * @param pipeline The pipeline, whose layout has a push descriptor set layout (see
+ *        vc_descriptor_set_layout_builder_build) at set_index
+ * @param set_index The set number
+ * @param writer The writer, which is reset
+ */
+void vc_cmd_push_descriptor_set(vc_cmd_record record, vc_handle pipeline, u32 set_index, vc_descriptor_set_writer *writer);
+
+/**
+ * @brief Pushes descriptors with a template compiled by vc_descriptor_set_writer_compile_push
+ *
+ * @param record The record
+ * @param pipeline A pipeline whose layout is compatible with the one the template was compiled for
+ * @param update_template The template
+ * @param data One vc_descriptor_data per write of the template
+ */
+void vc_cmd_push_descriptor_set_with_template(vc_cmd_record record, vc_handle pipeline, vc_descriptor_update_template update_template, const vc_descriptor_data *data);
+
 void vc_cmd_draw(vc_cmd_record record, u32 vertex_count, u32 instance_count, u32 first_vertex, u32 first_instance);
 void vc_cmd_bind_pipeline(vc_cmd_record record, vc_gfx_pipeline pipeline);
 
+/*
+ * Dynamic state, see vc_dynamic_state_flags. A state is set for the following draws, until the next
+ * vc_cmd_begin_rendering. Binding a pipeline baking a state resets that state to its default for the next pipeline
+ * where it is dynamic. States the device cannot make dynamic are not set, with an error: the ones of
+ * extended_dynamic_state without it, the ones of extended_dynamic_state3 without it, and the shader objects only ones.
+ */
+
+void vc_cmd_set_viewport(vc_cmd_record record, u32 viewport_count, const VkViewport *viewports);
+void vc_cmd_set_scissor(vc_cmd_record record, u32 scissor_count, const VkRect2D *scissors);
+void vc_cmd_set_cull_mode(vc_cmd_record record, VkCullModeFlags cull_mode, VkFrontFace front_face);
+void vc_cmd_set_topology(vc_cmd_record record, VkPrimitiveTopology topology, b8 primitive_restart);
+void vc_cmd_set_depth_test(vc_cmd_record record, b8 test, b8 write, VkCompareOp compare_op);
+void vc_cmd_set_depth_bounds(vc_cmd_record record, b8 test, f32 min, f32 max);
+void vc_cmd_set_depth_bias(vc_cmd_record record, b8 enable, f32 constant, f32 clamp, f32 slope);
+void vc_cmd_set_stencil(vc_cmd_record record, b8 test, VkStencilOpState front, VkStencilOpState back);
+void vc_cmd_set_line_width(vc_cmd_record record, f32 line_width);
+void vc_cmd_set_blend_constants(vc_cmd_record record, const f32 blend_constants[4]);
+void vc_cmd_set_polygon_mode(vc_cmd_record record, VkPolygonMode polygon_mode);
+void vc_cmd_set_depth_clamp(vc_cmd_record record, b8 enable);
+void vc_cmd_set_blend(vc_cmd_record record, u32 first_attachment, u32 attachment_count, const VkPipelineColorBlendAttachmentState *blends);
+void vc_cmd_set_multisample(vc_cmd_record record, VkSampleCountFlagBits sample_count, b8 alpha_to_coverage);
+void vc_cmd_set_vertex_input(vc_cmd_record record, u32 binding_count, const vc_vertex_binding *bindings);
+
+/**
+ * @brief Binds shader objects, each to its stage. Binding a vertex or fragment shader unbinds the graphics stages
+ *        left out, sets the vertex input to the one of the vertex shader, and resets the dynamic states overwritten
+ *        by a pipeline to their defaults.
+ *
+ * @param record The command buffer
+ * @param count The number of shaders
+ * @param shaders The shaders, at most one per stage
+ */
+void vc_cmd_bind_shaders(vc_cmd_record record, u32 count, const vc_shader *shaders);
+
+// Dispatches the bound compute shader
+void vc_cmd_dispatch(vc_cmd_record record, u32 groups_x, u32 groups_y, u32 groups_z);
+
+// Readbacks
+
+/**
+ * @brief A pending readback. 0 is never a valid ticket.
+ */
+typedef u64 vc_readback_ticket;
+
+typedef struct
+{
+    // Buffers
+    u64                         offset;
+
+    // Images
+    VkImageLayout               image_layout; // TRANSFER_SRC_OPTIMAL or GENERAL
+    VkImageSubresourceLayers    subresource;
+    VkOffset3D                  image_offset;
+    VkExtent3D                  image_extent;
+
+    // The number of bytes to read back (for images, the size of the tightly packed texels of the region)
+    u64                         size;
+} vc_readback_region;
+
+/**
+ * @brief Records a copy of a buffer or an image region into host memory
+ *
+ * @param record The recording context
+ * @param source A buffer, or an image created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+ * @param region The region to read back
+ * @return A ticket, to poll or wait on (0 on failure)
+ * @note The ticket completes when the frame in which it was recorded finishes on the GPU, so the command buffer must be
+ *       submitted before vc_frame_end.
+ * @note Image regions are read one aspect at a time, and are rejected if size is smaller than their tightly packed texels.
+ */
+vc_readback_ticket vc_cmd_readback(vc_cmd_record record, vc_handle source, vc_readback_region region);
+
+/**
+ * @brief Checks, without blocking, wether a readback is complete
+ *
+ * @param ctx The vulcain context
+ * @param ticket The readback ticket
+ * @param data Set to the mapped data if the readback is complete (may be NULL)
+ * @return TRUE if the readback is complete
+ */
+b8                 vc_readback_poll(vc_ctx *ctx, vc_readback_ticket ticket, void **data);
+
+/**
+ * @brief Blocks until a readback is complete
+ *
+ * @param ctx The vulcain context
+ * @param ticket The readback ticket
+ * @return The mapped data, valid until the ticket is released (NULL if the ticket is invalid or its frame was not
+ *         ended yet)
+ * @note The frame of the readback must have been ended.
+ */
+void              *vc_readback_wait(vc_ctx *ctx, vc_readback_ticket ticket);
+
+/**
+ * @brief Releases a readback, its memory goes back to the pool
+ *
+ * @param ctx The vulcain context
+ * @param ticket The readback ticket
+ * @note The frame of the readback must have been ended.
+ */
+void               vc_readback_release(vc_ctx *ctx, vc_readback_ticket ticket);
+
+/**
+ * @brief Records one defragmentation step (copies and barriers) into the command buffer
+ *
+ * @param record The recording context
+ * @return TRUE if moves were recorded
+ * @note Record it before any other use of buffers and images in the frame, and submit it before vc_frame_end.
+ *       Only one step can be in flight at once, FALSE is returned until the previous one retires.
+ */
+b8   vc_cmd_defrag_step(vc_cmd_record    record);
+
+/**
+ * @brief Records every pending upload (copies, mip generation and layout transitions) into the command buffer
+ *
+ * @param record The recording context
+ * @note Meant to be called once per frame, before the uploaded images are used, and submitted before vc_frame_end.
+ */
+void vc_cmd_flush_uploads(vc_cmd_record    record);
+
 // dynamic rendering
 void vc_cmd_begin_rendering(vc_cmd_record record, vc_rendering_info info);
 void vc_cmd_end_rendering(vc_cmd_record    record);